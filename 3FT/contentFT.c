@@ -0,0 +1,1782 @@
+/*--------------------------------------------------------------------*/
+/* contentFT.c                                                        */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+/* for pread, pwrite, and mmap under a strict -std */
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include "contentFT.h"
+#include "lzFT.h"
+
+/* The class of a cell that is part of a block of stored contents */
+#define STORED_CLASS 0xffffU
+
+/* The class of a cell allocated on its own, as its contents are too
+   long for any of the heap's size classes */
+#define LARGE_CLASS 0xfffeU
+
+/* The class of the cell of chunked contents, and of one of their
+   chunks */
+#define CHUNKED_CLASS 0xfffdU
+#define CHUNK_CLASS 0xfffcU
+
+/* The class of the cell of packed contents */
+#define PACKED_CLASS 0xfffbU
+
+/* The class of the cell of tiered contents */
+#define TIERED_CLASS 0xfffaU
+
+/* The class of the cell of mapped contents */
+#define MAPPED_CLASS 0xfff9U
+
+/* The size of the chunks of chunked contents, and of the pieces all
+   contents are hashed in */
+enum {CHUNK_SIZE = 4096};
+
+/* The header of the contents the store and the heap hold, just before
+   their bytes */
+struct cell
+{
+    /* the number of references to the contents */
+    unsigned int uRefs;
+
+    /* the index of the cell's size class in aulCellSizes, or one of
+       the *_CLASS classes */
+    unsigned int uClass : 16;
+
+    /* 1 if the contents were touched since Content_cool last looked
+       at them */
+    unsigned int uTouched : 1;
+};
+
+/* A block of stored contents, whose bytes follow it */
+struct block
+{
+    /* the next block in the same bucket of the table */
+    struct block *psNext;
+
+    /* the hash of the bytes, as Content_hash computes it */
+    uint64_t ulHash;
+
+    /* the number of bytes */
+    size_t ulLength;
+
+    /* the last count the block was counted in: see Content_countOnce */
+    size_t ulCounted;
+
+    /* the header of the bytes, which must come last */
+    struct cell sCell;
+};
+
+/* Chunked contents: a length and an array of chunks of CHUNK_SIZE
+   bytes, each a cell of CHUNK_CLASS with its bytes after it, counting
+   the chunked contents sharing it. The bytes of the chunks past the
+   length are always 0. */
+struct chunked
+{
+    /* the last count the contents were counted in */
+    size_t ulCounted;
+
+    /* the number of bytes */
+    size_t ulLength;
+
+    /* the number of chunks, which cover at least ulLength bytes, and
+       the room for them in ppsChunks and pulHashes */
+    size_t ulNumChunks;
+    size_t ulCapacity;
+
+    /* the chunks, and the hash of each one's piece of the bytes */
+    struct cell **ppsChunks;
+    uint64_t *pulHashes;
+
+    /* the sum of the hashes of the pieces within ulLength */
+    uint64_t ulSum;
+
+    /* the bytes in one block, as Content_flatten last made them, or
+       NULL */
+    char *pcFlat;
+
+    /* the header of the contents, which must come last */
+    struct cell sCell;
+};
+
+/* Packed contents: the bytes of some contents compressed with
+   Lz_compress, which follow them, or the bytes themselves if they do
+   not compress */
+struct packed
+{
+    /* the last count the contents were counted in */
+    size_t ulCounted;
+
+    /* the number of bytes, and the number of them packed, which is
+       ulLength if they are kept as they are */
+    size_t ulLength;
+    size_t ulPacked;
+
+    /* the hash of the bytes, as Content_hash computes it */
+    uint64_t ulHash;
+
+    /* the header of the contents, which must come last */
+    struct cell sCell;
+};
+
+/* The number of packed contents whose bytes are kept unpacked */
+enum {NUM_UNPACKED = 8};
+
+/* Packed contents whose bytes are kept unpacked */
+struct unpacked
+{
+    /* the packed contents, or NULL if the slot is free */
+    const void *pvPacked;
+
+    /* their bytes */
+    char *pcBytes;
+
+    /* when the slot was last used, in Content_unpack calls */
+    size_t ulUsed;
+};
+
+/* A spill file, that tiered contents are written out to once */
+struct spill
+{
+    /* the file's descriptor */
+    int iFd;
+
+    /* the number of bytes written to the file, after which the next
+       contents go */
+    size_t ulEnd;
+
+    /* the number of tiered contents written to the file, plus 1 while
+       contents are spilled to it */
+    size_t ulRefs;
+};
+
+/* Tiered contents: bytes kept in memory while they are used, and read
+   back from a spill file when they were written out to make room */
+struct tiered
+{
+    /* the last count the contents were counted in */
+    size_t ulCounted;
+
+    /* the number of bytes */
+    size_t ulLength;
+
+    /* the hash of the bytes, as Content_hash computes it */
+    uint64_t ulHash;
+
+    /* the bytes in memory, or NULL if they are only in the spill file */
+    char *pcBytes;
+
+    /* the spill file the bytes were written to, and where in it, or
+       NULL if they were not written out yet */
+    struct spill *psSpill;
+    size_t ulOffset;
+
+    /* the contents used just after and just before these, among the
+       tiered contents in memory */
+    struct tiered *psNewer;
+    struct tiered *psOlder;
+
+    /* the header of the contents, which must come last */
+    struct cell sCell;
+};
+
+/* Mapped contents: bytes of a file, mapped into memory read-only */
+struct mapped
+{
+    /* the last count the contents were counted in */
+    size_t ulCounted;
+
+    /* the number of bytes */
+    size_t ulLength;
+
+    /* the hash of the bytes, as Content_hash computes it */
+    uint64_t ulHash;
+
+    /* the mapping, which starts at the page the bytes start in, and
+       its length */
+    void *pvMap;
+    size_t ulMapLength;
+
+    /* the bytes, within the mapping */
+    const char *pcBytes;
+
+    /* the header of the contents, which must come last */
+    struct cell sCell;
+};
+
+/* The sizes of the heap's cells, header included, in increasing
+   order: fine steps for the many short contents, then powers of 2 */
+static const size_t aulCellSizes[] =
+    {16, 32, 48, 64, 80, 96, 112, 128, 256, 512, 1024, 2048, 4096};
+
+/* The number of size classes */
+enum {NUM_CLASSES = sizeof(aulCellSizes) / sizeof(aulCellSizes[0])};
+
+/* The size of the slabs that cells are carved from */
+enum {SLAB_SIZE = 65536};
+
+/* A slab of cells of one size class, which follow it */
+struct slab
+{
+    /* the slab allocated before this one */
+    struct slab *psNext;
+
+    /* padding, so that cells are aligned as malloc aligns */
+    double dAlign;
+};
+
+/* A size class of the heap */
+struct sizeClass
+{
+    /* the first free cell of the class, whose bytes hold the next */
+    struct cell *psFree;
+
+    /* the part of the newest slab of the class not carved yet */
+    char *pcBump;
+    char *pcEnd;
+};
+
+/* The heap's size classes */
+static struct sizeClass asClasses[NUM_CLASSES];
+
+/* All the heap's slabs, newest first */
+static struct slab *psSlabs;
+
+/* The number of cells the heap holds, slabs' and large ones */
+static size_t ulNumCells;
+
+/* The table of all stored blocks, chained in buckets by hash */
+static struct block **ppsBuckets;
+
+/* The number of buckets, a power of 2 (0 until the first block), and
+   the number of blocks */
+static size_t ulNumBuckets;
+static size_t ulNumBlocks;
+
+/* The statistics Content_getStats reports */
+static size_t ulInterned;
+static size_t ulHits;
+static size_t ulStored;
+static size_t ulSaved;
+
+/* The last count number handed out by Content_newCount */
+static size_t ulLastCount;
+
+/* The cache of unpacked bytes: NUM_UNPACKED slots, or more while
+   Content_holdBytes holds them, and the number of slots */
+static struct unpacked asFixedSlots[NUM_UNPACKED];
+static struct unpacked *psSlots = asFixedSlots;
+static size_t ulNumSlots = NUM_UNPACKED;
+
+/* TRUE while Content_holdBytes holds the unpacked and paged in bytes */
+static boolean bHolding;
+
+/* The number of calls to Content_unpack so far */
+static size_t ulUnpacks;
+
+/* The statistics Content_getPackStats reports */
+static size_t ulPackedFrom;
+static size_t ulPackedTo;
+static size_t ulUnpackHits;
+static size_t ulUnpackMisses;
+static clock_t ctPacking;
+static clock_t ctUnpacking;
+
+/* The spill file tiered contents are written out to, or NULL if none
+   are, and the number of bytes of tiered contents that may be kept in
+   memory while they are */
+static struct spill *psCurrentSpill;
+static size_t ulBudget;
+
+/* The tiered contents in memory, from the most recently used to the
+   least */
+static struct tiered *psNewest;
+static struct tiered *psOldest;
+
+/* The statistics Content_getSpillStats reports */
+static size_t ulResident;
+static size_t ulOnDisk;
+static size_t ulPageIns;
+static size_t ulPageOuts;
+
+uint64_t Content_mix(uint64_t ulHash)
+{
+    /* the constants are built from 32-bit halves, as -ansi -pedantic
+       warns about 64-bit literals, though it lets <stdint.h> give
+       uint64_t */
+    ulHash ^= ulHash >> 30;
+    ulHash *= (uint64_t)0xbf58476dU << 32 | 0x1ce4e5b9U;
+    ulHash ^= ulHash >> 27;
+    ulHash *= (uint64_t)0x94d049bbU << 32 | 0x133111ebU;
+    ulHash ^= ulHash >> 31;
+    return ulHash;
+}
+
+/* Returns the header of the contents pvContents. */
+static struct cell *Content_getCell(const void *pvContents)
+{
+    assert(pvContents != NULL);
+    return (struct cell *)pvContents - 1;
+}
+
+/* Returns the chunked contents pvContents. */
+static struct chunked *Content_getChunked(const void *pvContents)
+{
+    assert(Content_getCell(pvContents)->uClass == CHUNKED_CLASS);
+    return (struct chunked *)((const char *)pvContents -
+                              sizeof(struct chunked));
+}
+
+/* Returns the packed contents pvContents. */
+static struct packed *Content_getPacked(const void *pvContents)
+{
+    assert(Content_getCell(pvContents)->uClass == PACKED_CLASS);
+    return (struct packed *)((const char *)pvContents -
+                             sizeof(struct packed));
+}
+
+/* Returns the tiered contents pvContents. */
+static struct tiered *Content_getTiered(const void *pvContents)
+{
+    assert(Content_getCell(pvContents)->uClass == TIERED_CLASS);
+    return (struct tiered *)((const char *)pvContents -
+                             sizeof(struct tiered));
+}
+
+/* Returns the mapped contents pvContents. */
+static struct mapped *Content_getMappedOf(const void *pvContents)
+{
+    assert(Content_getCell(pvContents)->uClass == MAPPED_CLASS);
+    return (struct mapped *)((const char *)pvContents -
+                             sizeof(struct mapped));
+}
+
+/* Returns the block whose bytes are at pvContents, which must be
+   stored contents. */
+static struct block *Content_getBlock(const void *pvContents)
+{
+    assert(Content_getCell(pvContents)->uClass == STORED_CLASS);
+    return (struct block *)((const char *)pvContents -
+                            sizeof(struct block));
+}
+
+/*
+  Doubles the number of buckets (or makes the first 64), and rehashes
+  every block into them. Returns SUCCESS, or MEMORY_ERROR if memory
+  could not be allocated, in which case the table is unchanged.
+*/
+static int Content_grow(void)
+{
+    size_t ulNewNumBuckets = ulNumBuckets == 0 ? 64 : 2 * ulNumBuckets;
+    struct block **ppsNew;
+    size_t i;
+
+    ppsNew = calloc(ulNewNumBuckets, sizeof(struct block *));
+    if (ppsNew == NULL)
+        return MEMORY_ERROR;
+    for (i = 0; i < ulNumBuckets; i++)
+    {
+        while (ppsBuckets[i] != NULL)
+        {
+            struct block *psBlock = ppsBuckets[i];
+            size_t ulBucket = (size_t)psBlock->ulHash &
+                              (ulNewNumBuckets - 1);
+            ppsBuckets[i] = psBlock->psNext;
+            psBlock->psNext = ppsNew[ulBucket];
+            ppsNew[ulBucket] = psBlock;
+        }
+    }
+    free(ppsBuckets);
+    ppsBuckets = ppsNew;
+    ulNumBuckets = ulNewNumBuckets;
+    return SUCCESS;
+}
+
+/* Returns the hash of piece number ulPiece of some contents, the
+   ulLength bytes at pucBytes. */
+static uint64_t Content_hashPiece(size_t ulPiece,
+                                  const unsigned char *pucBytes,
+                                  size_t ulLength)
+{
+    uint64_t ulHash = Content_mix((uint64_t)ulPiece);
+    uint64_t ulWord;
+    size_t i = 0;
+
+    /* 8 bytes at a time, then what is left */
+    for (; i + sizeof(ulWord) <= ulLength; i += sizeof(ulWord))
+    {
+        memcpy(&ulWord, pucBytes + i, sizeof(ulWord));
+        ulHash = Content_mix(ulHash ^ ulWord);
+    }
+    if (i < ulLength)
+    {
+        ulWord = 0;
+        memcpy(&ulWord, pucBytes + i, ulLength - i);
+        ulHash = Content_mix(ulHash ^ ulWord);
+    }
+    return ulHash;
+}
+
+/* Returns the hash of contents of ulLength bytes whose pieces' hashes
+   sum to ulSum. */
+static uint64_t Content_finish(size_t ulLength, uint64_t ulSum)
+{
+    return Content_mix(Content_mix((uint64_t)ulLength) + ulSum);
+}
+
+uint64_t Content_hash(const void *pvBytes, size_t ulLength)
+{
+    const unsigned char *pucBytes = pvBytes;
+    uint64_t ulSum = 0;
+    size_t i;
+
+    /* the pieces are those of chunked contents, whose hash can then
+       be kept up to date a chunk at a time */
+    for (i = 0; i < ulLength; i += CHUNK_SIZE)
+        ulSum += Content_hashPiece(i / CHUNK_SIZE, pucBytes + i,
+                                   ulLength - i < CHUNK_SIZE ?
+                                   ulLength - i : CHUNK_SIZE);
+    return Content_finish(ulLength, ulSum);
+}
+
+int Content_intern(const void *pvBytes, size_t ulLength,
+                   void **ppvResult)
+{
+    uint64_t ulHash;
+    struct block *psBlock;
+    size_t ulBucket;
+
+    assert(pvBytes != NULL || ulLength == 0);
+    assert(ppvResult != NULL);
+
+    *ppvResult = NULL;
+    ulHash = Content_hash(pvBytes, ulLength);
+
+    /* the same bytes may be stored already */
+    if (ulNumBuckets != 0)
+    {
+        for (psBlock = ppsBuckets[(size_t)ulHash & (ulNumBuckets - 1)];
+             psBlock != NULL; psBlock = psBlock->psNext)
+        {
+            if (psBlock->ulHash == ulHash &&
+                psBlock->ulLength == ulLength &&
+                (ulLength == 0 ||
+                 memcmp(psBlock + 1, pvBytes, ulLength) == 0))
+            {
+                ulInterned++;
+                ulHits++;
+                *ppvResult = psBlock + 1;
+                assert(psBlock->sCell.uRefs < UINT_MAX);
+                Content_retain(*ppvResult);
+                psBlock->sCell.uTouched = 1;
+                return SUCCESS;
+            }
+        }
+    }
+
+    /* keep at most one block per bucket on average, though longer
+       chains only slow lookups down */
+    if (ulNumBlocks >= ulNumBuckets && Content_grow() != SUCCESS &&
+        ulNumBuckets == 0)
+        return MEMORY_ERROR;
+    psBlock = malloc(sizeof(struct block) + ulLength);
+    if (psBlock == NULL)
+        return MEMORY_ERROR;
+    psBlock->ulHash = ulHash;
+    psBlock->ulLength = ulLength;
+    psBlock->sCell.uRefs = 1;
+    psBlock->sCell.uClass = STORED_CLASS;
+    psBlock->sCell.uTouched = 1;
+    psBlock->ulCounted = 0;
+    if (ulLength != 0)
+        memcpy(psBlock + 1, pvBytes, ulLength);
+    ulBucket = (size_t)ulHash & (ulNumBuckets - 1);
+    psBlock->psNext = ppsBuckets[ulBucket];
+    ppsBuckets[ulBucket] = psBlock;
+    ulNumBlocks++;
+    ulInterned++;
+    ulStored += ulLength;
+
+    *ppvResult = psBlock + 1;
+    return SUCCESS;
+}
+
+/*
+  Takes a cell of size class uClass from the heap, carving a new slab
+  if the class has no free cells left. Returns it, or NULL if memory
+  could not be allocated.
+*/
+static struct cell *Content_heapAlloc(unsigned int uClass)
+{
+    struct sizeClass *psClass = &asClasses[uClass];
+    struct cell *psCell = psClass->psFree;
+
+    if (psCell != NULL)
+    {
+        memcpy(&psClass->psFree, psCell + 1, sizeof(struct cell *));
+        return psCell;
+    }
+    if (psClass->pcBump == psClass->pcEnd)
+    {
+        struct slab *psSlab = malloc(SLAB_SIZE);
+        if (psSlab == NULL)
+            return NULL;
+        psSlab->psNext = psSlabs;
+        psSlabs = psSlab;
+        psClass->pcBump = (char *)(psSlab + 1);
+        psClass->pcEnd = psClass->pcBump +
+            (SLAB_SIZE - sizeof(struct slab)) / aulCellSizes[uClass] *
+            aulCellSizes[uClass];
+    }
+    psCell = (struct cell *)psClass->pcBump;
+    psClass->pcBump += aulCellSizes[uClass];
+    return psCell;
+}
+
+/* Gives back all of the heap's slabs, once it holds no cells. */
+static void Content_heapReset(void)
+{
+    size_t i;
+
+    assert(ulNumCells == 0);
+
+    while (psSlabs != NULL)
+    {
+        struct slab *psNext = psSlabs->psNext;
+        free(psSlabs);
+        psSlabs = psNext;
+    }
+    for (i = 0; i < NUM_CLASSES; i++)
+    {
+        asClasses[i].psFree = NULL;
+        asClasses[i].pcBump = NULL;
+        asClasses[i].pcEnd = NULL;
+    }
+}
+
+/*
+  Allocates room for ulLength bytes in the content heap, with one
+  reference to them, without filling it in. Returns SUCCESS and sets
+  *ppvResult to the room, or returns MEMORY_ERROR and sets *ppvResult
+  to NULL.
+*/
+static int Content_ownRoom(size_t ulLength, void **ppvResult)
+{
+    struct cell *psCell;
+    unsigned int uClass = 0;
+
+    *ppvResult = NULL;
+
+    /* the smallest class the bytes fit in, if any */
+    while (uClass < NUM_CLASSES &&
+           aulCellSizes[uClass] - sizeof(struct cell) < ulLength)
+        uClass++;
+    if (uClass < NUM_CLASSES)
+        psCell = Content_heapAlloc(uClass);
+    else
+    {
+        if (ulLength > (size_t)-1 - sizeof(struct cell))
+            return MEMORY_ERROR;
+        psCell = malloc(sizeof(struct cell) + ulLength);
+        uClass = LARGE_CLASS;
+    }
+    if (psCell == NULL)
+        return MEMORY_ERROR;
+
+    psCell->uRefs = 1;
+    psCell->uClass = uClass;
+    psCell->uTouched = 1;
+    ulNumCells++;
+
+    *ppvResult = psCell + 1;
+    return SUCCESS;
+}
+
+int Content_own(const void *pvBytes, size_t ulLength, void **ppvResult)
+{
+    int iStatus;
+
+    assert(pvBytes != NULL || ulLength == 0);
+    assert(ppvResult != NULL);
+
+    iStatus = Content_ownRoom(ulLength, ppvResult);
+    if (iStatus == SUCCESS && ulLength != 0)
+        memcpy(*ppvResult, pvBytes, ulLength);
+    return iStatus;
+}
+
+int Content_getKind(const void *pvContents)
+{
+    switch (Content_getCell(pvContents)->uClass)
+    {
+    case STORED_CLASS:
+        return CONTENT_STORED;
+    case CHUNKED_CLASS:
+        return CONTENT_CHUNKED;
+    case PACKED_CLASS:
+        return CONTENT_PACKED;
+    case TIERED_CLASS:
+        return CONTENT_TIERED;
+    case MAPPED_CLASS:
+        return CONTENT_MAPPED;
+    default:
+        return CONTENT_HEAP;
+    }
+}
+
+int Content_chunk(const void *pvBytes, size_t ulLength, void **ppvResult)
+{
+    struct chunked *psChunked;
+    int iStatus;
+
+    assert(pvBytes != NULL || ulLength == 0);
+    assert(ppvResult != NULL);
+
+    *ppvResult = NULL;
+    psChunked = calloc(1, sizeof(struct chunked));
+    if (psChunked == NULL)
+        return MEMORY_ERROR;
+    psChunked->sCell.uRefs = 1;
+    psChunked->sCell.uClass = CHUNKED_CLASS;
+    psChunked->sCell.uTouched = 1;
+    ulNumCells++;
+
+    *ppvResult = psChunked + 1;
+    iStatus = Content_write(ppvResult, 0, pvBytes, ulLength);
+    if (iStatus != SUCCESS)
+    {
+        Content_release(*ppvResult);
+        *ppvResult = NULL;
+    }
+    return iStatus;
+}
+
+/*
+  Replaces the chunked contents *ppvContents, which others share, with
+  a copy of them for the caller alone, sharing their chunks, and drops
+  the caller's reference to the original. Returns SUCCESS, or
+  MEMORY_ERROR if memory could not be allocated, in which case
+  *ppvContents is unchanged.
+*/
+static int Content_unshare(void **ppvContents)
+{
+    struct chunked *psOld = Content_getChunked(*ppvContents);
+    struct chunked *psNew;
+    size_t i;
+
+    psNew = malloc(sizeof(struct chunked));
+    if (psNew == NULL)
+        return MEMORY_ERROR;
+    *psNew = *psOld;
+    psNew->ulCapacity = psOld->ulNumChunks;
+    psNew->ppsChunks = malloc(psNew->ulCapacity * sizeof(struct cell *) +
+                              1);
+    psNew->pulHashes = malloc(psNew->ulCapacity * sizeof(uint64_t) + 1);
+    if (psNew->ppsChunks == NULL || psNew->pulHashes == NULL)
+    {
+        free(psNew->ppsChunks);
+        free(psNew->pulHashes);
+        free(psNew);
+        return MEMORY_ERROR;
+    }
+    memcpy(psNew->ppsChunks, psOld->ppsChunks,
+           psOld->ulNumChunks * sizeof(struct cell *));
+    memcpy(psNew->pulHashes, psOld->pulHashes,
+           psOld->ulNumChunks * sizeof(uint64_t));
+    for (i = 0; i < psNew->ulNumChunks; i++)
+        psNew->ppsChunks[i]->uRefs++;
+    psNew->pcFlat = NULL;
+    psNew->sCell.uRefs = 1;
+    ulNumCells++;
+
+    Content_release(*ppvContents);
+    *ppvContents = psNew + 1;
+    return SUCCESS;
+}
+
+/*
+  Readies chunks ulFirst to ulLast of psChunked to be written: makes
+  room for them, adds the ones missing, filled with 0, and copies the
+  ones other chunked contents share. Returns SUCCESS, or MEMORY_ERROR
+  if memory could not be allocated, in which case psChunked holds the
+  same bytes as before.
+*/
+static int Content_readyChunks(struct chunked *psChunked, size_t ulFirst,
+                               size_t ulLast)
+{
+    size_t c;
+
+    if (ulLast >= psChunked->ulCapacity)
+    {
+        size_t ulNewCapacity = psChunked->ulCapacity == 0 ? 4 :
+                               2 * psChunked->ulCapacity;
+        struct cell **ppsNewChunks;
+        uint64_t *pulNewHashes;
+
+        while (ulNewCapacity <= ulLast)
+            ulNewCapacity *= 2;
+        if (ulNewCapacity > (size_t)-1 / sizeof(uint64_t))
+            return MEMORY_ERROR;
+        ppsNewChunks = realloc(psChunked->ppsChunks,
+                               ulNewCapacity * sizeof(struct cell *));
+        if (ppsNewChunks == NULL)
+            return MEMORY_ERROR;
+        psChunked->ppsChunks = ppsNewChunks;
+        pulNewHashes = realloc(psChunked->pulHashes,
+                               ulNewCapacity * sizeof(uint64_t));
+        if (pulNewHashes == NULL)
+            return MEMORY_ERROR;
+        psChunked->pulHashes = pulNewHashes;
+        psChunked->ulCapacity = ulNewCapacity;
+    }
+
+    for (c = ulFirst; c <= ulLast; c++)
+    {
+        struct cell *psChunk;
+
+        if (c == psChunked->ulNumChunks)
+        {
+            psChunk = calloc(1, sizeof(struct cell) + CHUNK_SIZE);
+            if (psChunk == NULL)
+                return MEMORY_ERROR;
+            psChunk->uRefs = 1;
+            psChunk->uClass = CHUNK_CLASS;
+            psChunked->ppsChunks[c] = psChunk;
+            psChunked->ulNumChunks++;
+        }
+        else if (psChunked->ppsChunks[c]->uRefs > 1)
+        {
+            psChunk = malloc(sizeof(struct cell) + CHUNK_SIZE);
+            if (psChunk == NULL)
+                return MEMORY_ERROR;
+            memcpy(psChunk, psChunked->ppsChunks[c],
+                   sizeof(struct cell) + CHUNK_SIZE);
+            psChunk->uRefs = 1;
+            psChunked->ppsChunks[c]->uRefs--;
+            psChunked->ppsChunks[c] = psChunk;
+        }
+    }
+    return SUCCESS;
+}
+
+int Content_write(void **ppvContents, size_t ulOffset,
+                  const void *pvBytes, size_t ulLength)
+{
+    struct chunked *psChunked;
+    size_t ulEnd, ulNewLength, ulFirst, ulLast, c;
+    int iStatus;
+
+    assert(ppvContents != NULL);
+    assert(pvBytes != NULL || ulLength == 0);
+
+    if (ulLength == 0)
+        return SUCCESS;
+    if (ulOffset > (size_t)-1 - ulLength)
+        return MEMORY_ERROR;
+    if (Content_getCell(*ppvContents)->uRefs > 1)
+    {
+        iStatus = Content_unshare(ppvContents);
+        if (iStatus != SUCCESS)
+            return iStatus;
+    }
+    psChunked = Content_getChunked(*ppvContents);
+
+    /* the chunks whose bytes change, from the first byte written, or
+       the end of the bytes if the write starts past it, to the last
+       byte written */
+    ulEnd = ulOffset + ulLength;
+    ulNewLength = ulEnd > psChunked->ulLength ? ulEnd
+                                              : psChunked->ulLength;
+    ulFirst = (ulOffset < psChunked->ulLength ? ulOffset
+                                              : psChunked->ulLength) /
+              CHUNK_SIZE;
+    ulLast = (ulEnd - 1) / CHUNK_SIZE;
+    iStatus = Content_readyChunks(psChunked, ulFirst, ulLast);
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    /* copy the bytes in, and rehash each piece they change */
+    for (c = ulFirst; c <= ulLast; c++)
+    {
+        char *pcChunk = (char *)(psChunked->ppsChunks[c] + 1);
+        size_t ulStart = c * CHUNK_SIZE;
+        size_t ulFrom = ulOffset > ulStart ? ulOffset : ulStart;
+        size_t ulTo = ulEnd < ulStart + CHUNK_SIZE ? ulEnd
+                                                   : ulStart + CHUNK_SIZE;
+
+        if (ulFrom < ulTo)
+            memcpy(pcChunk + (ulFrom - ulStart),
+                   (const char *)pvBytes + (ulFrom - ulOffset),
+                   ulTo - ulFrom);
+        if (ulStart < psChunked->ulLength)
+            psChunked->ulSum -= psChunked->pulHashes[c];
+        psChunked->pulHashes[c] = Content_hashPiece(
+            c, (const unsigned char *)pcChunk,
+            ulNewLength - ulStart < CHUNK_SIZE ? ulNewLength - ulStart
+                                               : CHUNK_SIZE);
+        psChunked->ulSum += psChunked->pulHashes[c];
+    }
+    psChunked->ulLength = ulNewLength;
+    psChunked->sCell.uTouched = 1;
+    free(psChunked->pcFlat);
+    psChunked->pcFlat = NULL;
+    return SUCCESS;
+}
+
+size_t Content_read(const void *pvContents, size_t ulOffset,
+                    void *pvBuf, size_t ulLength)
+{
+    struct chunked *psChunked = Content_getChunked(pvContents);
+    size_t ulDone = 0;
+
+    assert(pvBuf != NULL || ulLength == 0);
+
+    if (ulOffset >= psChunked->ulLength)
+        return 0;
+    if (ulLength > psChunked->ulLength - ulOffset)
+        ulLength = psChunked->ulLength - ulOffset;
+    while (ulDone < ulLength)
+    {
+        size_t ulAt = ulOffset + ulDone;
+        size_t ulIn = CHUNK_SIZE - ulAt % CHUNK_SIZE;
+
+        if (ulIn > ulLength - ulDone)
+            ulIn = ulLength - ulDone;
+        memcpy((char *)pvBuf + ulDone,
+               (const char *)(psChunked->ppsChunks[ulAt / CHUNK_SIZE] + 1) +
+               ulAt % CHUNK_SIZE, ulIn);
+        ulDone += ulIn;
+    }
+    return ulLength;
+}
+
+void *Content_flatten(const void *pvContents)
+{
+    struct chunked *psChunked = Content_getChunked(pvContents);
+
+    if (psChunked->pcFlat == NULL)
+    {
+        psChunked->pcFlat = malloc(psChunked->ulLength + 1);
+        if (psChunked->pcFlat != NULL)
+            (void)Content_read(pvContents, 0, psChunked->pcFlat,
+                               psChunked->ulLength);
+    }
+    return psChunked->pcFlat;
+}
+
+int Content_pack(void **ppvContents, size_t ulLength, uint64_t ulHash)
+{
+    const void *pvBytes = *ppvContents;
+    struct packed *psPacked;
+    struct packed *psShrunk;
+    size_t ulPacked;
+    clock_t ctStart;
+
+    assert(ppvContents != NULL);
+    assert(Content_getKind(*ppvContents) != CONTENT_PACKED);
+
+    if (Content_getKind(pvBytes) == CONTENT_CHUNKED)
+    {
+        pvBytes = Content_flatten(pvBytes);
+        if (pvBytes == NULL)
+            return MEMORY_ERROR;
+    }
+    if (ulLength > (size_t)-1 - sizeof(struct packed))
+        return MEMORY_ERROR;
+    psPacked = malloc(sizeof(struct packed) + ulLength);
+    if (psPacked == NULL)
+        return MEMORY_ERROR;
+
+    /* bytes that do not shrink are kept as they are */
+    ctStart = clock();
+    ulPacked = ulLength == 0 ? 0 : Lz_compress(pvBytes, ulLength,
+                                               psPacked + 1, ulLength - 1);
+    ctPacking += clock() - ctStart;
+    if (ulPacked == 0)
+    {
+        if (ulLength != 0)
+            memcpy(psPacked + 1, pvBytes, ulLength);
+        ulPacked = ulLength;
+    }
+    else
+    {
+        psShrunk = realloc(psPacked, sizeof(struct packed) + ulPacked);
+        if (psShrunk != NULL)
+            psPacked = psShrunk;
+    }
+    psPacked->ulCounted = 0;
+    psPacked->ulLength = ulLength;
+    psPacked->ulPacked = ulPacked;
+    psPacked->ulHash = ulHash;
+    psPacked->sCell.uRefs = 1;
+    psPacked->sCell.uClass = PACKED_CLASS;
+    psPacked->sCell.uTouched = 0;
+    ulNumCells++;
+    ulPackedFrom += ulLength;
+    ulPackedTo += ulPacked;
+
+    Content_release(*ppvContents);
+    *ppvContents = psPacked + 1;
+    return SUCCESS;
+}
+
+/* Frees the unpacked bytes in the cache's slot psSlot, and frees the
+   slot. */
+static void Content_freeSlot(struct unpacked *psSlot)
+{
+    free(psSlot->pcBytes);
+    psSlot->pvPacked = NULL;
+    psSlot->pcBytes = NULL;
+}
+
+/*
+  Returns a free slot of the cache: a free one, or, while the cache is
+  held, a new one, or else the least recently used one, freed. Returns
+  NULL if memory could not be allocated.
+*/
+static struct unpacked *Content_takeSlot(void)
+{
+    struct unpacked *psVictim = &psSlots[0];
+    struct unpacked *psNewSlots;
+    size_t i;
+
+    for (i = 0; i < ulNumSlots; i++)
+    {
+        if (psSlots[i].pvPacked == NULL)
+            return &psSlots[i];
+        if (psSlots[i].ulUsed < psVictim->ulUsed)
+            psVictim = &psSlots[i];
+    }
+    if (!bHolding)
+    {
+        Content_freeSlot(psVictim);
+        return psVictim;
+    }
+
+    psNewSlots = malloc(2 * ulNumSlots * sizeof(struct unpacked));
+    if (psNewSlots == NULL)
+        return NULL;
+    memcpy(psNewSlots, psSlots, ulNumSlots * sizeof(struct unpacked));
+    memset(psNewSlots + ulNumSlots, 0,
+           ulNumSlots * sizeof(struct unpacked));
+    if (psSlots != asFixedSlots)
+        free(psSlots);
+    psSlots = psNewSlots;
+    ulNumSlots *= 2;
+    return &psSlots[ulNumSlots / 2];
+}
+
+const void *Content_unpack(const void *pvContents)
+{
+    struct packed *psPacked = Content_getPacked(pvContents);
+    struct unpacked *psSlot;
+    char *pcBytes;
+    clock_t ctStart;
+    size_t i;
+
+    Content_touch(pvContents);
+    if (psPacked->ulPacked == psPacked->ulLength)
+        return pvContents;
+
+    ulUnpacks++;
+    for (i = 0; i < ulNumSlots; i++)
+    {
+        if (psSlots[i].pvPacked == pvContents)
+        {
+            ulUnpackHits++;
+            psSlots[i].ulUsed = ulUnpacks;
+            return psSlots[i].pcBytes;
+        }
+    }
+
+    ulUnpackMisses++;
+    pcBytes = malloc(psPacked->ulLength);
+    if (pcBytes == NULL)
+        return NULL;
+    ctStart = clock();
+    Lz_decompress(pvContents, pcBytes, psPacked->ulLength);
+    ctUnpacking += clock() - ctStart;
+    psSlot = Content_takeSlot();
+    if (psSlot == NULL)
+    {
+        free(pcBytes);
+        return NULL;
+    }
+    psSlot->pvPacked = pvContents;
+    psSlot->pcBytes = pcBytes;
+    psSlot->ulUsed = ulUnpacks;
+    return pcBytes;
+}
+
+static void Content_enforceBudget(const struct tiered *psKeep);
+
+void Content_holdBytes(boolean bHold)
+{
+    size_t ulKept, i;
+
+    bHolding = bHold;
+    if (bHold)
+        return;
+    Content_enforceBudget(NULL);
+    if (psSlots == asFixedSlots)
+        return;
+
+    /* keep the most recently used bytes in the fixed slots */
+    for (ulKept = 0; ulKept < NUM_UNPACKED; ulKept++)
+    {
+        struct unpacked *psFresh = NULL;
+        for (i = 0; i < ulNumSlots; i++)
+            if (psSlots[i].pvPacked != NULL &&
+                (psFresh == NULL || psSlots[i].ulUsed > psFresh->ulUsed))
+                psFresh = &psSlots[i];
+        if (psFresh == NULL)
+            break;
+        asFixedSlots[ulKept] = *psFresh;
+        psFresh->pvPacked = NULL;
+        psFresh->pcBytes = NULL;
+    }
+    for (i = 0; i < ulNumSlots; i++)
+        if (psSlots[i].pvPacked != NULL)
+            Content_freeSlot(&psSlots[i]);
+    for (; ulKept < NUM_UNPACKED; ulKept++)
+    {
+        asFixedSlots[ulKept].pvPacked = NULL;
+        asFixedSlots[ulKept].pcBytes = NULL;
+    }
+    free(psSlots);
+    psSlots = asFixedSlots;
+    ulNumSlots = NUM_UNPACKED;
+}
+
+void Content_touch(const void *pvContents)
+{
+    Content_getCell(pvContents)->uTouched = 1;
+}
+
+boolean Content_cool(const void *pvContents)
+{
+    struct cell *psCell = Content_getCell(pvContents);
+
+    if (psCell->uTouched)
+    {
+        psCell->uTouched = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+size_t Content_getResidentLength(const void *pvContents)
+{
+    const struct tiered *psTiered;
+
+    if (Content_getCell(pvContents)->uClass == PACKED_CLASS)
+        return Content_getPacked(pvContents)->ulPacked;
+    psTiered = Content_getTiered(pvContents);
+    return psTiered->pcBytes == NULL ? 0 : psTiered->ulLength;
+}
+
+/* Drops a reference to psSpill, and closes and frees it if it was the
+   last. */
+static void Content_dropSpill(struct spill *psSpill)
+{
+    if (--psSpill->ulRefs != 0)
+        return;
+    (void)close(psSpill->iFd);
+    free(psSpill);
+}
+
+/* Makes psTiered, which is in memory, the most recently used of the
+   tiered contents in memory. */
+static void Content_pushNewest(struct tiered *psTiered)
+{
+    psTiered->psNewer = NULL;
+    psTiered->psOlder = psNewest;
+    if (psNewest != NULL)
+        psNewest->psNewer = psTiered;
+    else
+        psOldest = psTiered;
+    psNewest = psTiered;
+}
+
+/* Takes psTiered out of the list of tiered contents in memory. */
+static void Content_unlinkTiered(struct tiered *psTiered)
+{
+    if (psTiered->psNewer != NULL)
+        psTiered->psNewer->psOlder = psTiered->psOlder;
+    else
+        psNewest = psTiered->psOlder;
+    if (psTiered->psOlder != NULL)
+        psTiered->psOlder->psNewer = psTiered->psNewer;
+    else
+        psOldest = psTiered->psNewer;
+}
+
+/*
+  Writes psTiered's bytes out to the current spill file, unless they
+  were written out before, and frees them from memory. Returns
+  SUCCESS, or IO_ERROR if they could not be written, in which case
+  they stay in memory.
+*/
+static int Content_evict(struct tiered *psTiered)
+{
+    size_t ulDone = 0;
+
+    if (psTiered->psSpill == NULL)
+    {
+        /* the file is only ever appended to */
+        while (ulDone < psTiered->ulLength)
+        {
+            ssize_t lWritten = pwrite(psCurrentSpill->iFd,
+                                      psTiered->pcBytes + ulDone,
+                                      psTiered->ulLength - ulDone,
+                                      (off_t)(psCurrentSpill->ulEnd +
+                                              ulDone));
+            if (lWritten < 0 && errno == EINTR)
+                continue;
+            if (lWritten <= 0)
+                return IO_ERROR;
+            ulDone += (size_t)lWritten;
+        }
+        psTiered->psSpill = psCurrentSpill;
+        psTiered->ulOffset = psCurrentSpill->ulEnd;
+        psCurrentSpill->ulEnd += psTiered->ulLength;
+        psCurrentSpill->ulRefs++;
+        ulPageOuts++;
+    }
+    Content_unlinkTiered(psTiered);
+    free(psTiered->pcBytes);
+    psTiered->pcBytes = NULL;
+    ulResident -= psTiered->ulLength;
+    ulOnDisk += psTiered->ulLength;
+    return SUCCESS;
+}
+
+/*
+  Writes out the least recently used tiered contents in memory, other
+  than psKeep, until those in memory fit in the budget, if contents
+  are spilled and Content_holdBytes does not hold them. Stops at the
+  first that cannot be written.
+*/
+static void Content_enforceBudget(const struct tiered *psKeep)
+{
+    if (psCurrentSpill == NULL || bHolding)
+        return;
+    while (ulResident > ulBudget && psOldest != NULL &&
+           psOldest != psKeep)
+        if (Content_evict(psOldest) != SUCCESS)
+            return;
+}
+
+int Content_setSpill(const char *pcFile, size_t ulNewBudget)
+{
+    struct spill *psSpill = NULL;
+
+    if (pcFile != NULL)
+    {
+        psSpill = malloc(sizeof(struct spill));
+        if (psSpill == NULL)
+            return MEMORY_ERROR;
+        psSpill->iFd = open(pcFile, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (psSpill->iFd < 0)
+        {
+            free(psSpill);
+            return IO_ERROR;
+        }
+        /* the file lives as long as it is open, and no longer */
+        (void)unlink(pcFile);
+        psSpill->ulEnd = 0;
+        psSpill->ulRefs = 1;
+    }
+    if (psCurrentSpill != NULL)
+        Content_dropSpill(psCurrentSpill);
+    psCurrentSpill = psSpill;
+    ulBudget = ulNewBudget;
+    Content_enforceBudget(NULL);
+    return SUCCESS;
+}
+
+/* Returns new tiered contents with room for ulLength bytes in memory,
+   not filled in, or NULL if memory could not be allocated. */
+static struct tiered *Content_newTiered(size_t ulLength)
+{
+    struct tiered *psTiered = malloc(sizeof(struct tiered));
+
+    if (psTiered == NULL)
+        return NULL;
+    psTiered->pcBytes = malloc(ulLength + 1);
+    if (psTiered->pcBytes == NULL)
+    {
+        free(psTiered);
+        return NULL;
+    }
+    psTiered->ulLength = ulLength;
+    return psTiered;
+}
+
+/*
+  Finishes the new tiered contents psTiered, whose bytes are filled
+  in, with one reference to them, makes them the most recently used,
+  and writes out others until the budget holds. Returns them.
+*/
+static void *Content_addTiered(struct tiered *psTiered)
+{
+    psTiered->ulCounted = 0;
+    psTiered->ulHash = Content_hash(psTiered->pcBytes, psTiered->ulLength);
+    psTiered->psSpill = NULL;
+    psTiered->ulOffset = 0;
+    psTiered->sCell.uRefs = 1;
+    psTiered->sCell.uClass = TIERED_CLASS;
+    psTiered->sCell.uTouched = 1;
+    ulNumCells++;
+    Content_pushNewest(psTiered);
+    ulResident += psTiered->ulLength;
+
+    /* the contents used last stay too, as a file's old contents are
+       used just before its new contents replace them */
+    Content_enforceBudget(psTiered->psOlder != NULL ? psTiered->psOlder :
+                          psTiered);
+    return psTiered + 1;
+}
+
+int Content_tier(const void *pvBytes, size_t ulLength, void **ppvResult)
+{
+    struct tiered *psTiered;
+
+    assert(pvBytes != NULL || ulLength == 0);
+    assert(ppvResult != NULL);
+
+    *ppvResult = NULL;
+    psTiered = Content_newTiered(ulLength);
+    if (psTiered == NULL)
+        return MEMORY_ERROR;
+    if (ulLength != 0)
+        memcpy(psTiered->pcBytes, pvBytes, ulLength);
+    *ppvResult = Content_addTiered(psTiered);
+    return SUCCESS;
+}
+
+/* Reads ulLength bytes at offset ulOffset of the file open as iFd
+   into pvBuf. Returns SUCCESS, or IO_ERROR if they could not be, as
+   the file ends before them or reading it fails. */
+static int Content_readFd(int iFd, size_t ulOffset, void *pvBuf,
+                          size_t ulLength)
+{
+    size_t ulDone = 0;
+
+    while (ulDone < ulLength)
+    {
+        ssize_t lRead = pread(iFd, (char *)pvBuf + ulDone,
+                              ulLength - ulDone,
+                              (off_t)(ulOffset + ulDone));
+        if (lRead < 0 && errno == EINTR)
+            continue;
+        if (lRead <= 0)
+            return IO_ERROR;
+        ulDone += (size_t)lRead;
+    }
+    return SUCCESS;
+}
+
+int Content_page(const void *pvContents, const void **ppvBytes)
+{
+    struct tiered *psTiered = Content_getTiered(pvContents);
+    int iStatus;
+
+    assert(ppvBytes != NULL);
+
+    *ppvBytes = NULL;
+    Content_touch(pvContents);
+    if (psTiered->pcBytes != NULL)
+    {
+        Content_unlinkTiered(psTiered);
+        Content_pushNewest(psTiered);
+        *ppvBytes = psTiered->pcBytes;
+        return SUCCESS;
+    }
+
+    psTiered->pcBytes = malloc(psTiered->ulLength + 1);
+    if (psTiered->pcBytes == NULL)
+        return MEMORY_ERROR;
+    iStatus = Content_readFd(psTiered->psSpill->iFd, psTiered->ulOffset,
+                                psTiered->pcBytes, psTiered->ulLength);
+    if (iStatus != SUCCESS)
+    {
+        free(psTiered->pcBytes);
+        psTiered->pcBytes = NULL;
+        return iStatus;
+    }
+    ulPageIns++;
+    ulOnDisk -= psTiered->ulLength;
+    ulResident += psTiered->ulLength;
+    Content_pushNewest(psTiered);
+    Content_enforceBudget(psTiered);
+    *ppvBytes = psTiered->pcBytes;
+    return SUCCESS;
+}
+
+int Content_readTiered(const void *pvContents, size_t ulOffset,
+                       void *pvBuf, size_t ulLength, size_t *pulRead)
+{
+    struct tiered *psTiered = Content_getTiered(pvContents);
+    int iStatus = SUCCESS;
+
+    assert(pvBuf != NULL || ulLength == 0);
+    assert(pulRead != NULL);
+
+    *pulRead = 0;
+    Content_touch(pvContents);
+    if (ulOffset >= psTiered->ulLength)
+        return SUCCESS;
+    if (ulLength > psTiered->ulLength - ulOffset)
+        ulLength = psTiered->ulLength - ulOffset;
+
+    /* contents in memory count as used; the others are read in place,
+       without paging in the rest of them */
+    if (psTiered->pcBytes != NULL)
+    {
+        Content_unlinkTiered(psTiered);
+        Content_pushNewest(psTiered);
+        memcpy(pvBuf, psTiered->pcBytes + ulOffset, ulLength);
+    }
+    else
+        iStatus = Content_readFd(psTiered->psSpill->iFd,
+                                    psTiered->ulOffset + ulOffset, pvBuf,
+                                    ulLength);
+    if (iStatus == SUCCESS)
+        *pulRead = ulLength;
+    return iStatus;
+}
+
+/*
+  Maps the ulLength bytes at offset ulOffset of the file open as iFd,
+  which must not be 0, into new mapped contents, with one reference to
+  them. Returns SUCCESS and sets *ppvResult to them, or returns
+  MEMORY_ERROR or IO_ERROR, if the file ends before the bytes or
+  cannot be mapped, and sets *ppvResult to NULL.
+*/
+static int Content_map(int iFd, size_t ulOffset, size_t ulLength,
+                       void **ppvResult)
+{
+    struct mapped *psMapped;
+    struct stat sStat;
+    size_t ulSkip = ulOffset % (size_t)sysconf(_SC_PAGESIZE);
+
+    *ppvResult = NULL;
+
+    /* touching a mapping past the end of its file faults */
+    if (fstat(iFd, &sStat) != 0 || (size_t)sStat.st_size < ulOffset ||
+        (size_t)sStat.st_size - ulOffset < ulLength)
+        return IO_ERROR;
+    psMapped = malloc(sizeof(struct mapped));
+    if (psMapped == NULL)
+        return MEMORY_ERROR;
+    psMapped->ulMapLength = ulSkip + ulLength;
+    psMapped->pvMap = mmap(NULL, psMapped->ulMapLength, PROT_READ,
+                           MAP_PRIVATE, iFd, (off_t)(ulOffset - ulSkip));
+    if (psMapped->pvMap == MAP_FAILED)
+    {
+        free(psMapped);
+        return IO_ERROR;
+    }
+    psMapped->pcBytes = (const char *)psMapped->pvMap + ulSkip;
+    psMapped->ulCounted = 0;
+    psMapped->ulLength = ulLength;
+    psMapped->ulHash = Content_hash(psMapped->pcBytes, ulLength);
+    psMapped->sCell.uRefs = 1;
+    psMapped->sCell.uClass = MAPPED_CLASS;
+    psMapped->sCell.uTouched = 1;
+    ulNumCells++;
+
+    *ppvResult = psMapped + 1;
+    return SUCCESS;
+}
+
+int Content_load(int iFd, size_t ulOffset, size_t ulLength, int iKind,
+                 void **ppvResult)
+{
+    void *pvBuf;
+    int iStatus;
+
+    assert(iFd >= 0);
+    assert(ppvResult != NULL);
+    assert(iKind == CONTENT_STORED || iKind == CONTENT_HEAP ||
+           iKind == CONTENT_TIERED || iKind == CONTENT_MAPPED);
+
+    *ppvResult = NULL;
+    if (iKind == CONTENT_MAPPED && ulLength != 0)
+        return Content_map(iFd, ulOffset, ulLength, ppvResult);
+
+    /* tiered and heap contents are read straight into their room */
+    if (iKind == CONTENT_TIERED)
+    {
+        struct tiered *psTiered = Content_newTiered(ulLength);
+
+        if (psTiered == NULL)
+            return MEMORY_ERROR;
+        iStatus = Content_readFd(iFd, ulOffset, psTiered->pcBytes,
+                                 ulLength);
+        if (iStatus != SUCCESS)
+        {
+            free(psTiered->pcBytes);
+            free(psTiered);
+            return iStatus;
+        }
+        *ppvResult = Content_addTiered(psTiered);
+        return SUCCESS;
+    }
+    if (iKind != CONTENT_STORED)
+    {
+        iStatus = Content_ownRoom(ulLength, ppvResult);
+        if (iStatus != SUCCESS)
+            return iStatus;
+        iStatus = Content_readFd(iFd, ulOffset, *ppvResult, ulLength);
+        if (iStatus != SUCCESS)
+        {
+            Content_release(*ppvResult);
+            *ppvResult = NULL;
+        }
+        return iStatus;
+    }
+
+    /* stored contents are known by their bytes, read first */
+    pvBuf = malloc(ulLength + 1);
+    if (pvBuf == NULL)
+        return MEMORY_ERROR;
+    iStatus = Content_readFd(iFd, ulOffset, pvBuf, ulLength);
+    if (iStatus == SUCCESS)
+        iStatus = Content_intern(pvBuf, ulLength, ppvResult);
+    free(pvBuf);
+    return iStatus;
+}
+
+const void *Content_getMapped(const void *pvContents)
+{
+    return Content_getMappedOf(pvContents)->pcBytes;
+}
+
+int Content_sendBytes(const void *pvBytes, size_t ulLength, int iFd)
+{
+    size_t ulDone = 0;
+
+    assert(pvBytes != NULL || ulLength == 0);
+
+    while (ulDone < ulLength)
+    {
+        ssize_t lWritten = write(iFd, (const char *)pvBytes + ulDone,
+                                 ulLength - ulDone);
+        if (lWritten < 0 && errno == EINTR)
+            continue;
+        if (lWritten <= 0)
+            return IO_ERROR;
+        ulDone += (size_t)lWritten;
+    }
+    return SUCCESS;
+}
+
+/*
+  Writes the ulLength bytes at offset ulOffset of the file open as
+  iFdIn to the file open as iFd with sendfile, which copies them
+  within the kernel. Returns TRUE and sets *piStatus to SUCCESS, or to
+  IO_ERROR if they could not be written, or returns FALSE, having
+  written none, if sendfile cannot copy between the two files.
+*/
+static boolean Content_sendFile(int iFdIn, size_t ulOffset,
+                                size_t ulLength, int iFd, int *piStatus)
+{
+    off_t lAt = (off_t)ulOffset;
+    size_t ulDone = 0;
+
+    *piStatus = SUCCESS;
+    while (ulDone < ulLength)
+    {
+        ssize_t lSent = sendfile(iFd, iFdIn, &lAt, ulLength - ulDone);
+        if (lSent < 0 && errno == EINTR)
+            continue;
+        if (lSent < 0 && ulDone == 0 &&
+            (errno == EINVAL || errno == ENOSYS))
+            return FALSE;
+        if (lSent <= 0)
+        {
+            *piStatus = IO_ERROR;
+            return TRUE;
+        }
+        ulDone += (size_t)lSent;
+    }
+    return TRUE;
+}
+
+int Content_send(const void *pvContents, size_t ulLength, int iFd)
+{
+    const void *pvBytes = pvContents;
+    int iStatus;
+
+    Content_touch(pvContents);
+    switch (Content_getCell(pvContents)->uClass)
+    {
+    case CHUNKED_CLASS:
+    {
+        struct chunked *psChunked = Content_getChunked(pvContents);
+        size_t ulDone = 0, i;
+
+        for (i = 0; ulDone < ulLength; i++)
+        {
+            size_t ulIn = ulLength - ulDone < CHUNK_SIZE ?
+                          ulLength - ulDone : CHUNK_SIZE;
+            iStatus = Content_sendBytes(psChunked->ppsChunks[i] + 1, ulIn,
+                                        iFd);
+            if (iStatus != SUCCESS)
+                return iStatus;
+            ulDone += ulIn;
+        }
+        return SUCCESS;
+    }
+    case PACKED_CLASS:
+        pvBytes = Content_unpack(pvContents);
+        if (pvBytes == NULL)
+            return MEMORY_ERROR;
+        break;
+    case TIERED_CLASS:
+    {
+        struct tiered *psTiered = Content_getTiered(pvContents);
+
+        /* spilled contents go from the spill file without paging them
+           in, where sendfile can */
+        if (psTiered->pcBytes == NULL &&
+            Content_sendFile(psTiered->psSpill->iFd, psTiered->ulOffset,
+                             ulLength, iFd, &iStatus))
+            return iStatus;
+        iStatus = Content_page(pvContents, &pvBytes);
+        if (iStatus != SUCCESS)
+            return iStatus;
+        break;
+    }
+    case MAPPED_CLASS:
+        pvBytes = Content_getMappedOf(pvContents)->pcBytes;
+        break;
+    default:
+        break;
+    }
+    return Content_sendBytes(pvBytes, ulLength, iFd);
+}
+
+void Content_retain(const void *pvContents)
+{
+    struct cell *psCell = Content_getCell(pvContents);
+
+    assert(psCell->uRefs < UINT_MAX);
+
+    psCell->uRefs++;
+    if (psCell->uClass == STORED_CLASS)
+        ulSaved += Content_getBlock(pvContents)->ulLength;
+}
+
+void Content_release(const void *pvContents)
+{
+    struct cell *psCell = Content_getCell(pvContents);
+    struct block *psBlock;
+    struct block **ppsLink;
+
+    assert(psCell->uRefs != 0);
+
+    if (psCell->uClass != STORED_CLASS)
+    {
+        if (--psCell->uRefs != 0)
+            return;
+
+        /* a large cell goes back to malloc, a slab's to its class,
+           chunked contents let go of their chunks, packed contents of
+           their unpacked bytes, tiered ones of their bytes and their
+           place in the spill file, and mapped ones of their mapping */
+        if (psCell->uClass == MAPPED_CLASS)
+        {
+            struct mapped *psMapped = Content_getMappedOf(pvContents);
+
+            (void)munmap(psMapped->pvMap, psMapped->ulMapLength);
+            free(psMapped);
+        }
+        else if (psCell->uClass == TIERED_CLASS)
+        {
+            struct tiered *psTiered = Content_getTiered(pvContents);
+
+            if (psTiered->pcBytes != NULL)
+            {
+                Content_unlinkTiered(psTiered);
+                free(psTiered->pcBytes);
+                ulResident -= psTiered->ulLength;
+            }
+            else
+                ulOnDisk -= psTiered->ulLength;
+            if (psTiered->psSpill != NULL)
+                Content_dropSpill(psTiered->psSpill);
+            free(psTiered);
+        }
+        else if (psCell->uClass == PACKED_CLASS)
+        {
+            struct packed *psPacked = Content_getPacked(pvContents);
+            size_t i;
+
+            for (i = 0; i < ulNumSlots; i++)
+                if (psSlots[i].pvPacked == pvContents)
+                    Content_freeSlot(&psSlots[i]);
+            ulPackedFrom -= psPacked->ulLength;
+            ulPackedTo -= psPacked->ulPacked;
+            free(psPacked);
+        }
+        else if (psCell->uClass == CHUNKED_CLASS)
+        {
+            struct chunked *psChunked = Content_getChunked(pvContents);
+            size_t i;
+
+            for (i = 0; i < psChunked->ulNumChunks; i++)
+                if (--psChunked->ppsChunks[i]->uRefs == 0)
+                    free(psChunked->ppsChunks[i]);
+            free(psChunked->ppsChunks);
+            free(psChunked->pulHashes);
+            free(psChunked->pcFlat);
+            free(psChunked);
+        }
+        else if (psCell->uClass == LARGE_CLASS)
+            free(psCell);
+        else
+        {
+            struct sizeClass *psClass = &asClasses[psCell->uClass];
+            memcpy(psCell + 1, &psClass->psFree, sizeof(struct cell *));
+            psClass->psFree = psCell;
+        }
+        if (--ulNumCells == 0)
+            Content_heapReset();
+        return;
+    }
+
+    psBlock = Content_getBlock(pvContents);
+    if (--psCell->uRefs != 0)
+    {
+        ulSaved -= psBlock->ulLength;
+        return;
+    }
+
+    /* unlink the block from its bucket, and free it */
+    ppsLink = &ppsBuckets[(size_t)psBlock->ulHash & (ulNumBuckets - 1)];
+    while (*ppsLink != psBlock)
+        ppsLink = &(*ppsLink)->psNext;
+    *ppsLink = psBlock->psNext;
+    ulStored -= psBlock->ulLength;
+    free(psBlock);
+
+    /* give back the table with the last block */
+    if (--ulNumBlocks == 0)
+    {
+        free(ppsBuckets);
+        ppsBuckets = NULL;
+        ulNumBuckets = 0;
+    }
+}
+
+uint64_t Content_getHash(const void *pvContents)
+{
+    if (Content_getCell(pvContents)->uClass == CHUNKED_CLASS)
+        return Content_finish(Content_getChunked(pvContents)->ulLength,
+                              Content_getChunked(pvContents)->ulSum);
+    if (Content_getCell(pvContents)->uClass == PACKED_CLASS)
+        return Content_getPacked(pvContents)->ulHash;
+    if (Content_getCell(pvContents)->uClass == TIERED_CLASS)
+        return Content_getTiered(pvContents)->ulHash;
+    if (Content_getCell(pvContents)->uClass == MAPPED_CLASS)
+        return Content_getMappedOf(pvContents)->ulHash;
+    return Content_getBlock(pvContents)->ulHash;
+}
+
+size_t Content_getRefs(const void *pvContents)
+{
+    return Content_getCell(pvContents)->uRefs;
+}
+
+boolean Content_countOnce(const void *pvContents, size_t ulCount)
+{
+    size_t *pulCounted;
+
+    if (Content_getCell(pvContents)->uClass == CHUNKED_CLASS)
+        pulCounted = &Content_getChunked(pvContents)->ulCounted;
+    else if (Content_getCell(pvContents)->uClass == PACKED_CLASS)
+        pulCounted = &Content_getPacked(pvContents)->ulCounted;
+    else if (Content_getCell(pvContents)->uClass == TIERED_CLASS)
+        pulCounted = &Content_getTiered(pvContents)->ulCounted;
+    else if (Content_getCell(pvContents)->uClass == MAPPED_CLASS)
+        pulCounted = &Content_getMappedOf(pvContents)->ulCounted;
+    else
+        pulCounted = &Content_getBlock(pvContents)->ulCounted;
+    if (*pulCounted == ulCount)
+        return FALSE;
+    *pulCounted = ulCount;
+    return TRUE;
+}
+
+size_t Content_newCount(void)
+{
+    return ++ulLastCount;
+}
+
+void Content_getStats(size_t *pulInterned, size_t *pulHits,
+                      size_t *pulStored, size_t *pulSaved)
+{
+    assert(pulInterned != NULL);
+    assert(pulHits != NULL);
+    assert(pulStored != NULL);
+    assert(pulSaved != NULL);
+
+    *pulInterned = ulInterned;
+    *pulHits = ulHits;
+    *pulStored = ulStored;
+    *pulSaved = ulSaved;
+}
+
+void Content_getPackStats(size_t *pulPackedFrom, size_t *pulPackedTo,
+                          size_t *pulHits, size_t *pulMisses,
+                          double *pdPackMs, double *pdUnpackMs)
+{
+    assert(pulPackedFrom != NULL);
+    assert(pulPackedTo != NULL);
+    assert(pulHits != NULL);
+    assert(pulMisses != NULL);
+    assert(pdPackMs != NULL);
+    assert(pdUnpackMs != NULL);
+
+    *pulPackedFrom = ulPackedFrom;
+    *pulPackedTo = ulPackedTo;
+    *pulHits = ulUnpackHits;
+    *pulMisses = ulUnpackMisses;
+    *pdPackMs = 1000.0 * (double)ctPacking / CLOCKS_PER_SEC;
+    *pdUnpackMs = 1000.0 * (double)ctUnpacking / CLOCKS_PER_SEC;
+}
+
+void Content_getSpillStats(size_t *pulResident, size_t *pulOnDisk,
+                           size_t *pulPageIns, size_t *pulPageOuts)
+{
+    assert(pulResident != NULL);
+    assert(pulOnDisk != NULL);
+    assert(pulPageIns != NULL);
+    assert(pulPageOuts != NULL);
+
+    *pulResident = ulResident;
+    *pulOnDisk = ulOnDisk;
+    *pulPageIns = ulPageIns;
+    *pulPageOuts = ulPageOuts;
+}
+
+size_t Content_getNumBlocks(void)
+{
+    return ulNumBlocks + ulNumCells;
+}
@@ -0,0 +1,300 @@
+/*--------------------------------------------------------------------*/
+/* contentFT.h                                                        */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef CONTENT_INCLUDED
+#define CONTENT_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "a4def.h"
+
+/*
+  The content store holds file contents owned by the File Trees, keyed
+  by their hash, so that contents that are byte for byte the same are
+  stored once however many files hold them. The content heap holds
+  contents owned by one file each, in cells of a few size classes
+  carved from large slabs, so that short contents take no allocation
+  of their own and sit close together. Chunked contents are split in
+  chunks of a few KiB, so that writing a range of them or appending to
+  them takes time in proportion to the bytes written; chunked contents
+  that share chunks copy a chunk before writing to it. Packed contents
+  are compressed, and decompressed into a cache of a few buffers when
+  their bytes are asked for. Tiered contents keep their bytes in
+  memory while the tiered contents in memory fit in a budget, and
+  otherwise have the least recently used written out to a spill file,
+  once, and read back when they are used. Mapped contents are bytes
+  of a file mapped into memory read-only. Contents of any kind count
+  the references to them (one per file node holding them, plus any
+  taken with Content_retain), and are freed with the last. They are
+  identified by the pointer to their bytes (or, for chunked, packed,
+  tiered, and mapped contents, to where bytes would be), which stays
+  valid, and never moves, as long as they are referred to. All
+  contents remember whether they were touched (made, read, or
+  written) since Content_cool last looked at them.
+*/
+
+/* The kinds of contents */
+enum { CONTENT_STORED, CONTENT_HEAP, CONTENT_CHUNKED, CONTENT_PACKED,
+       CONTENT_TIERED, CONTENT_MAPPED };
+
+/*
+  Returns the hash of the ulLength bytes at pvBytes, which may be NULL
+  if ulLength is 0. Bytes that are the same hash the same, and bytes
+  that differ hash the same only with negligible probability. The
+  bytes are hashed in pieces of the size of a chunk, so that chunked
+  contents hash the same as their bytes in one block.
+*/
+uint64_t Content_hash(const void *pvBytes, size_t ulLength);
+
+/* Returns the 64-bit hash ulHash with its bits mixed, as splitmix64
+   does, for hashes built from others. */
+uint64_t Content_mix(uint64_t ulHash);
+
+/*
+  Finds the stored contents equal to the ulLength bytes at pvBytes,
+  or stores a copy of them if there are none, and adds a reference to
+  them. Returns SUCCESS and sets *ppvResult to the stored contents, or
+  returns MEMORY_ERROR and sets *ppvResult to NULL.
+*/
+int Content_intern(const void *pvBytes, size_t ulLength,
+                   void **ppvResult);
+
+/*
+  Copies the ulLength bytes at pvBytes, which may be NULL if ulLength
+  is 0, into the content heap, with one reference to them. Returns
+  SUCCESS and sets *ppvResult to the copy, or returns MEMORY_ERROR and
+  sets *ppvResult to NULL.
+*/
+int Content_own(const void *pvBytes, size_t ulLength, void **ppvResult);
+
+/*
+  Copies the ulLength bytes at pvBytes, which may be NULL if ulLength
+  is 0, into new chunked contents, with one reference to them. Returns
+  SUCCESS and sets *ppvResult to the chunked contents, or returns
+  MEMORY_ERROR and sets *ppvResult to NULL.
+*/
+int Content_chunk(const void *pvBytes, size_t ulLength, void **ppvResult);
+
+/*
+  Writes the ulLength bytes at pvBytes into the chunked contents
+  *ppvContents at offset ulOffset, extending them if the bytes reach
+  past their end, with 0 bytes between their end and ulOffset if it
+  is past it. If others share *ppvContents, writes into a copy of them
+  for the caller instead, sets *ppvContents to it, and drops the
+  caller's reference to the original. Returns SUCCESS, or MEMORY_ERROR
+  if memory could not be allocated, in which case *ppvContents may be
+  a copy but holds the same bytes as before.
+*/
+int Content_write(void **ppvContents, size_t ulOffset,
+                  const void *pvBytes, size_t ulLength);
+
+/* Copies up to ulLength bytes of the chunked contents pvContents from
+   offset ulOffset into pvBuf, and returns the number copied, fewer if
+   the end of the contents comes first. */
+size_t Content_read(const void *pvContents, size_t ulOffset,
+                    void *pvBuf, size_t ulLength);
+
+/*
+  Returns the bytes of the chunked contents pvContents in one block,
+  made the first time they are asked for after they were last
+  written, which stays valid until they are next written or freed.
+  Returns NULL if memory could not be allocated.
+*/
+void *Content_flatten(const void *pvContents);
+
+/*
+  Replaces the contents *ppvContents, of ulLength bytes whose hash is
+  ulHash, which must not be packed and to which the caller must hold
+  the only reference, with packed contents holding the same bytes,
+  and drops the caller's reference to the original. Returns SUCCESS,
+  or MEMORY_ERROR if memory could not be allocated, in which case
+  *ppvContents is unchanged.
+*/
+int Content_pack(void **ppvContents, size_t ulLength, uint64_t ulHash);
+
+/*
+  Returns the bytes of the packed contents pvContents in one block:
+  their unpacked bytes from the cache, which holds those of the few
+  packed contents last asked for, decompressing them into it first if
+  they are not there. The block stays valid until the contents are
+  freed, or a few others' bytes have been decompressed since they
+  were last asked for (but not while Content_holdBytes holds the
+  cache). Returns NULL if memory could not be allocated.
+*/
+const void *Content_unpack(const void *pvContents);
+
+/*
+  Starts spilling tiered contents to a new spill file named pcFile,
+  which is removed from its directory at once and so is gone when the
+  process ends, with a budget of ulBudget bytes of tiered contents in
+  memory, and writes out the least recently used of them until they
+  fit. If pcFile is NULL, stops spilling: tiered contents stay in
+  memory from now on, though those written out are still read back
+  from their file. Returns SUCCESS, MEMORY_ERROR if memory could not
+  be allocated, or IO_ERROR if the file could not be made, in which
+  case nothing changes.
+*/
+int Content_setSpill(const char *pcFile, size_t ulBudget);
+
+/*
+  Copies the ulLength bytes at pvBytes, which may be NULL if ulLength
+  is 0, into new tiered contents, the most recently used, with one
+  reference to them, then writes out others, but not those used just
+  before, until the budget holds.
+  Returns SUCCESS and sets *ppvResult to the copy, or returns
+  MEMORY_ERROR and sets *ppvResult to NULL.
+*/
+int Content_tier(const void *pvBytes, size_t ulLength, void **ppvResult);
+
+/*
+  Makes the tiered contents pvContents the most recently used, reading
+  their bytes back from the spill file if they are not in memory, and
+  writing out others until the budget holds. Returns SUCCESS and sets
+  *ppvBytes to their bytes, which stay valid until other tiered
+  contents are used or made (but not while Content_holdBytes holds
+  them), or returns MEMORY_ERROR or IO_ERROR and sets *ppvBytes to
+  NULL.
+*/
+int Content_page(const void *pvContents, const void **ppvBytes);
+
+/*
+  Copies up to ulLength of the bytes of the tiered contents pvContents
+  from offset ulOffset on into pvBuf, reading them from the spill file
+  without reading the rest of the contents back if they are not in
+  memory, and stores in *pulRead the number copied. Returns SUCCESS,
+  or IO_ERROR if they could not be read.
+*/
+int Content_readTiered(const void *pvContents, size_t ulOffset,
+                       void *pvBuf, size_t ulLength, size_t *pulRead);
+
+/*
+  Makes contents of the kind iKind (CONTENT_STORED, CONTENT_HEAP,
+  CONTENT_TIERED, or CONTENT_MAPPED) from the ulLength bytes at offset
+  ulOffset of the file open as iFd, with one reference to them, as
+  Content_intern, Content_own, and Content_tier do from bytes in
+  memory, but reading heap and tiered contents straight into their
+  room, and mapping the bytes of the file for mapped contents (or
+  making heap contents of them if ulLength is 0). Mapped contents
+  change if the file does, so it must not while they are referred to.
+  Returns SUCCESS and sets *ppvResult to the contents, or returns
+  MEMORY_ERROR, or IO_ERROR if the file ends before the bytes or could
+  not be read or mapped, and sets *ppvResult to NULL.
+*/
+int Content_load(int iFd, size_t ulOffset, size_t ulLength, int iKind,
+                 void **ppvResult);
+
+/* Returns the bytes of the mapped contents pvContents. */
+const void *Content_getMapped(const void *pvContents);
+
+/*
+  Writes the ulLength bytes at pvBytes, which may be NULL if ulLength
+  is 0, to the file open as iFd, at its offset. Returns SUCCESS, or
+  IO_ERROR if they could not all be written.
+*/
+int Content_sendBytes(const void *pvBytes, size_t ulLength, int iFd);
+
+/*
+  Writes the bytes of the contents pvContents, of ulLength bytes, to
+  the file open as iFd, as Content_sendBytes does, without copying
+  them into one block first: chunked contents a chunk at a time, and
+  tiered contents that are only in the spill file straight from it
+  with sendfile, where it can copy to that file. Returns SUCCESS,
+  MEMORY_ERROR if memory could not be allocated to unpack or page in
+  the contents, or IO_ERROR if they could not be read or written.
+*/
+int Content_send(const void *pvContents, size_t ulLength, int iFd);
+
+/*
+  If bHold is TRUE, keeps all the bytes Content_unpack decompresses
+  and Content_page reads back from now on in memory, however many
+  they are, so that all the blocks they return stay valid until the
+  contents are freed; if FALSE, trims the cache back to its few most
+  recently used blocks, and writes out tiered contents until the
+  budget holds.
+*/
+void Content_holdBytes(boolean bHold);
+
+/* Returns the number of bytes of the packed or tiered contents
+   pvContents held in memory: the bytes they take packed for packed
+   contents, and all or none of them for tiered contents. */
+size_t Content_getResidentLength(const void *pvContents);
+
+/* Marks the contents pvContents as touched. */
+void Content_touch(const void *pvContents);
+
+/* Returns TRUE if the contents pvContents were not touched since the
+   last call for them, and FALSE if they were, and marks them as not
+   touched. */
+boolean Content_cool(const void *pvContents);
+
+/* Returns the kind of the contents pvContents: one of the CONTENT_*
+   kinds. */
+int Content_getKind(const void *pvContents);
+
+/* Adds a reference to the contents pvContents. */
+void Content_retain(const void *pvContents);
+
+/* Drops a reference to the contents pvContents, and frees them if it
+   was the last. */
+void Content_release(const void *pvContents);
+
+/* Returns the hash of the stored, chunked, or packed contents
+   pvContents, as Content_hash computes it for their bytes. */
+uint64_t Content_getHash(const void *pvContents);
+
+/* Returns the number of references to the contents pvContents. */
+size_t Content_getRefs(const void *pvContents);
+
+/*
+  Marks the stored, chunked, or packed contents pvContents as counted
+  in the count numbered ulCount, for walks that must count them once
+  however many files refer to them. Returns TRUE if they were not
+  marked as counted in it yet, and FALSE if they were. ulCount must
+  differ from all earlier counts: see Content_newCount.
+*/
+boolean Content_countOnce(const void *pvContents, size_t ulCount);
+
+/* Returns a count number that Content_countOnce has not seen yet. */
+size_t Content_newCount(void);
+
+/*
+  Reports the store's statistics: stores in *pulInterned the number of
+  calls to Content_intern so far, in *pulHits how many of them found
+  the contents already stored, in *pulStored the number of bytes
+  stored (each block once), and in *pulSaved the number of bytes that
+  storing each block once saves, i.e., the bytes of every reference to
+  a block beyond its first.
+*/
+void Content_getStats(size_t *pulInterned, size_t *pulHits,
+                      size_t *pulStored, size_t *pulSaved);
+
+/*
+  Reports on packed contents: stores in *pulPackedFrom the number of
+  bytes packed now, and in *pulPackedTo the number of bytes they take
+  packed, in *pulHits the number of times Content_unpack found the
+  bytes of compressed contents in the cache so far, and in *pulMisses
+  the number of times it decompressed them, and in *pdPackMs and
+  *pdUnpackMs the CPU time spent compressing and decompressing so far,
+  in milliseconds.
+*/
+void Content_getPackStats(size_t *pulPackedFrom, size_t *pulPackedTo,
+                          size_t *pulHits, size_t *pulMisses,
+                          double *pdPackMs, double *pdUnpackMs);
+
+/*
+  Reports on tiered contents: stores in *pulResident the number of
+  bytes of them in memory, in *pulOnDisk the number only in a spill
+  file, and in *pulPageIns and *pulPageOuts the number of times so far
+  that contents were read back from a spill file and written out to
+  one.
+*/
+void Content_getSpillStats(size_t *pulResident, size_t *pulOnDisk,
+                           size_t *pulPageIns, size_t *pulPageOuts);
+
+/* Returns the number of blocks of contents in the store and in the
+   heap, and of chunked, packed, tiered, and mapped contents. */
+size_t Content_getNumBlocks(void);
+
+#endif
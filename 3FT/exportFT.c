@@ -0,0 +1,654 @@
+/*--------------------------------------------------------------------*/
+/* exportFT.c                                                         */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+/* for syscall and MAP_POPULATE, as io_uring is Linux's */
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "exportFT.h"
+
+/* The most bytes one write is asked for, and the most files in flight
+   at once */
+enum {WRITE_CHUNK = 1 << 30, MAX_DEPTH = 4096};
+
+/* The most threads writing files when there is no io_uring */
+enum {MAX_THREADS = 16};
+
+/* The operations of the chain that writes a file through the ring,
+   kept in the user data of each, with its slot and, for a write, the
+   number of bytes it must write */
+enum {OP_OPEN, OP_WRITE, OP_CLOSE};
+
+/* A file queued to the threads */
+struct job
+{
+    char *pcPath;
+    const void *pvBytes;
+    size_t ulLength;
+};
+
+/* A registered descriptor slot of the ring, and the file whose chain
+   uses it */
+struct slot
+{
+    /* the file's path, kept until its chain completes */
+    char *pcPath;
+
+    /* the completions of its chain not reaped yet */
+    size_t ulPending;
+};
+
+/* An io_uring, set up and driven with system calls directly */
+struct ring
+{
+    /* its descriptor, and its rings as mapped */
+    int iFd;
+    void *pvRings;
+    size_t ulRingsSize;
+    struct io_uring_sqe *psSqes;
+    size_t ulSqesSize;
+
+    /* the fields of the submission and completion rings */
+    unsigned *puSqHead, *puSqTail, *puSqMask, *puSqArray;
+    unsigned *puCqHead, *puCqTail, *puCqMask;
+    struct io_uring_cqe *psCqes;
+    unsigned uSqEntries;
+
+    /* the entries filled since the last submission, and the entries
+       filled whose completions are not reaped yet */
+    unsigned uFilled;
+    size_t ulOutstanding;
+
+    /* the descriptor slots, one per file in flight, and the numbers of
+       those free, as a stack */
+    struct slot *psSlots;
+    size_t *pulFree;
+    size_t ulNumFree;
+};
+
+/* The threads writing files, and the queue of files they take from,
+   with room for ulDepth of them */
+struct pool
+{
+    pthread_t *psThreads;
+    size_t ulThreads;
+    struct job *psJobs;
+    size_t ulFirst;
+    size_t ulNumJobs;
+
+    /* TRUE once no more files will be queued */
+    boolean bFinishing;
+
+    /* guard the fields above and the export's status, and signal that
+       the queue is not empty or full */
+    pthread_mutex_t sLock;
+    pthread_cond_t sNotEmpty;
+    pthread_cond_t sNotFull;
+};
+
+struct export
+{
+    /* the descriptor of the directory exported into */
+    int iRootFd;
+
+    /* the most files in flight at once */
+    size_t ulDepth;
+
+    /* IO_ERROR once a file could not be written, and SUCCESS until
+       then */
+    int iStatus;
+
+    /* TRUE if the files are written through sRing, and FALSE if
+       through sPool */
+    boolean bRing;
+    struct ring sRing;
+    struct pool sPool;
+};
+
+/*
+  Creates the file with path pcPath relative to the directory open as
+  iRootFd, and writes the ulLength bytes at pvBytes to it, at once.
+  Returns SUCCESS, or IO_ERROR if it could not be created or written.
+*/
+static int Export_writeFile(int iRootFd, const char *pcPath,
+                            const void *pvBytes, size_t ulLength)
+{
+    size_t ulDone = 0;
+    int iFd;
+
+    iFd = openat(iRootFd, pcPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (iFd < 0)
+        return IO_ERROR;
+    while (ulDone < ulLength)
+    {
+        ssize_t lWritten = pwrite(iFd, (const char *)pvBytes + ulDone,
+                                  ulLength - ulDone, (off_t)ulDone);
+        if (lWritten < 0 && errno == EINTR)
+            continue;
+        if (lWritten <= 0)
+        {
+            (void)close(iFd);
+            return IO_ERROR;
+        }
+        ulDone += (size_t)lWritten;
+    }
+    return close(iFd) == 0 ? SUCCESS : IO_ERROR;
+}
+
+/* Copies the string pcString. Returns the copy, or NULL if memory
+   could not be allocated. */
+static char *Export_copy(const char *pcString)
+{
+    char *pcCopy = malloc(strlen(pcString) + 1);
+
+    if (pcCopy != NULL)
+        strcpy(pcCopy, pcString);
+    return pcCopy;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions write files through the ring.
+*/
+
+/*
+  Sets up oEExport's ring, with a descriptor slot per file in flight
+  and two entries for each. Returns TRUE, or FALSE if the kernel does
+  not offer an io_uring that opens into slots, or memory could not be
+  allocated, in which case nothing is left set up.
+*/
+static boolean Export_openRing(Export_T oEExport)
+{
+    struct ring *psRing = &oEExport->sRing;
+    struct io_uring_params sParams;
+    size_t ulSqSize, ulCqSize;
+    int *piSlots;
+    size_t i;
+    long lStatus;
+
+    memset(&sParams, 0, sizeof(sParams));
+    psRing->iFd = (int)syscall(__NR_io_uring_setup,
+                               (unsigned)(oEExport->ulDepth * 2), &sParams);
+    if (psRing->iFd < 0)
+        return FALSE;
+
+    /* opening into slots came after skipping completions did, so
+       kernels without the latter are not trusted with the former */
+    if (!(sParams.features & IORING_FEAT_SINGLE_MMAP) ||
+        !(sParams.features & IORING_FEAT_CQE_SKIP))
+    {
+        (void)close(psRing->iFd);
+        return FALSE;
+    }
+
+    ulSqSize = sParams.sq_off.array + sParams.sq_entries * sizeof(unsigned);
+    ulCqSize = sParams.cq_off.cqes +
+               sParams.cq_entries * sizeof(struct io_uring_cqe);
+    psRing->ulRingsSize = ulSqSize > ulCqSize ? ulSqSize : ulCqSize;
+    psRing->pvRings = mmap(NULL, psRing->ulRingsSize,
+                           PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, psRing->iFd,
+                           IORING_OFF_SQ_RING);
+    if (psRing->pvRings == MAP_FAILED)
+    {
+        (void)close(psRing->iFd);
+        return FALSE;
+    }
+    psRing->ulSqesSize = sParams.sq_entries * sizeof(struct io_uring_sqe);
+    psRing->psSqes = mmap(NULL, psRing->ulSqesSize,
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, psRing->iFd,
+                          IORING_OFF_SQES);
+    if (psRing->psSqes == MAP_FAILED)
+    {
+        (void)munmap(psRing->pvRings, psRing->ulRingsSize);
+        (void)close(psRing->iFd);
+        return FALSE;
+    }
+
+    psRing->puSqHead = (unsigned *)((char *)psRing->pvRings +
+                                    sParams.sq_off.head);
+    psRing->puSqTail = (unsigned *)((char *)psRing->pvRings +
+                                    sParams.sq_off.tail);
+    psRing->puSqMask = (unsigned *)((char *)psRing->pvRings +
+                                    sParams.sq_off.ring_mask);
+    psRing->puSqArray = (unsigned *)((char *)psRing->pvRings +
+                                     sParams.sq_off.array);
+    psRing->puCqHead = (unsigned *)((char *)psRing->pvRings +
+                                    sParams.cq_off.head);
+    psRing->puCqTail = (unsigned *)((char *)psRing->pvRings +
+                                    sParams.cq_off.tail);
+    psRing->puCqMask = (unsigned *)((char *)psRing->pvRings +
+                                    sParams.cq_off.ring_mask);
+    psRing->psCqes = (struct io_uring_cqe *)((char *)psRing->pvRings +
+                                             sParams.cq_off.cqes);
+    psRing->uSqEntries = sParams.sq_entries;
+    psRing->uFilled = 0;
+    psRing->ulOutstanding = 0;
+
+    /* the slots are registered empty, and filled by the opens */
+    psRing->psSlots = calloc(oEExport->ulDepth, sizeof(struct slot));
+    psRing->pulFree = malloc(oEExport->ulDepth * sizeof(size_t));
+    piSlots = malloc(oEExport->ulDepth * sizeof(int));
+    lStatus = -1;
+    if (psRing->psSlots != NULL && psRing->pulFree != NULL &&
+        piSlots != NULL)
+    {
+        for (i = 0; i < oEExport->ulDepth; i++)
+        {
+            piSlots[i] = -1;
+            psRing->pulFree[i] = oEExport->ulDepth - 1 - i;
+        }
+        psRing->ulNumFree = oEExport->ulDepth;
+        lStatus = syscall(__NR_io_uring_register, psRing->iFd,
+                          IORING_REGISTER_FILES, piSlots,
+                          (unsigned)oEExport->ulDepth);
+    }
+    free(piSlots);
+    if (lStatus < 0)
+    {
+        free(psRing->psSlots);
+        free(psRing->pulFree);
+        (void)munmap(psRing->psSqes, psRing->ulSqesSize);
+        (void)munmap(psRing->pvRings, psRing->ulRingsSize);
+        (void)close(psRing->iFd);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Reaps the completions oEExport's ring holds, freeing the slots of
+   the chains they complete, and noting failures. */
+static void Export_reap(Export_T oEExport)
+{
+    struct ring *psRing = &oEExport->sRing;
+    unsigned uHead = *psRing->puCqHead;
+    unsigned uTail = __atomic_load_n(psRing->puCqTail, __ATOMIC_ACQUIRE);
+
+    while (uHead != uTail)
+    {
+        struct io_uring_cqe *psCqe =
+            &psRing->psCqes[uHead & *psRing->puCqMask];
+        size_t ulSlot = (size_t)(psCqe->user_data & 0xffffff);
+        int iOp = (int)((psCqe->user_data >> 24) & 0xff);
+        struct slot *psSlot = &psRing->psSlots[ulSlot];
+
+        /* the operations after a failed open are cancelled */
+        if (psCqe->res < 0 ||
+            (iOp == OP_WRITE &&
+             (uint64_t)psCqe->res != psCqe->user_data >> 32))
+            oEExport->iStatus = IO_ERROR;
+        if (--psSlot->ulPending == 0)
+        {
+            free(psSlot->pcPath);
+            psSlot->pcPath = NULL;
+            psRing->pulFree[psRing->ulNumFree++] = ulSlot;
+        }
+        psRing->ulOutstanding--;
+        uHead++;
+    }
+    __atomic_store_n(psRing->puCqHead, uHead, __ATOMIC_RELEASE);
+}
+
+/*
+  Submits the entries filled in oEExport's ring, waiting for at least
+  one completion first if bWait is TRUE, and reaps the completions.
+  Returns SUCCESS, or IO_ERROR if the ring failed.
+*/
+static int Export_submit(Export_T oEExport, boolean bWait)
+{
+    struct ring *psRing = &oEExport->sRing;
+    unsigned uTail = *psRing->puSqTail + psRing->uFilled;
+
+    __atomic_store_n(psRing->puSqTail, uTail, __ATOMIC_RELEASE);
+    psRing->uFilled = 0;
+    for (;;)
+    {
+        unsigned uToSubmit = uTail - __atomic_load_n(psRing->puSqHead,
+                                                     __ATOMIC_ACQUIRE);
+        long lSubmitted;
+
+        if (uToSubmit == 0 && !bWait)
+            break;
+        lSubmitted = syscall(__NR_io_uring_enter, psRing->iFd, uToSubmit,
+                             bWait ? 1 : 0,
+                             bWait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (lSubmitted < 0 && errno == EINTR)
+            continue;
+        if (lSubmitted < 0 || (lSubmitted == 0 && uToSubmit != 0))
+            return IO_ERROR;
+        bWait = FALSE;
+    }
+    Export_reap(oEExport);
+    return SUCCESS;
+}
+
+/* Returns the next free submission entry of psRing, cleared, to be
+   submitted with the others filled. */
+static struct io_uring_sqe *Export_nextSqe(struct ring *psRing)
+{
+    unsigned uIndex = (*psRing->puSqTail + psRing->uFilled) &
+                      *psRing->puSqMask;
+    struct io_uring_sqe *psSqe = &psRing->psSqes[uIndex];
+
+    memset(psSqe, 0, sizeof(struct io_uring_sqe));
+    psRing->puSqArray[uIndex] = uIndex;
+    psRing->uFilled++;
+    psRing->ulOutstanding++;
+    return psSqe;
+}
+
+/* Queues the file with path pcPath and the ulLength bytes at pvBytes
+   to oEExport's ring, as Export_addFile does. */
+static int Export_addToRing(Export_T oEExport, const char *pcPath,
+                            const void *pvBytes, size_t ulLength)
+{
+    struct ring *psRing = &oEExport->sRing;
+    size_t ulChain = 2 + (ulLength + WRITE_CHUNK - 1) / WRITE_CHUNK;
+    struct io_uring_sqe *psSqe;
+    size_t ulSlot, ulDone;
+    char *pcCopy;
+
+    /* a chain must be submitted whole, so one too long for the ring
+       is written at once */
+    if (ulChain > psRing->uSqEntries)
+        return Export_writeFile(oEExport->iRootFd, pcPath, pvBytes,
+                                ulLength);
+
+    /* the queued files are submitted once they fill the slots */
+    while (oEExport->iStatus == SUCCESS &&
+           (psRing->ulNumFree == 0 ||
+            psRing->ulOutstanding + ulChain > psRing->uSqEntries))
+        if (Export_submit(oEExport, TRUE) != SUCCESS)
+            oEExport->iStatus = IO_ERROR;
+    if (oEExport->iStatus != SUCCESS)
+        return IO_ERROR;
+
+    pcCopy = Export_copy(pcPath);
+    if (pcCopy == NULL)
+        return MEMORY_ERROR;
+    ulSlot = psRing->pulFree[--psRing->ulNumFree];
+    psRing->psSlots[ulSlot].pcPath = pcCopy;
+    psRing->psSlots[ulSlot].ulPending = ulChain;
+
+    psSqe = Export_nextSqe(psRing);
+    psSqe->opcode = IORING_OP_OPENAT;
+    psSqe->flags = IOSQE_IO_LINK;
+    psSqe->fd = oEExport->iRootFd;
+    psSqe->addr = (uint64_t)(uintptr_t)pcCopy;
+    psSqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+    psSqe->len = 0644;
+    psSqe->file_index = (uint32_t)ulSlot + 1;
+    psSqe->user_data = (uint64_t)ulSlot | (uint64_t)OP_OPEN << 24;
+
+    /* the close follows even if a write fails */
+    for (ulDone = 0; ulDone < ulLength; ulDone += WRITE_CHUNK)
+    {
+        size_t ulChunk = ulLength - ulDone < WRITE_CHUNK ?
+                         ulLength - ulDone : WRITE_CHUNK;
+        psSqe = Export_nextSqe(psRing);
+        psSqe->opcode = IORING_OP_WRITE;
+        psSqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+        psSqe->fd = (int)ulSlot;
+        psSqe->addr = (uint64_t)(uintptr_t)((const char *)pvBytes +
+                                             ulDone);
+        psSqe->len = (uint32_t)ulChunk;
+        psSqe->off = ulDone;
+        psSqe->user_data = (uint64_t)ulSlot | (uint64_t)OP_WRITE << 24 |
+                           (uint64_t)ulChunk << 32;
+    }
+
+    psSqe = Export_nextSqe(psRing);
+    psSqe->opcode = IORING_OP_CLOSE;
+    psSqe->file_index = (uint32_t)ulSlot + 1;
+    psSqe->user_data = (uint64_t)ulSlot | (uint64_t)OP_CLOSE << 24;
+    return SUCCESS;
+}
+
+/* Waits for the files queued to oEExport's ring, and closes it. */
+static void Export_closeRing(Export_T oEExport)
+{
+    struct ring *psRing = &oEExport->sRing;
+    size_t i;
+
+    while (psRing->ulOutstanding > 0 &&
+           Export_submit(oEExport, TRUE) == SUCCESS)
+        ;
+    if (psRing->ulOutstanding > 0)
+        oEExport->iStatus = IO_ERROR;
+    for (i = 0; i < oEExport->ulDepth; i++)
+        free(psRing->psSlots[i].pcPath);
+    free(psRing->psSlots);
+    free(psRing->pulFree);
+    (void)munmap(psRing->psSqes, psRing->ulSqesSize);
+    (void)munmap(psRing->pvRings, psRing->ulRingsSize);
+    (void)close(psRing->iFd);
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions write files through the threads.
+*/
+
+/* Writes the files queued to the export pvExport until it finishes.
+   Returns NULL. */
+static void *Export_work(void *pvExport)
+{
+    Export_T oEExport = pvExport;
+    struct pool *psPool = &oEExport->sPool;
+
+    pthread_mutex_lock(&psPool->sLock);
+    for (;;)
+    {
+        struct job sJob;
+        int iStatus;
+
+        while (psPool->ulNumJobs == 0 && !psPool->bFinishing)
+            pthread_cond_wait(&psPool->sNotEmpty, &psPool->sLock);
+        if (psPool->ulNumJobs == 0)
+            break;
+
+        sJob = psPool->psJobs[psPool->ulFirst];
+        psPool->ulFirst = (psPool->ulFirst + 1) % oEExport->ulDepth;
+        psPool->ulNumJobs--;
+        pthread_cond_signal(&psPool->sNotFull);
+        pthread_mutex_unlock(&psPool->sLock);
+
+        iStatus = Export_writeFile(oEExport->iRootFd, sJob.pcPath,
+                                   sJob.pvBytes, sJob.ulLength);
+        free(sJob.pcPath);
+        pthread_mutex_lock(&psPool->sLock);
+        if (iStatus != SUCCESS)
+            oEExport->iStatus = iStatus;
+    }
+    pthread_mutex_unlock(&psPool->sLock);
+    return NULL;
+}
+
+/*
+  Starts oEExport's threads, as many as files may be in flight, up to
+  MAX_THREADS. Returns SUCCESS, or MEMORY_ERROR if none could be
+  started.
+*/
+static int Export_openPool(Export_T oEExport)
+{
+    struct pool *psPool = &oEExport->sPool;
+    size_t ulWanted = oEExport->ulDepth < MAX_THREADS ?
+                      oEExport->ulDepth : MAX_THREADS;
+
+    psPool->psJobs = malloc(oEExport->ulDepth * sizeof(struct job));
+    psPool->psThreads = malloc(ulWanted * sizeof(pthread_t));
+    if (psPool->psJobs == NULL || psPool->psThreads == NULL)
+    {
+        free(psPool->psJobs);
+        free(psPool->psThreads);
+        return MEMORY_ERROR;
+    }
+    psPool->ulFirst = 0;
+    psPool->ulNumJobs = 0;
+    psPool->bFinishing = FALSE;
+    pthread_mutex_init(&psPool->sLock, NULL);
+    pthread_cond_init(&psPool->sNotEmpty, NULL);
+    pthread_cond_init(&psPool->sNotFull, NULL);
+
+    /* the export goes on with the threads that could be started */
+    psPool->ulThreads = 0;
+    while (psPool->ulThreads < ulWanted &&
+           pthread_create(&psPool->psThreads[psPool->ulThreads], NULL,
+                          Export_work, oEExport) == 0)
+        psPool->ulThreads++;
+    if (psPool->ulThreads == 0)
+    {
+        pthread_mutex_destroy(&psPool->sLock);
+        pthread_cond_destroy(&psPool->sNotEmpty);
+        pthread_cond_destroy(&psPool->sNotFull);
+        free(psPool->psJobs);
+        free(psPool->psThreads);
+        return MEMORY_ERROR;
+    }
+    return SUCCESS;
+}
+
+/* Queues the file with path pcPath and the ulLength bytes at pvBytes
+   to oEExport's threads, as Export_addFile does. */
+static int Export_addToPool(Export_T oEExport, const char *pcPath,
+                            const void *pvBytes, size_t ulLength)
+{
+    struct pool *psPool = &oEExport->sPool;
+    struct job *psJob;
+    char *pcCopy;
+
+    pcCopy = Export_copy(pcPath);
+    if (pcCopy == NULL)
+        return MEMORY_ERROR;
+
+    pthread_mutex_lock(&psPool->sLock);
+    while (psPool->ulNumJobs == oEExport->ulDepth &&
+           oEExport->iStatus == SUCCESS)
+        pthread_cond_wait(&psPool->sNotFull, &psPool->sLock);
+    if (oEExport->iStatus != SUCCESS)
+    {
+        pthread_mutex_unlock(&psPool->sLock);
+        free(pcCopy);
+        return IO_ERROR;
+    }
+    psJob = &psPool->psJobs[(psPool->ulFirst + psPool->ulNumJobs) %
+                            oEExport->ulDepth];
+    psJob->pcPath = pcCopy;
+    psJob->pvBytes = pvBytes;
+    psJob->ulLength = ulLength;
+    psPool->ulNumJobs++;
+    pthread_cond_signal(&psPool->sNotEmpty);
+    pthread_mutex_unlock(&psPool->sLock);
+    return SUCCESS;
+}
+
+/* Waits for the files queued to oEExport's threads, and stops them. */
+static void Export_closePool(Export_T oEExport)
+{
+    struct pool *psPool = &oEExport->sPool;
+
+    pthread_mutex_lock(&psPool->sLock);
+    psPool->bFinishing = TRUE;
+    pthread_cond_broadcast(&psPool->sNotEmpty);
+    pthread_mutex_unlock(&psPool->sLock);
+    while (psPool->ulThreads > 0)
+        pthread_join(psPool->psThreads[--psPool->ulThreads], NULL);
+    pthread_mutex_destroy(&psPool->sLock);
+    pthread_cond_destroy(&psPool->sNotEmpty);
+    pthread_cond_destroy(&psPool->sNotFull);
+    free(psPool->psJobs);
+    free(psPool->psThreads);
+}
+
+/* -------------------------------------------------------------------- */
+
+int Export_new(const char *pcDir, size_t ulDepth, boolean bRing,
+               Export_T *poEResult)
+{
+    Export_T oEExport;
+
+    assert(pcDir != NULL);
+    assert(ulDepth >= 1);
+    assert(poEResult != NULL);
+
+    *poEResult = NULL;
+    oEExport = calloc(1, sizeof(struct export));
+    if (oEExport == NULL)
+        return MEMORY_ERROR;
+    oEExport->iRootFd = open(pcDir, O_RDONLY | O_DIRECTORY);
+    if (oEExport->iRootFd < 0)
+    {
+        free(oEExport);
+        return IO_ERROR;
+    }
+    oEExport->ulDepth = ulDepth < MAX_DEPTH ? ulDepth : MAX_DEPTH;
+    oEExport->iStatus = SUCCESS;
+
+    oEExport->bRing = (boolean)(bRing && Export_openRing(oEExport));
+    if (!oEExport->bRing && Export_openPool(oEExport) != SUCCESS)
+    {
+        (void)close(oEExport->iRootFd);
+        free(oEExport);
+        return MEMORY_ERROR;
+    }
+    *poEResult = oEExport;
+    return SUCCESS;
+}
+
+int Export_makeDir(Export_T oEExport, const char *pcPath)
+{
+    assert(oEExport != NULL);
+    assert(pcPath != NULL);
+
+    return mkdirat(oEExport->iRootFd, pcPath, 0755) == 0 ? SUCCESS :
+           IO_ERROR;
+}
+
+int Export_addFile(Export_T oEExport, const char *pcPath,
+                   const void *pvBytes, size_t ulLength)
+{
+    assert(oEExport != NULL);
+    assert(pcPath != NULL);
+    assert(pvBytes != NULL || ulLength == 0);
+
+    if (oEExport->bRing)
+        return Export_addToRing(oEExport, pcPath, pvBytes, ulLength);
+    return Export_addToPool(oEExport, pcPath, pvBytes, ulLength);
+}
+
+int Export_finish(Export_T oEExport)
+{
+    int iStatus;
+
+    assert(oEExport != NULL);
+
+    if (oEExport->bRing)
+        Export_closeRing(oEExport);
+    else
+        Export_closePool(oEExport);
+    iStatus = oEExport->iStatus;
+    (void)close(oEExport->iRootFd);
+    free(oEExport);
+    return iStatus;
+}
+
+boolean Export_usesRing(Export_T oEExport)
+{
+    assert(oEExport != NULL);
+
+    return oEExport->bRing;
+}
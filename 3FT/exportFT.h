@@ -0,0 +1,66 @@
+/*--------------------------------------------------------------------*/
+/* exportFT.h                                                         */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef EXPORT_INCLUDED
+#define EXPORT_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  An Export_T writes a hierarchy out under a directory of a real
+  filesystem: its directories are made one at a time, in the order
+  given, and its files are queued, to be created and written in
+  batches, up to a queue depth of them at once. The batches go
+  through an io_uring, each file as a linked chain of an open into a
+  registered descriptor slot, its writes, and a close, so that one
+  system call submits the whole batch, or, where the kernel does not
+  offer that, to a pool of threads that each open and pwrite a file
+  at a time.
+*/
+typedef struct export *Export_T;
+
+/*
+  Starts an export into the directory named pcDir, which must exist,
+  with up to ulDepth (at least 1) files in flight at once, through an
+  io_uring if bRing is TRUE and the kernel offers one, and through
+  threads otherwise. Returns SUCCESS and sets *poEResult to the
+  export. Otherwise, sets *poEResult to NULL and returns:
+  * IO_ERROR if pcDir could not be opened
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Export_new(const char *pcDir, size_t ulDepth, boolean bRing,
+               Export_T *poEResult);
+
+/*
+  Makes the directory with path pcPath, relative to oEExport's, at
+  once. Returns SUCCESS, or IO_ERROR if it could not be made.
+*/
+int Export_makeDir(Export_T oEExport, const char *pcPath);
+
+/*
+  Queues the file with path pcPath, relative to oEExport's directory,
+  whose parent directory must be made already, to be created with the
+  ulLength bytes at pvBytes as its contents, which must stay valid
+  until Export_finish returns. Waits for earlier files to be written
+  first while the queue is full. Returns SUCCESS, MEMORY_ERROR if
+  memory could not be allocated, or IO_ERROR if an earlier file could
+  not be written, in which case the file is not queued.
+*/
+int Export_addFile(Export_T oEExport, const char *pcPath,
+                   const void *pvBytes, size_t ulLength);
+
+/*
+  Waits for all the files queued to oEExport to be written, and frees
+  it. Returns SUCCESS, or IO_ERROR if a file could not be created or
+  written.
+*/
+int Export_finish(Export_T oEExport);
+
+/* Returns TRUE if oEExport writes through an io_uring, and FALSE if
+   through threads. */
+boolean Export_usesRing(Export_T oEExport);
+
+#endif
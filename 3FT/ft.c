@@ -3,15 +3,47 @@
 /* Author: Judah Guggenheim                                           */
 /*--------------------------------------------------------------------*/
 
+/* for fork, waitpid, and clock_gettime under a strict -std */
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include "nodeFT.h"
-#include "dynarray.h"
+#include "imageFT.h"
+#include "journalFT.h"
+#include "contentFT.h"
+#include "scanFT.h"
+#include "exportFT.h"
 #include "ft.h"
 #include "path.h"
 #include <stdlib.h>
 
+/* A subtree detached from the FT by FT_detach */
+struct subtree
+{
+    /* its root, which has no parent */
+    Node_T oNRoot;
+};
+
+/* The image the FT was loaded from and the contents replayed into it,
+   held by the FT and by each snapshot taken since, whose nodes refer
+   to them */
+struct loaded
+{
+    Image_T oIImage;
+    void *pvReplayed;
+
+    /* the FT's hold, if it still has one, and the snapshots' */
+    size_t ulRefs;
+};
+
 /* a boolean stating whether the FT has been initalized or not. */
 /* This should be FALSE before the FT is initialized. */
 static boolean bIsInitialized;
@@ -24,145 +56,390 @@ static Node_T oNRoot;
 /* The count should be 0 before the FT is initialized. */
 static size_t ulCount;
 
+/* the succinct image of the FT while it is frozen, in which case */
+/* oNRoot is NULL_NODE. This should be NULL otherwise. */
+static Image_T oIFrozen;
+
+/* the image the FT was last loaded from, which holds the contents of */
+/* the files loaded with it. This should be NULL otherwise. */
+static Image_T oILoaded;
+
+/* the journal the FT's mutations are recorded in, if any. */
+/* This should be NULL otherwise. */
+static Journal_T oJJournal;
+
+/* TRUE once a mutation could not be recorded in the journal. */
+static boolean bJournalFailed;
+
+/* the sequence number of the last journaled mutation the FT reflects, */
+/* which FT_save records with the image. */
+static size_t ulSequence;
+
+/* the process saving the FT in the background, and the pipe its */
+/* outcome comes back through. These should be 0 and -1 otherwise. */
+static pid_t iSaver;
+static int iSaverFd = -1;
+
+/* TRUE once a background save ended without FT_pollSave reporting */
+/* on it, as FT_saveInBackground waited for it, and its outcome. */
+static boolean bSaveHeld;
+static int iHeldStatus;
+static size_t ulHeldSize;
+
+/* the number of snapshots not yet freed, which share nodes with */
+/* the FT or with each other. */
+static size_t ulSnapshots;
+
+/* the block holding the contents of the files replayed from a */
+/* journal by FT_recover. This should be NULL otherwise. */
+static void *pvReplayed;
+
+/* oILoaded and pvReplayed, once a snapshot holds them too. This */
+/* should be NULL otherwise. */
+static struct loaded *psLoaded;
+
+/* how the FT holds the contents of the files inserted into it: one */
+/* of the FT_CONTENTS_* modes */
+static int iContentsMode = FT_CONTENTS_BORROWED;
+
+/* the owned contents last replaced by FT_replaceFileContents, which */
+/* are kept until the next mutation. This should be NULL otherwise. */
+static void *pvRetired;
+
+/* the number of mutations after which contents not touched since the
+   last sweep are packed, or 0 to pack none that way; the length from
+   which contents are packed as they are stored, or 0 for none; and
+   the number of mutations since the last sweep */
+static size_t ulColdUpdates;
+static size_t ulLargeLength;
+static size_t ulUpdates;
+
+/* the shortest contents worth packing when cold */
+enum {MIN_PACKED = 64};
+
+/* TRUE if owned contents at least ulSpillFrom bytes long are tiered,
+   so that they can be spilled to a file */
+static boolean bSpilling;
+static size_t ulSpillFrom;
+
+/* the files and bytes the last FT_importDir imported, and the
+   seconds it took */
+static size_t ulImportedFiles;
+static size_t ulImportedBytes;
+static double dImportSeconds;
+
+/* the queue depth FT_exportDir writes files with, and whether it
+   writes them through an io_uring (see FT_setExport) */
+enum {EXPORT_DEPTH = 64};
+static size_t ulExportDepth = EXPORT_DEPTH;
+static boolean bExportRing = TRUE;
+
+/* the files and bytes the last FT_exportDir exported, the seconds it
+   took, and whether it wrote through an io_uring */
+static size_t ulExportedFiles;
+static size_t ulExportedBytes;
+static double dExportSeconds;
+static boolean bExportedRing;
+
+/*
+  If the FT is frozen, decodes its image back into nodes so that it
+  can be modified. Returns SUCCESS, or MEMORY_ERROR if memory could
+  not be allocated, in which case the FT stays frozen.
+*/
+static int FT_thaw(void)
+{
+    int iStatus;
+
+    if (oIFrozen == NULL)
+        return SUCCESS;
+
+    iStatus = Image_toTree(oIFrozen, &oNRoot);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    /* a loaded image must outlive the nodes referring to its contents */
+    if (oIFrozen != oILoaded)
+        Image_free(oIFrozen);
+    oIFrozen = NULL;
+    return SUCCESS;
+}
+
+/* Releases the contents last replaced by FT_replaceFileContents, if it
+   kept them. */
+static void FT_releaseRetired(void)
+{
+    if (pvRetired != NULL)
+        Content_release(pvRetired);
+    pvRetired = NULL;
+}
+
+/* Returns the kind of contents (one of the CONTENT_* kinds) the FT
+   stores contents of ulLength bytes as, in a mode other than
+   FT_CONTENTS_BORROWED, or, if bFromFd is TRUE, in any mode, as they
+   are read from a file. */
+static int FT_storageKind(size_t ulLength, boolean bFromFd)
+{
+    if (bFromFd && iContentsMode == FT_CONTENTS_MAPPED)
+        return CONTENT_MAPPED;
+    if (iContentsMode == FT_CONTENTS_DEDUPLICATED)
+        return CONTENT_STORED;
+    if (bSpilling && ulLength >= ulSpillFrom)
+        return CONTENT_TIERED;
+    return CONTENT_HEAP;
+}
+
+/*
+  Readies the FT for a mutation: fails with IO_ERROR if an earlier
+  mutation could not be journaled, and otherwise thaws the FT, and
+  packs cold contents if it is time to (see FT_setCompression).
+  Returns SUCCESS, or the status of whichever failed.
+*/
+static int FT_beginUpdate(void)
+{
+    int iStatus;
+
+    FT_releaseRetired();
+    if (bJournalFailed)
+        return IO_ERROR;
+    iStatus = FT_thaw();
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    /* sweep, packing contents untouched since the last sweep */
+    if (ulColdUpdates != 0 && ++ulUpdates >= ulColdUpdates)
+    {
+        ulUpdates = 0;
+        if (oNRoot != NULL_NODE)
+            Node_pack(oNRoot, MIN_PACKED, TRUE);
+    }
+    return SUCCESS;
+}
+
+/*
+  Records mutation iOp of absolute path pcPath, with contents
+  pvContents of ulLength bytes, in the journal, if one is open, as the
+  next sequence number. Returns SUCCESS, MEMORY_ERROR if the record
+  could not be appended, or IO_ERROR if its group could not be written
+  out, after which the FT accepts no more mutations until the journal
+  is closed: the record may or may not have reached the file.
+*/
+static int FT_log(int iOp, const char *pcPath, const void *pvContents,
+                  size_t ulLength)
+{
+    int iStatus;
+
+    if (oJJournal == NULL)
+        return SUCCESS;
+
+    /* number the record after both the tree's and the journal's last */
+    if (ulSequence < Journal_getLastSequence(oJJournal))
+        ulSequence = Journal_getLastSequence(oJJournal);
+    iStatus = Journal_append(oJJournal, ulSequence + 1, iOp, pcPath,
+                             pvContents, ulLength);
+    if (iStatus != SUCCESS)
+    {
+        if (iStatus == IO_ERROR)
+            bJournalFailed = TRUE;
+        return iStatus;
+    }
+    ulSequence++;
+    return SUCCESS;
+}
+
+/*
+  Makes room in the journal, if one is open, for ulRecords more
+  records whose paths and contents take up ulBytes in all, so that
+  FT_log cannot fail for lack of memory while journaling them.
+  Returns SUCCESS, or MEMORY_ERROR if memory could not be allocated.
+*/
+static int FT_reserve(size_t ulRecords, size_t ulBytes)
+{
+    if (oJJournal == NULL)
+        return SUCCESS;
+    return Journal_reserve(oJJournal, ulRecords, ulBytes);
+}
+
+/*
+  Journals, after the record of a mutation that then could not be
+  applied, the mutation iOp that undoes it, as FT_log does. If that
+  cannot be journaled either, the journal holds a mutation the FT
+  does not, so the FT accepts no more mutations until it is closed.
+*/
+static void FT_logUndo(int iOp, const char *pcPath,
+                       const void *pvContents, size_t ulLength)
+{
+    if (FT_log(iOp, pcPath, pvContents, ulLength) != SUCCESS)
+        bJournalFailed = TRUE;
+}
+
 /*
-  Traverses the DT starting at the root as far as possible towards
-  absolute path oPPath. If able to traverse, returns an int SUCCESS
-  status and sets *poNFurthest to the furthest node reached (which may
-  be only a prefix of oPPath, or even NULL if the root is NULL).
-  Otherwise, sets *poNFurthest to NULL and returns with status:
+  Traverses the tree rooted at *poNTop as far as possible towards
+  absolute path oPPath. If bOwn is TRUE, readies each node reached to
+  be modified with Node_own, updating *poNTop if the root is copied.
+  If able to traverse, returns an int SUCCESS status, sets
+  *poNFurthest to the furthest node reached (which may be only a
+  prefix of oPPath, or even NULL_NODE if the root is NULL_NODE), and
+  sets *pulFurthestDepth to that node's depth (0 if none was reached).
+  Otherwise, sets *poNFurthest to NULL_NODE and returns with status:
   * CONFLICTING_PATH if the root's path is not a prefix of oPPath
-  * MEMORY_ERROR if memory could not be allocated to complete request
+  * MEMORY_ERROR if a node could not be readied
 */
-static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest)
+static int FT_traversePath(Node_T *poNTop, boolean bOwn, Path_T oPPath,
+                           Node_T *poNFurthest, size_t *pulFurthestDepth)
 {
     int iStatus;
-    Path_T oPPrefix = NULL;
     Node_T oNCurr;
-    Node_T oNChild = NULL;
+    Node_T oNChild = NULL_NODE;
     size_t ulDepth;
     size_t i;
     size_t ulChildID = 0;
 
+    assert(poNTop != NULL);
     assert(oPPath != NULL);
     assert(poNFurthest != NULL);
+    assert(pulFurthestDepth != NULL);
 
-    /* root is NULL -> won't find anything */
-    if (oNRoot == NULL)
+    *pulFurthestDepth = 0;
+    *poNFurthest = NULL_NODE;
+
+    /* root is NULL_NODE -> won't find anything */
+    if (*poNTop == NULL_NODE)
     {
-        *poNFurthest = NULL;
         return SUCCESS;
     }
 
-    iStatus = Path_prefix(oPPath, 1, &oPPrefix);
-    if (iStatus != SUCCESS)
+    if (strcmp(Node_getName(*poNTop), Path_getComponent(oPPath, 0)))
     {
-        *poNFurthest = NULL;
-        return iStatus;
+        return CONFLICTING_PATH;
     }
-
-    if (Path_comparePath(Node_getPath(oNRoot), oPPrefix))
+    if (bOwn)
     {
-        Path_free(oPPrefix);
-        *poNFurthest = NULL;
-        return CONFLICTING_PATH;
+        iStatus = Node_own(NULL_NODE, poNTop);
+        if (iStatus != SUCCESS)
+            return iStatus;
     }
-    Path_free(oPPrefix);
-    oPPrefix = NULL;
 
-    oNCurr = oNRoot;
+    /* descend one component (i.e., one child name) at a time */
+    oNCurr = *poNTop;
     ulDepth = Path_getDepth(oPPath);
-    for (i = 2; i <= ulDepth; i++)
+    for (i = 1; i < ulDepth; i++)
     {
-        iStatus = Path_prefix(oPPath, i, &oPPrefix);
-        if (iStatus != SUCCESS)
-        {
-            *poNFurthest = NULL;
-            return iStatus;
-        }
-        if (Node_hasChild(oNCurr, oPPrefix, &ulChildID))
+        if (Node_hasChild(oNCurr, Path_getComponent(oPPath, i),
+                          &ulChildID))
         {
-            /* go to that child and continue with next prefix */
-            Path_free(oPPrefix);
-            oPPrefix = NULL;
+            /* go to that child and continue with next component */
             iStatus = Node_getChild(oNCurr, ulChildID, &oNChild);
+            if (iStatus == SUCCESS && bOwn)
+                iStatus = Node_own(oNCurr, &oNChild);
             if (iStatus != SUCCESS)
             {
-                *poNFurthest = NULL;
                 return iStatus;
             }
             oNCurr = oNChild;
         }
         else
         {
-            /* oNCurr doesn't have child with path oPPrefix:
+            /* oNCurr doesn't have child with this name:
                this is as far as we can go */
             break;
         }
     }
 
-    Path_free(oPPrefix);
     *poNFurthest = oNCurr;
+    *pulFurthestDepth = i;
 
     return SUCCESS;
 }
 
 /*
-  Traverses the DT to find a node with absolute path pcPath. Returns a
-  int SUCCESS status and sets *poNResult to be the node, if found.
-  Otherwise, sets *poNResult to NULL and returns with status:
-  * INITIALIZATION_ERROR if the DT is not in an initialized state
+  Traverses the tree rooted at *poNTop to find a node with absolute
+  path pcPath, readying each node on the way to be modified if bOwn is
+  TRUE, as FT_traversePath does. Returns a int SUCCESS status and sets
+  *poNResult to be the node, if found. Otherwise, sets *poNResult to
+  NULL_NODE and returns with status:
   * BAD_PATH if pcPath does not represent a well-formatted path
   * CONFLICTING_PATH if the root's path is not a prefix of pcPath
   * NO_SUCH_PATH if no node with pcPath exists in the hierarchy
   * MEMORY_ERROR if memory could not be allocated to complete request
  */
-static int FT_findNode(const char *pcPath, Node_T *poNResult)
+static int FT_findIn(Node_T *poNTop, boolean bOwn, const char *pcPath,
+                     Node_T *poNResult)
 {
     Path_T oPPath = NULL;
-    Node_T oNFound = NULL;
+    Node_T oNFound = NULL_NODE;
+    size_t ulFoundDepth;
     int iStatus;
 
     assert(pcPath != NULL);
     assert(poNResult != NULL);
 
-    if (!bIsInitialized)
-    {
-        *poNResult = NULL;
-        return INITIALIZATION_ERROR;
-    }
-
+    *poNResult = NULL_NODE;
     iStatus = Path_new(pcPath, &oPPath);
     if (iStatus != SUCCESS)
     {
-        *poNResult = NULL;
         return iStatus;
     }
 
-    iStatus = FT_traversePath(oPPath, &oNFound);
+    iStatus = FT_traversePath(poNTop, bOwn, oPPath, &oNFound,
+                              &ulFoundDepth);
     if (iStatus != SUCCESS)
     {
         Path_free(oPPath);
-        *poNResult = NULL;
         return iStatus;
     }
 
-    if (oNFound == NULL)
+    /* the furthest node reached must be the whole path */
+    if (oNFound == NULL_NODE || ulFoundDepth != Path_getDepth(oPPath))
     {
         Path_free(oPPath);
-        *poNResult = NULL;
         return NO_SUCH_PATH;
     }
 
-    if (Path_comparePath(Node_getPath(oNFound), oPPath) != 0)
+    Path_free(oPPath);
+    *poNResult = oNFound;
+    return SUCCESS;
+}
+
+/*
+  Finds the node with absolute path pcPath in the FT, as FT_findIn
+  does, readying the path to it to be modified if bOwn is TRUE.
+  Returns with the same statuses, or INITIALIZATION_ERROR if the FT is
+  not in an initialized state.
+*/
+static int FT_findNode(const char *pcPath, boolean bOwn,
+                       Node_T *poNResult)
+{
+    assert(pcPath != NULL);
+    assert(poNResult != NULL);
+
+    if (!bIsInitialized)
     {
-        Path_free(oPPath);
-        *poNResult = NULL;
-        return NO_SUCH_PATH;
+        *poNResult = NULL_NODE;
+        return INITIALIZATION_ERROR;
     }
+    return FT_findIn(&oNRoot, bOwn, pcPath, poNResult);
+}
+
+/*
+  Looks up absolute path pcPath in the frozen FT's image. Returns an
+  int SUCCESS status and sets *pulResult to the image node, if found.
+  Otherwise, returns with the same statuses as FT_findNode.
+*/
+static int FT_findFrozen(const char *pcPath, size_t *pulResult)
+{
+    Path_T oPPath = NULL;
+    int iStatus;
+
+    assert(pcPath != NULL);
+    assert(pulResult != NULL);
+    assert(oIFrozen != NULL);
+
+    iStatus = Path_new(pcPath, &oPPath);
+    if (iStatus != SUCCESS)
+        return iStatus;
 
+    iStatus = Image_find(oIFrozen, oPPath, pulResult);
     Path_free(oPPath);
-    *poNResult = oNFound;
-    return SUCCESS;
+    return iStatus;
 }
 /*--------------------------------------------------------------------*/
 
@@ -170,8 +447,8 @@ int FT_insertDir(const char *pcPath)
 {
     int iStatus;
     Path_T oPPath = NULL;
-    Node_T oNFirstNew = NULL;
-    Node_T oNCurr = NULL;
+    Node_T oNFirstNew = NULL_NODE;
+    Node_T oNCurr = NULL_NODE;
     size_t ulDepth, ulIndex;
     size_t ulNewNodes = 0;
 
@@ -182,12 +459,16 @@ int FT_insertDir(const char *pcPath)
     if (!bIsInitialized)
         return INITIALIZATION_ERROR;
 
+    iStatus = FT_beginUpdate();
+    if (iStatus != SUCCESS)
+        return iStatus;
+
     iStatus = Path_new(pcPath, &oPPath);
     if (iStatus != SUCCESS)
         return iStatus;
 
     /* find the closest ancestor of oPPath already in the tree */
-    iStatus = FT_traversePath(oPPath, &oNCurr);
+    iStatus = FT_traversePath(&oNRoot, TRUE, oPPath, &oNCurr, &ulIndex);
     if (iStatus != SUCCESS)
     {
         Path_free(oPPath);
@@ -195,77 +476,66 @@ int FT_insertDir(const char *pcPath)
     }
 
     /* adding a child to a file is illegal */
-    if (oNCurr != NULL && Node_isDirectory(oNCurr) == FALSE)
+    if (oNCurr != NULL_NODE && Node_isDirectory(oNCurr) == FALSE)
     {
         Path_free(oPPath);
         return NOT_A_DIRECTORY;
     }
 
-    /* no ancestor node found, so if root is not NULL,
+    /* no ancestor node found, so if root is not NULL_NODE,
        pcPath isn't underneath root. */
-    if (oNCurr == NULL && oNRoot != NULL)
+    if (oNCurr == NULL_NODE && oNRoot != NULL_NODE)
     {
         Path_free(oPPath);
         return CONFLICTING_PATH;
     }
 
     ulDepth = Path_getDepth(oPPath);
-    if (oNCurr == NULL) /* new root! */
-        ulIndex = 1;
-    else
+    /* oNCurr is the node we're trying to insert. otherwise, ulIndex
+       is the index of the first component not in the tree yet (0 for
+       a new root!) */
+    if (oNCurr != NULL_NODE && ulIndex == ulDepth)
     {
-        ulIndex = Path_getDepth(Node_getPath(oNCurr)) + 1;
-
-        /* oNCurr is the node we're trying to insert */
-        if (ulIndex == ulDepth + 1 && !Path_comparePath(oPPath,
-                                                        Node_getPath(oNCurr)))
-        {
-            Path_free(oPPath);
-            return ALREADY_IN_TREE;
-        }
+        Path_free(oPPath);
+        return ALREADY_IN_TREE;
     }
 
     /* starting at oNCurr, build rest of the path one level at a time */
-    while (ulIndex <= ulDepth)
+    while (ulIndex < ulDepth)
     {
-        Path_T oPPrefix = NULL;
-        Node_T oNNewNode = NULL;
-
-        /* generate a Path_T for this level */
-        iStatus = Path_prefix(oPPath, ulIndex, &oPPrefix);
-        if (iStatus != SUCCESS)
-        {
-            Path_free(oPPath);
-            if (oNFirstNew != NULL)
-                (void)Node_free(oNFirstNew);
-            /* assert(CheckerDT_isValid(bIsInitialized, oNRoot, ulCount)); */
-            return iStatus;
-        }
+        const char *pcName = Path_getComponent(oPPath, ulIndex);
+        Node_T oNNewNode = NULL_NODE;
 
         /* insert the new node for this level */
-        iStatus = Node_new(oPPrefix, oNCurr, &oNNewNode, TRUE, NULL, 0);
+        iStatus = Node_new(pcName, oNCurr, &oNNewNode, TRUE, NULL, 0);
         if (iStatus != SUCCESS)
         {
             Path_free(oPPath);
-            Path_free(oPPrefix);
-            if (oNFirstNew != NULL)
+            if (oNFirstNew != NULL_NODE)
                 (void)Node_free(oNFirstNew);
             /* assert(CheckerDT_isValid(bIsInitialized, oNRoot, ulCount)); */
             return iStatus;
         }
 
         /* set up for next level */
-        Path_free(oPPrefix);
         oNCurr = oNNewNode;
         ulNewNodes++;
-        if (oNFirstNew == NULL)
+        if (oNFirstNew == NULL_NODE)
             oNFirstNew = oNCurr;
         ulIndex++;
     }
 
     Path_free(oPPath);
+    /* the insertion stands only once journaled */
+    iStatus = FT_log(JOURNAL_INSERT_DIR, pcPath, NULL, 0);
+    if (iStatus != SUCCESS)
+    {
+        (void)Node_free(oNFirstNew);
+        return iStatus;
+    }
+
     /* update DT state variables to reflect insertion */
-    if (oNRoot == NULL)
+    if (oNRoot == NULL_NODE)
         oNRoot = oNFirstNew;
     ulCount += ulNewNodes;
 
@@ -277,11 +547,19 @@ int FT_insertDir(const char *pcPath)
 boolean FT_containsDir(const char *pcPath)
 {
     int iStatus;
-    Node_T oNFound = NULL;
+    Node_T oNFound = NULL_NODE;
 
     assert(pcPath != NULL);
 
-    iStatus = FT_findNode(pcPath, &oNFound);
+    if (oIFrozen != NULL)
+    {
+        size_t ulFound;
+        if (FT_findFrozen(pcPath, &ulFound) != SUCCESS)
+            return FALSE;
+        return Image_isDirectory(oIFrozen, ulFound);
+    }
+
+    iStatus = FT_findNode(pcPath, FALSE, &oNFound);
     if (iStatus != SUCCESS)
     {
         return FALSE;
@@ -293,11 +571,16 @@ boolean FT_containsDir(const char *pcPath)
 int FT_rmDir(const char *pcPath)
 {
     int iStatus;
-    Node_T oNRemove = NULL;
+    Node_T oNRemove = NULL_NODE;
 
     assert(pcPath != NULL);
 
-    iStatus = FT_findNode(pcPath, &oNRemove);
+    iStatus = FT_beginUpdate();
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+    iStatus = FT_findNode(pcPath, TRUE, &oNRemove);
     if (iStatus != SUCCESS)
     {
         return iStatus;
@@ -307,11 +590,18 @@ int FT_rmDir(const char *pcPath)
         return NOT_A_DIRECTORY;
     }
 
-    /* if removing the root, set the root pointer to NULL */
+    /* journaled first, as removing cannot fail */
+    iStatus = FT_log(JOURNAL_RM_DIR, pcPath, NULL, 0);
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+
+    /* if removing the root, set the root to NULL_NODE */
     if (oNRemove == oNRoot)
     {
         ulCount -= Node_free(oNRemove);
-        oNRoot = NULL;
+        oNRoot = NULL_NODE;
     }
     else
     {
@@ -320,13 +610,20 @@ int FT_rmDir(const char *pcPath)
     return SUCCESS;
 }
 
-int FT_insertFile(const char *pcPath, void *pvContents,
-                  size_t ulLength)
+/*
+  Inserts a file at pcPath, as FT_insertFile does, with the ulLength
+  bytes at pvContents, or, if iFd is not negative, with the ulLength
+  bytes at offset ulOffset of the file open as iFd, ignoring
+  pvContents. Returns the statuses FT_insertFile and
+  FT_insertFileFromFd do.
+*/
+static int FT_insertFileFrom(const char *pcPath, void *pvContents,
+                             size_t ulLength, int iFd, size_t ulOffset)
 {
     int iStatus;
     Path_T oPPath = NULL;
-    Node_T oNFirstNew = NULL;
-    Node_T oNCurr = NULL;
+    Node_T oNFirstNew = NULL_NODE;
+    Node_T oNCurr = NULL_NODE;
     size_t ulDepth, ulIndex;
     size_t ulNewNodes = 0;
 
@@ -337,12 +634,16 @@ int FT_insertFile(const char *pcPath, void *pvContents,
     if (!bIsInitialized)
         return INITIALIZATION_ERROR;
 
+    iStatus = FT_beginUpdate();
+    if (iStatus != SUCCESS)
+        return iStatus;
+
     iStatus = Path_new(pcPath, &oPPath);
     if (iStatus != SUCCESS)
         return iStatus;
 
     /* find the closest ancestor of oPPath already in the tree */
-    iStatus = FT_traversePath(oPPath, &oNCurr);
+    iStatus = FT_traversePath(&oNRoot, TRUE, oPPath, &oNCurr, &ulIndex);
     if (iStatus != SUCCESS)
     {
         Path_free(oPPath);
@@ -350,15 +651,15 @@ int FT_insertFile(const char *pcPath, void *pvContents,
     }
 
     /* adding a child to a file is illegal */
-    if (oNCurr != NULL && Node_isDirectory(oNCurr) == FALSE)
+    if (oNCurr != NULL_NODE && Node_isDirectory(oNCurr) == FALSE)
     {
         Path_free(oPPath);
         return NOT_A_DIRECTORY;
     }
 
-    /* no ancestor node found, so if root is not NULL,
+    /* no ancestor node found, so if root is not NULL_NODE,
        pcPath isn't underneath root. */
-    if (oNCurr == NULL && oNRoot != NULL)
+    if (oNCurr == NULL_NODE && oNRoot != NULL_NODE)
     {
         Path_free(oPPath);
         return CONFLICTING_PATH;
@@ -373,69 +674,91 @@ int FT_insertFile(const char *pcPath, void *pvContents,
         return CONFLICTING_PATH;
     }
 
-    if (oNCurr == NULL) /* new root! */
-        ulIndex = 1;
-    else
+    /* oNCurr is the node we're trying to insert. otherwise, ulIndex
+       is the index of the first component not in the tree yet (0 for
+       a new root!) */
+    if (oNCurr != NULL_NODE && ulIndex == ulDepth)
     {
-        ulIndex = Path_getDepth(Node_getPath(oNCurr)) + 1;
-
-        /* oNCurr is the node we're trying to insert */
-        if (ulIndex == ulDepth + 1 && !Path_comparePath(oPPath,
-                                                        Node_getPath(oNCurr)))
-        {
-            Path_free(oPPath);
-            return ALREADY_IN_TREE;
-        }
+        Path_free(oPPath);
+        return ALREADY_IN_TREE;
     }
 
     /* starting at oNCurr, build rest of the path one level at a time */
-    while (ulIndex <= ulDepth)
+    while (ulIndex < ulDepth)
     {
-        Path_T oPPrefix = NULL;
-        Node_T oNNewNode = NULL;
+        const char *pcName = Path_getComponent(oPPath, ulIndex);
+        Node_T oNNewNode = NULL_NODE;
 
-        /* generate a Path_T for this level */
-        iStatus = Path_prefix(oPPath, ulIndex, &oPPrefix);
-        if (iStatus != SUCCESS)
+        /* insert the new directory node for all levels except the last */
+        if (ulIndex == ulDepth - 1 && iFd >= 0)
         {
-            Path_free(oPPath);
-            if (oNFirstNew != NULL)
-                (void)Node_free(oNFirstNew);
-            /* assert(CheckerDT_isValid(bIsInitialized, oNRoot, ulCount)); */
-            return iStatus;
+            iStatus = Node_new(pcName, oNCurr, &oNNewNode, FALSE, NULL, 0);
         }
-
-        /* insert the new directory node for all levels except the last */
-        if (ulIndex == ulDepth)
+        else if (ulIndex == ulDepth - 1)
         {
-            iStatus = Node_new(oPPrefix, oNCurr, &oNNewNode, FALSE, pvContents, ulLength);
+            iStatus = Node_new(pcName, oNCurr, &oNNewNode, FALSE,
+                               pvContents, ulLength);
         }
         else
         {
-            iStatus = Node_new(oPPrefix, oNCurr, &oNNewNode, TRUE, NULL, 0);
+            iStatus = Node_new(pcName, oNCurr, &oNNewNode, TRUE, NULL, 0);
         }
         if (iStatus != SUCCESS)
         {
             Path_free(oPPath);
-            Path_free(oPPrefix);
-            if (oNFirstNew != NULL)
+            if (oNFirstNew != NULL_NODE)
                 (void)Node_free(oNFirstNew);
             /* assert(CheckerDT_isValid(bIsInitialized, oNRoot, ulCount)); */
             return iStatus;
         }
 
         /* set up for next level */
-        Path_free(oPPrefix);
         oNCurr = oNNewNode;
         ulNewNodes++;
-        if (oNFirstNew == NULL)
+        if (oNFirstNew == NULL_NODE)
             oNFirstNew = oNCurr;
         ulIndex++;
     }
 
+    /* the file holds a reference to its own copy of the contents, as
+       it always does of contents read from a file */
+    if (iFd >= 0 ||
+        (iContentsMode != FT_CONTENTS_BORROWED && pvContents != NULL))
+    {
+        if (iFd >= 0)
+            iStatus = Node_loadContents(oNCurr, iFd, ulOffset, ulLength,
+                                        FT_storageKind(ulLength, TRUE));
+        else
+            iStatus = Node_storeContents(oNCurr, pvContents, ulLength,
+                                         FT_storageKind(ulLength, FALSE));
+        if (iStatus != SUCCESS)
+        {
+            Path_free(oPPath);
+            (void)Node_free(oNFirstNew);
+            return iStatus;
+        }
+        if (ulLargeLength != 0)
+            Node_pack(oNCurr, ulLargeLength, FALSE);
+    }
+
     Path_free(oPPath);
+    /* the insertion stands only once journaled, with the bytes read
+       if they came from a file */
+    if (iFd >= 0 && oJJournal != NULL &&
+        Node_fetchContents(oNCurr, &pvContents) != SUCCESS)
+    {
+        (void)Node_free(oNFirstNew);
+        return MEMORY_ERROR;
+    }
+    iStatus = FT_log(JOURNAL_INSERT_FILE, pcPath, pvContents, ulLength);
+    if (iStatus != SUCCESS)
+    {
+        (void)Node_free(oNFirstNew);
+        return iStatus;
+    }
+
     /* update DT state variables to reflect insertion */
-    if (oNRoot == NULL)
+    if (oNRoot == NULL_NODE)
         oNRoot = oNFirstNew;
     ulCount += ulNewNodes;
 
@@ -443,16 +766,66 @@ int FT_insertFile(const char *pcPath, void *pvContents,
     return SUCCESS;
 }
 
+int FT_insertFile(const char *pcPath, void *pvContents,
+                  size_t ulLength)
+{
+    return FT_insertFileFrom(pcPath, pvContents, ulLength, -1, 0);
+}
+
+int FT_insertFileFromFd(const char *pcPath, int iFd, size_t ulOffset,
+                        size_t ulLength)
+{
+    assert(pcPath != NULL);
+    assert(iFd >= 0);
+
+    return FT_insertFileFrom(pcPath, NULL, ulLength, iFd, ulOffset);
+}
+
+int FT_writeFileToFd(const char *pcPath, int iFd)
+{
+    Node_T oNFile = NULL_NODE;
+    int iStatus;
+
+    assert(pcPath != NULL);
+    assert(iFd >= 0);
+
+    if (oIFrozen != NULL)
+    {
+        size_t ulFile;
+        iStatus = FT_findFrozen(pcPath, &ulFile);
+        if (iStatus != SUCCESS)
+            return iStatus;
+        if (Image_isDirectory(oIFrozen, ulFile))
+            return NOT_A_FILE;
+        return Content_sendBytes(Image_getContents(oIFrozen, ulFile),
+                                 Image_getSizeContents(oIFrozen, ulFile),
+                                 iFd);
+    }
+
+    iStatus = FT_findNode(pcPath, FALSE, &oNFile);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    return Node_sendContents(oNFile, iFd);
+}
+
 
 
 boolean FT_containsFile(const char *pcPath)
 {
     int iStatus;
-    Node_T oNFound = NULL;
+    Node_T oNFound = NULL_NODE;
 
     assert(pcPath != NULL);
 
-    iStatus = FT_findNode(pcPath, &oNFound);
+    if (oIFrozen != NULL)
+    {
+        size_t ulFound;
+        if (FT_findFrozen(pcPath, &ulFound) != SUCCESS)
+            return FALSE;
+        return (boolean)(Image_isDirectory(oIFrozen, ulFound) == FALSE);
+    }
+
+    iStatus = FT_findNode(pcPath, FALSE, &oNFound);
     if (iStatus != SUCCESS)
     {
         return FALSE;
@@ -465,11 +838,16 @@ boolean FT_containsFile(const char *pcPath)
 int FT_rmFile(const char *pcPath)
 {
     int iStatus;
-    Node_T oNRemove = NULL;
+    Node_T oNRemove = NULL_NODE;
 
     assert(pcPath != NULL);
 
-    iStatus = FT_findNode(pcPath, &oNRemove);
+    iStatus = FT_beginUpdate();
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+    iStatus = FT_findNode(pcPath, TRUE, &oNRemove);
     if (iStatus != SUCCESS)
     {
         return iStatus;
@@ -478,79 +856,2078 @@ int FT_rmFile(const char *pcPath)
     {
         return NOT_A_FILE;
     }
+    iStatus = FT_log(JOURNAL_RM_FILE, pcPath, NULL, 0);
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
     ulCount -= Node_free(oNRemove);
     return SUCCESS;
 }
 
 
 
-void *FT_getFileContents(const char *pcPath)
+/*
+  Finds the parent of oPPath, at least two components deep, in the FT,
+  readying the path to it to be modified, for a node to be put at
+  oPPath. Returns SUCCESS and sets *poNParent to the parent. Otherwise,
+  returns:
+  * CONFLICTING_PATH if the root's path is not a prefix of oPPath
+  * NO_SUCH_PATH if the parent of oPPath is not in the FT
+  * NOT_A_DIRECTORY if a proper prefix of oPPath exists as a file
+  * ALREADY_IN_TREE if oPPath is already in the FT
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int FT_findParent(Path_T oPPath, Node_T *poNParent)
 {
-    Node_T oNFile = NULL;
+    size_t ulDepth = Path_getDepth(oPPath);
+    size_t ulIndex;
     int iStatus;
 
-    assert(pcPath != NULL);
+    assert(ulDepth > 1);
+    assert(poNParent != NULL);
 
-    iStatus = FT_findNode(pcPath, &oNFile);
+    iStatus = FT_traversePath(&oNRoot, TRUE, oPPath, poNParent, &ulIndex);
     if (iStatus != SUCCESS)
-    {
-        return NULL;
-    }
-
-    return Node_getContents(oNFile);
+        return iStatus;
+    if (*poNParent == NULL_NODE)
+        return NO_SUCH_PATH;
+    if (ulIndex == ulDepth)
+        return ALREADY_IN_TREE;
+    if (Node_isDirectory(*poNParent) == FALSE)
+        return NOT_A_DIRECTORY;
+    if (ulIndex < ulDepth - 1)
+        return NO_SUCH_PATH;
+    return SUCCESS;
 }
 
-
-void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
-                             size_t ulNewLength)
+/*
+  Checks that the node at absolute path pcSrc, which is in the FT, can
+  be moved or copied to absolute path pcDst, and readies the path to
+  pcDst's parent to be modified. Returns SUCCESS, sets *poNParent to
+  pcDst's parent, and sets *poPDst to a Path_T for pcDst, which the
+  caller must free. Otherwise, returns with the status FT_move
+  documents.
+*/
+static int FT_findDestination(const char *pcSrc, const char *pcDst,
+                              Path_T *poPDst, Node_T *poNParent)
 {
-    Node_T oNNode = NULL;
-    void *pvOldContents;
     int iStatus;
+    Path_T oPSrc = NULL;
+    Path_T oPDst = NULL;
+    size_t ulDepth;
 
-    assert(pcPath != NULL);
+    assert(pcSrc != NULL);
+    assert(pcDst != NULL);
+    assert(poPDst != NULL);
+    assert(poNParent != NULL);
 
-    iStatus = FT_findNode(pcPath, &oNNode);
+    iStatus = Path_new(pcSrc, &oPSrc);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    iStatus = Path_new(pcDst, &oPDst);
     if (iStatus != SUCCESS)
     {
-        return NULL;
+        Path_free(oPSrc);
+        return iStatus;
     }
-    if (Node_isDirectory(oNNode) == TRUE)
+
+    /* a subtree cannot go into itself, and the root cannot go */
+    ulDepth = Path_getDepth(oPDst);
+    if (Path_comparePath(oPSrc, oPDst) == 0)
+        iStatus = ALREADY_IN_TREE;
+    else if (ulDepth == 1 || Path_getDepth(oPSrc) == 1 ||
+             Path_getSharedPrefixDepth(oPSrc, oPDst) ==
+             Path_getDepth(oPSrc))
+        iStatus = CONFLICTING_PATH;
+    Path_free(oPSrc);
+
+    /* this copies no node on the path to the source, which is not
+       under the destination's parent, so the source's handle stays
+       valid */
+    if (iStatus == SUCCESS)
+        iStatus = FT_findParent(oPDst, poNParent);
+    if (iStatus != SUCCESS)
     {
-        return NULL;
+        Path_free(oPDst);
+        return iStatus;
     }
-    pvOldContents = Node_getContents(oNNode);
-    Node_setContents(oNNode, pvNewContents, ulNewLength);
-    return pvOldContents;
+    *poPDst = oPDst;
+    return SUCCESS;
 }
 
-
-
-int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize)
+int FT_move(const char *pcSrc, const char *pcDst)
 {
-    Node_T oNNode = NULL;
     int iStatus;
+    Path_T oPDst = NULL;
+    Node_T oNSrc = NULL_NODE;
+    Node_T oNParent = NULL_NODE;
 
-    assert(pcPath != NULL);
+    assert(pcSrc != NULL);
+    assert(pcDst != NULL);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    iStatus = FT_beginUpdate();
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    iStatus = FT_findNode(pcSrc, TRUE, &oNSrc);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_findDestination(pcSrc, pcDst, &oPDst, &oNParent);
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    /* journaled first, with room kept for moving it back in the
+       journal if the move then fails */
+    iStatus = FT_reserve(2, 2 * (strlen(pcSrc) + strlen(pcDst) + 2));
+    if (iStatus == SUCCESS)
+        iStatus = FT_log(JOURNAL_MOVE, pcSrc, pcDst, strlen(pcDst) + 1);
+    if (iStatus != SUCCESS)
+    {
+        Path_free(oPDst);
+        return iStatus;
+    }
+
+    iStatus = Node_move(oNSrc, oNParent,
+                        Path_getComponent(oPDst, Path_getDepth(oPDst) - 1));
+    Path_free(oPDst);
+    if (iStatus != SUCCESS)
+        FT_logUndo(JOURNAL_MOVE, pcDst, pcSrc, strlen(pcSrc) + 1);
+    return iStatus;
+}
+
+int FT_copy(const char *pcSrc, const char *pcDst)
+{
+    int iStatus;
+    Path_T oPDst = NULL;
+    Node_T oNSrc = NULL_NODE;
+    Node_T oNParent = NULL_NODE;
+    Node_T oNCopy = NULL_NODE;
+    size_t ulDirs, ulFiles, ulBytes;
+
+    assert(pcSrc != NULL);
+    assert(pcDst != NULL);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    iStatus = FT_beginUpdate();
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    /* the source is only shared, not modified */
+    iStatus = FT_findNode(pcSrc, FALSE, &oNSrc);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_findDestination(pcSrc, pcDst, &oPDst, &oNParent);
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    iStatus = Node_copy(oNSrc, oNParent,
+                        Path_getComponent(oPDst, Path_getDepth(oPDst) - 1),
+                        &oNCopy);
+    Path_free(oPDst);
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    /* the copy stands only once journaled */
+    iStatus = FT_log(JOURNAL_COPY, pcSrc, pcDst, strlen(pcDst) + 1);
+    if (iStatus != SUCCESS)
+    {
+        (void)Node_free(oNCopy);
+        return iStatus;
+    }
+    Node_getTotals(oNCopy, &ulDirs, &ulFiles, &ulBytes);
+    ulCount += ulDirs + ulFiles;
+    return SUCCESS;
+}
+
+/*
+  Returns the absolute path of the child named pcName of the node with
+  absolute path pcParent, in memory that the caller owns, or NULL if
+  memory could not be allocated.
+*/
+static char *FT_childPath(const char *pcParent, const char *pcName)
+{
+    size_t ulLength = strlen(pcParent);
+    char *pcChild = malloc(ulLength + strlen(pcName) + 2);
+
+    if (pcChild == NULL)
+        return NULL;
+    strcpy(pcChild, pcParent);
+    pcChild[ulLength] = '/';
+    strcpy(pcChild + ulLength + 1, pcName);
+    return pcChild;
+}
+
+/*
+  Records in the journal, if one is open, the insertion of each node
+  of the subtree rooted at oNNode, which is at absolute path pcPath,
+  in pre-order. Returns SUCCESS, or the status of the first record
+  that could not be journaled, or MEMORY_ERROR if memory for a record
+  could not be allocated: the records before it stay journaled.
+*/
+static int FT_logSubtree(Node_T oNNode, const char *pcPath)
+{
+    size_t c;
+    int iStatus;
+
+    if (oJJournal == NULL)
+        return SUCCESS;
+    if (Node_isDirectory(oNNode) == FALSE)
+    {
+        void *pvContents;
+
+        /* chunked contents may not fit in one block */
+        if (Node_fetchContents(oNNode, &pvContents) != SUCCESS)
+            return MEMORY_ERROR;
+        return FT_log(JOURNAL_INSERT_FILE, pcPath, pvContents,
+                      Node_getSizeContents(oNNode));
+    }
+
+    iStatus = FT_log(JOURNAL_INSERT_DIR, pcPath, NULL, 0);
+    for (c = 0; iStatus == SUCCESS && c < Node_getNumChildren(oNNode);
+         c++)
+    {
+        Node_T oNChild = NULL_NODE;
+        char *pcChild;
+
+        (void)Node_getChild(oNNode, c, &oNChild);
+        pcChild = FT_childPath(pcPath, Node_getName(oNChild));
+        if (pcChild == NULL)
+            return MEMORY_ERROR;
+        iStatus = FT_logSubtree(oNChild, pcChild);
+        free(pcChild);
+    }
+    return iStatus;
+}
+
+int FT_detach(const char *pcPath, Subtree_T *poTResult)
+{
+    int iStatus;
+    Node_T oNDetach = NULL_NODE;
+    size_t ulDirs, ulFiles, ulBytes;
+
+    assert(pcPath != NULL);
+    assert(poTResult != NULL);
+
+    *poTResult = NULL;
+    iStatus = FT_beginUpdate();
+    if (iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_findNode(pcPath, TRUE, &oNDetach);
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    *poTResult = malloc(sizeof(struct subtree));
+    if (*poTResult == NULL)
+        return MEMORY_ERROR;
+    iStatus = FT_log(Node_isDirectory(oNDetach) ? JOURNAL_RM_DIR :
+                     JOURNAL_RM_FILE, pcPath, NULL, 0);
+    if (iStatus != SUCCESS)
+    {
+        free(*poTResult);
+        *poTResult = NULL;
+        return iStatus;
+    }
+
+    /* under its own name, as a root of its own, which cannot fail */
+    Node_getTotals(oNDetach, &ulDirs, &ulFiles, &ulBytes);
+    iStatus = Node_move(oNDetach, NULL_NODE, Node_getName(oNDetach));
+    assert(iStatus == SUCCESS);
+    if (oNDetach == oNRoot)
+        oNRoot = NULL_NODE;
+    ulCount -= ulDirs + ulFiles;
+    (*poTResult)->oNRoot = oNDetach;
+    return SUCCESS;
+}
+
+int FT_attach(const char *pcPath, Subtree_T oTSubtree)
+{
+    int iStatus;
+    Path_T oPPath = NULL;
+    Node_T oNParent = NULL_NODE;
+    Node_T oNAttach;
+    size_t ulDepth, ulDirs, ulFiles, ulBytes;
+    size_t ulLogged = 0;
+
+    assert(pcPath != NULL);
+    assert(oTSubtree != NULL);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+    iStatus = FT_beginUpdate();
+    if (iStatus != SUCCESS)
+        return iStatus;
+    iStatus = Path_new(pcPath, &oPPath);
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    /* the subtree either becomes the root of an empty FT, or goes
+       under a directory already in the FT */
+    oNAttach = oTSubtree->oNRoot;
+    ulDepth = Path_getDepth(oPPath);
+    if (ulDepth > 1)
+        iStatus = FT_findParent(oPPath, &oNParent);
+    else if (oNRoot != NULL_NODE)
+        iStatus = Path_compareString(oPPath, Node_getName(oNRoot)) == 0 ?
+                  ALREADY_IN_TREE : CONFLICTING_PATH;
+    else if (Node_isDirectory(oNAttach) == FALSE)
+        iStatus = CONFLICTING_PATH;
+
+    /* journaled first, so that failing leaves the subtree with the
+       caller, and removed again in the journal if it was partly
+       journaled, or could not be grafted */
+    if (oJJournal != NULL)
+        ulLogged = Journal_getLastSequence(oJJournal);
+    if (iStatus == SUCCESS)
+        iStatus = FT_logSubtree(oNAttach, pcPath);
+    if (iStatus == SUCCESS)
+        iStatus = Node_move(oNAttach, oNParent,
+                            Path_getComponent(oPPath, ulDepth - 1));
+    Path_free(oPPath);
+    if (iStatus != SUCCESS)
+    {
+        if (oJJournal != NULL &&
+            Journal_getLastSequence(oJJournal) != ulLogged)
+            FT_logUndo(Node_isDirectory(oNAttach) ? JOURNAL_RM_DIR :
+                       JOURNAL_RM_FILE, pcPath, NULL, 0);
+        return iStatus;
+    }
+
+    if (oNParent == NULL_NODE)
+        oNRoot = oNAttach;
+    Node_getTotals(oNAttach, &ulDirs, &ulFiles, &ulBytes);
+    ulCount += ulDirs + ulFiles;
+    free(oTSubtree);
+    return SUCCESS;
+}
+
+void FT_freeSubtree(Subtree_T oTSubtree)
+{
+    assert(oTSubtree != NULL);
+
+    (void)Node_free(oTSubtree->oNRoot);
+    free(oTSubtree);
+}
+
+int FT_merge(const char *pcPath, Subtree_T oTSubtree, int iPolicy)
+{
+    int iStatus;
+    Node_T oNDst = NULL_NODE;
+    size_t ulOldDirs, ulOldFiles, ulOldBytes;
+    size_t ulDirs, ulFiles, ulBytes;
+
+    assert(pcPath != NULL);
+    assert(oTSubtree != NULL);
+
+    iStatus = FT_beginUpdate();
+    if (iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_findNode(pcPath, TRUE, &oNDst);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    if (Node_isDirectory(oNDst) == FALSE ||
+        Node_isDirectory(oTSubtree->oNRoot) == FALSE)
+        return NOT_A_DIRECTORY;
+
+    Node_getTotals(oNDst, &ulOldDirs, &ulOldFiles, &ulOldBytes);
+    iStatus = Node_merge(oNDst, oTSubtree->oNRoot,
+                         (boolean)((iPolicy & FT_MERGE_FILES_FROM_SRC) != 0),
+                         (boolean)((iPolicy & FT_MERGE_KINDS_FROM_SRC) != 0));
+    Node_getTotals(oNDst, &ulDirs, &ulFiles, &ulBytes);
+    ulCount = ulCount + ulDirs + ulFiles - ulOldDirs - ulOldFiles;
+
+    /* a partial merge changed the tree too, so journal it either way,
+       as the directory's removal and the insertion of what it holds */
+    if (iStatus == SUCCESS)
+        FT_freeSubtree(oTSubtree);
+    if (FT_log(JOURNAL_RM_DIR, pcPath, NULL, 0) != SUCCESS ||
+        FT_logSubtree(oNDst, pcPath) != SUCCESS)
+        bJournalFailed = TRUE;
+    if (iStatus == SUCCESS && bJournalFailed)
+        return IO_ERROR;
+    return iStatus;
+}
+
+/*
+  Builds, from oSScan, a detached directory named pcName holding what
+  the scanned directory does, and stores it in *poNResult. Each
+  directory's files are inserted before its directories, both in the
+  sorted order of the scan, so every insertion appends. Returns
+  SUCCESS, or MEMORY_ERROR if memory could not be allocated, in which
+  case nothing is left allocated.
+*/
+static int FT_buildScanned(Scan_T oSScan, const char *pcName,
+                           Node_T *poNResult)
+{
+    size_t ulNumDirs = Scan_getNumDirs(oSScan);
+    Node_T *poNDirs;
+    size_t i, j;
+    int iPass;
+    int iStatus;
+
+    *poNResult = NULL_NODE;
+    poNDirs = malloc(ulNumDirs * sizeof(Node_T));
+    if (poNDirs == NULL)
+        return MEMORY_ERROR;
+    iStatus = Node_new(pcName, NULL_NODE, &poNDirs[0], TRUE, NULL, 0);
+    if (iStatus != SUCCESS)
+    {
+        free(poNDirs);
+        return iStatus;
+    }
+
+    /* every directory is numbered after its parent, so exists by the
+       time its own entries are inserted */
+    for (i = 0; iStatus == SUCCESS && i < ulNumDirs; i++)
+    {
+        size_t ulNumEntries = Scan_getNumEntries(oSScan, i);
+        for (iPass = 0; iStatus == SUCCESS && iPass < 2; iPass++)
+        {
+            for (j = 0; iStatus == SUCCESS && j < ulNumEntries; j++)
+            {
+                const void *pvContents;
+                size_t ulLength;
+                Node_T oNNew;
+
+                /* files in the first pass, directories in the second */
+                if (Scan_isDirectory(oSScan, i, j) != (iPass == 1))
+                    continue;
+                if (iPass == 1)
+                {
+                    iStatus = Node_new(Scan_getName(oSScan, i, j),
+                                       poNDirs[i],
+                                       &poNDirs[Scan_getDir(oSScan, i, j)],
+                                       TRUE, NULL, 0);
+                    continue;
+                }
+                pvContents = Scan_getContents(oSScan, i, j, &ulLength);
+                iStatus = Node_new(Scan_getName(oSScan, i, j), poNDirs[i],
+                                   &oNNew, FALSE, NULL, 0);
+                if (iStatus == SUCCESS)
+                    iStatus = Node_storeContents(oNNew, pvContents,
+                                                 ulLength,
+                                                 FT_storageKind(ulLength,
+                                                                FALSE));
+                if (iStatus == SUCCESS && ulLargeLength != 0)
+                    Node_pack(oNNew, ulLargeLength, FALSE);
+            }
+        }
+    }
+
+    if (iStatus != SUCCESS)
+        (void)Node_free(poNDirs[0]);
+    else
+        *poNResult = poNDirs[0];
+    free(poNDirs);
+    return iStatus;
+}
+
+int FT_importDir(const char *pcFsPath, const char *pcFtRoot,
+                 size_t ulThreads)
+{
+    int iStatus;
+    Path_T oPPath = NULL;
+    Node_T oNFound = NULL_NODE;
+    Scan_T oSScan;
+    Subtree_T oTSubtree;
+    struct timespec sStart, sEnd;
+    size_t ulFiles, ulBytes;
+
+    assert(pcFsPath != NULL);
+    assert(pcFtRoot != NULL);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    /* a path already taken fails before the directory is read */
+    iStatus = FT_findNode(pcFtRoot, FALSE, &oNFound);
+    if (iStatus == SUCCESS)
+        return ALREADY_IN_TREE;
+    if (iStatus != NO_SUCH_PATH)
+        return iStatus;
+    iStatus = Path_new(pcFtRoot, &oPPath);
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    clock_gettime(CLOCK_MONOTONIC, &sStart);
+    iStatus = Scan_run(pcFsPath, ulThreads == 0 ? 1 : ulThreads,
+                       &oSScan);
+    if (iStatus != SUCCESS)
+    {
+        Path_free(oPPath);
+        return iStatus;
+    }
+
+    oTSubtree = malloc(sizeof(struct subtree));
+    if (oTSubtree == NULL)
+        iStatus = MEMORY_ERROR;
+    else
+        iStatus = FT_buildScanned(oSScan, Path_getComponent(oPPath,
+                                  Path_getDepth(oPPath) - 1),
+                                  &oTSubtree->oNRoot);
+    Path_free(oPPath);
+    Scan_getTotals(oSScan, &ulFiles, &ulBytes);
+    Scan_free(oSScan);
+    if (iStatus != SUCCESS)
+    {
+        free(oTSubtree);
+        return iStatus;
+    }
+
+    /* only a successful attach consumes the subtree */
+    iStatus = FT_attach(pcFtRoot, oTSubtree);
+    if (iStatus != SUCCESS)
+    {
+        FT_freeSubtree(oTSubtree);
+        return iStatus;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &sEnd);
+    ulImportedFiles = ulFiles;
+    ulImportedBytes = ulBytes;
+    dImportSeconds = (double)(sEnd.tv_sec - sStart.tv_sec) +
+                     (double)(sEnd.tv_nsec - sStart.tv_nsec) / 1e9;
+    return SUCCESS;
+}
+
+int FT_importStats(size_t *pulFiles, size_t *pulBytes,
+                   double *pdFilesPerSec, double *pdBytesPerSec)
+{
+    assert(pulFiles != NULL);
+    assert(pulBytes != NULL);
+    assert(pdFilesPerSec != NULL);
+    assert(pdBytesPerSec != NULL);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+    *pulFiles = ulImportedFiles;
+    *pulBytes = ulImportedBytes;
+    *pdFilesPerSec = 0;
+    *pdBytesPerSec = 0;
+    if (dImportSeconds > 0)
+    {
+        *pdFilesPerSec = (double)ulImportedFiles / dImportSeconds;
+        *pdBytesPerSec = (double)ulImportedBytes / dImportSeconds;
+    }
+    return SUCCESS;
+}
+
+int FT_setExport(size_t ulQueueDepth, boolean bRing)
+{
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+    ulExportDepth = ulQueueDepth == 0 ? 1 : ulQueueDepth;
+    bExportRing = bRing;
+    return SUCCESS;
+}
+
+/*
+  Queues to oEExport the files under directory oNDir, whose path
+  relative to oEExport's directory is pcPath, and makes the
+  directories, each before what is under it, adding the number of
+  files and their bytes to *pulFiles and *pulBytes. Returns SUCCESS,
+  or the status of whichever failed first.
+*/
+static int FT_exportSubtree(Export_T oEExport, Node_T oNDir,
+                            const char *pcPath, size_t *pulFiles,
+                            size_t *pulBytes)
+{
+    size_t c;
+    int iStatus = SUCCESS;
+
+    for (c = 0; iStatus == SUCCESS && c < Node_getNumChildren(oNDir); c++)
+    {
+        Node_T oNChild = NULL_NODE;
+        char *pcChild;
+
+        (void)Node_getChild(oNDir, c, &oNChild);
+        pcChild = FT_childPath(pcPath, Node_getName(oNChild));
+        if (pcChild == NULL)
+            return MEMORY_ERROR;
+        if (Node_isDirectory(oNChild))
+        {
+            iStatus = Export_makeDir(oEExport, pcChild);
+            if (iStatus == SUCCESS)
+                iStatus = FT_exportSubtree(oEExport, oNChild, pcChild,
+                                           pulFiles, pulBytes);
+        }
+        else
+        {
+            /* the bytes stay in memory until the export is finished,
+               as the caller holds them */
+            void *pvContents;
+            size_t ulLength = Node_getSizeContents(oNChild);
+
+            /* a file borrowing no contents is written empty */
+            iStatus = Node_fetchContents(oNChild, &pvContents);
+            if (pvContents == NULL)
+                ulLength = 0;
+            if (iStatus == SUCCESS)
+                iStatus = Export_addFile(oEExport, pcChild, pvContents,
+                                         ulLength);
+            (*pulFiles)++;
+            *pulBytes += ulLength;
+        }
+        free(pcChild);
+    }
+    return iStatus;
+}
+
+/*
+  Queues to oEExport, as FT_exportSubtree does, what is under
+  directory ulDir of the frozen FT's image, whose path relative to
+  oEExport's directory is pcPath. The contents are read in place, as
+  the image outlives the export.
+*/
+static int FT_exportFrozen(Export_T oEExport, size_t ulDir,
+                           const char *pcPath, size_t *pulFiles,
+                           size_t *pulBytes)
+{
+    size_t ulFirst, ulNumFiles, ulNumDirs, ulNode;
+    int iStatus = SUCCESS;
+
+    assert(oIFrozen != NULL);
+
+    Image_getChildren(oIFrozen, ulDir, &ulFirst, &ulNumFiles, &ulNumDirs);
+    for (ulNode = ulFirst; iStatus == SUCCESS &&
+         ulNode < ulFirst + ulNumFiles + ulNumDirs; ulNode++)
+    {
+        char *pcChild = FT_childPath(pcPath,
+                                     Image_getName(oIFrozen, ulNode));
+        if (pcChild == NULL)
+            return MEMORY_ERROR;
+        if (Image_isDirectory(oIFrozen, ulNode))
+        {
+            iStatus = Export_makeDir(oEExport, pcChild);
+            if (iStatus == SUCCESS)
+                iStatus = FT_exportFrozen(oEExport, ulNode, pcChild,
+                                          pulFiles, pulBytes);
+        }
+        else
+        {
+            void *pvContents = Image_getContents(oIFrozen, ulNode);
+            size_t ulLength = Image_getSizeContents(oIFrozen, ulNode);
+
+            if (pvContents == NULL)
+                ulLength = 0;
+            iStatus = Export_addFile(oEExport, pcChild, pvContents,
+                                     ulLength);
+            (*pulFiles)++;
+            *pulBytes += ulLength;
+        }
+        free(pcChild);
+    }
+    return iStatus;
+}
+
+int FT_exportDir(const char *pcFtPath, const char *pcFsPath)
+{
+    int iStatus, iFinished;
+    Node_T oNDir = NULL_NODE;
+    size_t ulDir = 0;
+    Export_T oEExport;
+    struct timespec sStart, sEnd;
+    size_t ulFiles = 0, ulBytes = 0;
+    boolean bRing;
+
+    assert(pcFtPath != NULL);
+    assert(pcFsPath != NULL);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+    if (oIFrozen != NULL)
+    {
+        iStatus = FT_findFrozen(pcFtPath, &ulDir);
+        if (iStatus != SUCCESS)
+            return iStatus;
+        if (Image_isDirectory(oIFrozen, ulDir) == FALSE)
+            return NOT_A_DIRECTORY;
+    }
+    else
+    {
+        iStatus = FT_findNode(pcFtPath, FALSE, &oNDir);
+        if (iStatus != SUCCESS)
+            return iStatus;
+        if (Node_isDirectory(oNDir) == FALSE)
+            return NOT_A_DIRECTORY;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &sStart);
+    if (mkdir(pcFsPath, 0755) != 0)
+        return IO_ERROR;
+    iStatus = Export_new(pcFsPath, ulExportDepth, bExportRing, &oEExport);
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    /* the files' bytes are written after they are asked for, so the
+       unpacked and paged in ones must all stay in memory until then */
+    Content_holdBytes(TRUE);
+    if (oIFrozen != NULL)
+        iStatus = FT_exportFrozen(oEExport, ulDir, ".", &ulFiles,
+                                  &ulBytes);
+    else
+        iStatus = FT_exportSubtree(oEExport, oNDir, ".", &ulFiles,
+                                   &ulBytes);
+    bRing = Export_usesRing(oEExport);
+    iFinished = Export_finish(oEExport);
+    Content_holdBytes(FALSE);
+    if (iStatus == SUCCESS)
+        iStatus = iFinished;
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    clock_gettime(CLOCK_MONOTONIC, &sEnd);
+    ulExportedFiles = ulFiles;
+    ulExportedBytes = ulBytes;
+    bExportedRing = bRing;
+    dExportSeconds = (double)(sEnd.tv_sec - sStart.tv_sec) +
+                     (double)(sEnd.tv_nsec - sStart.tv_nsec) / 1e9;
+    return SUCCESS;
+}
+
+int FT_exportStats(size_t *pulFiles, size_t *pulBytes,
+                   double *pdFilesPerSec, double *pdBytesPerSec,
+                   boolean *pbRing)
+{
+    assert(pulFiles != NULL);
+    assert(pulBytes != NULL);
+    assert(pdFilesPerSec != NULL);
+    assert(pdBytesPerSec != NULL);
+    assert(pbRing != NULL);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+    *pulFiles = ulExportedFiles;
+    *pulBytes = ulExportedBytes;
+    *pbRing = bExportedRing;
+    *pdFilesPerSec = 0;
+    *pdBytesPerSec = 0;
+    if (dExportSeconds > 0)
+    {
+        *pdFilesPerSec = (double)ulExportedFiles / dExportSeconds;
+        *pdBytesPerSec = (double)ulExportedBytes / dExportSeconds;
+    }
+    return SUCCESS;
+}
+
+int FT_usage(size_t *pulExclusive, size_t *pulShared)
+{
+    assert(pulExclusive != NULL);
+    assert(pulShared != NULL);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    if (oIFrozen != NULL)
+    {
+        *pulExclusive = Image_getSize(oIFrozen);
+        *pulShared = 0;
+        return SUCCESS;
+    }
+    return Node_getUsage(oNRoot, pulExclusive, pulShared);
+}
+
+
+
+int FT_setContentsMode(int iMode)
+{
+    assert(iMode == FT_CONTENTS_BORROWED ||
+           iMode == FT_CONTENTS_DEDUPLICATED ||
+           iMode == FT_CONTENTS_OWNED ||
+           iMode == FT_CONTENTS_MAPPED);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+    iContentsMode = iMode;
+    return SUCCESS;
+}
+
+
+
+int FT_setCompression(size_t ulColdAfter, size_t ulLargeFrom)
+{
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+    ulColdUpdates = ulColdAfter;
+    ulLargeLength = ulLargeFrom;
+    ulUpdates = 0;
+    return SUCCESS;
+}
+
+
+
+int FT_setSpill(const char *pcFile, size_t ulBudget, size_t ulMinLength)
+{
+    int iStatus;
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+    iStatus = Content_setSpill(pcFile, ulBudget);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    bSpilling = (boolean)(pcFile != NULL);
+    ulSpillFrom = ulMinLength;
+    return SUCCESS;
+}
+
+
+
+int FT_spillStats(size_t *pulResident, size_t *pulOnDisk,
+                  size_t *pulPageIns, size_t *pulPageOuts)
+{
+    assert(pulResident != NULL);
+    assert(pulOnDisk != NULL);
+    assert(pulPageIns != NULL);
+    assert(pulPageOuts != NULL);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+    Content_getSpillStats(pulResident, pulOnDisk, pulPageIns,
+                          pulPageOuts);
+    return SUCCESS;
+}
+
+
+
+int FT_compressionStats(size_t *pulOriginal, size_t *pulCompressed,
+                        size_t *pulHits, size_t *pulMisses,
+                        double *pdCompressMs, double *pdDecompressMs)
+{
+    assert(pulOriginal != NULL);
+    assert(pulCompressed != NULL);
+    assert(pulHits != NULL);
+    assert(pulMisses != NULL);
+    assert(pdCompressMs != NULL);
+    assert(pdDecompressMs != NULL);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+    Content_getPackStats(pulOriginal, pulCompressed, pulHits, pulMisses,
+                         pdCompressMs, pdDecompressMs);
+    return SUCCESS;
+}
+
+
+
+int FT_contentsStats(size_t *pulInterned, size_t *pulHits,
+                     size_t *pulStored, size_t *pulSaved)
+{
+    assert(pulInterned != NULL);
+    assert(pulHits != NULL);
+    assert(pulStored != NULL);
+    assert(pulSaved != NULL);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+    Content_getStats(pulInterned, pulHits, pulStored, pulSaved);
+    return SUCCESS;
+}
+
+
+
+void *FT_getFileContents(const char *pcPath)
+{
+    Node_T oNFile = NULL_NODE;
+    int iStatus;
+
+    assert(pcPath != NULL);
+
+    if (oIFrozen != NULL)
+    {
+        size_t ulFile;
+        if (FT_findFrozen(pcPath, &ulFile) != SUCCESS)
+            return NULL;
+        return Image_getContents(oIFrozen, ulFile);
+    }
+
+    iStatus = FT_findNode(pcPath, FALSE, &oNFile);
+    if (iStatus != SUCCESS)
+    {
+        return NULL;
+    }
+
+    return Node_getContents(oNFile);
+}
+
+
+/*
+  Replaces the contents of the file pcPath with the ulNewLength bytes
+  at pvNewContents, as FT_replaceFileContents does, and sets
+  *ppvOldContents to the old contents. Returns SUCCESS, or
+  NOT_A_FILE if pcPath is a directory, or the status of whichever step
+  failed, leaving the FT and *ppvOldContents unchanged.
+*/
+static int FT_replaceContents(const char *pcPath, void *pvNewContents,
+                              size_t ulNewLength, void **ppvOldContents)
+{
+    Node_T oNNode = NULL_NODE;
+    void *pvOldContents;
+    size_t ulOldLength;
+    boolean bStore;
+    int iStatus;
+
+    assert(pcPath != NULL);
+    assert(ppvOldContents != NULL);
+
+    iStatus = FT_beginUpdate();
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+    iStatus = FT_findNode(pcPath, TRUE, &oNNode);
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+    if (Node_isDirectory(oNNode) == TRUE)
+    {
+        return NOT_A_FILE;
+    }
+    iStatus = Node_fetchContents(oNNode, &pvOldContents);
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+    ulOldLength = Node_getSizeContents(oNNode);
+
+    /* journaled first, with room kept, if storing a copy can fail, for
+       putting the old contents back in the journal */
+    bStore = (boolean)(iContentsMode != FT_CONTENTS_BORROWED &&
+                       pvNewContents != NULL);
+    iStatus = SUCCESS;
+    if (bStore)
+        iStatus = FT_reserve(2, 2 * strlen(pcPath) + 2 + ulNewLength +
+                             ulOldLength);
+    if (iStatus == SUCCESS)
+        iStatus = FT_log(JOURNAL_REPLACE_CONTENTS, pcPath, pvNewContents,
+                         ulNewLength);
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+
+    /* owned contents stay valid for the caller until the next
+       mutation, even if no other file holds them */
+    pvRetired = Node_retainContents(oNNode);
+    if (bStore)
+    {
+        iStatus = Node_storeContents(oNNode, pvNewContents, ulNewLength,
+                                     FT_storageKind(ulNewLength, FALSE));
+        if (iStatus != SUCCESS)
+        {
+            FT_releaseRetired();
+            FT_logUndo(JOURNAL_REPLACE_CONTENTS, pcPath, pvOldContents,
+                       ulOldLength);
+            return iStatus;
+        }
+        if (ulLargeLength != 0)
+            Node_pack(oNNode, ulLargeLength, FALSE);
+    }
+    else
+        Node_setContents(oNNode, pvNewContents, ulNewLength);
+    *ppvOldContents = pvOldContents;
+    return SUCCESS;
+}
+
+void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
+                             size_t ulNewLength)
+{
+    void *pvOldContents;
+
+    assert(pcPath != NULL);
+
+    if (FT_replaceContents(pcPath, pvNewContents, ulNewLength,
+                           &pvOldContents) != SUCCESS)
+    {
+        return NULL;
+    }
+    return pvOldContents;
+}
+
+
+
+/*
+  Journals the write of the ulLength bytes at pvBytes at offset
+  ulOffset of the file pcPath, as a record whose contents are the
+  offset, as 8 bytes, least significant first, then the bytes.
+  Returns SUCCESS, or the status FT_log does, or MEMORY_ERROR if the
+  record could not be allocated.
+*/
+static int FT_logWrite(const char *pcPath, size_t ulOffset,
+                       const void *pvBytes, size_t ulLength)
+{
+    unsigned char *pucRecord;
+    uint64_t ulAt = ulOffset;
+    int iStatus;
+    int i;
+
+    if (oJJournal == NULL)
+        return SUCCESS;
+    pucRecord = malloc(8 + ulLength);
+    if (pucRecord == NULL)
+        return MEMORY_ERROR;
+    for (i = 0; i < 8; i++)
+        pucRecord[i] = (unsigned char)(ulAt >> (8 * i));
+    if (ulLength != 0)
+        memcpy(pucRecord + 8, pvBytes, ulLength);
+    iStatus = FT_log(JOURNAL_WRITE_AT, pcPath, pucRecord, 8 + ulLength);
+    free(pucRecord);
+    return iStatus;
+}
+
+/*
+  Writes the ulLength bytes at pvBytes at offset ulOffset of the file
+  oNFile, with absolute path pcPath, once the write is journaled. If
+  the write then fails, journals the contents oNFile still holds in
+  its place, as FT_logUndo does. Returns the status of the first
+  failure, if any, and SUCCESS otherwise.
+*/
+static int FT_writeLogged(Node_T oNFile, const char *pcPath,
+                          size_t ulOffset, const void *pvBytes,
+                          size_t ulLength)
+{
+    void *pvContents;
+    int iStatus;
+
+    if (Node_isDirectory(oNFile) == TRUE)
+        return NOT_A_FILE;
+    iStatus = FT_logWrite(pcPath, ulOffset, pvBytes, ulLength);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    iStatus = Node_writeContents(oNFile, ulOffset, pvBytes, ulLength);
+    if (iStatus != SUCCESS)
+    {
+        if (Node_fetchContents(oNFile, &pvContents) != SUCCESS)
+            bJournalFailed = TRUE;
+        else
+            FT_logUndo(JOURNAL_REPLACE_CONTENTS, pcPath, pvContents,
+                       Node_getSizeContents(oNFile));
+    }
+    return iStatus;
+}
+
+int FT_readAt(const char *pcPath, size_t ulOffset, void *pvBuf,
+              size_t ulLength, size_t *pulRead)
+{
+    Node_T oNFile = NULL_NODE;
+    int iStatus;
+
+    assert(pcPath != NULL);
+    assert(pvBuf != NULL || ulLength == 0);
+    assert(pulRead != NULL);
+
+    *pulRead = 0;
+    if (oIFrozen != NULL)
+    {
+        size_t ulFile, ulSize;
+        iStatus = FT_findFrozen(pcPath, &ulFile);
+        if (iStatus != SUCCESS)
+            return iStatus;
+        if (Image_isDirectory(oIFrozen, ulFile))
+            return NOT_A_FILE;
+        ulSize = Image_getSizeContents(oIFrozen, ulFile);
+        if (ulOffset < ulSize)
+        {
+            *pulRead = ulSize - ulOffset < ulLength ? ulSize - ulOffset
+                                                    : ulLength;
+            memcpy(pvBuf, (char *)Image_getContents(oIFrozen, ulFile) +
+                   ulOffset, *pulRead);
+        }
+        return SUCCESS;
+    }
+
+    iStatus = FT_findNode(pcPath, FALSE, &oNFile);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    if (Node_isDirectory(oNFile) == TRUE)
+        return NOT_A_FILE;
+    return Node_readContents(oNFile, ulOffset, pvBuf, ulLength, pulRead);
+}
+
+
+
+int FT_writeAt(const char *pcPath, size_t ulOffset, const void *pvBytes,
+               size_t ulLength)
+{
+    Node_T oNFile = NULL_NODE;
+    int iStatus;
+
+    assert(pcPath != NULL);
+    assert(pvBytes != NULL || ulLength == 0);
+
+    iStatus = FT_beginUpdate();
+    if (iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_findNode(pcPath, TRUE, &oNFile);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    return FT_writeLogged(oNFile, pcPath, ulOffset, pvBytes, ulLength);
+}
+
+
+
+int FT_append(const char *pcPath, const void *pvBytes, size_t ulLength)
+{
+    Node_T oNFile = NULL_NODE;
+    size_t ulOffset;
+    int iStatus;
+
+    assert(pcPath != NULL);
+    assert(pvBytes != NULL || ulLength == 0);
+
+    iStatus = FT_beginUpdate();
+    if (iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_findNode(pcPath, TRUE, &oNFile);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    ulOffset = Node_getSizeContents(oNFile);
+    /* replayed as a write at the same offset */
+    return FT_writeLogged(oNFile, pcPath, ulOffset, pvBytes, ulLength);
+}
+
+
+
+int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize)
+{
+    Node_T oNNode = NULL_NODE;
+    int iStatus;
+
+    assert(pcPath != NULL);
     assert(pbIsFile != NULL);
     assert(pulSize != NULL);
 
-    iStatus = FT_findNode(pcPath, &oNNode);
+    if (oIFrozen != NULL)
+    {
+        size_t ulNode;
+        iStatus = FT_findFrozen(pcPath, &ulNode);
+        if (iStatus != SUCCESS)
+        {
+            return iStatus;
+        }
+        *pbIsFile = (boolean)(Image_isDirectory(oIFrozen, ulNode) == FALSE);
+        if (*pbIsFile)
+            *pulSize = Image_getSizeContents(oIFrozen, ulNode);
+        return SUCCESS;
+    }
+
+    iStatus = FT_findNode(pcPath, FALSE, &oNNode);
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+
+    if (Node_isDirectory(oNNode) == TRUE)
+    {
+        *pbIsFile = FALSE;
+    }
+    else
+    {
+        *pbIsFile = TRUE;
+        *pulSize = Node_getSizeContents(oNNode);
+    }
+    return SUCCESS;
+}
+
+
+
+int FT_du(const char *pcPath, size_t *pulDirs, size_t *pulFiles,
+          size_t *pulBytes)
+{
+    Node_T oNNode = NULL_NODE;
+    int iStatus;
+
+    assert(pcPath != NULL);
+    assert(pulDirs != NULL);
+    assert(pulFiles != NULL);
+    assert(pulBytes != NULL);
+
+    if (oIFrozen != NULL)
+    {
+        size_t ulNode;
+        iStatus = FT_findFrozen(pcPath, &ulNode);
+        if (iStatus != SUCCESS)
+        {
+            return iStatus;
+        }
+        Image_getTotals(oIFrozen, ulNode, pulDirs, pulFiles, pulBytes);
+        return SUCCESS;
+    }
+
+    iStatus = FT_findNode(pcPath, FALSE, &oNNode);
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+
+    Node_getTotals(oNNode, pulDirs, pulFiles, pulBytes);
+    return SUCCESS;
+}
+
+
+
+/* How the children that can match a component of an FT_glob pattern
+   are found: by binary search for one without wildcards, by a range
+   scan for one starting with other characters, by **'s own rule, and
+   by looking at all of them for the rest */
+enum {GLOB_LITERAL, GLOB_PREFIX, GLOB_DEEP, GLOB_ANY};
+
+/* A component of an FT_glob pattern */
+struct globPart
+{
+    /* its text, its kind, and the number of characters before its
+       first wildcard */
+    const char *pcText;
+    int iKind;
+    size_t ulPrefix;
+};
+
+/* An FT_glob pattern, and what to call with its matches */
+struct glob
+{
+    struct globPart *psParts;
+    size_t ulDepth;
+    void (*pfVisit)(const char *pcPath, boolean bIsFile, void *pvExtra);
+    void *pvExtra;
+};
+
+/* Returns TRUE if the name pcName matches the pattern component
+   pcPattern, with its wildcards, and FALSE if not. */
+static boolean FT_globMatch(const char *pcPattern, const char *pcName)
+{
+    const char *pcStar = NULL;
+    const char *pcResume = NULL;
+
+    /* a mismatch after a '*' lets it take one more character */
+    while (*pcName != '\0')
+    {
+        if (*pcPattern == '*')
+        {
+            pcStar = pcPattern++;
+            pcResume = pcName;
+        }
+        else if (*pcPattern == '?' || *pcPattern == *pcName)
+        {
+            pcPattern++;
+            pcName++;
+        }
+        else if (pcStar != NULL)
+        {
+            pcPattern = pcStar + 1;
+            pcName = ++pcResume;
+        }
+        else
+            return FALSE;
+    }
+    while (*pcPattern == '*')
+        pcPattern++;
+    return (boolean)(*pcPattern == '\0');
+}
+
+/*
+  Sets abTo to the states of psGlob's pattern a node named pcName is
+  in, as the child of a node in the states abFrom: state i means that
+  the components before component i matched the path so far, and
+  state ulDepth that the whole pattern did. A "**" stays in its state
+  whatever the name, and is passed over as matching nothing.
+*/
+static void FT_globStep(const struct glob *psGlob, const boolean *abFrom,
+                        const char *pcName, boolean *abTo)
+{
+    size_t i;
+
+    for (i = 0; i <= psGlob->ulDepth; i++)
+        abTo[i] = FALSE;
+    for (i = 0; i < psGlob->ulDepth; i++)
+    {
+        if (!abFrom[i])
+            continue;
+        if (psGlob->psParts[i].iKind == GLOB_DEEP)
+            abTo[i] = TRUE;
+        else if (FT_globMatch(psGlob->psParts[i].pcText, pcName))
+            abTo[i + 1] = TRUE;
+    }
+    for (i = 0; i < psGlob->ulDepth; i++)
+        if (abTo[i] && psGlob->psParts[i].iKind == GLOB_DEEP)
+            abTo[i + 1] = TRUE;
+}
+
+/*
+  FT_glob walks the nodes of the tree, or, while the FT is frozen,
+  those of its image without thawing it, each held in a size_t: a
+  Node_T, or an image node number. The children of a directory are
+  known by identifiers: their Node_getChild identifiers, or their
+  image node numbers. The functions below give what it needs of
+  either.
+*/
+
+/* Returns TRUE if node ulNode is a directory. */
+static boolean FT_globIsDir(size_t ulNode)
+{
+    if (oIFrozen != NULL)
+        return Image_isDirectory(oIFrozen, ulNode);
+    return Node_isDirectory((Node_T)ulNode);
+}
+
+/* Returns the name of node ulNode, valid until the next name read. */
+static const char *FT_globName(size_t ulNode)
+{
+    if (oIFrozen != NULL)
+        return Image_getName(oIFrozen, ulNode);
+    return Node_getName((Node_T)ulNode);
+}
+
+/* Stores the identifiers of directory ulDir's children: its files
+   are *pulBegin up to *pulDirs, and its directories from there up
+   to *pulEnd. */
+static void FT_globRange(size_t ulDir, size_t *pulBegin, size_t *pulDirs,
+                         size_t *pulEnd)
+{
+    size_t ulNumFiles, ulNumDirs;
+
+    if (oIFrozen != NULL)
+    {
+        Image_getChildren(oIFrozen, ulDir, pulBegin, &ulNumFiles,
+                          &ulNumDirs);
+        *pulDirs = *pulBegin + ulNumFiles;
+        *pulEnd = *pulDirs + ulNumDirs;
+        return;
+    }
+    *pulBegin = 0;
+    *pulDirs = Node_getNumFileChildren((Node_T)ulDir);
+    *pulEnd = Node_getNumChildren((Node_T)ulDir);
+}
+
+/* Returns the child of directory ulDir with identifier ulChild. */
+static size_t FT_globGetChild(size_t ulDir, size_t ulChild)
+{
+    Node_T oNChild = NULL_NODE;
+
+    if (oIFrozen != NULL)
+        return ulChild;
+    (void)Node_getChild((Node_T)ulDir, ulChild, &oNChild);
+    return (size_t)oNChild;
+}
+
+/* Returns TRUE and sets *pulChild to the identifier of directory
+   ulDir's child named pcName, if it has one, and FALSE if not. */
+static boolean FT_globHasChild(size_t ulDir, const char *pcName,
+                               size_t *pulChild)
+{
+    if (oIFrozen != NULL)
+        return Image_hasChild(oIFrozen, ulDir, pcName, pulChild);
+    return Node_hasChild((Node_T)ulDir, pcName, pulChild);
+}
+
+/* Returns the identifier of directory ulDir's first child as
+   Node_findPrefix finds it. */
+static size_t FT_globFindPrefix(size_t ulDir, boolean bDirs,
+                                const char *pcPrefix, size_t ulLength)
+{
+    if (oIFrozen != NULL)
+        return Image_findPrefix(oIFrozen, ulDir, bDirs, pcPrefix,
+                                ulLength);
+    return Node_findPrefix((Node_T)ulDir, bDirs, pcPrefix, ulLength);
+}
+
+static int FT_globIn(const struct glob *psGlob, size_t ulDir,
+                     const char *pcPath, const boolean *abStates);
+
+/*
+  Reports node ulNode, whose absolute path is pcPath and which is in
+  the states abStates, if it matches psGlob's pattern, and descends
+  into it if it is a directory that can hold a match. Returns SUCCESS,
+  or MEMORY_ERROR if memory could not be allocated.
+*/
+static int FT_globVisit(const struct glob *psGlob, size_t ulNode,
+                        const char *pcPath, const boolean *abStates)
+{
+    size_t i;
+
+    if (abStates[psGlob->ulDepth])
+        psGlob->pfVisit(pcPath, (boolean)!FT_globIsDir(ulNode),
+                        psGlob->pvExtra);
+    if (FT_globIsDir(ulNode))
+        for (i = 0; i < psGlob->ulDepth; i++)
+            if (abStates[i])
+                return FT_globIn(psGlob, ulNode, pcPath, abStates);
+    return SUCCESS;
+}
+
+/*
+  Visits the child of directory ulDir, whose absolute path is pcPath
+  and which is in the states abStates, with identifier ulChild, as
+  FT_globVisit does, with abChild as room for the child's states. Its
+  path is made only if it matches or can hold a match.
+*/
+static int FT_globChild(const struct glob *psGlob, size_t ulDir,
+                        const char *pcPath, const boolean *abStates,
+                        size_t ulChild, boolean *abChild)
+{
+    size_t ulNode = FT_globGetChild(ulDir, ulChild);
+    boolean bWanted;
+    char *pcChild;
+    size_t i;
+    int iStatus;
+
+    FT_globStep(psGlob, abStates, FT_globName(ulNode), abChild);
+    bWanted = abChild[psGlob->ulDepth];
+    for (i = 0; i < psGlob->ulDepth && FT_globIsDir(ulNode); i++)
+        bWanted = (boolean)(bWanted || abChild[i]);
+    if (!bWanted)
+        return SUCCESS;
+
+    pcChild = FT_childPath(pcPath, FT_globName(ulNode));
+    if (pcChild == NULL)
+        return MEMORY_ERROR;
+    iStatus = FT_globVisit(psGlob, ulNode, pcChild, abChild);
+    free(pcChild);
+    return iStatus;
+}
+
+/*
+  Visits the children of directory ulDir, whose absolute path is
+  pcPath and which is in the states abStates, that can match psGlob's
+  pattern, as FT_globVisit does. Returns SUCCESS, or MEMORY_ERROR if
+  memory could not be allocated.
+*/
+static int FT_globIn(const struct glob *psGlob, size_t ulDir,
+                     const char *pcPath, const boolean *abStates)
+{
+    const struct globPart *psOnly = NULL;
+    size_t ulLive = 0;
+    size_t ulBegin, ulDirs, ulEnd;
+    size_t ulChild, ulStop;
+    boolean *abChild;
+    int iStatus = SUCCESS;
+    size_t i;
+
+    for (i = 0; i < psGlob->ulDepth; i++)
+        if (abStates[i])
+        {
+            psOnly = &psGlob->psParts[i];
+            ulLive++;
+        }
+    abChild = malloc((psGlob->ulDepth + 1) * sizeof(boolean));
+    if (abChild == NULL)
+        return MEMORY_ERROR;
+    FT_globRange(ulDir, &ulBegin, &ulDirs, &ulEnd);
+
+    /* a lone component without a leading wildcard narrows the
+       children down by binary search, to one, or to a range of each
+       kind; otherwise each child's name is matched */
+    if (ulLive == 1 && psOnly->iKind == GLOB_LITERAL)
+    {
+        if (FT_globHasChild(ulDir, psOnly->pcText, &ulChild))
+            iStatus = FT_globChild(psGlob, ulDir, pcPath, abStates,
+                                   ulChild, abChild);
+    }
+    else if (ulLive == 1 && psOnly->iKind == GLOB_PREFIX)
+    {
+        for (i = 0; iStatus == SUCCESS && i < 2; i++)
+        {
+            ulStop = i == 0 ? ulDirs : ulEnd;
+            for (ulChild = FT_globFindPrefix(ulDir, (boolean)(i == 1),
+                                             psOnly->pcText,
+                                             psOnly->ulPrefix);
+                 iStatus == SUCCESS && ulChild < ulStop; ulChild++)
+            {
+                if (strncmp(FT_globName(FT_globGetChild(ulDir, ulChild)),
+                            psOnly->pcText, psOnly->ulPrefix) != 0)
+                    break;
+                iStatus = FT_globChild(psGlob, ulDir, pcPath, abStates,
+                                       ulChild, abChild);
+            }
+        }
+    }
+    else
+        for (ulChild = ulBegin; iStatus == SUCCESS && ulChild < ulEnd;
+             ulChild++)
+            iStatus = FT_globChild(psGlob, ulDir, pcPath, abStates,
+                                   ulChild, abChild);
+
+    free(abChild);
+    return iStatus;
+}
+
+int FT_glob(const char *pcPattern,
+            void (*pfVisit)(const char *pcPath, boolean bIsFile,
+                            void *pvExtra),
+            void *pvExtra)
+{
+    struct glob sGlob;
+    Path_T oPPattern = NULL;
+    boolean *abStart, *abRoot;
+    int iStatus;
+    size_t i;
+
+    assert(pcPattern != NULL);
+    assert(pfVisit != NULL);
+
+    if (!bIsInitialized)
+        return INITIALIZATION_ERROR;
+    iStatus = Path_new(pcPattern, &oPPattern);
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    sGlob.ulDepth = Path_getDepth(oPPattern);
+    sGlob.pfVisit = pfVisit;
+    sGlob.pvExtra = pvExtra;
+    sGlob.psParts = malloc(sGlob.ulDepth * sizeof(struct globPart));
+    abStart = calloc(sGlob.ulDepth + 1, sizeof(boolean));
+    abRoot = malloc((sGlob.ulDepth + 1) * sizeof(boolean));
+    if (sGlob.psParts == NULL || abStart == NULL || abRoot == NULL)
+    {
+        free(sGlob.psParts);
+        free(abStart);
+        free(abRoot);
+        Path_free(oPPattern);
+        return MEMORY_ERROR;
+    }
+    for (i = 0; i < sGlob.ulDepth; i++)
+    {
+        struct globPart *psPart = &sGlob.psParts[i];
+        psPart->pcText = Path_getComponent(oPPattern, i);
+        psPart->ulPrefix = strcspn(psPart->pcText, "*?");
+        if (psPart->pcText[psPart->ulPrefix] == '\0')
+            psPart->iKind = GLOB_LITERAL;
+        else if (strcmp(psPart->pcText, "**") == 0)
+            psPart->iKind = GLOB_DEEP;
+        else
+            psPart->iKind = psPart->ulPrefix > 0 ? GLOB_PREFIX : GLOB_ANY;
+    }
+
+    /* the root is the child of a node that matched nothing yet */
+    abStart[0] = TRUE;
+    for (i = 0; i < sGlob.ulDepth; i++)
+        if (abStart[i] && sGlob.psParts[i].iKind == GLOB_DEEP)
+            abStart[i + 1] = TRUE;
+    if (oIFrozen != NULL)
+    {
+        /* the image's root is node 0; its name is copied, as the
+           names read on the way down overwrite it */
+        const char *pcName = Image_getName(oIFrozen, 0);
+        char *pcRoot = malloc(strlen(pcName) + 1);
+        if (pcRoot == NULL)
+            iStatus = MEMORY_ERROR;
+        else
+        {
+            strcpy(pcRoot, pcName);
+            FT_globStep(&sGlob, abStart, pcRoot, abRoot);
+            iStatus = FT_globVisit(&sGlob, 0, pcRoot, abRoot);
+            free(pcRoot);
+        }
+    }
+    else if (oNRoot != NULL_NODE)
+    {
+        FT_globStep(&sGlob, abStart, Node_getName(oNRoot), abRoot);
+        iStatus = FT_globVisit(&sGlob, (size_t)oNRoot,
+                               Node_getName(oNRoot), abRoot);
+    }
+
+    free(sGlob.psParts);
+    free(abStart);
+    free(abRoot);
+    Path_free(oPPattern);
+    return iStatus;
+}
+
+int FT_compact(void)
+{
+    if (bIsInitialized == FALSE)
+    {
+        return INITIALIZATION_ERROR;
+    }
+
+    /* a frozen FT has no nodes to relocate, and nodes shared with
+       snapshots must stay where the snapshots refer to them (as must
+       nodes shared by copies, which Node_compact leaves alone) */
+    if (oIFrozen != NULL || ulSnapshots != 0)
+    {
+        return NOT_COMPACTED;
+    }
+
+    /* every node's handle changes, including the root's */
+    return Node_compact(oNRoot, &oNRoot);
+}
+
+
+
+int FT_freeze(void)
+{
+    int iStatus;
+
+    if (bIsInitialized == FALSE)
+    {
+        return INITIALIZATION_ERROR;
+    }
+    if (oIFrozen != NULL || oNRoot == NULL_NODE)
+    {
+        return SUCCESS;
+    }
+    /* an image refers to contents without holding them, so owned
+       contents could be freed from under it */
+    if (Content_getNumBlocks() != 0)
+    {
+        return OWNED_CONTENTS;
+    }
+
+    iStatus = Image_fromTree(oNRoot, &oIFrozen);
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+
+    /* the image now stands for the nodes; ulCount is unchanged */
+    (void)Node_free(oNRoot);
+    oNRoot = NULL_NODE;
+    return SUCCESS;
+}
+
+
+
+int FT_save(const char *pcFile)
+{
+    Image_T oIImage;
+    int iStatus;
+
+    assert(pcFile != NULL);
+
+    if (bIsInitialized == FALSE)
+    {
+        return INITIALIZATION_ERROR;
+    }
+    if (oIFrozen != NULL)
+    {
+        return Image_save(oIFrozen, pcFile, ulSequence);
+    }
+
+    /* the image refers to the unpacked bytes of packed contents, and
+       the paged in bytes of tiered ones, which must all stay in
+       memory until it is written */
+    Content_holdBytes(TRUE);
+    iStatus = Image_fromTree(oNRoot, &oIImage);
+    if (iStatus == SUCCESS)
+    {
+        iStatus = Image_save(oIImage, pcFile, ulSequence);
+        Image_free(oIImage);
+    }
+    Content_holdBytes(FALSE);
+    return iStatus;
+}
+
+
+
+/* The outcome of a background save, as the saving process reports it */
+struct saveOutcome
+{
+    /* the status FT_save returned */
+    int iStatus;
+
+    /* the size of the saved file, if saved */
+    size_t ulSize;
+};
+
+/*
+  Checks on the running background save, waiting for it to end if
+  bWait is TRUE. Returns FALSE if it is still running. Otherwise,
+  reaps it, closes its pipe, and returns TRUE with *piStatus and
+  *pulSize set as FT_pollSave sets them.
+*/
+static boolean FT_reapSave(boolean bWait, int *piStatus, size_t *pulSize)
+{
+    struct saveOutcome sOutcome;
+    pid_t iDone;
+    int iExit;
+
+    assert(iSaver != 0);
+
+    do
+        iDone = waitpid(iSaver, &iExit, bWait ? 0 : WNOHANG);
+    while (iDone < 0 && errno == EINTR);
+    if (iDone == 0)
+    {
+        return FALSE;
+    }
+
+    /* a saver that died before reporting has not saved */
+    if (iDone == iSaver &&
+        read(iSaverFd, &sOutcome, sizeof(sOutcome)) ==
+        (ssize_t)sizeof(sOutcome) && WIFEXITED(iExit) &&
+        WEXITSTATUS(iExit) == 0)
+    {
+        *piStatus = sOutcome.iStatus;
+        if (sOutcome.iStatus == SUCCESS)
+            *pulSize = sOutcome.ulSize;
+    }
+    else
+        *piStatus = IO_ERROR;
+    (void)close(iSaverFd);
+    iSaver = 0;
+    iSaverFd = -1;
+    return TRUE;
+}
+
+int FT_saveInBackground(const char *pcFile)
+{
+    struct saveOutcome sOutcome;
+    int aiPipe[2];
+    int iStatus;
+    size_t ulSize;
+    pid_t iChild;
+
+    assert(pcFile != NULL);
+
+    if (bIsInitialized == FALSE)
+    {
+        return INITIALIZATION_ERROR;
+    }
+    /* one background save at a time; the outcome of the one that
+       ran is held for FT_pollSave, the first failure being kept */
+    if (iSaver != 0)
+    {
+        ulSize = 0;
+        (void)FT_reapSave(TRUE, &iStatus, &ulSize);
+        if (!bSaveHeld || iHeldStatus == SUCCESS)
+        {
+            iHeldStatus = iStatus;
+            ulHeldSize = ulSize;
+        }
+        bSaveHeld = TRUE;
+    }
+
+    if (pipe(aiPipe) != 0)
+    {
+        return IO_ERROR;
+    }
+    iChild = fork();
+    if (iChild < 0)
+    {
+        (void)close(aiPipe[0]);
+        (void)close(aiPipe[1]);
+        return MEMORY_ERROR;
+    }
+
+    if (iChild == 0)
+    {
+        /* the child saves its copy-on-write view of the FT, reports
+           back, and leaves without running anything of the parent's */
+        struct stat sStat;
+        (void)close(aiPipe[0]);
+        /* only the parent appends to the spill file */
+        (void)Content_setSpill(NULL, 0);
+        sOutcome.iStatus = FT_save(pcFile);
+        sOutcome.ulSize = 0;
+        if (sOutcome.iStatus == SUCCESS && stat(pcFile, &sStat) == 0)
+            sOutcome.ulSize = (size_t)sStat.st_size;
+        if (write(aiPipe[1], &sOutcome, sizeof(sOutcome)) !=
+            (ssize_t)sizeof(sOutcome))
+            _exit(1);
+        _exit(0);
+    }
+
+    (void)close(aiPipe[1]);
+    iSaver = iChild;
+    iSaverFd = aiPipe[0];
+    return SUCCESS;
+}
+
+
+
+boolean FT_pollSave(boolean bWait, int *piStatus, size_t *pulSize)
+{
+    assert(piStatus != NULL);
+    assert(pulSize != NULL);
+
+    if (bSaveHeld)
+    {
+        *piStatus = iHeldStatus;
+        if (iHeldStatus == SUCCESS)
+            *pulSize = ulHeldSize;
+        bSaveHeld = FALSE;
+        return TRUE;
+    }
+    if (iSaver == 0)
+    {
+        *piStatus = INITIALIZATION_ERROR;
+        return TRUE;
+    }
+    return FT_reapSave(bWait, piStatus, pulSize);
+}
+
+
+
+/* Drops a hold on psHeld, freeing the image and the contents it
+   holds once no snapshot or FT holds them. */
+static void FT_releaseLoaded(struct loaded *psHeld)
+{
+    assert(psHeld != NULL);
+
+    if (--psHeld->ulRefs != 0)
+        return;
+    Image_free(psHeld->oIImage);
+    free(psHeld->pvReplayed);
+    free(psHeld);
+}
+
+/* Discards the image the FT was loaded from and the contents replayed
+   into it, if any, or the FT's hold on them, if snapshots hold them
+   too. */
+static void FT_dropLoaded(void)
+{
+    if (psLoaded != NULL)
+        FT_releaseLoaded(psLoaded);
+    else
+    {
+        Image_free(oILoaded);
+        free(pvReplayed);
+    }
+    psLoaded = NULL;
+    oILoaded = NULL;
+    pvReplayed = NULL;
+}
+
+/*
+  Discards the FT's current tree, the image it was loaded from and the
+  contents replayed into it if any, and makes oIImage, which holds its
+  files' contents, the FT's frozen tree.
+*/
+static void FT_replaceWithImage(Image_T oIImage)
+{
+    assert(oIImage != NULL);
+
+    if (oNRoot != NULL_NODE)
+        (void)Node_free(oNRoot);
+    if (oIFrozen != oILoaded)
+        Image_free(oIFrozen);
+    FT_dropLoaded();
+    oNRoot = NULL_NODE;
+    oIFrozen = NULL;
+
+    /* the new tree starts out frozen, unless it is empty */
+    ulSequence = Image_getSequence(oIImage);
+    ulCount = Image_getNumNodes(oIImage);
+    if (ulCount == 0)
+        Image_free(oIImage);
+    else
+        oIFrozen = oILoaded = oIImage;
+}
+
+int FT_load(const char *pcFile)
+{
+    Image_T oIImage;
+    int iStatus;
+
+    assert(pcFile != NULL);
+
+    if (bIsInitialized == FALSE)
+    {
+        return INITIALIZATION_ERROR;
+    }
+
+    iStatus = Image_load(pcFile, &oIImage);
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+    FT_replaceWithImage(oIImage);
+    return SUCCESS;
+}
+
+
+
+int FT_open(const char *pcFile)
+{
+    Image_T oIImage;
+    int iStatus;
+
+    assert(pcFile != NULL);
+
+    if (bIsInitialized == FALSE)
+    {
+        return INITIALIZATION_ERROR;
+    }
+
+    iStatus = Image_map(pcFile, &oIImage);
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+    FT_replaceWithImage(oIImage);
+    return SUCCESS;
+}
+
+
+
+int FT_openJournal(const char *pcFile, size_t ulBatch)
+{
+    int iStatus;
+
+    assert(pcFile != NULL);
+    assert(ulBatch >= 1);
+
+    if (bIsInitialized == FALSE)
+    {
+        return INITIALIZATION_ERROR;
+    }
+
+    iStatus = FT_closeJournal();
     if (iStatus != SUCCESS)
     {
         return iStatus;
     }
+    return Journal_open(pcFile, ulBatch, &oJJournal);
+}
 
-    if (Node_isDirectory(oNNode) == TRUE)
+
+
+int FT_syncJournal(void)
+{
+    if (bIsInitialized == FALSE)
     {
-        *pbIsFile = FALSE;
+        return INITIALIZATION_ERROR;
+    }
+    if (oJJournal == NULL)
+    {
+        return SUCCESS;
+    }
+    return Journal_sync(oJJournal);
+}
+
+
+
+int FT_closeJournal(void)
+{
+    int iStatus;
+
+    if (bIsInitialized == FALSE)
+    {
+        return INITIALIZATION_ERROR;
+    }
+    if (oJJournal == NULL)
+    {
+        return SUCCESS;
+    }
+
+    iStatus = Journal_close(oJJournal);
+    oJJournal = NULL;
+    bJournalFailed = FALSE;
+    return iStatus;
+}
+
+
+
+int FT_checkpoint(const char *pcFile)
+{
+    int iStatus;
+
+    assert(pcFile != NULL);
+
+    iStatus = FT_save(pcFile);
+    if (iStatus != SUCCESS || oJJournal == NULL)
+    {
+        return iStatus;
+    }
+
+    /* the snapshot now reflects every record in the journal */
+    iStatus = Journal_truncate(oJJournal);
+    if (iStatus != SUCCESS)
+    {
+        bJournalFailed = TRUE;
+    }
+    return iStatus;
+}
+
+
+
+/*
+  Applies the mutation iOp of pcPath replayed from a journal, with
+  contents pvContents of ulLength bytes, to the FT. pvExtra is unused.
+  Returns SUCCESS, or the status of the mutation.
+*/
+static int FT_applyRecord(int iOp, const char *pcPath, void *pvContents,
+                          size_t ulLength, void *pvExtra)
+{
+    void *pvOldContents;
+
+    assert(pvExtra == NULL);
+
+    switch (iOp)
+    {
+    case JOURNAL_INSERT_DIR:
+        return FT_insertDir(pcPath);
+    case JOURNAL_INSERT_FILE:
+        return FT_insertFile(pcPath, pvContents, ulLength);
+    case JOURNAL_RM_DIR:
+        return FT_rmDir(pcPath);
+    case JOURNAL_RM_FILE:
+        return FT_rmFile(pcPath);
+    case JOURNAL_MOVE:
+        return FT_move(pcPath, (const char *)pvContents);
+    case JOURNAL_COPY:
+        return FT_copy(pcPath, (const char *)pvContents);
+    case JOURNAL_WRITE_AT:
+    {
+        const unsigned char *pucAt = pvContents;
+        uint64_t ulAt = 0;
+        int i;
+
+        /* the journal checked there is an offset */
+        for (i = 7; i >= 0; i--)
+            ulAt = ulAt << 8 | pucAt[i];
+        return FT_writeAt(pcPath, (size_t)ulAt, pucAt + 8,
+                          ulLength - 8);
+    }
+    default:
+        return FT_replaceContents(pcPath, pvContents, ulLength,
+                                  &pvOldContents);
+    }
+}
+
+int FT_recover(const char *pcSnapshot, const char *pcJournal)
+{
+    void *pvBlock;
+    int iStatus;
+
+    assert(pcJournal != NULL);
+
+    if (bIsInitialized == FALSE)
+    {
+        return INITIALIZATION_ERROR;
+    }
+
+    /* replayed mutations are not journaled again */
+    iStatus = FT_closeJournal();
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+
+    if (pcSnapshot != NULL)
+    {
+        iStatus = FT_load(pcSnapshot);
+        if (iStatus != SUCCESS)
+        {
+            return iStatus;
+        }
     }
     else
     {
-        *pbIsFile = TRUE;
-        *pulSize = Node_getSizeContents(oNNode);
+        (void)FT_destroy();
+        (void)FT_init();
     }
-    return SUCCESS;
+
+    /* the snapshot's sequence number tells where the tail starts; no
+       snapshot holds what the FT just loaded yet */
+    assert(psLoaded == NULL);
+    iStatus = Journal_replay(pcJournal, ulSequence, FT_applyRecord, NULL,
+                             &pvBlock, &ulSequence);
+    pvReplayed = pvBlock;
+    return iStatus;
 }
 
 
@@ -575,8 +2952,41 @@ int FT_destroy(void)
         return INITIALIZATION_ERROR;
     }
 
-    ulCount -= Node_free(oNDestroy);
-    oNRoot = NULL;
+    if (oNDestroy != NULL_NODE)
+        ulCount -= Node_free(oNDestroy);
+    if (oIFrozen != NULL)
+        ulCount -= Image_getNumNodes(oIFrozen);
+    if (oIFrozen != oILoaded)
+        Image_free(oIFrozen);
+    FT_dropLoaded();
+    oIFrozen = NULL;
+    oNRoot = NULL_NODE;
+    (void)FT_closeJournal();
+    if (iSaver != 0)
+    {
+        int iStatus;
+        size_t ulSize;
+        (void)FT_reapSave(TRUE, &iStatus, &ulSize);
+    }
+    bSaveHeld = FALSE;
+    ulSequence = 0;
+    FT_releaseRetired();
+    iContentsMode = FT_CONTENTS_BORROWED;
+    ulColdUpdates = 0;
+    ulLargeLength = 0;
+    ulUpdates = 0;
+    (void)Content_setSpill(NULL, 0);
+    bSpilling = FALSE;
+    ulSpillFrom = 0;
+    ulImportedFiles = 0;
+    ulImportedBytes = 0;
+    dImportSeconds = 0;
+    ulExportDepth = EXPORT_DEPTH;
+    bExportRing = TRUE;
+    ulExportedFiles = 0;
+    ulExportedBytes = 0;
+    dExportSeconds = 0;
+    bExportedRing = FALSE;
     bIsInitialized = FALSE;
 
     return SUCCESS;
@@ -589,105 +2999,426 @@ int FT_destroy(void)
 */
 
 /*
-  Performs a pre-order traversal of the tree rooted at n,
-  inserting each payload to DynArray_T d beginning at index i.
-  Returns the next unused index in d after the insertion(s).
+  Performs a pre-order traversal of the tree rooted at n, whose
+  absolute path is ulPathLen characters long, summing the length of
+  each node's path plus one (for its newline). Returns the sum.
 */
-static size_t FT_preOrderTraversal(Node_T n, DynArray_T d, size_t i)
+static size_t FT_strlenSubtree(Node_T n, size_t ulPathLen)
 {
     size_t c;
+    size_t ulAcc = ulPathLen + 1;
 
-    assert(d != NULL);
-
-    if (n != NULL)
+    for (c = 0; c < Node_getNumChildren(n); c++)
     {
-        (void)DynArray_set(d, i, n);
-        i++;
-
-        for (c = 0; c < Node_getNumChildren(n); c++)
-        {
-            int iStatus;
-            Node_T oNChild = NULL;
-            iStatus = Node_getChild(n, c, &oNChild);
-            assert(iStatus == SUCCESS);
-            if (Node_isDirectory(oNChild) == FALSE)
-            {
-                (void)DynArray_set(d, i, oNChild);
-                i++;
-            }
-        }
-        for (c = 0; c < Node_getNumChildren(n); c++)
-        {
-            int iStatus;
-            Node_T oNChild = NULL;
-            iStatus = Node_getChild(n, c, &oNChild);
-            assert(iStatus == SUCCESS);
-            if (Node_isDirectory(oNChild) == TRUE)
-            {
-                i = FT_preOrderTraversal(oNChild, d, i);
-            }
-        }
+        int iStatus;
+        Node_T oNChild = NULL_NODE;
+        iStatus = Node_getChild(n, c, &oNChild);
+        assert(iStatus == SUCCESS);
+        ulAcc += FT_strlenSubtree(oNChild, ulPathLen + 1 +
+                                  strlen(Node_getName(oNChild)));
     }
-    return i;
+    return ulAcc;
 }
 
 /*
-  Alternate version of strlen that uses pulAcc as an in-out parameter
-  to accumulate a string length, rather than returning the length of
-  oNNode's path, and also always adds one addition byte to the sum.
+  Performs a pre-order traversal of the tree rooted at n, writing each
+  node's path followed by a newline into pcAcc. n's path is written as
+  the ulParentLen characters at pcParent (its parent's path, if n is
+  not the root), a '/', and n's name. Returns the position in pcAcc
+  just past what was written.
 */
-static void FT_strlenAccumulate(Node_T oNNode, size_t *pulAcc)
+static char *FT_strcatSubtree(Node_T n, const char *pcParent,
+                              size_t ulParentLen, char *pcAcc)
 {
-    assert(pulAcc != NULL);
-
-    if (oNNode != NULL)
-        *pulAcc += (Path_getStrLength(Node_getPath(oNNode)) + 1);
-}
+    const char *pcPath = pcAcc;
+    size_t ulPathLen;
+    size_t c;
 
-/*
-  Alternate version of strcat that inverts the typical argument
-  order, appending oNNode's path onto pcAcc, and also always adds one
-  newline at the end of the concatenated string.
-*/
-static void FT_strcatAccumulate(Node_T oNNode, char *pcAcc)
-{
     assert(pcAcc != NULL);
 
-    if (oNNode != NULL)
+    /* the line just written is the path to pass down to children */
+    if (pcParent != NULL)
     {
-        strcat(pcAcc, Path_getPathname(Node_getPath(oNNode)));
-        strcat(pcAcc, "\n");
+        memcpy(pcAcc, pcParent, ulParentLen);
+        pcAcc += ulParentLen;
+        *pcAcc++ = '/';
     }
+    ulPathLen = strlen(Node_getName(n));
+    memcpy(pcAcc, Node_getName(n), ulPathLen);
+    pcAcc += ulPathLen;
+    ulPathLen = (size_t)(pcAcc - pcPath);
+    *pcAcc++ = '\n';
+
+    /* children are ordered files first, then directories, so one
+       pass emits the files and then recurses into the directories */
+    for (c = 0; c < Node_getNumChildren(n); c++)
+    {
+        int iStatus;
+        Node_T oNChild = NULL_NODE;
+        iStatus = Node_getChild(n, c, &oNChild);
+        assert(iStatus == SUCCESS);
+        pcAcc = FT_strcatSubtree(oNChild, pcPath, ulPathLen, pcAcc);
+    }
+    return pcAcc;
 }
 /*--------------------------------------------------------------------*/
 
-char *FT_toString(void)
+/*
+  Returns the string representation of the tree rooted at oNTop (or of
+  an empty tree, if oNTop is NULL_NODE), as FT_toString describes it,
+  or NULL if there is an allocation error.
+*/
+static char *FT_toStringIn(Node_T oNTop)
 {
-    DynArray_T nodes;
     size_t totalStrlen = 1;
     char *result = NULL;
+    char *pcEnd;
+
+    if (oNTop != NULL_NODE)
+        totalStrlen += FT_strlenSubtree(oNTop,
+                                        strlen(Node_getName(oNTop)));
+
+    result = malloc(totalStrlen);
+    if (result == NULL)
+        return NULL;
+
+    pcEnd = result;
+    if (oNTop != NULL_NODE)
+        pcEnd = FT_strcatSubtree(oNTop, NULL, 0, result);
+    *pcEnd = '\0';
+
+    return result;
+}
 
+char *FT_toString(void)
+{
     if (!bIsInitialized)
         return NULL;
 
-    nodes = DynArray_new(ulCount);
-    (void)FT_preOrderTraversal(oNRoot, nodes, 0);
+    if (oIFrozen != NULL)
+        return Image_toString(oIFrozen);
 
-    DynArray_map(nodes, (void (*)(void *, void *))FT_strlenAccumulate,
-                 (void *)&totalStrlen);
+    return FT_toStringIn(oNRoot);
+}
 
-    result = malloc(totalStrlen);
-    if (result == NULL)
+/*--------------------------------------------------------------------*/
+/* Snapshots                                                          */
+/*--------------------------------------------------------------------*/
+
+/* A snapshot: the root of a tree that shares its nodes with the FT
+   until either is modified */
+struct snapshot
+{
+    /* the root, or NULL_NODE if the FT was empty */
+    Node_T oNRoot;
+
+    /* the image and replayed contents its files may refer to, or NULL
+       if the FT had none */
+    struct loaded *psLoaded;
+};
+
+int FT_snapshot(Snapshot_T *poSResult)
+{
+    int iStatus;
+
+    assert(poSResult != NULL);
+
+    *poSResult = NULL;
+    if (bIsInitialized == FALSE)
+    {
+        return INITIALIZATION_ERROR;
+    }
+
+    /* only nodes can be shared */
+    iStatus = FT_thaw();
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+
+    *poSResult = malloc(sizeof(struct snapshot));
+    if (*poSResult == NULL)
+    {
+        return MEMORY_ERROR;
+    }
+
+    /* contents loaded or replayed outlive the FT's hold on them for as
+       long as the snapshot's */
+    if (psLoaded == NULL && (oILoaded != NULL || pvReplayed != NULL))
+    {
+        psLoaded = malloc(sizeof(struct loaded));
+        if (psLoaded == NULL)
+        {
+            free(*poSResult);
+            *poSResult = NULL;
+            return MEMORY_ERROR;
+        }
+        psLoaded->oIImage = oILoaded;
+        psLoaded->pvReplayed = pvReplayed;
+        psLoaded->ulRefs = 1;
+    }
+    if (psLoaded != NULL)
+        psLoaded->ulRefs++;
+    (*poSResult)->psLoaded = psLoaded;
+    (*poSResult)->oNRoot = oNRoot;
+    if (oNRoot != NULL_NODE)
+        Node_share(oNRoot);
+    ulSnapshots++;
+    return SUCCESS;
+}
+
+void FT_freeSnapshot(Snapshot_T oSSnapshot)
+{
+    assert(oSSnapshot != NULL);
+
+    if (oSSnapshot->oNRoot != NULL_NODE)
+        (void)Node_free(oSSnapshot->oNRoot);
+    if (oSSnapshot->psLoaded != NULL)
+        FT_releaseLoaded(oSSnapshot->psLoaded);
+    free(oSSnapshot);
+    ulSnapshots--;
+}
+
+boolean FT_snapshotContainsDir(Snapshot_T oSSnapshot, const char *pcPath)
+{
+    Node_T oNFound = NULL_NODE;
+
+    assert(oSSnapshot != NULL);
+    assert(pcPath != NULL);
+
+    if (FT_findIn(&oSSnapshot->oNRoot, FALSE, pcPath, &oNFound) != SUCCESS)
+    {
+        return FALSE;
+    }
+    return Node_isDirectory(oNFound);
+}
+
+boolean FT_snapshotContainsFile(Snapshot_T oSSnapshot, const char *pcPath)
+{
+    Node_T oNFound = NULL_NODE;
+
+    assert(oSSnapshot != NULL);
+    assert(pcPath != NULL);
+
+    if (FT_findIn(&oSSnapshot->oNRoot, FALSE, pcPath, &oNFound) != SUCCESS)
+    {
+        return FALSE;
+    }
+    return (boolean)(Node_isDirectory(oNFound) == FALSE);
+}
+
+void *FT_snapshotGetFileContents(Snapshot_T oSSnapshot,
+                                 const char *pcPath)
+{
+    Node_T oNFile = NULL_NODE;
+
+    assert(oSSnapshot != NULL);
+    assert(pcPath != NULL);
+
+    if (FT_findIn(&oSSnapshot->oNRoot, FALSE, pcPath, &oNFile) != SUCCESS)
     {
-        DynArray_free(nodes);
         return NULL;
     }
-    *result = '\0';
+    return Node_getContents(oNFile);
+}
 
-    DynArray_map(nodes, (void (*)(void *, void *))FT_strcatAccumulate,
-                 (void *)result);
+int FT_snapshotStat(Snapshot_T oSSnapshot, const char *pcPath,
+                    boolean *pbIsFile, size_t *pulSize)
+{
+    Node_T oNNode = NULL_NODE;
+    int iStatus;
 
-    DynArray_free(nodes);
+    assert(oSSnapshot != NULL);
+    assert(pcPath != NULL);
+    assert(pbIsFile != NULL);
+    assert(pulSize != NULL);
 
-    return result;
+    iStatus = FT_findIn(&oSSnapshot->oNRoot, FALSE, pcPath, &oNNode);
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+    *pbIsFile = (boolean)(Node_isDirectory(oNNode) == FALSE);
+    if (*pbIsFile)
+        *pulSize = Node_getSizeContents(oNNode);
+    return SUCCESS;
+}
+
+int FT_snapshotDu(Snapshot_T oSSnapshot, const char *pcPath,
+                  size_t *pulDirs, size_t *pulFiles, size_t *pulBytes)
+{
+    Node_T oNNode = NULL_NODE;
+    int iStatus;
+
+    assert(oSSnapshot != NULL);
+    assert(pcPath != NULL);
+    assert(pulDirs != NULL);
+    assert(pulFiles != NULL);
+    assert(pulBytes != NULL);
+
+    iStatus = FT_findIn(&oSSnapshot->oNRoot, FALSE, pcPath, &oNNode);
+    if (iStatus != SUCCESS)
+    {
+        return iStatus;
+    }
+    Node_getTotals(oNNode, pulDirs, pulFiles, pulBytes);
+    return SUCCESS;
+}
+
+char *FT_snapshotToString(Snapshot_T oSSnapshot)
+{
+    assert(oSSnapshot != NULL);
+
+    return FT_toStringIn(oSSnapshot->oNRoot);
+}
+
+/*
+  Reports to (*pfVisit)(..., pvExtra) file oNOld, at absolute path
+  pcPath, changed into file oNNew, whose hash differs, unless their
+  bytes are the same: borrowed contents are hashed by their address,
+  so the same bytes borrowed from two places hash differently.
+  Returns SUCCESS, or MEMORY_ERROR.
+*/
+static int FT_diffFiles(Node_T oNOld, Node_T oNNew, const char *pcPath,
+                        void (*pfVisit)(const char *pcPath, int iChange,
+                                        void *pvExtra),
+                        void *pvExtra)
+{
+    void *pvOld, *pvNew;
+    size_t ulLength = Node_getSizeContents(oNOld);
+
+    if (ulLength == Node_getSizeContents(oNNew))
+    {
+        if (Node_fetchContents(oNOld, &pvOld) != SUCCESS ||
+            Node_fetchContents(oNNew, &pvNew) != SUCCESS)
+            return MEMORY_ERROR;
+        if (pvOld == pvNew || ulLength == 0)
+            return SUCCESS;
+        if (pvOld != NULL && pvNew != NULL &&
+            memcmp(pvOld, pvNew, ulLength) == 0)
+            return SUCCESS;
+    }
+    pfVisit(pcPath, FT_DIFF_CHANGED, pvExtra);
+    return SUCCESS;
+}
+
+/*
+  Reports to (*pfVisit)(..., pvExtra), as FT_diff does, the
+  differences between the nodes oNOld and oNNew, of the same name and
+  kind, at absolute path pcPath. Returns SUCCESS, or MEMORY_ERROR.
+*/
+static int FT_diffIn(Node_T oNOld, Node_T oNNew, const char *pcPath,
+                     void (*pfVisit)(const char *pcPath, int iChange,
+                                     void *pvExtra),
+                     void *pvExtra)
+{
+    size_t aulOld[2], aulNew[2];
+    size_t ulOld = 0, ulNew = 0;
+    int iKind;
+    int iStatus = SUCCESS;
+
+    /* shared, or equal to all intents */
+    if (oNOld == oNNew || Node_getHash(oNOld) == Node_getHash(oNNew))
+        return SUCCESS;
+    if (Node_isDirectory(oNOld) == FALSE)
+    {
+        return FT_diffFiles(oNOld, oNNew, pcPath, pfVisit, pvExtra);
+    }
+
+    /* walk both runs in lockstep, files then directories, each sorted
+       by name */
+    aulOld[0] = Node_getNumFileChildren(oNOld);
+    aulOld[1] = Node_getNumChildren(oNOld);
+    aulNew[0] = Node_getNumFileChildren(oNNew);
+    aulNew[1] = Node_getNumChildren(oNNew);
+    for (iKind = 0; iKind < 2; iKind++)
+    {
+        while (iStatus == SUCCESS &&
+               (ulOld < aulOld[iKind] || ulNew < aulNew[iKind]))
+        {
+            Node_T oNOldChild = NULL_NODE;
+            Node_T oNNewChild = NULL_NODE;
+            char *pcChild;
+            int iCmp;
+
+            if (ulOld < aulOld[iKind])
+                (void)Node_getChild(oNOld, ulOld, &oNOldChild);
+            if (ulNew < aulNew[iKind])
+                (void)Node_getChild(oNNew, ulNew, &oNNewChild);
+            if (oNOldChild == NULL_NODE)
+                iCmp = 1;
+            else if (oNNewChild == NULL_NODE)
+                iCmp = -1;
+            else
+                iCmp = strcmp(Node_getName(oNOldChild),
+                              Node_getName(oNNewChild));
+
+            /* most children of a changed directory are unchanged */
+            if (iCmp == 0 && (oNOldChild == oNNewChild ||
+                              Node_getHash(oNOldChild) ==
+                              Node_getHash(oNNewChild)))
+            {
+                ulOld++;
+                ulNew++;
+                continue;
+            }
+
+            pcChild = FT_childPath(pcPath, Node_getName(
+                                       iCmp > 0 ? oNNewChild : oNOldChild));
+            if (pcChild == NULL)
+                return MEMORY_ERROR;
+            if (iCmp < 0)
+            {
+                pfVisit(pcChild, FT_DIFF_REMOVED, pvExtra);
+                ulOld++;
+            }
+            else if (iCmp > 0)
+            {
+                pfVisit(pcChild, FT_DIFF_ADDED, pvExtra);
+                ulNew++;
+            }
+            else
+            {
+                iStatus = FT_diffIn(oNOldChild, oNNewChild, pcChild,
+                                    pfVisit, pvExtra);
+                ulOld++;
+                ulNew++;
+            }
+            free(pcChild);
+        }
+    }
+    return iStatus;
+}
+
+int FT_diff(Snapshot_T oSOld, Snapshot_T oSNew,
+            void (*pfVisit)(const char *pcPath, int iChange,
+                            void *pvExtra),
+            void *pvExtra)
+{
+    Node_T oNOld, oNNew;
+    int iStatus;
+
+    assert(pfVisit != NULL);
+
+    /* the FT itself can only be compared as nodes */
+    if (oSOld == NULL || oSNew == NULL)
+    {
+        if (bIsInitialized == FALSE)
+            return INITIALIZATION_ERROR;
+        iStatus = FT_thaw();
+        if (iStatus != SUCCESS)
+            return iStatus;
+    }
+    oNOld = oSOld == NULL ? oNRoot : oSOld->oNRoot;
+    oNNew = oSNew == NULL ? oNRoot : oSNew->oNRoot;
+
+    if (oNOld != NULL_NODE && oNNew != NULL_NODE &&
+        strcmp(Node_getName(oNOld), Node_getName(oNNew)) == 0)
+        return FT_diffIn(oNOld, oNNew, Node_getName(oNOld), pfVisit,
+                         pvExtra);
+    if (oNOld != NULL_NODE)
+        pfVisit(Node_getName(oNOld), FT_DIFF_REMOVED, pvExtra);
+    if (oNNew != NULL_NODE)
+        pfVisit(Node_getName(oNNew), FT_DIFF_ADDED, pvExtra);
+    return SUCCESS;
 }
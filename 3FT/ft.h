@@ -64,6 +64,39 @@ int FT_rmDir(const char *pcPath);
 int FT_insertFile(const char *pcPath, void *pvContents,
                   size_t ulLength);
 
+/*
+  Inserts a new file into the FT with absolute path pcPath, as
+  FT_insertFile does, with the ulLength bytes at offset ulOffset of
+  the file open as iFd as its contents, read straight into storage
+  the FT owns, without a buffer of the client's: into the content
+  store in FT_CONTENTS_DEDUPLICATED mode, and for the file alone in
+  the other modes (see FT_setContentsMode and FT_setSpill), except
+  that in FT_CONTENTS_MAPPED mode the FT maps the bytes of the file
+  into memory read-only and keeps them as the contents.
+  Returns the statuses FT_insertFile does, and also:
+  * IO_ERROR if the file ends before ulOffset + ulLength, or could
+             not be read or mapped
+*/
+int FT_insertFileFromFd(const char *pcPath, int iFd, size_t ulOffset,
+                        size_t ulLength);
+
+/*
+  Writes the contents of the file with absolute path pcPath to the
+  file open as iFd, at its offset, without copying them into one
+  block first where the FT stores them in pieces, and, for contents
+  spilled to disk (see FT_setSpill), copying them from the spill file
+  within the kernel with sendfile where it can copy to iFd.
+  Returns SUCCESS if written. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * NOT_A_FILE if pcPath is a directory
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  * IO_ERROR if the contents could not be read or written
+*/
+int FT_writeFileToFd(const char *pcPath, int iFd);
+
 /*
   Returns TRUE if the FT contains a file with absolute path
   pcPath and FALSE if not or if there is an error while checking.
@@ -83,6 +116,66 @@ boolean FT_containsFile(const char *pcPath);
 */
 int FT_rmFile(const char *pcPath);
 
+/*
+  Moves the file or directory with absolute path pcSrc, and everything
+  under it, to absolute path pcDst, whose parent directory must
+  already exist, as a rename would. Nodes do not store their absolute
+  paths, so this takes time proportional to the depths of the paths
+  and to the two parents' numbers of children, independent of the
+  size of the subtree moved.
+  Returns SUCCESS if moved. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcSrc or pcDst does not represent a well-formatted path
+  * CONFLICTING_PATH if the root is not a prefix of pcSrc or pcDst,
+                     pcSrc or pcDst is the root, or pcDst is under pcSrc
+  * NO_SUCH_PATH if pcSrc, or the parent of pcDst, is not in the FT
+  * NOT_A_DIRECTORY if a proper prefix of pcDst exists as a file
+  * ALREADY_IN_TREE if pcDst is already in the FT (as dir or file)
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_move(const char *pcSrc, const char *pcDst);
+
+/*
+  Copies the file or directory with absolute path pcSrc, and everything
+  under it, to absolute path pcDst, whose parent directory must
+  already exist. The copy shares its nodes, names, and file contents
+  with the original, so this takes time proportional to the depths of
+  the paths and to the numbers of children of pcSrc and of pcDst's
+  parent, independent of the size of the subtree copied: nodes are
+  copied lazily, on the first modification under either side, along
+  the path to what is modified. Contents borrowed, or held
+  deduplicated, chunked, packed, tiered, or mapped, are not copied:
+  the copy of a file refers to the same contents as the original
+  until either one's are replaced. Contents in FT_CONTENTS_OWNED
+  mode's heap, though, belong to one file each, so they are copied
+  when the file's node is: at once if pcSrc is such a file, and
+  otherwise when the file is first modified through either side (as
+  by FT_writeAt or FT_append). Each such copy takes as much memory
+  again as the original, and from then on FT_getFileContents returns
+  a different pointer for the side modified; a pointer it returned
+  earlier for that side still points to the other side's contents,
+  which stay valid and unchanged as long as that side keeps them.
+  Returns SUCCESS if copied. Otherwise, returns with the same statuses
+  as FT_move.
+*/
+int FT_copy(const char *pcSrc, const char *pcDst);
+
+/*
+  Reports the memory the FT takes up: its nodes, their names and
+  children arrays, and its files' contents. Stores in *pulShared the
+  bytes that the FT shares between copies made by FT_copy, or with
+  snapshots, each counted once, and in *pulExclusive the bytes only
+  one place in the FT uses. Contents the FT deduplicated (see
+  FT_setContentsMode) count once however many files hold them, as
+  shared if more than one does. A frozen FT reports the size of its
+  image as exclusive.
+  Returns SUCCESS if reported. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request,
+                 in which case *pulExclusive and *pulShared are 0
+*/
+int FT_usage(size_t *pulExclusive, size_t *pulShared);
+
 /*
   Returns the contents of the file with absolute path pcPath.
   Returns NULL if unable to complete the request for any reason.
@@ -96,11 +189,187 @@ void *FT_getFileContents(const char *pcPath);
   Replaces current contents of the file with absolute path pcPath with
   the parameter pvNewContents of size ulNewLength bytes.
   Returns the old contents if successful. (Note: contents may be NULL.)
-  Returns NULL if unable to complete the request for any reason.
+  Old contents the FT owned (see FT_setContentsMode) stay valid until
+  the next call that modifies the FT.
+  Returns NULL if unable to complete the request for any reason, the
+  replacement not being journaled included (see FT_openJournal), in
+  which case the file's contents are unchanged.
 */
 void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
                              size_t ulNewLength);
 
+/*
+  Copies up to ulLength bytes of the contents of the file with
+  absolute path pcPath, from offset ulOffset, into pvBuf, and sets
+  *pulRead to the number of bytes copied: fewer than ulLength if the
+  end of the contents comes first, and 0 if ulOffset is past it.
+  Returns SUCCESS if pcPath is a file. Otherwise, sets *pulRead to 0
+  and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * NOT_A_FILE if pcPath is a directory
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  * IO_ERROR if the contents could not be read from the spill file
+             (see FT_setSpill)
+*/
+int FT_readAt(const char *pcPath, size_t ulOffset, void *pvBuf,
+              size_t ulLength, size_t *pulRead);
+
+/*
+  Writes the ulLength bytes at pvBytes into the contents of the file
+  with absolute path pcPath at offset ulOffset, extending them if the
+  bytes reach past their end, with 0 bytes between their end and
+  ulOffset if it is past it. The first write to a file copies its
+  contents, whatever the mode (see FT_setContentsMode), into chunks
+  of a few KiB that the FT owns; from then on, FT_writeAt, FT_append,
+  and FT_readAt take time in proportion to the bytes they touch,
+  while FT_getFileContents returns the contents in one block, made
+  when first asked for after a write, and valid until the file is
+  modified, moved, or removed. Copies and snapshots of a chunked file
+  share its chunks until either writes to them.
+  Returns SUCCESS if written. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * NOT_A_FILE if pcPath is a directory
+  * MEMORY_ERROR if memory could not be allocated to complete request,
+                 in which case the file holds the same bytes as before
+  * IO_ERROR if the write could not be journaled, or an earlier
+             mutation could not be
+*/
+int FT_writeAt(const char *pcPath, size_t ulOffset, const void *pvBytes,
+               size_t ulLength);
+
+/*
+  Writes the ulLength bytes at pvBytes at the end of the contents of
+  the file with absolute path pcPath, as FT_writeAt does at the offset
+  of their length. Returns the same statuses as FT_writeAt.
+*/
+int FT_append(const char *pcPath, const void *pvBytes, size_t ulLength);
+
+/*
+  The ways the FT can hold the contents of files: FT_CONTENTS_BORROWED
+  keeps the client's pointer, which must stay valid while the file has
+  those contents; FT_CONTENTS_DEDUPLICATED stores a copy of the bytes
+  in a store keyed by their hash, shared by every file (in the FT, its
+  snapshots, and its copies) whose contents are the same bytes, and
+  freed with the last of them; FT_CONTENTS_OWNED copies the bytes for
+  the file alone, without hashing them, into a heap of size classes
+  that packs short contents (up to 120 bytes in classes 16 bytes
+  apart) side by side in large slabs, taking no allocation per file;
+  FT_CONTENTS_MAPPED does as FT_CONTENTS_OWNED, except that contents
+  FT_insertFileFromFd reads from a file are mapped from it instead,
+  read-only, so that the file must not change while the FT holds
+  them. NULL contents are kept as NULL.
+*/
+enum { FT_CONTENTS_BORROWED, FT_CONTENTS_DEDUPLICATED,
+       FT_CONTENTS_OWNED, FT_CONTENTS_MAPPED };
+
+/*
+  Sets how the FT holds the contents of files inserted, or replaced,
+  from now on to iMode, one of the FT_CONTENTS_* modes; files keep
+  the contents they have. FT_init starts the FT in
+  FT_CONTENTS_BORROWED mode. For contents the FT owns,
+  FT_getFileContents returns a pointer into FT memory that never
+  moves, valid until the file is modified, moved, or removed (unless
+  the FT compresses or spills contents: see FT_setCompression and
+  FT_setSpill).
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state.
+*/
+int FT_setContentsMode(int iMode);
+
+/*
+  Reports on the contents stored in FT_CONTENTS_DEDUPLICATED mode:
+  stores in *pulInterned the number of times contents were stored so
+  far, in *pulHits how many of those times the same bytes were
+  stored already (the dedup hit rate is *pulHits over *pulInterned),
+  in *pulStored the bytes stored now, each distinct contents once,
+  and in *pulSaved the bytes that storing them once saves now.
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state.
+*/
+int FT_contentsStats(size_t *pulInterned, size_t *pulHits,
+                     size_t *pulStored, size_t *pulSaved);
+
+/*
+  Sets the FT to compress the contents it owns (see
+  FT_setContentsMode) with a fast built-in LZ codec: every ulColdAfter
+  mutations, those at least 64 bytes long that were not read or
+  written since the last time, and those at least ulLargeFrom bytes
+  long as soon as a file is inserted or replaced with them. Either
+  being 0 turns that trigger off; FT_init starts the FT with both off.
+  Contents that several files share are left as they are, as are
+  mapped contents. Contents that do not shrink are kept uncompressed,
+  but count as compressed all the same: FT_compressionStats adds
+  their length to both *pulOriginal and *pulCompressed. A compressed
+  file reads and writes as any other, and stays compressed when read:
+  FT_getFileContents decompresses its contents into a cache that
+  holds those of the 8 compressed files read last. So while
+  compression is on, a pointer FT_getFileContents returns for
+  contents the FT owns is valid only until the next call that
+  modifies the FT, or saves it, and, if the contents are compressed,
+  until 8 other compressed files have been read since.
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state.
+*/
+int FT_setCompression(size_t ulColdAfter, size_t ulLargeFrom);
+
+/*
+  Reports on compressed contents: stores in *pulOriginal the bytes of
+  the contents compressed now, and in *pulCompressed the bytes they
+  take compressed (the compression ratio is one over the other), in
+  *pulHits the number of times reading compressed contents found them
+  in the cache so far, and in *pulMisses the number of times they
+  were decompressed, and in *pdCompressMs and *pdDecompressMs the CPU
+  time spent compressing and decompressing so far, in milliseconds.
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state.
+*/
+int FT_compressionStats(size_t *pulOriginal, size_t *pulCompressed,
+                        size_t *pulHits, size_t *pulMisses,
+                        double *pdCompressMs, double *pdDecompressMs);
+
+/*
+  Sets the FT to keep the contents it owns only (FT_CONTENTS_OWNED or
+  FT_CONTENTS_MAPPED mode, but not mapped contents) that are at least
+  ulMinLength bytes long within a budget of ulBudget bytes of memory,
+  from the next file inserted or replaced on: when those in memory
+  exceed the budget, the least recently used are written to a spill
+  file named pcFile, each once, as it is only ever appended to, and
+  their memory freed; they are read back when next used, with pread,
+  and FT_readAt reads just the bytes it asks for. Directories and
+  shorter contents always stay in memory, so looking up paths never
+  reads the file. The file is made anew, and removed from its
+  directory at once, so that it is gone when the process ends. A NULL
+  pcFile stops spilling; contents spilled before are still read from
+  their file. FT_init starts the FT with spilling off. While spilling
+  is on, a pointer FT_getFileContents returns for spilled contents is
+  valid only until the next call that reads or modifies the FT, and
+  spilled contents are not compressed (see FT_setCompression).
+  Returns SUCCESS if set. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if the spill file could not be made
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  in which cases nothing changes.
+*/
+int FT_setSpill(const char *pcFile, size_t ulBudget, size_t ulMinLength);
+
+/*
+  Reports on contents spilled (see FT_setSpill): stores in
+  *pulResident the bytes of those that may be spilled that are in
+  memory now, in *pulOnDisk the bytes only in the spill file, and in
+  *pulPageIns and *pulPageOuts the number of times contents were read
+  back from the file and written to it so far.
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state.
+*/
+int FT_spillStats(size_t *pulResident, size_t *pulOnDisk,
+                  size_t *pulPageIns, size_t *pulPageOuts);
+
 /*
   Returns SUCCESS if pcPath exists in the hierarchy,
   Otherwise, returns:
@@ -119,6 +388,504 @@ void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
 */
 int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize);
 
+/*
+  Reports disk usage for the hierarchy (subtree) at absolute path
+  pcPath, in time proportional to the depth of pcPath rather than to
+  the size of the subtree.
+  Returns SUCCESS if pcPath exists in the hierarchy,
+  Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * MEMORY_ERROR if memory could not be allocated to complete request
+
+  When returning SUCCESS, sets *pulDirs to the number of directories
+  in the subtree (counting pcPath itself if it is a directory),
+  *pulFiles to the number of files in the subtree (counting pcPath
+  itself if it is a file), and *pulBytes to the total length of those
+  files' contents.
+
+  When returning another status, *pulDirs, *pulFiles, and *pulBytes
+  are unchanged.
+*/
+int FT_du(const char *pcPath, size_t *pulDirs, size_t *pulFiles,
+          size_t *pulBytes);
+
+/*
+  Calls (*pfVisit)(pcPath, bIsFile, pvExtra) with the absolute path of
+  each file and directory in the FT that matches pcPattern (a frozen
+  FT is matched as it is, without thawing it), in the order
+  FT_toString lists them, and with bIsFile TRUE for a file and FALSE
+  for a directory.
+  pcPattern is a path whose components may hold the wildcards '*', for
+  any run of characters, and '?', for any one, and whose components
+  "**" each stand for any number of components, none included. For
+  example, the pattern with components root, "*", logs, and "*.gz"
+  matches the .gz files in the logs directory of each directory under
+  root, and the one with components root, "**", and "*.gz" every .gz
+  file anywhere under root. pcPath is only valid during the call,
+  which must not modify the FT.
+  Descends only into directories that can hold a match, and finds the
+  children that can match a component without wildcards, or one that
+  starts with characters other than wildcards, by binary search
+  among the sorted children, so takes time proportional to the
+  directories the pattern reaches, not to the size of the FT, unless
+  it starts a component with a wildcard.
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPattern does not represent a well-formatted path
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_glob(const char *pcPattern,
+            void (*pfVisit)(const char *pcPath, boolean bIsFile,
+                            void *pvExtra),
+            void *pvExtra);
+
+/*
+  Relocates all nodes of the FT, their names, and their children
+  arrays into freshly allocated contiguous memory, in the same
+  pre-order that FT_toString lists them, so that each subtree sits in
+  consecutive memory and later traversals and lookups touch fewer
+  pages. May be called at any time between other FT operations.
+  Returns SUCCESS if the FT was compacted (or is empty). Otherwise,
+  leaves the FT as it is and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * NOT_COMPACTED if the FT is frozen (see FT_freeze), or any snapshot
+                  exists, or the FT shares nodes between the sides
+                  of an FT_copy, or a subtree cut out with FT_detach
+                  is not attached or freed yet
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_compact(void);
+
+/*
+  Freezes the FT: replaces all of its nodes with a read-only, succinct
+  image of the tree in one block of memory (the tree's shape as a
+  bitvector of about two bits per node, names front-coded among
+  siblings, and each directory's FT_du totals), for trees that are
+  built once and then only queried. While frozen, FT_containsDir,
+  FT_containsFile, FT_getFileContents, FT_stat, FT_du, and FT_toString
+  answer from the image. Any call that modifies the FT first thaws it
+  back into nodes, and fails with MEMORY_ERROR (or returns NULL, for
+  FT_replaceFileContents) if that is not possible, leaving the FT
+  frozen. File contents are kept by reference, as always.
+  Returns SUCCESS if the FT was frozen, or was already frozen, or is
+  empty, in which cases it is left as it is. Otherwise, leaves the
+  FT as it is and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * OWNED_CONTENTS if the FT owns any contents (see
+                   FT_setContentsMode), which an image, holding
+                   contents by reference, could not keep alive
+  * MEMORY_ERROR if memory could not be allocated to complete request,
+                 in which case the FT is unchanged
+*/
+int FT_freeze(void);
+
+/*
+  Saves the whole FT, including the contents of its files, to the
+  file named pcFile in a versioned binary format with a checksum. The
+  file is replaced only once the new image is completely written.
+  Returns SUCCESS if the FT was saved. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if the file could not be written
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_save(const char *pcFile);
+
+/*
+  Starts saving the FT, as FT_save does, to the file named pcFile in a
+  child process forked for it, and returns without waiting: the child
+  saves the FT as it was at the fork from its copy-on-write view of
+  this process's memory, so later modifications do not affect the
+  file. Only one background save runs at a time: this waits for the
+  one running, if any, first, and holds on to its outcome, which the
+  next FT_pollSave reports before that of the save this starts (of
+  several such saves, the first that failed, or else the last).
+  Collect the outcome with FT_pollSave; FT_destroy waits for the save
+  to end and drops any outcome not collected.
+  Returns SUCCESS if the save was started. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if no pipe could be made to report back through
+  * MEMORY_ERROR if the process could not be forked
+*/
+int FT_saveInBackground(const char *pcFile);
+
+/*
+  Checks on the background save started by FT_saveInBackground,
+  waiting for it to end if bWait is TRUE. Returns FALSE if it is still
+  running. Otherwise, returns TRUE and sets *piStatus to:
+  * SUCCESS if it saved the FT, in which case *pulSize is set to the
+    size in bytes of the saved file
+  * whatever FT_save returned in the child, if that was not SUCCESS
+  * IO_ERROR if the child ended without reporting back
+  * INITIALIZATION_ERROR if no background save was started since the
+    last one that FT_pollSave reported on
+  An outcome FT_saveInBackground held on to is reported first, at
+  once, whatever bWait is.
+*/
+boolean FT_pollSave(boolean bWait, int *piStatus, size_t *pulSize);
+
+/*
+  Replaces the FT's contents with the tree saved by FT_save in the file
+  named pcFile. The file is read in one piece, and the loaded FT is
+  frozen (see FT_freeze) until it is first modified. The loaded files'
+  contents are owned by the FT: they remain valid, even after
+  being replaced or removed, until the next FT_load, FT_open, or
+  FT_destroy.
+  Returns SUCCESS if the FT was loaded. Otherwise, returns with the FT
+  unchanged:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if the file could not be opened or read
+  * CORRUPT_IMAGE if the file is not a saved FT of this version, or it
+                  fails its checksum or its structure is inconsistent
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_load(const char *pcFile);
+
+/*
+  Like FT_load, but maps the file saved by FT_save read-only into
+  memory instead of reading it, so that opening takes constant time
+  however large the tree: FT_containsDir, FT_containsFile,
+  FT_getFileContents, FT_stat, FT_du, and FT_toString are answered
+  directly from the mapped file, whose pages are read in as they are
+  first touched and are shared with other processes mapping the same
+  file. Only the file's header and layout are checked, not its
+  checksum or structure, so only files known to be intact should be
+  opened; FT_load checks everything. The file must not be modified or
+  truncated while the FT maps it, i.e., until the next FT_load,
+  FT_open, or FT_destroy. The first modification of the FT thaws the
+  tree into nodes, whose contents stay in the mapped file.
+  Returns SUCCESS if the file was mapped. Otherwise, returns with the
+  FT unchanged:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if the file could not be opened or mapped
+  * CORRUPT_IMAGE if the file is not a saved FT of this version, or
+                  its layout is inconsistent
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_open(const char *pcFile);
+
+/*
+  Starts recording every successful FT_insertDir, FT_insertFile,
+  FT_rmDir, FT_rmFile, FT_move, FT_copy, and FT_replaceFileContents in
+  the journal file named pcFile, appending to it if it exists, after
+  closing the journal already open, if any. Records are written out
+  and synced (with fdatasync) in groups of ulBatch, which must be at
+  least 1: a mutation is durable once its group is, or once
+  FT_syncJournal, FT_checkpoint, or FT_closeJournal returns SUCCESS,
+  so a crash loses at most the last ulBatch - 1 mutations. A journal
+  should only be reopened on the tree FT_recover rebuilt from it.
+  A mutation stands only once its record is in the journal: it is
+  journaled before the FT changes, or undone if it cannot be, so one
+  that fails leaves the FT unchanged (save for FT_merge, see there). A
+  record that could not be buffered fails its mutation with
+  MEMORY_ERROR, and the journal goes on. A group that could not be
+  written out fails the mutation that completed it with IO_ERROR (or
+  NULL, for FT_replaceFileContents), though its record may have
+  reached the file, and every later mutation fails the same way,
+  without changing the FT, until the journal is closed.
+  Returns SUCCESS if the journal was opened. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if the file could not be opened, read, or written, or the
+             journal already open could not be synced
+  * CORRUPT_IMAGE if the file is not a journal of this version
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_openJournal(const char *pcFile, size_t ulBatch);
+
+/*
+  Writes out and syncs the journaled mutations not yet durable, if a
+  journal is open. Returns SUCCESS if they were, or no journal is open.
+  Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if the journal could not be written or synced
+*/
+int FT_syncJournal(void);
+
+/*
+  Syncs and closes the journal, if one is open: mutations are no
+  longer journaled. FT_destroy closes the journal too.
+  Returns SUCCESS if the journal was synced and closed, or none was
+  open. Otherwise, closes it anyway, and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if the journal could not be written or synced
+*/
+int FT_closeJournal(void);
+
+/*
+  Saves the FT to the file named pcFile, like FT_save, as a snapshot
+  for FT_recover, then empties the open journal, if any, whose
+  mutations the snapshot now reflects.
+  Returns SUCCESS if the FT was saved and the journal emptied.
+  Otherwise, returns with the same statuses as FT_save, or IO_ERROR if
+  the journal could not be emptied.
+*/
+int FT_checkpoint(const char *pcFile);
+
+/*
+  Rebuilds the FT after a crash: closes the open journal, if any,
+  replaces the FT's contents with the snapshot saved by FT_save or
+  FT_checkpoint in the file named pcSnapshot (or empties the FT, if
+  pcSnapshot is NULL), and then replays the mutations in the journal
+  file named pcJournal that the snapshot does not reflect yet, up to
+  the last one written out whole. The replayed files' contents are
+  owned by the FT, as for FT_load. To go on journaling, reopen the
+  journal with FT_openJournal afterwards.
+  Returns SUCCESS if the FT was recovered. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if a file could not be opened or read, or the journal
+             already open could not be synced
+  * CORRUPT_IMAGE if a file is not a snapshot or journal of this
+                  version, or the snapshot fails its checks
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  * the status of a replayed mutation that failed, as it would if the
+    journal did not belong to the snapshot
+  If the snapshot could not be loaded, the FT is unchanged; otherwise
+  it holds the snapshot and the mutations replayed before the failure.
+*/
+int FT_recover(const char *pcSnapshot, const char *pcJournal);
+
+/*
+  A Snapshot_T is a read-only view of the FT as it was when it was
+  taken, which modifications of the FT do not change. Snapshots share
+  all their nodes with the FT and with each other: each modification
+  of the FT copies just the nodes on the path from the root down to
+  the nodes it changes, and leaves the subtrees it does not touch
+  shared. File contents are shared by reference, as always.
+*/
+typedef struct snapshot *Snapshot_T;
+
+/*
+  Takes a snapshot of the FT, in constant time (but a frozen FT is
+  thawed first, see FT_freeze). The snapshot stays valid until freed
+  with FT_freeSnapshot, even after FT_destroy, FT_load, FT_open, or
+  FT_recover: it keeps the image the FT was loaded from, and the
+  contents replayed into it, for as long as it refers to them. While
+  any snapshot exists, FT_compact returns NOT_COMPACTED.
+  Returns SUCCESS and sets *poSResult to the snapshot. Otherwise, sets
+  *poSResult to NULL and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_snapshot(Snapshot_T *poSResult);
+
+/* Frees oSSnapshot, and the nodes that only it still refers to. */
+void FT_freeSnapshot(Snapshot_T oSSnapshot);
+
+/*
+  The following are FT_containsDir, FT_containsFile,
+  FT_getFileContents, FT_stat, FT_du, and FT_toString for the tree in
+  snapshot oSSnapshot, with the same results and statuses, except that
+  they never fail with INITIALIZATION_ERROR.
+*/
+boolean FT_snapshotContainsDir(Snapshot_T oSSnapshot, const char *pcPath);
+boolean FT_snapshotContainsFile(Snapshot_T oSSnapshot, const char *pcPath);
+void *FT_snapshotGetFileContents(Snapshot_T oSSnapshot,
+                                 const char *pcPath);
+int FT_snapshotStat(Snapshot_T oSSnapshot, const char *pcPath,
+                    boolean *pbIsFile, size_t *pulSize);
+int FT_snapshotDu(Snapshot_T oSSnapshot, const char *pcPath,
+                  size_t *pulDirs, size_t *pulFiles, size_t *pulBytes);
+char *FT_snapshotToString(Snapshot_T oSSnapshot);
+
+/* The kinds of changes FT_diff reports */
+enum { FT_DIFF_ADDED, FT_DIFF_REMOVED, FT_DIFF_CHANGED };
+
+/*
+  Compares snapshot oSOld with snapshot oSNew, either of which may be
+  NULL for the FT as it is now (a frozen FT is thawed first, see
+  FT_freeze), and calls (*pfVisit)(pcPath, iChange, pvExtra) for each
+  difference: FT_DIFF_ADDED or FT_DIFF_REMOVED with the absolute path
+  of each file or directory only one of them has, but not of the
+  nodes under it, and FT_DIFF_CHANGED with the path of each file whose
+  contents differ. A node that is a file in one and a directory in the
+  other is reported removed and added. pcPath is only valid during
+  the call, which must not modify the FT.
+  Descends only into directories whose hashes differ (see
+  Node_getHash), so takes time proportional to the differences, and
+  the sizes of the directories holding them, however large the trees.
+  Contents the FT holds are compared as they were when last set, and
+  could hash the same despite differing, with negligible probability.
+  Borrowed contents, hashed by their address and length, are compared
+  byte for byte, as they are now, where those differ; NULL contents
+  differ from any others of the same nonzero length.
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if either is NULL and the FT is not in an
+                         initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_diff(Snapshot_T oSOld, Snapshot_T oSNew,
+            void (*pfVisit)(const char *pcPath, int iChange,
+                            void *pvExtra),
+            void *pvExtra);
+
+/*
+  A Subtree_T is a subtree cut out of the FT with FT_detach, to be
+  grafted back into it with FT_attach, at the same path or another,
+  possibly after FT_destroy and FT_init or FT_load. Detaching and
+  attaching relink just the subtree's root, whatever its size, and
+  the FT's totals are adjusted with the subtree's own.
+*/
+typedef struct subtree *Subtree_T;
+
+/*
+  Cuts the file or directory with absolute path pcPath, and everything
+  under it, out of the FT (a frozen FT is thawed first, see
+  FT_freeze). Its files' contents are owned as before: contents held
+  by the FT since FT_load or FT_recover stay valid only as long as the
+  FT would have kept them.
+  Returns SUCCESS and sets *poTResult to the subtree, which stays
+  valid until attached with FT_attach or freed with FT_freeSubtree.
+  Otherwise, sets *poTResult to NULL and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  * IO_ERROR if the removal could not be journaled
+*/
+int FT_detach(const char *pcPath, Subtree_T *poTResult);
+
+/*
+  Grafts oTSubtree into the FT at absolute path pcPath, whose parent
+  directory must already exist, under the last component of pcPath,
+  or as the root of an empty FT if pcPath has one component only and
+  oTSubtree is a directory. If a journal is open, the insertion of
+  every node of the subtree is journaled first, in time proportional
+  to its size.
+  Returns SUCCESS if attached, in which case oTSubtree is consumed.
+  Otherwise, the FT is unchanged, oTSubtree is left as it was, for
+  the caller to attach again or free, and the status is:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root is not a prefix of pcPath, or pcPath
+                     has one component and the root is not pcPath or
+                     oTSubtree is a file
+  * NO_SUCH_PATH if the parent of pcPath is not in the FT
+  * NOT_A_DIRECTORY if a proper prefix of pcPath exists as a file
+  * ALREADY_IN_TREE if pcPath is already in the FT (as dir or file)
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  * IO_ERROR if the insertion could not be journaled (see
+             FT_openJournal)
+*/
+int FT_attach(const char *pcPath, Subtree_T oTSubtree);
+
+/* Frees oTSubtree and all of its nodes not shared with snapshots. */
+void FT_freeSubtree(Subtree_T oTSubtree);
+
+/*
+  Policies for FT_merge, to be or'ed together: where the FT and the
+  subtree merged into it have nodes with the same path, the FT keeps
+  its own, unless the policy says to take the subtree's file instead
+  of the FT's, when both are files, or to take the subtree's node
+  instead of the FT's, when one is a file and the other a directory.
+*/
+enum { FT_MERGE_KEEP = 0, FT_MERGE_FILES_FROM_SRC = 1,
+       FT_MERGE_KINDS_FROM_SRC = 2 };
+
+/*
+  Merges directory oTSubtree into the directory with absolute path
+  pcPath in the FT (a frozen FT is thawed first, see FT_freeze): what
+  only oTSubtree has is grafted in whole, directories both have are
+  merged in turn, and conflicts are settled by iPolicy (see
+  FT_MERGE_KEEP). Walks the sorted children of the directories both
+  have in lockstep, so takes time proportional to the overlap of the
+  two, not to the size of oTSubtree, unless a journal is open, in
+  which case pcPath's removal and the insertion of every node then
+  under it are journaled.
+  Returns SUCCESS if merged, and consumes oTSubtree. Otherwise,
+  oTSubtree is left as it was, though the directory may have been
+  partly merged into, and the status is:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * NOT_A_DIRECTORY if pcPath is in the FT as a file, or oTSubtree is
+                    a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  * IO_ERROR if the merge could not be journaled, in which case
+             oTSubtree was merged, and consumed
+*/
+int FT_merge(const char *pcPath, Subtree_T oTSubtree, int iPolicy);
+
+/*
+  Copies the directory named pcFsPath of the real filesystem, and the
+  directories and regular files under it, into the FT as a directory
+  with absolute path pcFtRoot, whose parent directory must already
+  exist, or as the root of an empty FT if pcFtRoot has one component
+  only. Symbolic links and special files are skipped. ulThreads
+  threads (1 if 0) list the directories and read the files in
+  parallel, into memory; the subtree is then built from what they
+  read, with each directory's children inserted in sorted order, and
+  grafted in with FT_attach, so the FT is unchanged unless the whole
+  import succeeds. The files own their contents, in the contents mode
+  in effect (see FT_setContentsMode and FT_setSpill), except that in
+  FT_CONTENTS_BORROWED mode each has its own copy.
+  Returns SUCCESS if imported. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * the statuses FT_attach does, for pcFtRoot
+  * IO_ERROR if a directory could not be listed or a file read
+*/
+int FT_importDir(const char *pcFsPath, const char *pcFtRoot,
+                 size_t ulThreads);
+
+/*
+  Reports on the last successful FT_importDir: stores in *pulFiles
+  and *pulBytes the number of files it imported and the bytes of
+  their contents, and in *pdFilesPerSec and *pdBytesPerSec the rates
+  at which it imported them, over the whole import. All are 0 before
+  the first import.
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state.
+*/
+int FT_importStats(size_t *pulFiles, size_t *pulBytes,
+                   double *pdFilesPerSec, double *pdBytesPerSec);
+
+/*
+  Sets how FT_exportDir writes files: up to ulQueueDepth of them in
+  flight at once (1 if 0, and at most 4096), submitted in batches
+  through an io_uring if bRing is TRUE and the kernel offers one, and
+  written by a pool of threads with pwrite otherwise. The FT starts
+  with a depth of 64, through an io_uring.
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state.
+*/
+int FT_setExport(size_t ulQueueDepth, boolean bRing);
+
+/*
+  Writes the directory with absolute path pcFtPath, and everything
+  under it, out to the real filesystem as a new directory named
+  pcFsPath (a frozen FT is read as it is, without thawing it). Each
+  directory is made before anything under it, one at a time, and the
+  files are queued as they are reached, to be created and written in
+  batches (see FT_setExport); a file with NULL contents is written
+  empty.
+  Returns SUCCESS if exported. Otherwise, what was written by then is
+  left in place, and the status is:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcFtPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcFtPath
+  * NO_SUCH_PATH if absolute path pcFtPath does not exist in the FT
+  * NOT_A_DIRECTORY if pcFtPath is a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  * IO_ERROR if pcFsPath exists or could not be made, or a directory
+             or file under it could not be made or written, or
+             contents spilled to disk could not be read
+*/
+int FT_exportDir(const char *pcFtPath, const char *pcFsPath);
+
+/*
+  Reports on the last successful FT_exportDir, as FT_importStats does
+  on FT_importDir, and stores in *pbRing whether it wrote through an
+  io_uring.
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state.
+*/
+int FT_exportStats(size_t *pulFiles, size_t *pulBytes,
+                   double *pdFilesPerSec, double *pdBytesPerSec,
+                   boolean *pbRing);
+
 /*
   Sets the FT data structure to an initialized state.
   The data structure is initially empty.
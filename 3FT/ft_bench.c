@@ -0,0 +1,1047 @@
+/*--------------------------------------------------------------------*/
+/* ft_bench.c                                                         */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+/* for clock_gettime, pread, and fnmatch under a strict -std */
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include "ft.h"
+
+/* Sizes of the benchmark tree */
+enum {NUM_DIRS = 2000, NUM_FILES = 200000, NUM_WALKS = 10};
+
+/* Number of copies FT_copy makes of the benchmark tree */
+enum {NUM_COPIES = 1000};
+
+/* Longest path the benchmark builds, plus room for '\0' */
+enum {MAX_PATH = 64};
+
+/* Longest file contents the benchmark uses */
+enum {MAX_DATA = 64};
+
+/* The bytes that file contents are taken from */
+static char acData[MAX_DATA];
+
+/* Number of files inserted with deduplicated contents, the number of
+   distinct blobs among their contents, and the size of each blob */
+enum {NUM_DEDUP = 20000, NUM_BLOBS = 64, BLOB_SIZE = 4096};
+
+/* The blobs that deduplicated contents are copied from */
+static char acBlobs[NUM_BLOBS][BLOB_SIZE];
+
+/* Number of short files inserted with borrowed, then owned contents */
+enum {NUM_SMALL = 100000};
+
+/* Number of records appended to one growing file, and their size */
+enum {NUM_RECORDS = 1024, RECORD_SIZE = 1024};
+
+/* Number of text files compressed, the longest of them, and the
+   number of reads of them, most of a few hot files */
+enum {NUM_TEXTS = 20000, MAX_TEXT = 8192, NUM_READS = 100000,
+      NUM_HOT = 8};
+
+/* The spill file, and the budget for the text files' contents in
+   memory: a tenth of them */
+static const char *pcSpill = "ft_bench.spill";
+enum {SPILL_BUDGET = NUM_TEXTS / 10 * (MAX_TEXT / 2)};
+
+/* Number of files inserted from and written back to file
+   descriptors, and their size */
+enum {NUM_FD_FILES = 16384, FD_FILE_SIZE = 4096};
+
+/* The file they are inserted from, and the file they are written to */
+static const char *pcSource = "ft_bench.src";
+static const char *pcSink = "ft_bench.out";
+
+/* The real directory imported with FT_importDir, its number of
+   subdirectories, the files in each, their size, and the thread
+   counts it is imported with, ending with 0 */
+static const char *pcTree = "ft_bench.tree";
+enum {NUM_IMPORT_DIRS = 256, NUM_IMPORT_FILES = 64,
+      IMPORT_FILE_SIZE = 1024};
+static const size_t aulImportThreads[] = {1, 2, 4, 8, 0};
+
+/* The queue depths it is exported back out with, ending with 0 */
+static const size_t aulExportDepths[] = {1, 64, 0};
+
+/* Patterns matched against the files under root, ending with NULL */
+static const char *apcGlobs[] = {"root/d0042/*", "root/d00*/g1_f0000*",
+                                 "root/*/g1_f19999?", "root/**/*_f0001??",
+                                 NULL};
+
+/* The file FT_save writes to and FT_load reads from */
+static const char *pcImage = "ft_bench.img";
+
+/* The file mutations are journaled to */
+static const char *pcJournal = "ft_bench.log";
+
+/* Group sizes the journal is measured with, ending with 0 */
+static const size_t aulBatches[] = {1, 16, 256, 4096, 0};
+
+/* Returns the number of milliseconds of CPU time since ctStart. */
+static double Bench_msSince(clock_t ctStart)
+{
+   return (double)(clock() - ctStart) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/* Returns the number of milliseconds of wall-clock time since
+   *psStart, which waiting for the disk counts towards. */
+static double Bench_wallMsSince(const struct timespec *psStart)
+{
+   struct timespec sNow;
+   clock_gettime(CLOCK_MONOTONIC, &sNow);
+   return (double)(sNow.tv_sec - psStart->tv_sec) * 1000.0 +
+      (double)(sNow.tv_nsec - psStart->tv_nsec) / 1000000.0;
+}
+
+/* Writes into pcBuf the path of file number ulFile in generation
+   iGen. Files are spread over the NUM_DIRS directories. */
+static void Bench_filePath(char *pcBuf, size_t ulFile, int iGen)
+{
+   sprintf(pcBuf, "root/d%04lu/g%d_f%06lu",
+           (unsigned long)(ulFile % NUM_DIRS), iGen,
+           (unsigned long)ulFile);
+}
+
+/* Shuffles the ulLength elements of pulArray in place. */
+static void Bench_shuffle(size_t *pulArray, size_t ulLength)
+{
+   size_t i;
+   for(i = ulLength - 1; i > 0; i--) {
+      size_t j = (size_t)rand() % (i + 1);
+      size_t ulTemp = pulArray[i];
+      pulArray[i] = pulArray[j];
+      pulArray[j] = ulTemp;
+   }
+}
+
+/* Counts a difference FT_diff reports in the size_t at pvExtra. */
+static void Bench_countDiff(const char *pcPath, int iChange,
+                            void *pvExtra)
+{
+   (void)pcPath;
+   (void)iChange;
+   (*(size_t *)pvExtra)++;
+}
+
+/*
+  Inserts NUM_SMALL files of 8 to 64 bytes each under other/small, in
+  FT_CONTENTS_OWNED mode if bOwned is TRUE, and otherwise borrowing
+  contents that the client allocates each on its own, as it must when
+  the FT only borrows them. Then reads every byte of every file in
+  the order inserted, and removes them all. Prints the CPU time each
+  step took.
+*/
+static void Bench_smallFiles(boolean bOwned)
+{
+   static char *apcCopies[NUM_SMALL];
+   char acPath[MAX_PATH];
+   size_t ulSum = 0;
+   clock_t ctStart;
+   size_t i, j;
+
+   assert(FT_setContentsMode(bOwned ? FT_CONTENTS_OWNED :
+                             FT_CONTENTS_BORROWED) == SUCCESS);
+   ctStart = clock();
+   for(i = 0; i < NUM_SMALL; i++) {
+      size_t ulLength = 8 + i % 57;
+      void *pvContents = acData;
+      if(!bOwned) {
+         apcCopies[i] = malloc(ulLength);
+         assert(apcCopies[i] != NULL);
+         memcpy(apcCopies[i], acData, ulLength);
+         pvContents = apcCopies[i];
+      }
+      sprintf(acPath, "other/small/d%03lu/f%06lu",
+              (unsigned long)(i % 1000), (unsigned long)i);
+      assert(FT_insertFile(acPath, pvContents, ulLength) == SUCCESS);
+   }
+   printf("%d FT_insertFile of 8 to 64 bytes, %s: %8.2f ms\n",
+          NUM_SMALL, bOwned ? "owned   " : "borrowed",
+          Bench_msSince(ctStart));
+
+   ctStart = clock();
+   for(i = 0; i < NUM_SMALL; i++) {
+      const char *pcContents;
+      sprintf(acPath, "other/small/d%03lu/f%06lu",
+              (unsigned long)(i % 1000), (unsigned long)i);
+      pcContents = FT_getFileContents(acPath);
+      for(j = 0; j < 8 + i % 57; j++)
+         ulSum += (unsigned char)pcContents[j];
+   }
+   printf("reading every byte of them: %8.2f ms (sum %lu)\n",
+          Bench_msSince(ctStart), (unsigned long)ulSum);
+
+   ctStart = clock();
+   assert(FT_rmDir("other/small") == SUCCESS);
+   if(!bOwned)
+      for(i = 0; i < NUM_SMALL; i++)
+         free(apcCopies[i]);
+   printf("FT_rmDir of them%s: %8.2f ms\n",
+          bOwned ? "" : " and freeing the copies", Bench_msSince(ctStart));
+}
+
+/* Grows one file by NUM_RECORDS records of RECORD_SIZE bytes, first
+   by replacing its owned contents with the grown buffer each time,
+   then with FT_append, and reads and overwrites single records of
+   it. Prints how long each step took. */
+static void Bench_growth(void)
+{
+   static char acGrown[NUM_RECORDS * RECORD_SIZE];
+   static char acRecord[RECORD_SIZE];
+   Snapshot_T oSSnapshot;
+   size_t ulRead;
+   clock_t ctStart;
+   size_t i;
+
+   for(i = 0; i < NUM_RECORDS * RECORD_SIZE; i++)
+      acGrown[i] = (char)rand();
+   assert(FT_setContentsMode(FT_CONTENTS_OWNED) == SUCCESS);
+   ctStart = clock();
+   assert(FT_insertFile("other/replaced", acGrown, RECORD_SIZE) ==
+          SUCCESS);
+   for(i = 2; i <= NUM_RECORDS; i++)
+      assert(FT_replaceFileContents("other/replaced", acGrown,
+                                    i * RECORD_SIZE) != NULL);
+   printf("%d FT_replaceFileContents, growing by %d bytes: %8.2f ms\n",
+          NUM_RECORDS, RECORD_SIZE, Bench_msSince(ctStart));
+   assert(FT_rmFile("other/replaced") == SUCCESS);
+
+   assert(FT_insertFile("other/appended", NULL, 0) == SUCCESS);
+   ctStart = clock();
+   for(i = 0; i < NUM_RECORDS; i++)
+      assert(FT_append("other/appended", acGrown + i * RECORD_SIZE,
+                       RECORD_SIZE) == SUCCESS);
+   printf("%d FT_append of %d bytes: %8.2f ms\n",
+          NUM_RECORDS, RECORD_SIZE, Bench_msSince(ctStart));
+
+   ctStart = clock();
+   for(i = 0; i < NUM_RECORDS; i++) {
+      assert(FT_readAt("other/appended",
+                       (size_t)(rand() % NUM_RECORDS) * RECORD_SIZE,
+                       acRecord, RECORD_SIZE, &ulRead) == SUCCESS);
+      assert(ulRead == RECORD_SIZE);
+   }
+   printf("%d FT_readAt of a record: %8.2f ms\n", NUM_RECORDS,
+          Bench_msSince(ctStart));
+
+   /* a snapshot shares the chunks, so each write copies just one */
+   assert(FT_snapshot(&oSSnapshot) == SUCCESS);
+   ctStart = clock();
+   for(i = 0; i < NUM_RECORDS; i++)
+      assert(FT_writeAt("other/appended",
+                        (size_t)(rand() % NUM_RECORDS) * RECORD_SIZE,
+                        acRecord, RECORD_SIZE) == SUCCESS);
+   printf("%d FT_writeAt of a record, sharing with a snapshot: "
+          "%8.2f ms\n", NUM_RECORDS, Bench_msSince(ctStart));
+   FT_freeSnapshot(oSSnapshot);
+   assert(FT_rmFile("other/appended") == SUCCESS);
+}
+
+/* Reads NUM_READS files of the NUM_TEXTS under other/text, nine in
+   ten of them among the first NUM_HOT, touching every 64th byte.
+   Returns the CPU time the reads took, in milliseconds. */
+static double Bench_readTexts(void)
+{
+   char acPath[MAX_PATH];
+   size_t ulSum = 0;
+   clock_t ctStart;
+   size_t i, j;
+
+   srand(5);
+   ctStart = clock();
+   for(i = 0; i < NUM_READS; i++) {
+      size_t ulText = rand() % 10 != 0 ? (size_t)rand() % NUM_HOT
+                                        : (size_t)rand() % NUM_TEXTS;
+      const char *pcContents;
+      boolean bIsFile;
+      size_t ulLength;
+      sprintf(acPath, "other/text/d%03lu/f%05lu",
+              (unsigned long)(ulText % 100), (unsigned long)ulText);
+      assert(FT_stat(acPath, &bIsFile, &ulLength) == SUCCESS);
+      pcContents = FT_getFileContents(acPath);
+      for(j = 0; j < ulLength; j += 64)
+         ulSum += (unsigned char)pcContents[j];
+   }
+   assert(ulSum != 0);
+   return Bench_msSince(ctStart);
+}
+
+/* Inserts NUM_TEXTS files of English-like text, then compresses them
+   all as cold, and reads them before and after. Prints the
+   compression ratio, the CPU time compressing and reading took, and
+   the hit rate of the cache of decompressed contents. */
+static void Bench_compression(void)
+{
+   static const char *apcWords[] = {"the ", "tree ", "holds ", "a ",
+      "file ", "of ", "contents ", "and ", "each ", "directory ", "in ",
+      "its ", "path ", "is ", "read ", "written ", "to ", "disk. "};
+   static char acText[MAX_TEXT];
+   char acPath[MAX_PATH];
+   size_t ulOriginal, ulCompressed, ulHits, ulMisses;
+   size_t ulBefore, ulAfter, ulShared;
+   double dCompressMs, dDecompressMs, dPlain, dPacked;
+   clock_t ctStart;
+   size_t i, ulAt = 0;
+
+   while(ulAt < MAX_TEXT) {
+      const char *pcWord = apcWords[rand() % (sizeof(apcWords) /
+                                             sizeof(apcWords[0]))];
+      for(i = 0; pcWord[i] != '\0' && ulAt < MAX_TEXT; i++)
+         acText[ulAt++] = pcWord[i];
+   }
+   assert(FT_setContentsMode(FT_CONTENTS_OWNED) == SUCCESS);
+   for(i = 0; i < NUM_TEXTS; i++) {
+      size_t ulStart = (size_t)rand() % 1024;
+      sprintf(acPath, "other/text/d%03lu/f%05lu",
+              (unsigned long)(i % 100), (unsigned long)i);
+      assert(FT_insertFile(acPath, acText + ulStart,
+                           1024 + (size_t)rand() %
+                           (MAX_TEXT - 2048)) == SUCCESS);
+   }
+   assert(FT_usage(&ulBefore, &ulShared) == SUCCESS);
+   dPlain = Bench_readTexts();
+
+   /* the first sweep finds them all just touched, the second packs
+      them */
+   assert(FT_setCompression(1, 0) == SUCCESS);
+   ctStart = clock();
+   assert(FT_insertDir("other/sweep1") == SUCCESS);
+   assert(FT_insertDir("other/sweep2") == SUCCESS);
+   printf("two sweeps compressing %d cold files: %8.2f ms\n", NUM_TEXTS,
+          Bench_msSince(ctStart));
+   assert(FT_setCompression(0, 0) == SUCCESS);
+   assert(FT_usage(&ulAfter, &ulShared) == SUCCESS);
+   assert(FT_compressionStats(&ulOriginal, &ulCompressed, &ulHits,
+                              &ulMisses, &dCompressMs, &dDecompressMs) ==
+          SUCCESS);
+   printf("%lu bytes of text compressed to %lu, ratio %5.2f, in "
+          "%8.2f ms of CPU\n", (unsigned long)ulOriginal,
+          (unsigned long)ulCompressed,
+          (double)ulOriginal / (double)ulCompressed, dCompressMs);
+   printf("FT_usage: %lu bytes exclusive before, %lu after\n",
+          (unsigned long)ulBefore, (unsigned long)ulAfter);
+
+   dPacked = Bench_readTexts();
+   assert(FT_compressionStats(&ulOriginal, &ulCompressed, &ulHits,
+                              &ulMisses, &dCompressMs, &dDecompressMs) ==
+          SUCCESS);
+   printf("%d reads, 9 in 10 of %d files: %8.2f ms uncompressed, "
+          "%8.2f ms compressed\n", NUM_READS, NUM_HOT, dPlain, dPacked);
+   printf("cache hit rate %5.1f%%, %8.2f ms of CPU decompressing\n",
+          100.0 * (double)ulHits / (double)(ulHits + ulMisses),
+          dDecompressMs);
+   assert(FT_rmDir("other/text") == SUCCESS);
+}
+
+/* Inserts NUM_TEXTS files, spilling all but SPILL_BUDGET bytes of
+   them, and reads them as Bench_readTexts does. Prints the time each
+   took, the bytes spilled, and how often reads had to page contents
+   back in. */
+static void Bench_spill(void)
+{
+   static char acBytes[MAX_TEXT];
+   char acPath[MAX_PATH];
+   size_t ulResident, ulOnDisk, ulPageIns, ulPageOuts;
+   struct timespec sStart;
+   double dInsertMs;
+   size_t i;
+
+   for(i = 0; i < MAX_TEXT; i++)
+      acBytes[i] = (char)rand();
+   assert(FT_setContentsMode(FT_CONTENTS_OWNED) == SUCCESS);
+   assert(FT_setSpill(pcSpill, SPILL_BUDGET, 512) == SUCCESS);
+   clock_gettime(CLOCK_MONOTONIC, &sStart);
+   for(i = 0; i < NUM_TEXTS; i++) {
+      size_t ulStart = (size_t)rand() % 1024;
+      sprintf(acPath, "other/text/d%03lu/f%05lu",
+              (unsigned long)(i % 100), (unsigned long)i);
+      assert(FT_insertFile(acPath, acBytes + ulStart,
+                           1024 + (size_t)rand() %
+                           (MAX_TEXT - 2048)) == SUCCESS);
+   }
+   dInsertMs = Bench_wallMsSince(&sStart);
+   assert(FT_spillStats(&ulResident, &ulOnDisk, &ulPageIns,
+                        &ulPageOuts) == SUCCESS);
+   printf("%d files inserted with a budget of %d bytes: %8.2f ms, "
+          "%lu bytes in memory, %lu spilled\n", NUM_TEXTS, SPILL_BUDGET,
+          dInsertMs, (unsigned long)ulResident, (unsigned long)ulOnDisk);
+
+   clock_gettime(CLOCK_MONOTONIC, &sStart);
+   (void)Bench_readTexts();
+   assert(FT_spillStats(&ulResident, &ulOnDisk, &ulPageIns,
+                        &ulPageOuts) == SUCCESS);
+   printf("%d reads, 9 in 10 of %d files: %8.2f ms, %lu page-ins "
+          "(%5.1f%%), %lu page-outs in all\n", NUM_READS, NUM_HOT,
+          Bench_wallMsSince(&sStart), (unsigned long)ulPageIns,
+          100.0 * (double)ulPageIns / (double)NUM_READS,
+          (unsigned long)ulPageOuts);
+   assert(FT_rmDir("other/text") == SUCCESS);
+   assert(FT_setSpill(NULL, 0, 0) == SUCCESS);
+}
+
+/* Inserts NUM_FD_FILES files of FD_FILE_SIZE bytes each from the
+   file open as iFd under other/fd: read into a buffer and passed to
+   FT_insertFile if bBuffered is TRUE, and with FT_insertFileFromFd
+   otherwise, in the current contents mode. Returns the wall clock
+   time it took, in milliseconds. */
+static double Bench_insertFromFd(int iFd, boolean bBuffered)
+{
+   char acPath[MAX_PATH];
+   struct timespec sStart;
+   size_t i;
+
+   clock_gettime(CLOCK_MONOTONIC, &sStart);
+   for(i = 0; i < NUM_FD_FILES; i++) {
+      sprintf(acPath, "other/fd/d%03lu/f%05lu",
+              (unsigned long)(i % 100), (unsigned long)i);
+      if(bBuffered) {
+         char *pcBuf = malloc(FD_FILE_SIZE);
+         assert(pcBuf != NULL);
+         assert(pread(iFd, pcBuf, FD_FILE_SIZE,
+                      (off_t)(i * FD_FILE_SIZE)) == FD_FILE_SIZE);
+         assert(FT_insertFile(acPath, pcBuf, FD_FILE_SIZE) == SUCCESS);
+         free(pcBuf);
+      }
+      else
+         assert(FT_insertFileFromFd(acPath, iFd, i * FD_FILE_SIZE,
+                                    FD_FILE_SIZE) == SUCCESS);
+   }
+   return Bench_wallMsSince(&sStart);
+}
+
+/* Writes the NUM_FD_FILES files under other/fd to pcSink, with
+   FT_writeFileToFd if bDirect is TRUE, and with FT_getFileContents
+   and write otherwise. Returns the wall clock time it took, in
+   milliseconds. */
+static double Bench_writeToFd(boolean bDirect)
+{
+   char acPath[MAX_PATH];
+   struct timespec sStart;
+   int iFd;
+   size_t i;
+
+   (void)remove(pcSink);
+   iFd = open(pcSink, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+   assert(iFd >= 0);
+   clock_gettime(CLOCK_MONOTONIC, &sStart);
+   for(i = 0; i < NUM_FD_FILES; i++) {
+      sprintf(acPath, "other/fd/d%03lu/f%05lu",
+              (unsigned long)(i % 100), (unsigned long)i);
+      if(bDirect)
+         assert(FT_writeFileToFd(acPath, iFd) == SUCCESS);
+      else
+         assert(write(iFd, FT_getFileContents(acPath), FD_FILE_SIZE) ==
+                FD_FILE_SIZE);
+   }
+   assert(close(iFd) == 0);
+   return Bench_wallMsSince(&sStart);
+}
+
+/* Inserts NUM_FD_FILES files from one source file, reading them into
+   a buffer for FT_insertFile, with FT_insertFileFromFd into owned
+   storage, and mapped, and writes them back out with and without
+   FT_writeFileToFd, the last time from a spill file. Prints how long
+   each took. */
+static void Bench_fdFiles(void)
+{
+   static char acBlock[FD_FILE_SIZE];
+   double dCopied, dDirect;
+   int iFd;
+   size_t i;
+
+   iFd = open(pcSource, O_RDWR | O_CREAT | O_TRUNC, 0600);
+   assert(iFd >= 0);
+   for(i = 0; i < NUM_FD_FILES; i++) {
+      memset(acBlock, (int)(i & 0xff), FD_FILE_SIZE);
+      assert(write(iFd, acBlock, FD_FILE_SIZE) == FD_FILE_SIZE);
+   }
+
+   assert(FT_setContentsMode(FT_CONTENTS_OWNED) == SUCCESS);
+   printf("%d files of %d bytes read into a buffer, then inserted: "
+          "%8.2f ms\n", NUM_FD_FILES, FD_FILE_SIZE,
+          Bench_insertFromFd(iFd, TRUE));
+   dDirect = Bench_writeToFd(TRUE);
+   dCopied = Bench_writeToFd(FALSE);
+   printf("written out with FT_getFileContents and write: %8.2f ms, "
+          "with FT_writeFileToFd: %8.2f ms\n", dCopied, dDirect);
+   assert(FT_rmDir("other/fd") == SUCCESS);
+   printf("%d files read straight into the FT: %8.2f ms\n",
+          NUM_FD_FILES, Bench_insertFromFd(iFd, FALSE));
+   assert(FT_rmDir("other/fd") == SUCCESS);
+   assert(FT_setContentsMode(FT_CONTENTS_MAPPED) == SUCCESS);
+   printf("%d files mapped: %8.2f ms\n", NUM_FD_FILES,
+          Bench_insertFromFd(iFd, FALSE));
+   assert(FT_rmDir("other/fd") == SUCCESS);
+
+   /* all but the last file spilled, and sent from the spill file */
+   assert(FT_setContentsMode(FT_CONTENTS_OWNED) == SUCCESS);
+   assert(FT_setSpill(pcSpill, 0, 0) == SUCCESS);
+   (void)Bench_insertFromFd(iFd, FALSE);
+   dDirect = Bench_writeToFd(TRUE);
+   dCopied = Bench_writeToFd(FALSE);
+   printf("spilled, written out with FT_getFileContents and write: "
+          "%8.2f ms, with FT_writeFileToFd: %8.2f ms\n", dCopied,
+          dDirect);
+   assert(FT_rmDir("other/fd") == SUCCESS);
+   assert(FT_setSpill(NULL, 0, 0) == SUCCESS);
+   assert(close(iFd) == 0);
+   assert(remove(pcSource) == 0);
+   assert(remove(pcSink) == 0);
+}
+
+/* Creates, under pcTree, or removes, if bCreate is FALSE, the
+   NUM_IMPORT_DIRS directories of NUM_IMPORT_FILES files that
+   Bench_importDir imports and Bench_exportDir exports. */
+static void Bench_makeTree(boolean bCreate)
+{
+   static char acBlock[IMPORT_FILE_SIZE];
+   char acPath[MAX_PATH];
+   FILE *psFile;
+   size_t i, j;
+
+   if(bCreate)
+      assert(mkdir(pcTree, 0755) == 0);
+   for(i = 0; i < NUM_IMPORT_DIRS; i++) {
+      sprintf(acPath, "%s/d%lu", pcTree, (unsigned long)i);
+      if(bCreate)
+         assert(mkdir(acPath, 0755) == 0);
+      for(j = 0; j < NUM_IMPORT_FILES; j++) {
+         sprintf(acPath, "%s/d%lu/f%lu", pcTree, (unsigned long)i,
+                 (unsigned long)j);
+         if(!bCreate) {
+            assert(remove(acPath) == 0);
+            continue;
+         }
+         memset(acBlock, (int)((i + j) & 0xff), IMPORT_FILE_SIZE);
+         assert((psFile = fopen(acPath, "wb")) != NULL);
+         assert(fwrite(acBlock, 1, IMPORT_FILE_SIZE, psFile) ==
+                IMPORT_FILE_SIZE);
+         assert(fclose(psFile) == 0);
+      }
+      if(!bCreate) {
+         sprintf(acPath, "%s/d%lu", pcTree, (unsigned long)i);
+         assert(rmdir(acPath) == 0);
+      }
+   }
+   if(!bCreate)
+      assert(rmdir(pcTree) == 0);
+}
+
+/* Imports a real directory tree, already in the page cache, with
+   each of aulImportThreads threads, reporting the rates. */
+static void Bench_importDir(void)
+{
+   size_t ulFiles, ulBytes;
+   double dFilesPerSec, dBytesPerSec;
+   size_t i;
+
+   Bench_makeTree(TRUE);
+   assert(FT_setContentsMode(FT_CONTENTS_OWNED) == SUCCESS);
+   for(i = 0; aulImportThreads[i] != 0; i++) {
+      assert(FT_importDir(pcTree, "other/import", aulImportThreads[i]) ==
+             SUCCESS);
+      assert(FT_importStats(&ulFiles, &ulBytes, &dFilesPerSec,
+                            &dBytesPerSec) == SUCCESS);
+      assert(ulFiles == NUM_IMPORT_DIRS * NUM_IMPORT_FILES);
+      printf("%lu files imported with %lu threads: %10.0f files/s, "
+             "%8.1f MB/s\n", (unsigned long)ulFiles,
+             (unsigned long)aulImportThreads[i], dFilesPerSec,
+             dBytesPerSec / 1e6);
+      assert(FT_rmDir("other/import") == SUCCESS);
+   }
+}
+
+/* Exports the tree Bench_importDir imported with each of
+   aulExportDepths queue depths, through an io_uring and through
+   threads, reporting the rates, and removes it from the FT and the
+   disk. */
+static void Bench_exportDir(void)
+{
+   size_t ulFiles, ulBytes;
+   double dFilesPerSec, dBytesPerSec;
+   boolean bRing;
+   size_t i;
+   int iRing;
+
+   assert(FT_importDir(pcTree, "other/import", 1) == SUCCESS);
+   Bench_makeTree(FALSE);
+   for(i = 0; aulExportDepths[i] != 0; i++)
+      for(iRing = 1; iRing >= 0; iRing--) {
+         assert(FT_setExport(aulExportDepths[i], (boolean)iRing) ==
+                SUCCESS);
+         assert(FT_exportDir("other/import", pcTree) == SUCCESS);
+         assert(FT_exportStats(&ulFiles, &ulBytes, &dFilesPerSec,
+                               &dBytesPerSec, &bRing) == SUCCESS);
+         printf("%lu files exported %s, %4lu in flight: %10.0f files/s, "
+                "%8.1f MB/s\n", (unsigned long)ulFiles,
+                bRing ? "through an io_uring" : "through threads",
+                (unsigned long)aulExportDepths[i], dFilesPerSec,
+                dBytesPerSec / 1e6);
+         Bench_makeTree(FALSE);
+      }
+   assert(FT_rmDir("other/import") == SUCCESS);
+}
+
+/* Counts the call in the size_t pvExtra. */
+static void Bench_countMatch(const char *pcPath, boolean bIsFile,
+                             void *pvExtra)
+{
+   (void)pcPath;
+   (void)bIsFile;
+   (*(size_t *)pvExtra)++;
+}
+
+/* Matches each of apcGlobs with FT_glob, and with FT_toString and
+   fnmatch on each line, reporting both times. */
+static void Bench_glob(void)
+{
+   size_t ulGlobbed, ulScanned;
+   double dGlob;
+   clock_t ctStart;
+   size_t i;
+
+   for(i = 0; apcGlobs[i] != NULL; i++) {
+      char *pcDump, *pcLine;
+      ulGlobbed = 0;
+      ctStart = clock();
+      assert(FT_glob(apcGlobs[i], Bench_countMatch, &ulGlobbed) ==
+             SUCCESS);
+      dGlob = Bench_msSince(ctStart);
+
+      /* fnmatch has no "**", which matches one level here */
+      ulScanned = 0;
+      ctStart = clock();
+      pcDump = FT_toString();
+      assert(pcDump != NULL);
+      for(pcLine = strtok(pcDump, "\n"); pcLine != NULL;
+          pcLine = strtok(NULL, "\n"))
+         if(fnmatch(apcGlobs[i], pcLine, FNM_PATHNAME) == 0)
+            ulScanned++;
+      free(pcDump);
+      assert(ulScanned == ulGlobbed);
+      printf("%-20s %6lu matches: FT_glob %8.3f ms, "
+             "FT_toString and fnmatch %8.2f ms\n", apcGlobs[i],
+             (unsigned long)ulGlobbed, dGlob, Bench_msSince(ctStart));
+   }
+}
+
+/* Calls FT_toString NUM_WALKS times, and returns the CPU time each
+   call took on average, in milliseconds. */
+static double Bench_walk(void)
+{
+   clock_t ctStart = clock();
+   int i;
+   for(i = 0; i < NUM_WALKS; i++) {
+      char *pcDump = FT_toString();
+      assert(pcDump != NULL);
+      free(pcDump);
+   }
+   return Bench_msSince(ctStart) / NUM_WALKS;
+}
+
+/* Calls FT_stat on each of the ulLength second-generation files in
+   pulOrder, and returns the CPU time that took, in milliseconds. */
+static double Bench_lookup(size_t *pulOrder, size_t ulLength)
+{
+   char acPath[MAX_PATH];
+   boolean bIsFile;
+   size_t ulSize;
+   clock_t ctStart = clock();
+   size_t i;
+   for(i = 0; i < ulLength; i++) {
+      Bench_filePath(acPath, pulOrder[i], 1);
+      assert(FT_stat(acPath, &bIsFile, &ulSize) == SUCCESS);
+   }
+   return Bench_msSince(ctStart);
+}
+
+/* Empties the FT, then inserts the ulLength second-generation files in
+   pulOrder, and returns the CPU time that took, in milliseconds. */
+static double Bench_replay(size_t *pulOrder, size_t ulLength)
+{
+   char acPath[MAX_PATH];
+   clock_t ctStart;
+   size_t i;
+   assert(FT_destroy() == SUCCESS);
+   assert(FT_init() == SUCCESS);
+   ctStart = clock();
+   for(i = 0; i < ulLength; i++) {
+      Bench_filePath(acPath, pulOrder[i], 1);
+      assert(FT_insertFile(acPath, acData, pulOrder[i] % MAX_DATA) ==
+             SUCCESS);
+   }
+   return Bench_msSince(ctStart);
+}
+
+/* Empties the FT, then inserts the ulLength second-generation files in
+   pulOrder with their mutations journaled in groups of ulBatch (none
+   if ulBatch is 0), and returns the wall-clock time that took,
+   syncing the journal included, in milliseconds. */
+static double Bench_journal(size_t *pulOrder, size_t ulLength,
+                            size_t ulBatch)
+{
+   char acPath[MAX_PATH];
+   struct timespec sStart;
+   double dTime;
+   size_t i;
+   assert(FT_destroy() == SUCCESS);
+   assert(FT_init() == SUCCESS);
+   (void)remove(pcJournal);
+   if(ulBatch != 0)
+      assert(FT_openJournal(pcJournal, ulBatch) == SUCCESS);
+   clock_gettime(CLOCK_MONOTONIC, &sStart);
+   for(i = 0; i < ulLength; i++) {
+      Bench_filePath(acPath, pulOrder[i], 1);
+      assert(FT_insertFile(acPath, acData, pulOrder[i] % MAX_DATA) ==
+             SUCCESS);
+   }
+   assert(FT_syncJournal() == SUCCESS);
+   dTime = Bench_wallMsSince(&sStart);
+   assert(FT_closeJournal() == SUCCESS);
+   return dTime;
+}
+
+/* Inserts files of generation 2, numbered from *pulNext on, timing
+   each insertion, until the background save ends if bSaving is TRUE,
+   or else *pulOps of them. Advances *pulNext past them, sets *pulOps
+   to how many there were and *pdMean to their mean time, and returns
+   the longest one's, in milliseconds of wall-clock time. */
+static double Bench_writer(boolean bSaving, size_t *pulNext,
+                           size_t *pulOps, double *pdMean)
+{
+   char acPath[MAX_PATH];
+   double dMax = 0.0, dTotal = 0.0;
+   size_t ulOps = 0;
+   size_t ulSize;
+   int iStatus;
+   for(;;) {
+      struct timespec sStart;
+      double dTime;
+      if(bSaving) {
+         if(FT_pollSave(FALSE, &iStatus, &ulSize)) {
+            assert(iStatus == SUCCESS);
+            break;
+         }
+      }
+      else if(ulOps == *pulOps)
+         break;
+      Bench_filePath(acPath, (*pulNext)++, 2);
+      clock_gettime(CLOCK_MONOTONIC, &sStart);
+      assert(FT_insertFile(acPath, acData, 0) == SUCCESS);
+      dTime = Bench_wallMsSince(&sStart);
+      dTotal += dTime;
+      if(dTime > dMax)
+         dMax = dTime;
+      ulOps++;
+   }
+   *pulOps = ulOps;
+   *pdMean = ulOps == 0 ? 0.0 : dTotal / ulOps;
+   return dMax;
+}
+
+/* Measures FT_toString and FT_stat throughput on a tree fragmented by
+   interleaved insertions and removals, before and after FT_compact,
+   and after FT_freeze. Then compares rebuilding the tree by replaying
+   its insertions with FT_save and FT_load, and with mapping the saved
+   tree with FT_open, measures the throughput of insertions with and
+   without a journal, the latency of insertions while the tree is saved
+   in the background, and the cost of removals while a snapshot shares
+   the tree, of diffing a snapshot with the tree, of moving whole
+   directories, of copying them, of detaching them and attaching them
+   to another tree, of merging into them, and of keeping file contents
+   deduplicated, owned, chunked, and compressed. Prints the results to
+   stdout. Returns 0. */
+int main(void) {
+   static size_t aulOrder[NUM_FILES];
+   char acPath[MAX_PATH];
+   Snapshot_T oSSnapshot;
+   Subtree_T oTSubtree;
+   struct timespec sStart;
+   size_t ulNext = 0, ulOps;
+   size_t ulDirs, ulFiles, ulBytes;
+   size_t ulExclusive, ulShared;
+   size_t ulInterned, ulHits, ulStored, ulSaved;
+   double dMax, dMean;
+   clock_t ctStart;
+   double dWalk, dLookup, dMemory;
+   size_t i;
+
+   srand(217);
+   for(i = 0; i < MAX_DATA; i++)
+      acData[i] = (char)('a' + i % 26);
+   assert(FT_init() == SUCCESS);
+
+   /* insert a first generation of files in random order, then a
+      second generation, and remove the first: the survivors end up
+      scattered over the pools and arenas */
+   for(i = 0; i < NUM_FILES; i++)
+      aulOrder[i] = i;
+   Bench_shuffle(aulOrder, NUM_FILES);
+   for(i = 0; i < NUM_FILES; i++) {
+      Bench_filePath(acPath, aulOrder[i], 0);
+      assert(FT_insertFile(acPath, NULL, 0) == SUCCESS);
+   }
+   Bench_shuffle(aulOrder, NUM_FILES);
+   for(i = 0; i < NUM_FILES; i++) {
+      Bench_filePath(acPath, aulOrder[i], 1);
+      assert(FT_insertFile(acPath, acData, aulOrder[i] % MAX_DATA) ==
+             SUCCESS);
+      Bench_filePath(acPath, aulOrder[(i + NUM_FILES / 2) % NUM_FILES],
+                     0);
+      assert(FT_rmFile(acPath) == SUCCESS);
+   }
+   Bench_shuffle(aulOrder, NUM_FILES);
+
+   printf("%d files in %d directories\n", NUM_FILES, NUM_DIRS);
+
+   dWalk = Bench_walk();
+   dLookup = Bench_lookup(aulOrder, NUM_FILES);
+   printf("before FT_compact: FT_toString %8.2f ms, "
+          "%d FT_stat %8.2f ms\n", dWalk, NUM_FILES, dLookup);
+
+   ctStart = clock();
+   assert(FT_compact() == SUCCESS);
+   printf("FT_compact:        %8.2f ms\n", Bench_msSince(ctStart));
+
+   dWalk = Bench_walk();
+   dLookup = Bench_lookup(aulOrder, NUM_FILES);
+   printf("after FT_compact:  FT_toString %8.2f ms, "
+          "%d FT_stat %8.2f ms\n", dWalk, NUM_FILES, dLookup);
+   Bench_glob();
+
+   ctStart = clock();
+   assert(FT_freeze() == SUCCESS);
+   printf("FT_freeze:         %8.2f ms\n", Bench_msSince(ctStart));
+
+   dWalk = Bench_walk();
+   dLookup = Bench_lookup(aulOrder, NUM_FILES);
+   printf("after FT_freeze:   FT_toString %8.2f ms, "
+          "%d FT_stat %8.2f ms\n", dWalk, NUM_FILES, dLookup);
+
+   printf("replay of %d FT_insertFile: %8.2f ms\n", NUM_FILES,
+          Bench_replay(aulOrder, NUM_FILES));
+   ctStart = clock();
+   assert(FT_save(pcImage) == SUCCESS);
+   printf("FT_save:           %8.2f ms\n", Bench_msSince(ctStart));
+   assert(FT_destroy() == SUCCESS);
+   assert(FT_init() == SUCCESS);
+   ctStart = clock();
+   assert(FT_load(pcImage) == SUCCESS);
+   printf("FT_load:           %8.2f ms\n", Bench_msSince(ctStart));
+   ctStart = clock();
+   assert(FT_insertDir("root/thawed") == SUCCESS);
+   printf("first FT_insertDir after FT_load (thaws): %8.2f ms\n",
+          Bench_msSince(ctStart));
+   assert(FT_destroy() == SUCCESS);
+   assert(FT_init() == SUCCESS);
+   ctStart = clock();
+   assert(FT_open(pcImage) == SUCCESS);
+   printf("FT_open:           %8.2f ms\n", Bench_msSince(ctStart));
+   dWalk = Bench_walk();
+   dLookup = Bench_lookup(aulOrder, NUM_FILES);
+   printf("after FT_open:     FT_toString %8.2f ms, "
+          "%d FT_stat %8.2f ms\n", dWalk, NUM_FILES, dLookup);
+   assert(remove(pcImage) == 0);
+
+   /* a group of one syncs every insertion, so it gets fewer of them */
+   dMemory = Bench_journal(aulOrder, NUM_FILES, 0);
+   printf("no journal:        %8.0f FT_insertFile/s\n",
+          NUM_FILES / dMemory * 1000.0);
+   for(i = 0; aulBatches[i] != 0; i++) {
+      size_t ulLength = NUM_FILES / (aulBatches[i] == 1 ? 100 : 1);
+      double dJournal = Bench_journal(aulOrder, ulLength, aulBatches[i]);
+      printf("journal, groups of %4lu: %8.0f FT_insertFile/s "
+             "(%5.2fx the time)\n", (unsigned long)aulBatches[i],
+             ulLength / dJournal * 1000.0,
+             dJournal / ulLength / (dMemory / NUM_FILES));
+   }
+   assert(remove(pcJournal) == 0);
+
+   /* a synchronous save stalls the writer for all of it; a background
+      one for the fork, and then for copy-on-write faults */
+   clock_gettime(CLOCK_MONOTONIC, &sStart);
+   assert(FT_save(pcImage) == SUCCESS);
+   printf("FT_save stalls the writer:        %8.2f ms\n",
+          Bench_wallMsSince(&sStart));
+   clock_gettime(CLOCK_MONOTONIC, &sStart);
+   assert(FT_saveInBackground(pcImage) == SUCCESS);
+   printf("FT_saveInBackground (fork):       %8.2f ms\n",
+          Bench_wallMsSince(&sStart));
+   dMax = Bench_writer(TRUE, &ulNext, &ulOps, &dMean);
+   printf("%8lu FT_insertFile during it:   max %8.4f ms, "
+          "mean %8.4f ms\n", (unsigned long)ulOps, dMax, dMean);
+   dMax = Bench_writer(FALSE, &ulNext, &ulOps, &dMean);
+   printf("%8lu FT_insertFile after it:    max %8.4f ms, "
+          "mean %8.4f ms\n", (unsigned long)ulOps, dMax, dMean);
+   assert(remove(pcImage) == 0);
+
+   /* every removal copies the path down to the removed file, once */
+   ctStart = clock();
+   assert(FT_snapshot(&oSSnapshot) == SUCCESS);
+   printf("FT_snapshot:       %8.4f ms\n", Bench_msSince(ctStart));
+   for(i = 0; i < 2; i++) {
+      size_t j;
+      ctStart = clock();
+      for(j = i * NUM_FILES / 2; j < (i + 1) * NUM_FILES / 2; j++) {
+         Bench_filePath(acPath, aulOrder[j], 1);
+         assert(FT_rmFile(acPath) == SUCCESS);
+      }
+      printf("%d FT_rmFile %s: %8.2f ms\n", NUM_FILES / 2,
+             i == 0 ? "sharing with a snapshot" : "after FT_freeSnapshot",
+             Bench_msSince(ctStart));
+      if(i == 0) {
+         assert(FT_snapshotContainsFile(oSSnapshot, acPath) == TRUE);
+         FT_freeSnapshot(oSSnapshot);
+      }
+   }
+
+   /* a diff descends only into directories whose hashes differ,
+      where comparing the trees' strings walks all of both */
+   assert(FT_snapshot(&oSSnapshot) == SUCCESS);
+   for(i = 0; i < 8; i++) {
+      sprintf(acPath, "root/d%04lu/changed", (unsigned long)(i * 251));
+      assert(FT_insertFile(acPath, acData, MAX_DATA) == SUCCESS);
+   }
+   ulOps = 0;
+   ctStart = clock();
+   assert(FT_diff(oSSnapshot, NULL, Bench_countDiff, &ulOps) == SUCCESS);
+   printf("FT_diff of 8 changes: %8.4f ms\n", Bench_msSince(ctStart));
+   assert(ulOps == 8);
+   ctStart = clock();
+   {
+      char *pcOld = FT_snapshotToString(oSSnapshot);
+      char *pcNew = FT_toString();
+      assert(pcOld != NULL && pcNew != NULL);
+      assert(strcmp(pcOld, pcNew) != 0);
+      free(pcOld);
+      free(pcNew);
+   }
+   printf("FT_toString of both and strcmp: %8.2f ms\n",
+          Bench_msSince(ctStart));
+   FT_freeSnapshot(oSSnapshot);
+   for(i = 0; i < 8; i++) {
+      sprintf(acPath, "root/d%04lu/changed", (unsigned long)(i * 251));
+      assert(FT_rmFile(acPath) == SUCCESS);
+   }
+
+   /* a move relinks each directory, whatever it holds */
+   assert(FT_du("root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+   assert(FT_insertDir("root/archive") == SUCCESS);
+   ctStart = clock();
+   for(i = 0; i < NUM_DIRS; i++) {
+      char acTo[MAX_PATH];
+      sprintf(acPath, "root/d%04lu", (unsigned long)i);
+      sprintf(acTo, "root/archive/d%04lu", (unsigned long)i);
+      assert(FT_move(acPath, acTo) == SUCCESS);
+   }
+   printf("%d FT_move of %lu files in all: %8.2f ms\n", NUM_DIRS,
+          (unsigned long)ulFiles, Bench_msSince(ctStart));
+   ctStart = clock();
+   assert(FT_move("root/archive", "root/moved") == SUCCESS);
+   printf("FT_move of the directory holding them: %8.4f ms\n",
+          Bench_msSince(ctStart));
+
+   /* copies share the whole directory until they are modified */
+   assert(FT_usage(&ulExclusive, &ulShared) == SUCCESS);
+   printf("FT_usage before copies: %lu bytes exclusive\n",
+          (unsigned long)ulExclusive);
+   ctStart = clock();
+   for(i = 0; i < NUM_COPIES; i++) {
+      sprintf(acPath, "root/copy%04lu", (unsigned long)i);
+      assert(FT_copy("root/moved", acPath) == SUCCESS);
+   }
+   printf("%d FT_copy of %lu files each: %8.2f ms\n", NUM_COPIES,
+          (unsigned long)ulFiles, Bench_msSince(ctStart));
+   assert(FT_usage(&ulExclusive, &ulShared) == SUCCESS);
+   printf("FT_usage after copies: %lu bytes exclusive, %lu shared\n",
+          (unsigned long)ulExclusive, (unsigned long)ulShared);
+   ctStart = clock();
+   for(i = 0; i < NUM_COPIES; i++) {
+      sprintf(acPath, "root/copy%04lu/d0000/new", (unsigned long)i);
+      assert(FT_insertFile(acPath, acData, MAX_DATA) == SUCCESS);
+   }
+   printf("%d FT_insertFile, one into each copy: %8.2f ms\n",
+          NUM_COPIES, Bench_msSince(ctStart));
+   assert(FT_usage(&ulExclusive, &ulShared) == SUCCESS);
+   printf("FT_usage after that: %lu bytes exclusive, %lu shared\n",
+          (unsigned long)ulExclusive, (unsigned long)ulShared);
+
+   /* detaching and attaching relink the directory, whatever it holds */
+   ctStart = clock();
+   assert(FT_detach("root/moved", &oTSubtree) == SUCCESS);
+   printf("FT_detach of %lu files: %8.4f ms\n", (unsigned long)ulFiles,
+          Bench_msSince(ctStart));
+   assert(FT_destroy() == SUCCESS);
+   assert(FT_init() == SUCCESS);
+   assert(FT_insertDir("other") == SUCCESS);
+   ctStart = clock();
+   assert(FT_attach("other/attached", oTSubtree) == SUCCESS);
+   printf("FT_attach of them to another FT: %8.4f ms\n",
+          Bench_msSince(ctStart));
+
+   /* a merge walks only the directories both sides have, and grafts
+      in the rest whole */
+   for(i = 0; i < 16; i++) {
+      sprintf(acPath, "other/overlay/d%04lu/extra", (unsigned long)i);
+      assert(FT_insertFile(acPath, acData, MAX_DATA) == SUCCESS);
+   }
+   assert(FT_detach("other/overlay", &oTSubtree) == SUCCESS);
+   ctStart = clock();
+   assert(FT_merge("other/attached", oTSubtree, FT_MERGE_KEEP) ==
+          SUCCESS);
+   printf("FT_merge of 16 files into %lu: %8.4f ms\n",
+          (unsigned long)ulFiles, Bench_msSince(ctStart));
+   assert(FT_detach("other/attached", &oTSubtree) == SUCCESS);
+   assert(FT_insertDir("other/empty") == SUCCESS);
+   ctStart = clock();
+   assert(FT_merge("other/empty", oTSubtree, FT_MERGE_KEEP) == SUCCESS);
+   printf("FT_merge of %lu files into an empty directory: %8.4f ms\n",
+          (unsigned long)ulFiles + 16, Bench_msSince(ctStart));
+
+   /* files whose contents repeat a few blobs, as a client's own
+      copies that the FT then keeps once */
+   for(i = 0; i < NUM_BLOBS * BLOB_SIZE; i++)
+      acBlobs[i / BLOB_SIZE][i % BLOB_SIZE] = (char)rand();
+   assert(FT_setContentsMode(FT_CONTENTS_DEDUPLICATED) == SUCCESS);
+   ctStart = clock();
+   for(i = 0; i < NUM_DEDUP; i++) {
+      sprintf(acPath, "other/dedup/d%03lu/f%06lu",
+              (unsigned long)(i % 100), (unsigned long)i);
+      assert(FT_insertFile(acPath, acBlobs[rand() % NUM_BLOBS],
+                           BLOB_SIZE) == SUCCESS);
+   }
+   printf("%d FT_insertFile of %d-byte contents, deduplicated: "
+          "%8.2f ms\n", NUM_DEDUP, BLOB_SIZE, Bench_msSince(ctStart));
+   assert(FT_contentsStats(&ulInterned, &ulHits, &ulStored, &ulSaved) ==
+          SUCCESS);
+   printf("dedup hit rate %5.1f%%: %lu bytes stored, %lu saved\n",
+          100.0 * (double)ulHits / (double)ulInterned,
+          (unsigned long)ulStored, (unsigned long)ulSaved);
+   ctStart = clock();
+   assert(FT_rmDir("other/dedup") == SUCCESS);
+   printf("FT_rmDir of them: %8.2f ms\n", Bench_msSince(ctStart));
+
+   Bench_smallFiles(FALSE);
+   Bench_smallFiles(TRUE);
+   Bench_growth();
+   Bench_compression();
+   Bench_spill();
+   Bench_fdFiles();
+   Bench_importDir();
+   Bench_exportDir();
+
+   assert(FT_destroy() == SUCCESS);
+   return 0;
+}
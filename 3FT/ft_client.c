@@ -3,13 +3,56 @@
 /* Author: Christopher Moretti                                        */
 /*--------------------------------------------------------------------*/
 
+/* for fileno and symlink under a strict -std */
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include "ft.h"
 
+/* Appends pcPath to the string pvExtra, on a line of its own, after
+   '+', '-', or '~' as iChange is FT_DIFF_ADDED, FT_DIFF_REMOVED, or
+   FT_DIFF_CHANGED. */
+static void appendDiff(const char *pcPath, int iChange, void *pvExtra) {
+  char *pcDiff = pvExtra;
+  size_t ulLength = strlen(pcDiff);
+  pcDiff[ulLength] = iChange == FT_DIFF_ADDED ? '+' :
+                     iChange == FT_DIFF_REMOVED ? '-' : '~';
+  strcpy(pcDiff + ulLength + 1, pcPath);
+  strcat(pcDiff, "\n");
+}
+
+/* Appends pcPath to the string pvExtra, on a line of its own, after
+   'f' if bIsFile is TRUE, and 'd' if not. */
+static void appendMatch(const char *pcPath, boolean bIsFile,
+                        void *pvExtra) {
+  char *pcMatches = pvExtra;
+  size_t ulLength = strlen(pcMatches);
+  pcMatches[ulLength] = bIsFile ? 'f' : 'd';
+  strcpy(pcMatches + ulLength + 1, pcPath);
+  strcat(pcMatches, "\n");
+}
+
+/* Checks that the file named pcFile holds exactly the ulLength bytes
+   at pcBytes, and removes it. */
+static void checkAndRemove(const char *pcFile, const char *pcBytes,
+                           size_t ulLength) {
+  FILE *psFile;
+  size_t l;
+  assert((psFile = fopen(pcFile, "rb")) != NULL);
+  for (l = 0; l < ulLength; l++)
+    assert(fgetc(psFile) == (unsigned char)pcBytes[l]);
+  assert(fgetc(psFile) == EOF);
+  assert(fclose(psFile) == 0);
+  assert(remove(pcFile) == 0);
+}
+
 /* Tests the FT implementation with an assortment of checks.
    Prints the status of the data structure along the way to stderr.
    Returns 0. */
@@ -18,7 +61,21 @@ int main(void) {
   char* temp;
   boolean bIsFile;
   size_t l;
+  size_t ulDirs, ulFiles, ulBytes;
+  FILE *psFile;
+  Snapshot_T oSFirst, oSSecond;
+  Subtree_T oTFirst, oTSecond;
+  int iStatus;
   char arr[ARRLEN];
+  char acSame[] = "x";
+  char acBlob[] = "blob";
+  char acPath[32];
+  void *pvStored;
+  size_t ulInterned, ulHits, ulStored, ulSaved;
+  size_t ulOriginal, ulCompressed, ulMisses;
+  double dCompressMs, dDecompressMs;
+  size_t ulResident, ulOnDisk, ulPageIns, ulPageOuts, ulPagedBefore;
+  double dFilesPerSec, dBytesPerSec;
   arr[0] = '\0';
 
   /* Before the data structure is initialized:
@@ -33,7 +90,50 @@ int main(void) {
          INITIALIZATION_ERROR);
   assert(FT_containsFile("1root/2child/3gkid/4ggk") == FALSE);
   assert(FT_rmFile("1root/2child/3gkid/4ggk") == INITIALIZATION_ERROR);
+  assert(FT_move("1root/2child", "1root/3child") == INITIALIZATION_ERROR);
+  assert(FT_copy("1root/2child", "1root/3child") == INITIALIZATION_ERROR);
+  assert(FT_usage(&ulDirs, &ulBytes) == INITIALIZATION_ERROR);
+  assert(FT_detach("1root/2child", &oTFirst) == INITIALIZATION_ERROR);
+  assert(FT_diff(NULL, NULL, appendDiff, arr) == INITIALIZATION_ERROR);
+  assert(FT_setContentsMode(FT_CONTENTS_DEDUPLICATED) ==
+         INITIALIZATION_ERROR);
+  assert(FT_contentsStats(&ulInterned, &ulHits, &ulStored, &ulSaved) ==
+         INITIALIZATION_ERROR);
+  assert(FT_readAt("1root/a", 0, arr, 1, &l) == INITIALIZATION_ERROR);
+  assert(FT_writeAt("1root/a", 0, "x", 1) == INITIALIZATION_ERROR);
+  assert(FT_append("1root/a", "x", 1) == INITIALIZATION_ERROR);
+  assert(FT_setCompression(1, 1) == INITIALIZATION_ERROR);
+  assert(FT_compressionStats(&ulOriginal, &ulCompressed, &ulHits,
+                             &ulMisses, &dCompressMs, &dDecompressMs) ==
+         INITIALIZATION_ERROR);
+  assert(FT_setSpill("ft_client.spill", 1, 1) == INITIALIZATION_ERROR);
+  assert(FT_spillStats(&ulResident, &ulOnDisk, &ulPageIns,
+                       &ulPageOuts) == INITIALIZATION_ERROR);
+  assert(FT_insertFileFromFd("1root/a", 0, 0, 1) == INITIALIZATION_ERROR);
+  assert(FT_writeFileToFd("1root/a", 1) == INITIALIZATION_ERROR);
+  assert(FT_importDir(".", "1root/a", 1) == INITIALIZATION_ERROR);
+  assert(FT_importStats(&ulFiles, &ulBytes, &dFilesPerSec,
+                        &dBytesPerSec) == INITIALIZATION_ERROR);
+  assert(FT_setExport(1, FALSE) == INITIALIZATION_ERROR);
+  assert(FT_exportDir("1root", "ft_client.copy") == INITIALIZATION_ERROR);
+  assert(FT_exportStats(&ulFiles, &ulBytes, &dFilesPerSec, &dBytesPerSec,
+                        &bIsFile) == INITIALIZATION_ERROR);
+  assert(FT_glob("1root/**", appendMatch, arr) == INITIALIZATION_ERROR);
   assert((temp = FT_toString()) == NULL);
+  assert(FT_compact() == INITIALIZATION_ERROR);
+  assert(FT_freeze() == INITIALIZATION_ERROR);
+  assert(FT_save("ft_client.img") == INITIALIZATION_ERROR);
+  assert(FT_load("ft_client.img") == INITIALIZATION_ERROR);
+  assert(FT_open("ft_client.img") == INITIALIZATION_ERROR);
+  assert(FT_saveInBackground("ft_client.img") == INITIALIZATION_ERROR);
+  assert(FT_pollSave(TRUE, &iStatus, &l) == TRUE);
+  assert(iStatus == INITIALIZATION_ERROR);
+  assert(FT_openJournal("ft_client.log", 1) == INITIALIZATION_ERROR);
+  assert(FT_syncJournal() == INITIALIZATION_ERROR);
+  assert(FT_closeJournal() == INITIALIZATION_ERROR);
+  assert(FT_checkpoint("ft_client.img") == INITIALIZATION_ERROR);
+  assert(FT_recover(NULL, "ft_client.log") == INITIALIZATION_ERROR);
+  assert(FT_snapshot(&oSFirst) == INITIALIZATION_ERROR);
   assert(FT_destroy() == INITIALIZATION_ERROR);
 
   /* After initialization, the data structure is empty, so
@@ -46,6 +146,7 @@ int main(void) {
   assert((temp = FT_toString()) != NULL);
   assert(!strcmp(temp,""));
   free(temp);
+  assert(FT_compact() == SUCCESS);
 
   /* A valid path must not:
      * be the empty string
@@ -122,6 +223,27 @@ int main(void) {
          SUCCESS);
   assert(FT_containsDir("1root/2child/2child/2child/2child") == FALSE);
   assert(FT_containsFile("1root/2child/2child/2child/2child") == TRUE);
+
+  /* compacting relocates every node but changes nothing visible */
+  assert(FT_rmDir("1root/2ok/3yes") == SUCCESS);
+  assert(FT_insertDir("1root/2ok/3yes/4indeed") == SUCCESS);
+  assert(FT_compact() == SUCCESS);
+  assert(FT_containsDir("1root/2ok/3yes/4indeed") == TRUE);
+  assert(FT_containsFile("1root/2third") == TRUE);
+  assert(FT_insertDir("1root/2ok/3yes/4indeed") == ALREADY_IN_TREE);
+
+  /* but it leaves nodes shared with snapshots, copies, or detached
+     subtrees where they are */
+  assert(FT_snapshot(&oSFirst) == SUCCESS);
+  assert(FT_compact() == NOT_COMPACTED);
+  FT_freeSnapshot(oSFirst);
+  assert(FT_copy("1root/2ok", "1root/2copy") == SUCCESS);
+  assert(FT_compact() == NOT_COMPACTED);
+  assert(FT_rmDir("1root/2copy") == SUCCESS);
+  assert(FT_detach("1root/2ok/3yes", &oTFirst) == SUCCESS);
+  assert(FT_compact() == NOT_COMPACTED);
+  assert(FT_attach("1root/2ok/3yes", oTFirst) == SUCCESS);
+  assert(FT_compact() == SUCCESS);
   assert((temp = FT_toString()) != NULL);
   fprintf(stderr, "Checkpoint 2:\n%s\n", temp);
   free(temp);
@@ -204,6 +326,819 @@ int main(void) {
   assert(!strcmp(temp,""));
   free(temp);
 
+  /* du reports the totals for a whole subtree, and they are kept up
+     to date by insertions, removals, and content replacements */
+  assert(FT_insertFile("1root/a/f1", "abc", strlen("abc")+1) == SUCCESS);
+  assert(FT_insertFile("1root/a/b/f2", "hello", strlen("hello")+1) ==
+         SUCCESS);
+  assert(FT_insertDir("1root/a/c") == SUCCESS);
+  assert(FT_du("1root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 4 && ulFiles == 2 && ulBytes == 10);
+  assert(FT_du("1root/a/b", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 1 && ulFiles == 1 && ulBytes == 6);
+  assert(FT_du("1root/a/f1", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 0 && ulFiles == 1 && ulBytes == 4);
+  assert(!strcmp(FT_replaceFileContents("1root/a/b/f2", "hi",
+                                        strlen("hi")+1), "hello"));
+  assert(FT_du("1root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 4 && ulFiles == 2 && ulBytes == 7);
+  assert(FT_rmFile("1root/a/f1") == SUCCESS);
+  assert(FT_du("1root/a", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 3 && ulFiles == 1 && ulBytes == 3);
+  assert(FT_rmDir("1root/a/b") == SUCCESS);
+  assert(FT_du("1root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 3 && ulFiles == 0 && ulBytes == 0);
+  assert(FT_du("1root/a/b", &ulDirs, &ulFiles, &ulBytes) ==
+         NO_SUCH_PATH);
+  assert(ulDirs == 3 && ulFiles == 0 && ulBytes == 0);
+
+  /* a move relinks a whole subtree under its new name, totals and
+     all, leaving anything sharing the old tree as it was */
+  assert(FT_insertFile("1root/a/b/f2", "hello", strlen("hello")+1) ==
+         SUCCESS);
+  assert(FT_insertDir("1root/c") == SUCCESS);
+  assert(FT_snapshot(&oSFirst) == SUCCESS);
+  assert(FT_move("1root/a", "1root/c/a2") == SUCCESS);
+  assert(FT_containsDir("1root/a") == FALSE);
+  assert(!strcmp(FT_getFileContents("1root/c/a2/b/f2"), "hello"));
+  assert(FT_du("1root/c", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 4 && ulFiles == 1 && ulBytes == 6);
+  assert(FT_snapshotContainsFile(oSFirst, "1root/a/b/f2") == TRUE);
+  FT_freeSnapshot(oSFirst);
+  assert(FT_move("1root/c/a2/b/f2", "1root/f2") == SUCCESS);
+  assert(FT_move("1root/f2", "1root/c/a2/b/f2") == SUCCESS);
+  assert(FT_move("1root/c/a2", "1root/c/a2/b/a3") == CONFLICTING_PATH);
+  assert(FT_move("1root/c/a2", "1root/c/a2") == ALREADY_IN_TREE);
+  assert(FT_move("1root/c/a2", "1root/c") == ALREADY_IN_TREE);
+  assert(FT_move("1root", "1root/c/r") == CONFLICTING_PATH);
+  assert(FT_move("1root/c/a2", "2root/a") == CONFLICTING_PATH);
+  assert(FT_move("1root/c/a2", "1root/x/a") == NO_SUCH_PATH);
+  assert(FT_move("1root/x", "1root/y") == NO_SUCH_PATH);
+  assert(FT_move("1root/c/a2", "1root/c/a2/b/f2/a") == CONFLICTING_PATH);
+  assert(FT_move("1root/c", "1root/c/a2/b/f2/a") == CONFLICTING_PATH);
+  assert(FT_insertFile("1root/g", NULL, 0) == SUCCESS);
+  assert(FT_move("1root/c/a2", "1root/g/a") == NOT_A_DIRECTORY);
+  assert(FT_move("1root/c/a2", "1root/c//a") == BAD_PATH);
+  assert(FT_move("1root/c/a2", "1root/a") == SUCCESS);
+  assert(FT_rmDir("1root/c") == SUCCESS);
+  assert(FT_rmFile("1root/g") == SUCCESS);
+  assert(FT_rmDir("1root/a/b") == SUCCESS);
+  assert(FT_du("1root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 3 && ulFiles == 0 && ulBytes == 0);
+
+  /* a copy shares everything with the original until either side is
+     modified, and then only what is modified is copied */
+  assert(FT_insertFile("1root/a/b/f2", "hello", strlen("hello")+1) ==
+         SUCCESS);
+  assert(FT_usage(&ulDirs, &ulBytes) == SUCCESS);
+  assert(ulDirs > 0 && ulBytes == 0);
+  assert(FT_copy("1root/a", "1root/t1") == SUCCESS);
+  assert(FT_usage(&ulFiles, &ulBytes) == SUCCESS);
+  assert(ulBytes > 0 && ulFiles + ulBytes < 2 * ulDirs);
+  assert(FT_getFileContents("1root/t1/b/f2") ==
+         FT_getFileContents("1root/a/b/f2"));
+  assert(FT_du("1root/t1", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 3 && ulFiles == 1 && ulBytes == 6);
+  assert(!strcmp(FT_replaceFileContents("1root/t1/b/f2", "bye",
+                                        strlen("bye")+1), "hello"));
+  assert(!strcmp(FT_getFileContents("1root/a/b/f2"), "hello"));
+  assert(FT_insertDir("1root/a/b/new") == SUCCESS);
+  assert(FT_containsDir("1root/t1/b/new") == FALSE);
+  assert(FT_du("1root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 8 && ulFiles == 2 && ulBytes == 10);
+  assert(FT_copy("1root/a", "1root/a") == ALREADY_IN_TREE);
+  assert(FT_copy("1root/a", "1root/a/b/a") == CONFLICTING_PATH);
+  assert(FT_copy("1root/x", "1root/y") == NO_SUCH_PATH);
+  assert(FT_rmDir("1root/t1") == SUCCESS);
+  assert(FT_usage(&ulDirs, &ulBytes) == SUCCESS);
+  assert(ulBytes == 0);
+  assert(FT_rmDir("1root/a/b") == SUCCESS);
+
+  /* a detached subtree can be attached anywhere, under any name, even
+     after the FT it came from is destroyed */
+  assert(FT_insertFile("1root/a/b/f2", "hello", strlen("hello")+1) ==
+         SUCCESS);
+  assert(FT_detach("1root/a/b", &oTFirst) == SUCCESS);
+  assert(FT_containsDir("1root/a/b") == FALSE);
+  assert(FT_du("1root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 3 && ulFiles == 0 && ulBytes == 0);
+  assert(FT_detach("1root/a/b", &oTSecond) == NO_SUCH_PATH);
+  assert(oTSecond == NULL);
+  assert(FT_attach("1root/x/b", oTFirst) == NO_SUCH_PATH);
+  assert(FT_attach("1root/a/c", oTFirst) == ALREADY_IN_TREE);
+  assert(FT_attach("1root/a/c/b2", oTFirst) == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/a/c/b2/f2"), "hello"));
+  assert(FT_du("1root/a", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 3 && ulFiles == 1 && ulBytes == 6);
+  assert(FT_detach("1root", &oTFirst) == SUCCESS);
+  assert(FT_containsDir("1root") == FALSE);
+  assert(FT_destroy() == SUCCESS);
+  assert(FT_init() == SUCCESS);
+  assert(FT_attach("2root", oTFirst) == SUCCESS);
+  assert(FT_detach("2root/a/c/b2/f2", &oTSecond) == SUCCESS);
+  assert(FT_attach("f2", oTSecond) == CONFLICTING_PATH);
+  FT_freeSubtree(oTSecond);
+  assert(FT_detach("2root/a/c/b2", &oTSecond) == SUCCESS);
+  FT_freeSubtree(oTSecond);
+  assert(FT_detach("2root", &oTFirst) == SUCCESS);
+  assert(FT_attach("1root", oTFirst) == SUCCESS);
+  assert(FT_du("1root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 3 && ulFiles == 0 && ulBytes == 0);
+
+  /* merging a detached directory grafts in what only it has, and
+     settles conflicting files and kinds by the policy */
+  assert(FT_insertFile("1root/a/f", "dst", strlen("dst")+1) == SUCCESS);
+  assert(FT_insertFile("1root/a/k/x", "dst", strlen("dst")+1) == SUCCESS);
+  assert(FT_insertDir("1root/a/c/old") == SUCCESS);
+  assert(FT_insertFile("1root/s/f", "src", strlen("src")+1) == SUCCESS);
+  assert(FT_insertFile("1root/s/k", "src", strlen("src")+1) == SUCCESS);
+  assert(FT_insertFile("1root/s/c/new", "src", strlen("src")+1) ==
+         SUCCESS);
+  assert(FT_insertFile("1root/s/only/deep/z", "z", strlen("z")+1) ==
+         SUCCESS);
+  assert(FT_detach("1root/s", &oTFirst) == SUCCESS);
+  assert(FT_merge("1root/a/k/x", oTFirst, FT_MERGE_KEEP) ==
+         NOT_A_DIRECTORY);
+  assert(FT_merge("1root/x", oTFirst, FT_MERGE_KEEP) == NO_SUCH_PATH);
+  assert(FT_merge("1root/a", oTFirst, FT_MERGE_FILES_FROM_SRC) ==
+         SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/a/f"), "src"));
+  assert(FT_containsDir("1root/a/k") == TRUE);
+  assert(FT_containsDir("1root/a/c/old") == TRUE);
+  assert(FT_containsFile("1root/a/c/new") == TRUE);
+  assert(FT_containsFile("1root/a/only/deep/z") == TRUE);
+  assert(FT_du("1root/a", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 6 && ulFiles == 4 && ulBytes == 14);
+  assert(FT_insertFile("1root/s/f", "new", strlen("new")+1) == SUCCESS);
+  assert(FT_insertFile("1root/s/k", "kind", strlen("kind")+1) ==
+         SUCCESS);
+  assert(FT_detach("1root/s", &oTFirst) == SUCCESS);
+  assert(FT_merge("1root/a", oTFirst, FT_MERGE_KINDS_FROM_SRC) ==
+         SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/a/f"), "src"));
+  assert(!strcmp(FT_getFileContents("1root/a/k"), "kind"));
+  assert(FT_du("1root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 6 && ulFiles == 4 && ulBytes == 15);
+  assert(FT_detach("1root/a/f", &oTFirst) == SUCCESS);
+  assert(FT_merge("1root/a/c", oTFirst, FT_MERGE_KEEP) ==
+         NOT_A_DIRECTORY);
+  FT_freeSubtree(oTFirst);
+  assert(FT_rmDir("1root/a") == SUCCESS);
+  assert(FT_insertDir("1root/a/c") == SUCCESS);
+
+  /* a frozen FT answers queries from its image, and thaws back into
+     nodes on the next modification */
+  assert(FT_insertFile("1root/a/f1", "abc", strlen("abc")+1) == SUCCESS);
+  assert(FT_freeze() == SUCCESS);
+  assert(FT_freeze() == SUCCESS);
+  assert(FT_containsDir("1root/a/c") == TRUE);
+  assert(FT_containsFile("1root/a/c") == FALSE);
+  assert(FT_containsFile("1root/a/f1") == TRUE);
+  assert(FT_containsDir("1root/a/f1/x") == FALSE);
+  assert(!strcmp(FT_getFileContents("1root/a/f1"), "abc"));
+  assert(FT_stat("1root/a/f1", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 4);
+  assert(FT_stat("2root/a", &bIsFile, &l) == CONFLICTING_PATH);
+  assert(FT_du("1root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 3 && ulFiles == 1 && ulBytes == 4);
+  assert(FT_du("1root/a/b", &ulDirs, &ulFiles, &ulBytes) ==
+         NO_SUCH_PATH);
+  assert(FT_compact() == NOT_COMPACTED);
+  assert(FT_insertDir("1root/a/c") == ALREADY_IN_TREE);
+  assert(FT_containsFile("1root/a/f1") == TRUE);
+  assert(FT_rmDir("1root") == SUCCESS);
+  assert(FT_freeze() == SUCCESS);
+  assert(FT_containsDir("1root") == FALSE);
+
+  /* a saved FT maps or loads back whole, contents included, and a
+     damaged image is refused, leaving the FT as it was */
+  assert(FT_insertFile("1root/a/f1", "abc", strlen("abc")+1) == SUCCESS);
+  assert(FT_insertFile("1root/a/f2", NULL, 0) == SUCCESS);
+  assert(FT_insertDir("1root/b") == SUCCESS);
+  assert(FT_save("ft_client.img") == SUCCESS);
+  assert(FT_rmDir("1root") == SUCCESS);
+  assert(FT_open("ft_client.img") == SUCCESS);
+  assert(FT_containsFile("1root/a/f2") == TRUE);
+  assert(!strcmp(FT_getFileContents("1root/a/f1"), "abc"));
+  assert(FT_stat("1root/a/f1", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 4);
+  assert(FT_rmFile("1root/a/f2") == SUCCESS);
+  assert(FT_containsFile("1root/a/f2") == FALSE);
+  assert(!strcmp(FT_getFileContents("1root/a/f1"), "abc"));
+  assert(FT_load("ft_client.img") == SUCCESS);
+  assert(FT_containsDir("1root/b") == TRUE);
+  assert(!strcmp(FT_getFileContents("1root/a/f1"), "abc"));
+  assert(FT_getFileContents("1root/a/f2") == NULL);
+  assert(FT_du("1root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 3 && ulFiles == 2 && ulBytes == 4);
+  assert(FT_insertDir("1root/c") == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/a/f1"), "abc"));
+  assert(FT_load("no/such/dir.img") == IO_ERROR);
+  assert(FT_open("no/such/dir.img") == IO_ERROR);
+  assert((psFile = fopen("ft_client.img", "r+b")) != NULL);
+  assert(fseek(psFile, 200L, SEEK_SET) == 0);
+  assert(putc('~', psFile) == '~');
+  assert(fclose(psFile) == 0);
+  assert(FT_load("ft_client.img") == CORRUPT_IMAGE);
+  assert(FT_containsDir("1root/c") == TRUE);
+  assert(remove("ft_client.img") == 0);
+  assert(FT_rmDir("1root") == SUCCESS);
+
+  /* a background save writes the FT as it was when it started, and
+     reports back once, with the size of the file */
+  assert(FT_insertFile("1root/a/f1", "abc", strlen("abc")+1) == SUCCESS);
+  assert(FT_saveInBackground("ft_client.img") == SUCCESS);
+  assert(FT_rmDir("1root") == SUCCESS);
+  assert(FT_pollSave(TRUE, &iStatus, &l) == TRUE);
+  assert(iStatus == SUCCESS && l > 0);
+  assert(FT_pollSave(FALSE, &iStatus, &l) == TRUE);
+  assert(iStatus == INITIALIZATION_ERROR);
+  assert(FT_load("ft_client.img") == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/a/f1"), "abc"));
+  assert(FT_saveInBackground("no/such/dir.img") == SUCCESS);
+  assert(FT_pollSave(TRUE, &iStatus, &l) == TRUE);
+  assert(iStatus == IO_ERROR);
+  /* starting a save reaps the one before and holds its outcome for
+     later, the first failure over any success */
+  assert(FT_saveInBackground("ft_client.img") == SUCCESS);
+  assert(FT_saveInBackground("no/such/dir.img") == SUCCESS);
+  assert(FT_saveInBackground("ft_client.img") == SUCCESS);
+  assert(FT_pollSave(FALSE, &iStatus, &l) == TRUE);
+  assert(iStatus == IO_ERROR);
+  assert(FT_pollSave(TRUE, &iStatus, &l) == TRUE);
+  assert(iStatus == SUCCESS && l > 0);
+  assert(FT_pollSave(TRUE, &iStatus, &l) == TRUE);
+  assert(iStatus == INITIALIZATION_ERROR);
+  assert(waitpid(-1, NULL, WNOHANG) == -1);
+  assert(remove("ft_client.img") == 0);
+  assert(FT_rmDir("1root") == SUCCESS);
+
+  /* journaled mutations replay on top of the last checkpoint, up to
+     the last record written out whole */
+  (void)remove("ft_client.log");
+  assert(FT_syncJournal() == SUCCESS);
+  assert(FT_openJournal("ft_client.log", 2) == SUCCESS);
+  assert(FT_insertFile("1root/a/f1", "abc", strlen("abc")+1) == SUCCESS);
+  assert(FT_insertDir("1root/b") == SUCCESS);
+  assert(FT_insertDir("1root/b") == ALREADY_IN_TREE);
+  assert(FT_checkpoint("ft_client.img") == SUCCESS);
+  assert(FT_insertFile("1root/b/f3", NULL, 0) == SUCCESS);
+  assert(!strcmp(FT_replaceFileContents("1root/a/f1", "de",
+                                        strlen("de")+1), "abc"));
+  assert(FT_rmDir("1root/b") == SUCCESS);
+  assert(FT_insertDir("1root/c") == SUCCESS);
+  assert(FT_move("1root/c", "1root/d") == SUCCESS);
+  assert(FT_insertDir("1root/c") == SUCCESS);
+  assert(FT_copy("1root/a/f1", "1root/d/f1") == SUCCESS);
+  assert(FT_detach("1root/d", &oTFirst) == SUCCESS);
+  assert(FT_attach("1root/a/d", oTFirst) == SUCCESS);
+  assert(FT_insertFile("1root/c/f1", "xyz", strlen("xyz")+1) == SUCCESS);
+  assert(FT_detach("1root/c", &oTFirst) == SUCCESS);
+  assert(FT_merge("1root/a/d", oTFirst, FT_MERGE_FILES_FROM_SRC) ==
+         SUCCESS);
+  assert(FT_writeAt("1root/a/f1", 0, "DE", 2) == SUCCESS);
+  assert(FT_syncJournal() == SUCCESS);
+  assert(FT_closeJournal() == SUCCESS);
+  assert(FT_rmDir("1root") == SUCCESS);
+  assert(FT_recover("ft_client.img", "ft_client.log") == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/a/f1"), "DE"));
+  assert(FT_containsDir("1root/b") == FALSE);
+  assert(FT_containsDir("1root/d") == FALSE);
+  assert(FT_containsDir("1root/c") == FALSE);
+  assert(!strcmp(FT_getFileContents("1root/a/d/f1"), "xyz"));
+  assert(FT_du("1root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulDirs == 3 && ulFiles == 2 && ulBytes == 7);
+  assert(FT_recover(NULL, "ft_client.log") == NO_SUCH_PATH);
+  assert(FT_containsFile("1root/b/f3") == TRUE);
+  assert(FT_recover("ft_client.img", "no/such/dir.log") == IO_ERROR);
+  assert(FT_recover("ft_client.img", "ft_client.log") == SUCCESS);
+  assert(FT_openJournal("ft_client.log", 1) == SUCCESS);
+  assert(FT_insertDir("1root/e") == SUCCESS);
+  assert(FT_closeJournal() == SUCCESS);
+  assert((psFile = fopen("ft_client.log", "ab")) != NULL);
+  assert(fputs("torn record", psFile) >= 0);
+  assert(fclose(psFile) == 0);
+  assert(FT_recover("ft_client.img", "ft_client.log") == SUCCESS);
+  assert(FT_containsDir("1root/e") == TRUE);
+  assert(FT_openJournal("ft_client.log", 1) == SUCCESS);
+  assert(FT_insertDir("1root/f") == SUCCESS);
+  assert(FT_recover("ft_client.img", "ft_client.log") == SUCCESS);
+  assert(FT_containsDir("1root/e") == TRUE);
+  assert(FT_containsDir("1root/f") == TRUE);
+  assert(FT_snapshot(&oSFirst) == SUCCESS);
+  assert(FT_destroy() == SUCCESS);
+  assert(!strcmp(FT_snapshotGetFileContents(oSFirst, "1root/a/d/f1"),
+                 "xyz"));
+  FT_freeSnapshot(oSFirst);
+  assert(FT_init() == SUCCESS);
+  assert(FT_recover("ft_client.img", "ft_client.log") == SUCCESS);
+  assert(FT_recover("ft_client.log", "ft_client.img") == CORRUPT_IMAGE);
+  assert(FT_containsDir("1root/f") == TRUE);
+  assert(remove("ft_client.img") == 0);
+  assert(remove("ft_client.log") == 0);
+  assert(FT_rmDir("1root") == SUCCESS);
+
+  /* a replayed replace of a file that is no longer there fails the
+     recovery with the status the replace failed with */
+  assert(FT_openJournal("ft_client.log", 1) == SUCCESS);
+  assert(FT_insertFile("1root/r", "old", strlen("old")+1) == SUCCESS);
+  assert(FT_checkpoint("ft_client.img") == SUCCESS);
+  assert(!strcmp(FT_replaceFileContents("1root/r", "new",
+                                        strlen("new")+1), "old"));
+  assert(FT_closeJournal() == SUCCESS);
+  assert(FT_recover(NULL, "ft_client.log") == NO_SUCH_PATH);
+  assert(FT_containsFile("1root/r") == FALSE);
+  assert(FT_recover("ft_client.img", "ft_client.log") == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/r"), "new"));
+  assert(remove("ft_client.img") == 0);
+  assert(remove("ft_client.log") == 0);
+  assert(FT_rmDir("1root") == SUCCESS);
+
+  /* snapshots keep seeing the tree as it was when they were taken,
+     through any later modifications, until they are freed */
+  assert(FT_insertFile("1root/a/f1", "abc", strlen("abc")+1) == SUCCESS);
+  assert(FT_insertDir("1root/b") == SUCCESS);
+  assert(FT_snapshot(&oSFirst) == SUCCESS);
+  assert(FT_insertFile("1root/a/f2", NULL, 0) == SUCCESS);
+  assert(!strcmp(FT_replaceFileContents("1root/a/f1", "de",
+                                        strlen("de")+1), "abc"));
+  assert(FT_rmDir("1root/b") == SUCCESS);
+  assert(FT_snapshot(&oSSecond) == SUCCESS);
+  assert(FT_rmDir("1root") == SUCCESS);
+  assert(FT_snapshotContainsDir(oSFirst, "1root/b") == TRUE);
+  assert(FT_snapshotContainsFile(oSFirst, "1root/a/f2") == FALSE);
+  assert(!strcmp(FT_snapshotGetFileContents(oSFirst, "1root/a/f1"),
+                 "abc"));
+  assert(FT_snapshotStat(oSFirst, "1root/a/f1", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 4);
+  assert(FT_snapshotStat(oSFirst, "2root", &bIsFile, &l) ==
+         CONFLICTING_PATH);
+  assert(FT_snapshotDu(oSFirst, "1root", &ulDirs, &ulFiles, &ulBytes) ==
+         SUCCESS);
+  assert(ulDirs == 3 && ulFiles == 1 && ulBytes == 4);
+  assert((temp = FT_snapshotToString(oSFirst)) != NULL);
+  assert(!strcmp(temp, "1root\n1root/a\n1root/a/f1\n1root/b\n"));
+  free(temp);
+  FT_freeSnapshot(oSFirst);
+  assert(FT_snapshotContainsDir(oSSecond, "1root/b") == FALSE);
+  assert(FT_snapshotContainsFile(oSSecond, "1root/a/f2") == TRUE);
+  assert(!strcmp(FT_snapshotGetFileContents(oSSecond, "1root/a/f1"),
+                 "de"));
+  assert(FT_snapshotDu(oSSecond, "1root/a", &ulDirs, &ulFiles,
+                       &ulBytes) == SUCCESS);
+  assert(ulDirs == 1 && ulFiles == 2 && ulBytes == 3);
+  FT_freeSnapshot(oSSecond);
+  assert(FT_containsDir("1root") == FALSE);
+
+  /* a diff reports what was added, removed, or changed, and skips
+     what hashes the same, shared or not */
+  assert(FT_insertFile("1root/a/f1", "abc", strlen("abc")+1) == SUCCESS);
+  assert(FT_insertFile("1root/a/f2", "x", strlen("x")+1) == SUCCESS);
+  assert(FT_insertFile("1root/b/c/f3", "y", strlen("y")+1) == SUCCESS);
+  assert(FT_insertDir("1root/d") == SUCCESS);
+  assert(FT_snapshot(&oSFirst) == SUCCESS);
+  assert(!strcmp(FT_replaceFileContents("1root/a/f1", "abd",
+                                        strlen("abd")+1), "abc"));
+  assert(!strcmp(FT_replaceFileContents("1root/a/f2", acSame,
+                                        strlen(acSame)+1), "x"));
+  assert(FT_rmDir("1root/d") == SUCCESS);
+  assert(FT_insertFile("1root/e", "z", strlen("z")+1) == SUCCESS);
+  assert(FT_insertDir("1root/b/c/g") == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_diff(oSFirst, NULL, appendDiff, arr) == SUCCESS);
+  assert(!strcmp(arr, "+1root/e\n~1root/a/f1\n+1root/b/c/g\n-1root/d\n"));
+  arr[0] = '\0';
+  assert(FT_diff(NULL, oSFirst, appendDiff, arr) == SUCCESS);
+  assert(!strcmp(arr, "-1root/e\n~1root/a/f1\n-1root/b/c/g\n+1root/d\n"));
+  arr[0] = '\0';
+  assert(FT_diff(oSFirst, oSFirst, appendDiff, arr) == SUCCESS);
+  assert(arr[0] == '\0');
+  assert(FT_snapshot(&oSSecond) == SUCCESS);
+  assert(FT_rmFile("1root/e") == SUCCESS);
+  assert(FT_insertDir("1root/e") == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_diff(oSSecond, NULL, appendDiff, arr) == SUCCESS);
+  assert(!strcmp(arr, "-1root/e\n+1root/e\n"));
+  assert(FT_rmDir("1root/e") == SUCCESS);
+  assert(FT_insertFile("1root/e", "z", strlen("z")+1) == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_diff(oSSecond, NULL, appendDiff, arr) == SUCCESS);
+  assert(FT_diff(NULL, NULL, appendDiff, arr) == SUCCESS);
+  assert(arr[0] == '\0');
+  assert(FT_rmDir("1root") == SUCCESS);
+  assert(FT_insertDir("2root") == SUCCESS);
+  assert(FT_diff(oSSecond, NULL, appendDiff, arr) == SUCCESS);
+  assert(!strcmp(arr, "-1root\n+2root\n"));
+  FT_freeSnapshot(oSFirst);
+  FT_freeSnapshot(oSSecond);
+  assert(FT_rmDir("2root") == SUCCESS);
+
+  /* a file may borrow no contents yet have a length, which the FT
+     never reads through */
+  assert(FT_insertFile("1root/n", NULL, 5) == SUCCESS);
+  assert(FT_getFileContents("1root/n") == NULL);
+  assert(FT_stat("1root/n", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 5);
+  assert(FT_snapshot(&oSFirst) == SUCCESS);
+  assert(FT_replaceFileContents("1root/n", NULL, 7) == NULL);
+  assert(FT_stat("1root/n", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 7);
+  arr[0] = '\0';
+  assert(FT_diff(oSFirst, NULL, appendDiff, arr) == SUCCESS);
+  assert(!strcmp(arr, "~1root/n\n"));
+  FT_freeSnapshot(oSFirst);
+  assert(FT_freeze() == SUCCESS);
+  assert(FT_replaceFileContents("1root/n", "abc", 4) == NULL);
+  assert(!strcmp(FT_getFileContents("1root/n"), "abc"));
+  assert(FT_rmDir("1root") == SUCCESS);
+
+  /* in deduplicated mode the FT keeps one copy of the same bytes,
+     however many files (or copies, or snapshots) hold them */
+  assert(FT_setContentsMode(FT_CONTENTS_DEDUPLICATED) == SUCCESS);
+  assert(FT_insertFile("1root/a", acBlob, strlen(acBlob)+1) == SUCCESS);
+  assert(FT_insertFile("1root/b", "blob", strlen("blob")+1) == SUCCESS);
+  assert(FT_insertFile("1root/n", NULL, 0) == SUCCESS);
+  pvStored = FT_getFileContents("1root/a");
+  assert(pvStored != acBlob && !strcmp(pvStored, "blob"));
+  assert(FT_getFileContents("1root/b") == pvStored);
+  assert(FT_getFileContents("1root/n") == NULL);
+  assert(FT_contentsStats(&ulInterned, &ulHits, &ulStored, &ulSaved) ==
+         SUCCESS);
+  assert(ulInterned == 2 && ulHits == 1);
+  assert(ulStored == 5 && ulSaved == 5);
+  acBlob[0] = 'g';
+  assert(!strcmp(FT_getFileContents("1root/b"), "blob"));
+  assert(FT_stat("1root/b", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 5);
+  /* the old contents stay valid until the next modification */
+  assert(FT_replaceFileContents("1root/a", acBlob, strlen(acBlob)+1) ==
+         pvStored);
+  assert(FT_copy("1root/b", "1root/c") == SUCCESS);
+  assert(FT_contentsStats(&ulInterned, &ulHits, &ulStored, &ulSaved) ==
+         SUCCESS);
+  assert(ulStored == 10 && ulSaved == 5);
+  assert(FT_snapshot(&oSFirst) == SUCCESS);
+  assert(FT_rmFile("1root/b") == SUCCESS);
+  assert(FT_rmFile("1root/c") == SUCCESS);
+  assert(!strcmp(FT_snapshotGetFileContents(oSFirst, "1root/c"), "blob"));
+  FT_freeSnapshot(oSFirst);
+  assert(FT_contentsStats(&ulInterned, &ulHits, &ulStored, &ulSaved) ==
+         SUCCESS);
+  assert(ulStored == 5 && ulSaved == 0);
+  /* an FT with stored contents cannot be frozen */
+  assert(FT_freeze() == OWNED_CONTENTS);
+  assert(!strcmp(FT_getFileContents("1root/a"), "glob"));
+  /* contents borrowed again replace those stored */
+  assert(FT_setContentsMode(FT_CONTENTS_BORROWED) == SUCCESS);
+  assert(FT_replaceFileContents("1root/a", acSame,
+                                strlen(acSame)+1) != NULL);
+  assert(FT_getFileContents("1root/a") == acSame);
+  assert(FT_rmDir("1root") == SUCCESS);
+  assert(FT_contentsStats(&ulInterned, &ulHits, &ulStored, &ulSaved) ==
+         SUCCESS);
+  assert(ulStored == 0 && ulSaved == 0);
+
+  /* in owned mode each file has its own copy, short or long, which
+     stays put as the FT grows */
+  assert(FT_setContentsMode(FT_CONTENTS_OWNED) == SUCCESS);
+  assert(FT_insertFile("1root/a", acBlob, strlen(acBlob)+1) == SUCCESS);
+  assert(FT_insertFile("1root/b", acBlob, strlen(acBlob)+1) == SUCCESS);
+  assert(FT_insertFile("1root/l", arr, ARRLEN) == SUCCESS);
+  pvStored = FT_getFileContents("1root/a");
+  assert(pvStored != acBlob && !strcmp(pvStored, "glob"));
+  assert(FT_getFileContents("1root/b") != pvStored);
+  assert(FT_getFileContents("1root/l") != arr);
+  assert(!memcmp(FT_getFileContents("1root/l"), arr, ARRLEN));
+  for (l = 0; l < 100; l++) {
+    sprintf(acPath, "1root/d/f%lu", (unsigned long)l);
+    assert(FT_insertFile(acPath, acPath, strlen(acPath)+1) == SUCCESS);
+  }
+  assert(FT_getFileContents("1root/a") == pvStored);
+  assert(!strcmp(FT_getFileContents("1root/d/f42"), "1root/d/f42"));
+  assert(FT_contentsStats(&ulInterned, &ulHits, &ulStored, &ulSaved) ==
+         SUCCESS);
+  assert(ulStored == 0);
+  assert(FT_copy("1root/a", "1root/c") == SUCCESS);
+  assert(FT_getFileContents("1root/c") != pvStored);
+  assert(!strcmp(FT_getFileContents("1root/c"), "glob"));
+  assert(FT_replaceFileContents("1root/a", "x", 2) == pvStored);
+  assert(!strcmp(pvStored, "glob"));
+  assert(FT_freeze() == OWNED_CONTENTS);
+  assert(!strcmp(FT_getFileContents("1root/a"), "x"));
+  assert(FT_setContentsMode(FT_CONTENTS_BORROWED) == SUCCESS);
+  assert(FT_rmDir("1root") == SUCCESS);
+
+  /* files can be read, written, and appended to in ranges, across
+     chunks, and stay whole for the other calls */
+  assert(FT_insertFile("1root/log", NULL, 0) == SUCCESS);
+  assert(FT_insertFile("1root/flat", "0123456789", 10) == SUCCESS);
+  for (l = 0; l < 1000; l++)
+    assert(FT_append("1root/log", "0123456789", 10) == SUCCESS);
+  assert(FT_stat("1root/log", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE && l == 10000);
+  assert(FT_readAt("1root/log", 4090, arr, 12, &l) == SUCCESS);
+  assert(l == 12 && !memcmp(arr, "012345678901", 12));
+  assert(FT_readAt("1root/log", 9995, arr, 12, &l) == SUCCESS);
+  assert(l == 5 && !memcmp(arr, "56789", 5));
+  assert(FT_readAt("1root/log", 10001, arr, 12, &l) == SUCCESS);
+  assert(l == 0);
+  assert(FT_writeAt("1root/log", 4094, "abcd", 4) == SUCCESS);
+  assert(!memcmp((char *)FT_getFileContents("1root/log") + 4090,
+                 "0123abcd8901", 12));
+  assert(FT_snapshot(&oSFirst) == SUCCESS);
+  assert(FT_writeAt("1root/log", 10002, "z", 1) == SUCCESS);
+  assert(FT_readAt("1root/log", 9998, arr, 5, &l) == SUCCESS);
+  assert(l == 5 && !memcmp(arr, "89\0\0z", 5));
+  assert(FT_du("1root", &ulDirs, &ulFiles, &ulBytes) == SUCCESS);
+  assert(ulBytes == 10013);
+  arr[0] = '\0';
+  assert(FT_diff(oSFirst, NULL, appendDiff, arr) == SUCCESS);
+  assert(!strcmp(arr, "~1root/log\n"));
+  assert(!memcmp((char *)FT_snapshotGetFileContents(oSFirst, "1root/log") +
+                 9990, "0123456789", 10));
+  FT_freeSnapshot(oSFirst);
+  /* chunked contents hash as their bytes do */
+  assert(FT_snapshot(&oSFirst) == SUCCESS);
+  assert(FT_writeAt("1root/flat", 2, "23", 2) == SUCCESS);
+  assert(FT_readAt("1root/flat", 0, arr, 20, &l) == SUCCESS);
+  assert(l == 10 && !memcmp(arr, "0123456789", 10));
+  arr[0] = '\0';
+  assert(FT_diff(oSFirst, NULL, appendDiff, arr) == SUCCESS);
+  assert(arr[0] == '\0');
+  FT_freeSnapshot(oSFirst);
+  assert(FT_readAt("1root", 0, arr, 1, &l) == NOT_A_FILE);
+  assert(FT_writeAt("1root/none", 0, "x", 1) == NO_SUCH_PATH);
+  assert(FT_append("1root", "x", 1) == NOT_A_FILE);
+  assert(FT_rmDir("1root") == SUCCESS);
+
+  /* long contents are compressed as they come in, and others once a
+     sweep finds them untouched since the last; either way they read,
+     write, hash, and save as before */
+  assert(FT_setContentsMode(FT_CONTENTS_OWNED) == SUCCESS);
+  assert(FT_setCompression(2, 600) == SUCCESS);
+  for (l = 0; l < ARRLEN; l++)
+    arr[l] = "compress me "[l % 12];
+  assert(FT_insertFile("1root/big", arr, ARRLEN) == SUCCESS);
+  assert(FT_insertFile("1root/warm", arr, 300) == SUCCESS);
+  assert(FT_insertFile("1root/tiny", arr, 12) == SUCCESS);
+  assert(FT_compressionStats(&ulOriginal, &ulCompressed, &ulHits,
+                             &ulMisses, &dCompressMs, &dDecompressMs) ==
+         SUCCESS);
+  assert(ulOriginal == ARRLEN && ulCompressed < ARRLEN / 4);
+  pvStored = FT_getFileContents("1root/big");
+  assert(!memcmp(pvStored, arr, ARRLEN));
+  assert(FT_getFileContents("1root/big") == pvStored);
+  assert(FT_compressionStats(&ulOriginal, &ulCompressed, &ulHits,
+                             &ulMisses, &dCompressMs, &dDecompressMs) ==
+         SUCCESS);
+  assert(ulHits == 1 && ulMisses == 1);
+  assert(FT_snapshot(&oSFirst) == SUCCESS);
+  assert(FT_insertDir("1root/d") == SUCCESS);
+  assert(FT_insertDir("1root/e") == SUCCESS);
+  assert(FT_insertDir("1root/f") == SUCCESS);
+  assert(FT_compressionStats(&ulOriginal, &ulCompressed, &ulHits,
+                             &ulMisses, &dCompressMs, &dDecompressMs) ==
+         SUCCESS);
+  assert(ulOriginal == ARRLEN + 300);
+  assert(FT_readAt("1root/warm", 288, acPath, 20, &l) == SUCCESS);
+  assert(l == 12 && !memcmp(acPath, "compress me ", 12));
+  assert(FT_writeAt("1root/big", 0, "C", 1) == SUCCESS);
+  assert(FT_readAt("1root/big", 0, acPath, 9, &l) == SUCCESS);
+  assert(l == 9 && !memcmp(acPath, "Compress ", 9));
+  arr[0] = '\0';
+  assert(FT_diff(oSFirst, NULL, appendDiff, arr) == SUCCESS);
+  assert(!strcmp(arr, "~1root/big\n+1root/d\n+1root/e\n+1root/f\n"));
+  FT_freeSnapshot(oSFirst);
+  assert(FT_compressionStats(&ulOriginal, &ulCompressed, &ulHits,
+                             &ulMisses, &dCompressMs, &dDecompressMs) ==
+         SUCCESS);
+  assert(ulOriginal == 300);
+  assert(FT_save("ft_client.img") == SUCCESS);
+  assert(FT_rmDir("1root") == SUCCESS);
+  assert(FT_load("ft_client.img") == SUCCESS);
+  assert(FT_readAt("1root/warm", 0, acPath, 12, &l) == SUCCESS);
+  assert(l == 12 && !memcmp(acPath, "compress me ", 12));
+  assert(remove("ft_client.img") == 0);
+  assert(FT_rmDir("1root") == SUCCESS);
+  assert(FT_setCompression(0, 0) == SUCCESS);
+
+  /* long contents past the budget go to the spill file, least
+     recently used first, and come back when used; short ones and the
+     directories stay in memory */
+  assert(FT_setSpill("no/such/dir.spill", 800, 100) == IO_ERROR);
+  assert(FT_setSpill("ft_client.spill", 800, 100) == SUCCESS);
+  for (l = 0; l < ARRLEN; l++)
+    arr[l] = "spill me, "[l % 10];
+  assert(FT_insertFile("1root/a", arr, 400) == SUCCESS);
+  assert(FT_insertFile("1root/b", arr + 1, 400) == SUCCESS);
+  assert(FT_insertFile("1root/c", arr, 50) == SUCCESS);
+  assert(FT_insertFile("1root/d", arr + 2, 400) == SUCCESS);
+  assert(FT_spillStats(&ulResident, &ulOnDisk, &ulPageIns,
+                       &ulPageOuts) == SUCCESS);
+  assert(ulResident == 800 && ulOnDisk == 400);
+  assert(ulPageIns == 0 && ulPageOuts == 1);
+  assert(FT_readAt("1root/a", 396, acPath, 10, &l) == SUCCESS);
+  assert(l == 4 && !memcmp(acPath, "me, ", 4));
+  assert(!memcmp(FT_getFileContents("1root/a"), arr, 400));
+  assert(FT_spillStats(&ulResident, &ulOnDisk, &ulPageIns,
+                       &ulPageOuts) == SUCCESS);
+  assert(ulResident == 800 && ulOnDisk == 400);
+  assert(ulPageIns == 1 && ulPageOuts == 2);
+  /* the old contents stay readable until the next mutation */
+  pvStored = FT_replaceFileContents("1root/b", arr + 3, 400);
+  assert(pvStored != NULL && !memcmp(pvStored, arr + 1, 400));
+  assert(FT_save("ft_client.img") == SUCCESS);
+  assert(FT_rmDir("1root") == SUCCESS);
+  assert(FT_spillStats(&ulResident, &ulOnDisk, &ulPageIns,
+                       &ulPageOuts) == SUCCESS);
+  assert(ulResident == 0 && ulOnDisk == 0);
+  assert(FT_load("ft_client.img") == SUCCESS);
+  assert(FT_readAt("1root/b", 0, acPath, 10, &l) == SUCCESS);
+  assert(l == 10 && !memcmp(acPath, "ll me, spi", 10));
+  assert(!memcmp(FT_getFileContents("1root/d"), arr + 2, 400));
+  assert(remove("ft_client.img") == 0);
+  assert(FT_rmDir("1root") == SUCCESS);
+  assert(FT_setSpill(NULL, 0, 0) == SUCCESS);
+
+  /* contents come straight from a file, read or mapped, and go
+     straight back out to one, from the spill file if spilled */
+  for (l = 0; l < ARRLEN; l++)
+    arr[l] = "from a file "[l % 12];
+  assert((psFile = fopen("ft_client.dat", "w+b")) != NULL);
+  assert(fwrite(arr, 1, ARRLEN, psFile) == ARRLEN);
+  assert(fflush(psFile) == 0);
+  assert(FT_setSpill("ft_client.spill", 0, 100) == SUCCESS);
+  assert(FT_insertFileFromFd("1root/past", fileno(psFile), 900, 200) ==
+         IO_ERROR);
+  assert(FT_insertFileFromFd("1root/read", fileno(psFile), 12, 500) ==
+         SUCCESS);
+  assert(FT_insertFileFromFd("1root/next", fileno(psFile), 0, 500) ==
+         SUCCESS);
+  assert(FT_insertFileFromFd("1root/last", fileno(psFile), 0, 500) ==
+         SUCCESS);
+  assert(FT_setContentsMode(FT_CONTENTS_MAPPED) == SUCCESS);
+  assert(FT_insertFileFromFd("1root/mapped", fileno(psFile), 5, 990) ==
+         SUCCESS);
+  assert(FT_insertFileFromFd("1root/empty", fileno(psFile), 0, 0) ==
+         SUCCESS);
+  assert(fclose(psFile) == 0);
+  assert(FT_containsFile("1root/past") == FALSE);
+  assert(FT_stat("1root/mapped", &bIsFile, &l) == SUCCESS && l == 990);
+  assert(!memcmp(FT_getFileContents("1root/mapped"), arr + 5, 990));
+  assert(FT_readAt("1root/mapped", 985, acPath, 10, &l) == SUCCESS);
+  assert(l == 5 && !memcmp(acPath, arr + 990, 5));
+  assert(FT_writeAt("1root/mapped", 0, "F", 1) == SUCCESS);
+  assert(FT_spillStats(&ulResident, &ulOnDisk, &ulPageIns,
+                       &ulPageOuts) == SUCCESS);
+  assert(ulOnDisk == 500);
+  ulPagedBefore = ulPageIns;
+  assert((psFile = fopen("ft_client.out", "w+b")) != NULL);
+  assert(FT_writeFileToFd("1root/read", fileno(psFile)) == SUCCESS);
+  assert(FT_writeFileToFd("1root/mapped", fileno(psFile)) == SUCCESS);
+  assert(FT_writeFileToFd("1root/empty", fileno(psFile)) == SUCCESS);
+  assert(FT_writeFileToFd("1root", fileno(psFile)) == NOT_A_FILE);
+  assert(FT_spillStats(&ulResident, &ulOnDisk, &ulPageIns,
+                       &ulPageOuts) == SUCCESS);
+  assert(ulPageIns == ulPagedBefore);
+  rewind(psFile);
+  for (l = 0; l < 1490; l++)
+    assert(fgetc(psFile) == (l < 500 ? arr[l] : l == 500 ? 'F' :
+                             arr[l - 495]));
+  assert(fgetc(psFile) == EOF);
+  assert(fclose(psFile) == 0);
+  assert(remove("ft_client.out") == 0);
+  assert(remove("ft_client.dat") == 0);
+  assert(FT_rmDir("1root") == SUCCESS);
+  assert(FT_setSpill(NULL, 0, 0) == SUCCESS);
+  assert(FT_setContentsMode(FT_CONTENTS_BORROWED) == SUCCESS);
+
+  /* a real directory is imported whole, its files owning copies of
+     their contents, links and all else skipped, or not at all */
+  assert(mkdir("ft_client.tree", 0755) == 0);
+  assert(mkdir("ft_client.tree/a", 0755) == 0);
+  assert(mkdir("ft_client.tree/a/y", 0755) == 0);
+  assert((psFile = fopen("ft_client.tree/a/z", "wb")) != NULL);
+  assert(fwrite(arr, 1, ARRLEN, psFile) == ARRLEN);
+  assert(fclose(psFile) == 0);
+  assert((psFile = fopen("ft_client.tree/b", "wb")) != NULL);
+  assert(fputs("bee", psFile) >= 0);
+  assert(fclose(psFile) == 0);
+  assert(symlink("b", "ft_client.tree/link") == 0);
+  assert(FT_importStats(&ulFiles, &ulBytes, &dFilesPerSec,
+                        &dBytesPerSec) == SUCCESS);
+  assert(ulFiles == 0 && ulBytes == 0 && dFilesPerSec == 0);
+  assert(FT_insertDir("1root") == SUCCESS);
+  assert(FT_importDir("ft_client.none", "1root/tree", 4) == IO_ERROR);
+  assert(FT_importDir("ft_client.tree", "1root/none/tree", 4) ==
+         NO_SUCH_PATH);
+  assert(FT_containsDir("1root/tree") == FALSE);
+  assert(FT_importDir("ft_client.tree", "1root/tree", 4) == SUCCESS);
+  assert(FT_importDir("ft_client.tree", "1root/tree", 4) ==
+         ALREADY_IN_TREE);
+  assert(FT_importStats(&ulFiles, &ulBytes, &dFilesPerSec,
+                        &dBytesPerSec) == SUCCESS);
+  assert(ulFiles == 2 && ulBytes == ARRLEN + 3);
+  assert(dFilesPerSec > 0 && dBytesPerSec > dFilesPerSec);
+  assert((temp = FT_toString()) != NULL);
+  assert(!strcmp(temp, "1root\n1root/tree\n1root/tree/b\n1root/tree/a\n"
+                 "1root/tree/a/z\n1root/tree/a/y\n"));
+  free(temp);
+  assert(FT_stat("1root/tree/a/z", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile && l == ARRLEN);
+  assert(!memcmp(FT_getFileContents("1root/tree/a/z"), arr, ARRLEN));
+  assert(!memcmp(FT_getFileContents("1root/tree/b"), "bee", 3));
+
+  /* and exported back out, through an io_uring where the kernel has
+     one, then through threads, with one file in flight at a time */
+  assert(FT_exportDir("1root/tree/b", "ft_client.copy") ==
+         NOT_A_DIRECTORY);
+  assert(FT_exportDir("1root/none", "ft_client.copy") == NO_SUCH_PATH);
+  assert(FT_setExport(2, TRUE) == SUCCESS);
+  assert(FT_exportDir("1root/tree", "ft_client.copy") == SUCCESS);
+  assert(FT_exportDir("1root/tree", "ft_client.copy") == IO_ERROR);
+  assert(FT_setExport(0, FALSE) == SUCCESS);
+  assert(FT_exportDir("1root/tree", "ft_client.copy/a/y/again") ==
+         SUCCESS);
+  assert(FT_exportStats(&ulFiles, &ulBytes, &dFilesPerSec, &dBytesPerSec,
+                        &bIsFile) == SUCCESS);
+  assert(ulFiles == 2 && ulBytes == ARRLEN + 3 && bIsFile == FALSE);
+  checkAndRemove("ft_client.copy/a/y/again/b", "bee", 3);
+  checkAndRemove("ft_client.copy/a/y/again/a/z", arr, ARRLEN);
+  assert(rmdir("ft_client.copy/a/y/again/a/y") == 0);
+  assert(rmdir("ft_client.copy/a/y/again/a") == 0);
+  assert(rmdir("ft_client.copy/a/y/again") == 0);
+  checkAndRemove("ft_client.copy/b", "bee", 3);
+  checkAndRemove("ft_client.copy/a/z", arr, ARRLEN);
+  assert(rmdir("ft_client.copy/a/y") == 0);
+  assert(rmdir("ft_client.copy/a") == 0);
+  assert(rmdir("ft_client.copy") == 0);
+  assert(remove("ft_client.tree/link") == 0);
+  assert(remove("ft_client.tree/b") == 0);
+  assert(remove("ft_client.tree/a/z") == 0);
+  assert(rmdir("ft_client.tree/a/y") == 0);
+  assert(rmdir("ft_client.tree/a") == 0);
+  assert(rmdir("ft_client.tree") == 0);
+  assert(!memcmp(FT_getFileContents("1root/tree/b"), "bee", 3));
+  assert(FT_rmDir("1root") == SUCCESS);
+
+  /* globs match whole components, "**" any number of them, and each
+     node once, in the order of FT_toString */
+  assert(FT_insertFile("1root/a/logs/x.gz", NULL, 0) == SUCCESS);
+  assert(FT_insertFile("1root/a/logs/y.txt", NULL, 0) == SUCCESS);
+  assert(FT_insertFile("1root/b/logs/z.gz", NULL, 0) == SUCCESS);
+  assert(FT_insertFile("1root/b/other/w.gz", NULL, 0) == SUCCESS);
+  assert(FT_insertFile("1root/c/logs/deep/v.gz", NULL, 0) == SUCCESS);
+  assert(FT_insertFile("1root/logs", NULL, 0) == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_glob("1root/*/logs/*.gz", appendMatch, arr) == SUCCESS);
+  assert(!strcmp(arr, "f1root/a/logs/x.gz\nf1root/b/logs/z.gz\n"));
+  arr[0] = '\0';
+  assert(FT_glob("1root/**/*.gz", appendMatch, arr) == SUCCESS);
+  assert(!strcmp(arr, "f1root/a/logs/x.gz\nf1root/b/logs/z.gz\n"
+                 "f1root/b/other/w.gz\nf1root/c/logs/deep/v.gz\n"));
+  arr[0] = '\0';
+  assert(FT_glob("1root/**/logs/**/*.gz", appendMatch, arr) == SUCCESS);
+  assert(!strcmp(arr, "f1root/a/logs/x.gz\nf1root/b/logs/z.gz\n"
+                 "f1root/c/logs/deep/v.gz\n"));
+  arr[0] = '\0';
+  assert(FT_glob("1root/?/lo*", appendMatch, arr) == SUCCESS);
+  assert(!strcmp(arr, "d1root/a/logs\nd1root/b/logs\nd1root/c/logs\n"));
+  arr[0] = '\0';
+  assert(FT_glob("1root/l*s", appendMatch, arr) == SUCCESS);
+  assert(FT_glob("1root/b", appendMatch, arr) == SUCCESS);
+  assert(FT_glob("1root/b/x*", appendMatch, arr) == SUCCESS);
+  assert(FT_glob("2root/**", appendMatch, arr) == SUCCESS);
+  assert(!strcmp(arr, "f1root/logs\nd1root/b\n"));
+  assert(FT_glob("1root//b", appendMatch, arr) == BAD_PATH);
+  assert(FT_freeze() == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_glob("1root/**/logs/**/*.gz", appendMatch, arr) == SUCCESS);
+  assert(!strcmp(arr, "f1root/a/logs/x.gz\nf1root/b/logs/z.gz\n"
+                 "f1root/c/logs/deep/v.gz\n"));
+  arr[0] = '\0';
+  assert(FT_glob("1root/?/lo*", appendMatch, arr) == SUCCESS);
+  assert(FT_glob("1root/b", appendMatch, arr) == SUCCESS);
+  assert(FT_glob("1root/b/x*", appendMatch, arr) == SUCCESS);
+  assert(!strcmp(arr, "d1root/a/logs\nd1root/b/logs\nd1root/c/logs\n"
+                 "d1root/b\n"));
+  arr[0] = '\0';
+  assert(FT_glob("*/**", appendMatch, arr) == SUCCESS);
+  assert((temp = FT_toString()) != NULL);
+  assert(strlen(arr) == strlen(temp) + 15);
+  free(temp);
+  assert(FT_exportDir("1root/b/logs/z.gz", "ft_client.copy") ==
+         NOT_A_DIRECTORY);
+  assert(FT_exportDir("1root/b", "ft_client.copy") == SUCCESS);
+  assert(FT_exportStats(&ulFiles, &ulBytes, &dFilesPerSec, &dBytesPerSec,
+                        &bIsFile) == SUCCESS);
+  assert(ulFiles == 2 && ulBytes == 0);
+  checkAndRemove("ft_client.copy/logs/z.gz", NULL, 0);
+  checkAndRemove("ft_client.copy/other/w.gz", NULL, 0);
+  assert(rmdir("ft_client.copy/logs") == 0);
+  assert(rmdir("ft_client.copy/other") == 0);
+  assert(rmdir("ft_client.copy") == 0);
+  assert(FT_rmDir("1root") == SUCCESS);
+
   /* children should be printed in lexicographic order,
      depth first, file children before directory children */
   assert(FT_insertDir("1root/y") == SUCCESS);
@@ -231,6 +1166,7 @@ int main(void) {
   assert(FT_insertDir("1root/y/CHILD3DIR") == SUCCESS);
   assert(FT_insertFile("1root/y/CHILD1FILE", NULL, 0) == SUCCESS);
   assert(FT_insertDir("1root/y/CHILD2DIR/CHILD4DIR") == SUCCESS);
+  assert(FT_freeze() == SUCCESS);
   assert((temp = FT_toString()) != NULL);
   fprintf(stderr, "Checkpoint 4.5:\n%s\n", temp);
   free(temp);
@@ -0,0 +1,1645 @@
+/*--------------------------------------------------------------------*/
+/* imageFT.c                                                          */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+/* for fileno, mmap, and fstat under a strict -std */
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "imageFT.h"
+
+/* "FTIM", identifying a block of memory as an image */
+#define IMAGE_MAGIC 0x4D495446U
+
+/* The version of the layout described by struct imageHeader */
+#define IMAGE_VERSION 2U
+
+/* Header flag: contents references are pointers, not offsets */
+#define IMAGE_CONTENTS_BY_REFERENCE 1U
+
+/* The contents reference of a file whose contents are NULL */
+#define IMAGE_NO_CONTENTS ((uint64_t)-1)
+
+/* Bits per word, and words per block of the rank directories */
+enum { WORD_BITS = 64, BLOCK_WORDS = 8, BLOCK_BITS = 512 };
+
+/* Nodes per bucket of front-coded names: the first name of each
+   bucket, and of each directory's run of children, is stored whole */
+enum { NAME_BUCKET = 16 };
+
+/*
+  The header at the start of every image. All offsets are in bytes
+  from the start of the image, and all sections are 8-byte aligned.
+*/
+struct imageHeader
+{
+    /* IMAGE_MAGIC and IMAGE_VERSION */
+    uint32_t uMagic;
+    uint32_t uVersion;
+
+    /* IMAGE_* flags */
+    uint64_t ulFlags;
+
+    /* the size in bytes of the whole image, header included */
+    uint64_t ulSize;
+
+    /* the checksum of the whole image, computed as if this field were
+       0: see Image_checksum. Only saved images have one; it is 0 in
+       memory. */
+    uint64_t ulChecksum;
+
+    /* the sequence number the image was saved with (see Image_save);
+       0 in memory */
+    uint64_t ulSequence;
+
+    /* the numbers of nodes, directories, and files */
+    uint64_t ulNumNodes;
+    uint64_t ulNumDirs;
+    uint64_t ulNumFiles;
+
+    /* the length of the longest name, not counting its '\0', and the
+       length of all names, counting their '\0's */
+    uint64_t ulMaxName;
+    uint64_t ulNameBytes;
+
+    /* the LOUDS bitvector (2 * ulNumNodes + 1 bits), and the number
+       of ones before each of its BLOCK_BITS-bit blocks */
+    uint64_t ulLouds;
+    uint64_t ulLoudsRank;
+
+    /* the bitvector with bit i set if node i is a directory (ulNumNodes
+       bits), and the number of ones before each of its blocks */
+    uint64_t ulIsDir;
+    uint64_t ulIsDirRank;
+
+    /* the offset in the names section of the first entry of each
+       NAME_BUCKET-node bucket, and the names section itself */
+    uint64_t ulNameIndex;
+    uint64_t ulNames;
+
+    /* the directories', then the files', directory count, file count,
+       and byte count of their subtree: 3 per directory */
+    uint64_t ulTotals;
+
+    /* each file's contents reference and length: 2 per file. The
+       reference is IMAGE_NO_CONTENTS, a pointer if the image has the
+       IMAGE_CONTENTS_BY_REFERENCE flag, or else the offset of the
+       contents in the data section */
+    uint64_t ulContents;
+
+    /* the contents of the files, for images that hold them; it ends
+       the image */
+    uint64_t ulData;
+};
+
+/* An image, as a view of its block of memory */
+struct image
+{
+    /* the block, which starts with the header, and the length of the
+       mapping it is if it was mapped from a file (0 if allocated) */
+    char *pcBase;
+    size_t ulMapped;
+    const struct imageHeader *psHeader;
+
+    /* the sections of the block */
+    const uint64_t *pulLouds;
+    const uint64_t *pulLoudsRank;
+    const uint64_t *pulIsDir;
+    const uint64_t *pulIsDirRank;
+    const uint64_t *pulNameIndex;
+    const unsigned char *pucNames;
+    const uint64_t *pulTotals;
+    const uint64_t *pulContents;
+    const char *pcData;
+
+    /* room to decode one name into */
+    char *pcScratch;
+};
+
+/* A growable byte buffer, used to encode the names */
+struct buffer
+{
+    unsigned char *pucBytes;
+    size_t ulLength;
+    size_t ulCapacity;
+};
+
+/*--------------------------------------------------------------------*/
+/* Bitvectors and their rank directories                              */
+/*--------------------------------------------------------------------*/
+
+/* Returns the number of ones in ulWord. */
+static size_t Image_popcount(uint64_t ulWord)
+{
+#ifdef __GNUC__
+    return (size_t)__builtin_popcountl((unsigned long)ulWord);
+#else
+    size_t ulCount = 0;
+    while (ulWord != 0)
+    {
+        ulWord &= ulWord - 1;
+        ulCount++;
+    }
+    return ulCount;
+#endif
+}
+
+/* Returns the number of words needed for ulBits bits. */
+static size_t Image_wordsFor(size_t ulBits)
+{
+    return (ulBits + WORD_BITS - 1) / WORD_BITS;
+}
+
+/* Returns the number of rank directory entries for ulBits bits. */
+static size_t Image_rankEntriesFor(size_t ulBits)
+{
+    return (Image_wordsFor(ulBits) + BLOCK_WORDS - 1) / BLOCK_WORDS + 1;
+}
+
+/* Returns TRUE if bit ulPos of pulBits is set. */
+static boolean Image_getBit(const uint64_t *pulBits, size_t ulPos)
+{
+    return (boolean)((pulBits[ulPos / WORD_BITS] >>
+                      (ulPos % WORD_BITS)) & 1);
+}
+
+/* Sets bit ulPos of pulBits. */
+static void Image_setBit(uint64_t *pulBits, size_t ulPos)
+{
+    pulBits[ulPos / WORD_BITS] |= (uint64_t)1 << (ulPos % WORD_BITS);
+}
+
+/* Fills pulRank with the number of ones in the ulBits bits of pulBits
+   before each of its blocks. */
+static void Image_buildRank(const uint64_t *pulBits, size_t ulBits,
+                            uint64_t *pulRank)
+{
+    size_t ulWords = Image_wordsFor(ulBits);
+    size_t ulOnes = 0;
+    size_t w;
+
+    for (w = 0; w < ulWords; w++)
+    {
+        if (w % BLOCK_WORDS == 0)
+            pulRank[w / BLOCK_WORDS] = ulOnes;
+        ulOnes += Image_popcount(pulBits[w]);
+    }
+    pulRank[(ulWords + BLOCK_WORDS - 1) / BLOCK_WORDS] = ulOnes;
+}
+
+/* Returns the number of ones in pulBits before bit ulPos. */
+static size_t Image_rank1(const uint64_t *pulBits, const uint64_t *pulRank,
+                          size_t ulPos)
+{
+    size_t ulOnes = (size_t)pulRank[ulPos / BLOCK_BITS];
+    size_t w;
+
+    for (w = ulPos / BLOCK_BITS * BLOCK_WORDS; w < ulPos / WORD_BITS; w++)
+        ulOnes += Image_popcount(pulBits[w]);
+    if (ulPos % WORD_BITS != 0)
+        ulOnes += Image_popcount(pulBits[ulPos / WORD_BITS] &
+                                 (((uint64_t)1 << (ulPos % WORD_BITS)) - 1));
+    return ulOnes;
+}
+
+/*
+  Returns the position of zero number ulIndex (counting from 0) in the
+  ulBits bits of pulBits, which must have more than ulIndex zeros.
+*/
+static size_t Image_select0(const uint64_t *pulBits,
+                            const uint64_t *pulRank, size_t ulBits,
+                            size_t ulIndex)
+{
+    size_t ulLow = 0;
+    size_t ulHigh = Image_rankEntriesFor(ulBits) - 1;
+    size_t w;
+
+    /* find the last block starting with at most ulIndex zeros before
+       it; zeros before block k are (k * BLOCK_BITS - ones before it) */
+    while (ulHigh - ulLow > 1)
+    {
+        size_t ulMid = ulLow + (ulHigh - ulLow) / 2;
+        if (ulMid * BLOCK_BITS - (size_t)pulRank[ulMid] <= ulIndex)
+            ulLow = ulMid;
+        else
+            ulHigh = ulMid;
+    }
+    ulIndex -= ulLow * BLOCK_BITS - (size_t)pulRank[ulLow];
+
+    /* then the word, then the bit */
+    for (w = ulLow * BLOCK_WORDS; ; w++)
+    {
+        size_t ulZeros = WORD_BITS - Image_popcount(pulBits[w]);
+        if (ulIndex < ulZeros)
+        {
+            size_t b;
+            for (b = 0; ; b++)
+            {
+                if (((pulBits[w] >> b) & 1) == 0)
+                {
+                    if (ulIndex == 0)
+                        return w * WORD_BITS + b;
+                    ulIndex--;
+                }
+            }
+        }
+        ulIndex -= ulZeros;
+    }
+}
+
+/*--------------------------------------------------------------------*/
+/* Structure navigation                                               */
+/*--------------------------------------------------------------------*/
+
+/* Returns the position of zero number ulIndex of oIImage's LOUDS. */
+static size_t Image_loudsSelect0(Image_T oIImage, size_t ulIndex)
+{
+    return Image_select0(oIImage->pulLouds, oIImage->pulLoudsRank,
+                         2 * (size_t)oIImage->psHeader->ulNumNodes + 1,
+                         ulIndex);
+}
+
+void Image_getChildren(Image_T oIImage, size_t ulNode, size_t *pulFirst,
+                       size_t *pulNumFiles, size_t *pulNumDirs)
+{
+    size_t ulStart, ulDegree;
+
+    assert(oIImage != NULL);
+    assert(pulFirst != NULL);
+    assert(pulNumFiles != NULL);
+    assert(pulNumDirs != NULL);
+
+    /* node ulNode's run of children starts after the (ulNode + 1)th
+       zero of the LOUDS, and each 1 bit in it is one child */
+    ulStart = Image_loudsSelect0(oIImage, ulNode);
+    ulDegree = Image_loudsSelect0(oIImage, ulNode + 1) - ulStart - 1;
+
+    *pulFirst = ulStart - ulNode;
+    *pulNumDirs = Image_rank1(oIImage->pulIsDir, oIImage->pulIsDirRank,
+                              *pulFirst + ulDegree) -
+                  Image_rank1(oIImage->pulIsDir, oIImage->pulIsDirRank,
+                              *pulFirst);
+    *pulNumFiles = ulDegree - *pulNumDirs;
+}
+
+/*--------------------------------------------------------------------*/
+/* Front-coded names                                                  */
+/*--------------------------------------------------------------------*/
+
+/* Appends ulLength bytes at pvBytes to psBuffer. Returns SUCCESS, or
+   MEMORY_ERROR if allocation fails. */
+static int Image_append(struct buffer *psBuffer, const void *pvBytes,
+                        size_t ulLength)
+{
+    if (psBuffer->ulLength + ulLength > psBuffer->ulCapacity)
+    {
+        size_t ulNewCapacity = psBuffer->ulCapacity == 0
+                               ? 1024 : psBuffer->ulCapacity * 2;
+        unsigned char *pucNew;
+        while (ulNewCapacity < psBuffer->ulLength + ulLength)
+            ulNewCapacity *= 2;
+        pucNew = realloc(psBuffer->pucBytes, ulNewCapacity);
+        if (pucNew == NULL)
+            return MEMORY_ERROR;
+        psBuffer->pucBytes = pucNew;
+        psBuffer->ulCapacity = ulNewCapacity;
+    }
+    memcpy(psBuffer->pucBytes + psBuffer->ulLength, pvBytes, ulLength);
+    psBuffer->ulLength += ulLength;
+    return SUCCESS;
+}
+
+/* Appends ulValue to psBuffer as a varint: 7 bits per byte, low bits
+   first, with the high bit set on all bytes but the last. Returns
+   SUCCESS, or MEMORY_ERROR if allocation fails. */
+static int Image_appendVarint(struct buffer *psBuffer, size_t ulValue)
+{
+    unsigned char aucBytes[10];
+    size_t ulLength = 0;
+
+    do
+    {
+        aucBytes[ulLength] = (unsigned char)(ulValue & 0x7F);
+        ulValue >>= 7;
+        if (ulValue != 0)
+            aucBytes[ulLength] |= 0x80;
+        ulLength++;
+    } while (ulValue != 0);
+    return Image_append(psBuffer, aucBytes, ulLength);
+}
+
+/* Returns the varint at *ppucPos, and advances *ppucPos past it. */
+static size_t Image_readVarint(const unsigned char **ppucPos)
+{
+    size_t ulValue = 0;
+    int iShift = 0;
+    unsigned char ucByte;
+
+    do
+    {
+        ucByte = *(*ppucPos)++;
+        ulValue |= (size_t)(ucByte & 0x7F) << iShift;
+        iShift += 7;
+    } while (ucByte & 0x80);
+    return ulValue;
+}
+
+/*
+  Decodes the name entry at *ppucPos into pcName, whose first bytes
+  must hold the previous name in the same bucket and run, and
+  advances *ppucPos past it. Each entry is the length of the prefix
+  shared with the previous name, then the length and the bytes of the
+  rest. Returns the decoded name's length.
+*/
+static size_t Image_readName(const unsigned char **ppucPos, char *pcName)
+{
+    size_t ulShared = Image_readVarint(ppucPos);
+    size_t ulRest = Image_readVarint(ppucPos);
+
+    memcpy(pcName + ulShared, *ppucPos, ulRest);
+    pcName[ulShared + ulRest] = '\0';
+    *ppucPos += ulRest;
+    return ulShared + ulRest;
+}
+
+/* Returns a pointer to the name entry of node ulNode of oIImage,
+   found by skipping from the start of its bucket. */
+static const unsigned char *Image_seekName(Image_T oIImage, size_t ulNode)
+{
+    const unsigned char *pucPos = oIImage->pucNames +
+        oIImage->pulNameIndex[ulNode / NAME_BUCKET];
+    size_t j;
+
+    for (j = ulNode - ulNode % NAME_BUCKET; j < ulNode; j++)
+    {
+        (void)Image_readVarint(&pucPos);
+        pucPos += Image_readVarint(&pucPos);
+    }
+    return pucPos;
+}
+
+const char *Image_getName(Image_T oIImage, size_t ulNode)
+{
+    const unsigned char *pucPos;
+    size_t j;
+
+    assert(oIImage != NULL);
+    assert(ulNode < oIImage->psHeader->ulNumNodes);
+
+    /* decoded into the scratch buffer */
+    pucPos = oIImage->pucNames + oIImage->pulNameIndex[ulNode / NAME_BUCKET];
+    for (j = ulNode - ulNode % NAME_BUCKET; j <= ulNode; j++)
+        (void)Image_readName(&pucPos, oIImage->pcScratch);
+    return oIImage->pcScratch;
+}
+
+/*
+  Binary searches the ulCount consecutive sibling nodes of oIImage
+  starting at ulFirst, which are sorted by name, for one named pcName.
+  Returns TRUE and sets *pulNode to it if found, and FALSE if not.
+*/
+static boolean Image_search(Image_T oIImage, size_t ulFirst,
+                            size_t ulCount, const char *pcName,
+                            size_t *pulNode)
+{
+    size_t ulLow = ulFirst;
+    size_t ulHigh = ulFirst + ulCount;
+
+    while (ulLow < ulHigh)
+    {
+        size_t ulMid = ulLow + (ulHigh - ulLow) / 2;
+        int iCmp = strcmp(Image_getName(oIImage, ulMid), pcName);
+        if (iCmp == 0)
+        {
+            *pulNode = ulMid;
+            return TRUE;
+        }
+        if (iCmp < 0)
+            ulLow = ulMid + 1;
+        else
+            ulHigh = ulMid;
+    }
+    return FALSE;
+}
+
+/* Returns the contents of the file with index ulFile among the files
+   of oIImage. */
+static void *Image_fileContents(Image_T oIImage, size_t ulFile)
+{
+    uint64_t ulRef = oIImage->pulContents[2 * ulFile];
+
+    if (ulRef == IMAGE_NO_CONTENTS)
+        return NULL;
+    if (oIImage->psHeader->ulFlags & IMAGE_CONTENTS_BY_REFERENCE)
+        return (void *)(size_t)ulRef;
+    return (void *)(oIImage->pcData + ulRef);
+}
+
+/*--------------------------------------------------------------------*/
+/* Building and freeing images                                        */
+/*--------------------------------------------------------------------*/
+
+/* Rounds ulBytes up to a multiple of 8. */
+static size_t Image_align(size_t ulBytes)
+{
+    return (ulBytes + 7) & ~(size_t)7;
+}
+
+/*
+  Sets the section offsets and the size in *psHeader, whose counts
+  must be set, for names taking ulNamesLength bytes and file contents
+  taking ulDataLength bytes.
+*/
+static void Image_layout(struct imageHeader *psHeader,
+                         size_t ulNamesLength, size_t ulDataLength)
+{
+    size_t ulNumNodes = (size_t)psHeader->ulNumNodes;
+    size_t ulLoudsBits = 2 * ulNumNodes + 1;
+
+    psHeader->ulLouds = Image_align(sizeof(struct imageHeader));
+    psHeader->ulLoudsRank = psHeader->ulLouds +
+        Image_wordsFor(ulLoudsBits) * sizeof(uint64_t);
+    psHeader->ulIsDir = psHeader->ulLoudsRank +
+        Image_rankEntriesFor(ulLoudsBits) * sizeof(uint64_t);
+    psHeader->ulIsDirRank = psHeader->ulIsDir +
+        Image_wordsFor(ulNumNodes) * sizeof(uint64_t);
+    psHeader->ulNameIndex = psHeader->ulIsDirRank +
+        Image_rankEntriesFor(ulNumNodes) * sizeof(uint64_t);
+    psHeader->ulNames = psHeader->ulNameIndex +
+        (ulNumNodes / NAME_BUCKET + 1) * sizeof(uint64_t);
+    psHeader->ulTotals = psHeader->ulNames + Image_align(ulNamesLength);
+    psHeader->ulContents = psHeader->ulTotals +
+        3 * psHeader->ulNumDirs * sizeof(uint64_t);
+    psHeader->ulData = psHeader->ulContents +
+        2 * psHeader->ulNumFiles * sizeof(uint64_t);
+    psHeader->ulSize = psHeader->ulData + Image_align(ulDataLength);
+}
+
+/*
+  Wraps the complete image block pcBase in a new struct image. The
+  struct takes ownership of pcBase. Returns SUCCESS and sets *poIResult
+  to it, or returns MEMORY_ERROR and sets *poIResult to NULL.
+*/
+static int Image_wrap(char *pcBase, Image_T *poIResult)
+{
+    const struct imageHeader *psHeader =
+        (const struct imageHeader *)pcBase;
+    struct image *psNew;
+
+    assert(psHeader->uMagic == IMAGE_MAGIC);
+    assert(psHeader->uVersion == IMAGE_VERSION);
+
+    *poIResult = NULL;
+    psNew = malloc(sizeof(struct image));
+    if (psNew == NULL)
+        return MEMORY_ERROR;
+    psNew->pcScratch = malloc((size_t)psHeader->ulMaxName + 1);
+    if (psNew->pcScratch == NULL)
+    {
+        free(psNew);
+        return MEMORY_ERROR;
+    }
+
+    psNew->pcBase = pcBase;
+    psNew->ulMapped = 0;
+    psNew->psHeader = psHeader;
+    psNew->pulLouds = (const uint64_t *)(pcBase + psHeader->ulLouds);
+    psNew->pulLoudsRank = (const uint64_t *)(pcBase + psHeader->ulLoudsRank);
+    psNew->pulIsDir = (const uint64_t *)(pcBase + psHeader->ulIsDir);
+    psNew->pulIsDirRank = (const uint64_t *)(pcBase + psHeader->ulIsDirRank);
+    psNew->pulNameIndex = (const uint64_t *)(pcBase + psHeader->ulNameIndex);
+    psNew->pucNames = (const unsigned char *)(pcBase + psHeader->ulNames);
+    psNew->pulTotals = (const uint64_t *)(pcBase + psHeader->ulTotals);
+    psNew->pulContents = (const uint64_t *)(pcBase + psHeader->ulContents);
+    psNew->pcData = pcBase + psHeader->ulData;
+
+    *poIResult = psNew;
+    return SUCCESS;
+}
+
+/*
+  Lists the ulNumNodes nodes of the tree rooted at oNRoot into
+  poNOrder in breadth-first order, each node's children in child
+  identifier order, and encodes their names into psNames, marking in
+  pulNameIndex where each bucket starts. Returns SUCCESS, or
+  MEMORY_ERROR if allocation fails. Stores the longest name's length
+  in *pulMaxName, and the names' total length, counting a '\0' for
+  each, in *pulNameBytes.
+*/
+static int Image_listNodes(Node_T oNRoot, size_t ulNumNodes,
+                           Node_T *poNOrder, struct buffer *psNames,
+                           uint64_t *pulNameIndex, size_t *pulMaxName,
+                           size_t *pulNameBytes)
+{
+    size_t ulHead;
+    size_t ulTail = 1;
+    size_t ulLength;
+    int iStatus;
+
+    *pulMaxName = ulLength = strlen(Node_getName(oNRoot));
+    *pulNameBytes = ulLength + 1;
+    poNOrder[0] = oNRoot;
+    pulNameIndex[0] = 0;
+    iStatus = Image_appendVarint(psNames, 0);
+    if (iStatus == SUCCESS)
+        iStatus = Image_appendVarint(psNames, ulLength);
+    if (iStatus == SUCCESS)
+        iStatus = Image_append(psNames, Node_getName(oNRoot), ulLength);
+
+    for (ulHead = 0; ulHead < ulNumNodes && iStatus == SUCCESS; ulHead++)
+    {
+        Node_T oNParent = poNOrder[ulHead];
+        const char *pcPrevious = NULL;
+        size_t c;
+
+        for (c = 0; c < Node_getNumChildren(oNParent); c++)
+        {
+            Node_T oNChild = NULL_NODE;
+            const char *pcName;
+            size_t ulShared = 0;
+
+            (void)Node_getChild(oNParent, c, &oNChild);
+            assert(ulTail < ulNumNodes);
+            poNOrder[ulTail] = oNChild;
+            pcName = Node_getName(oNChild);
+            ulLength = strlen(pcName);
+            if (ulLength > *pulMaxName)
+                *pulMaxName = ulLength;
+            *pulNameBytes += ulLength + 1;
+
+            /* names are stored whole at the start of each bucket and
+               of each run of siblings */
+            if (ulTail % NAME_BUCKET == 0)
+                pulNameIndex[ulTail / NAME_BUCKET] = psNames->ulLength;
+            else if (pcPrevious != NULL)
+                while (pcPrevious[ulShared] != '\0' &&
+                       pcPrevious[ulShared] == pcName[ulShared])
+                    ulShared++;
+
+            iStatus = Image_appendVarint(psNames, ulShared);
+            if (iStatus == SUCCESS)
+                iStatus = Image_appendVarint(psNames, ulLength - ulShared);
+            if (iStatus == SUCCESS)
+                iStatus = Image_append(psNames, pcName + ulShared,
+                                       ulLength - ulShared);
+            if (iStatus != SUCCESS)
+                break;
+            pcPrevious = pcName;
+            ulTail++;
+        }
+    }
+    return iStatus;
+}
+
+int Image_fromTree(Node_T oNRoot, Image_T *poIResult)
+{
+    struct imageHeader sHeader;
+    struct buffer sNames = {NULL, 0, 0};
+    Node_T *poNOrder;
+    uint64_t *pulNameIndex;
+    size_t ulNumNodes, ulNumDirs, ulNumFiles, ulBytes;
+    size_t ulMaxName = 0;
+    size_t ulNameBytes = 0;
+    size_t ulLoudsBits, ulPos, ulDir, ulFile, i;
+    char *pcBase;
+    uint64_t *pulLouds, *pulIsDir, *pulTotals, *pulContents;
+    int iStatus = SUCCESS;
+
+    assert(poIResult != NULL);
+
+    *poIResult = NULL;
+    ulNumDirs = ulNumFiles = 0;
+    if (oNRoot != NULL_NODE)
+        Node_getTotals(oNRoot, &ulNumDirs, &ulNumFiles, &ulBytes);
+    ulNumNodes = ulNumDirs + ulNumFiles;
+    ulLoudsBits = 2 * ulNumNodes + 1;
+
+    /* list the nodes breadth-first, and encode their names */
+    poNOrder = malloc(ulNumNodes * sizeof(Node_T) + 1);
+    pulNameIndex = malloc((ulNumNodes / NAME_BUCKET + 1) * sizeof(uint64_t));
+    if (poNOrder == NULL || pulNameIndex == NULL)
+    {
+        free(poNOrder);
+        free(pulNameIndex);
+        return MEMORY_ERROR;
+    }
+    pulNameIndex[0] = 0;
+    if (oNRoot != NULL_NODE)
+        iStatus = Image_listNodes(oNRoot, ulNumNodes, poNOrder, &sNames,
+                                  pulNameIndex, &ulMaxName, &ulNameBytes);
+    if (iStatus != SUCCESS)
+    {
+        free(poNOrder);
+        free(pulNameIndex);
+        free(sNames.pucBytes);
+        return iStatus;
+    }
+
+    /* lay out the sections, with the contents held by reference */
+    memset(&sHeader, 0, sizeof(sHeader));
+    sHeader.uMagic = IMAGE_MAGIC;
+    sHeader.uVersion = IMAGE_VERSION;
+    sHeader.ulFlags = IMAGE_CONTENTS_BY_REFERENCE;
+    sHeader.ulNumNodes = ulNumNodes;
+    sHeader.ulNumDirs = ulNumDirs;
+    sHeader.ulNumFiles = ulNumFiles;
+    sHeader.ulMaxName = ulMaxName;
+    sHeader.ulNameBytes = ulNameBytes;
+    Image_layout(&sHeader, sNames.ulLength, 0);
+
+    pcBase = calloc((size_t)sHeader.ulSize, 1);
+    if (pcBase == NULL)
+    {
+        free(poNOrder);
+        free(pulNameIndex);
+        free(sNames.pucBytes);
+        return MEMORY_ERROR;
+    }
+    memcpy(pcBase, &sHeader, sizeof(sHeader));
+    memcpy(pcBase + sHeader.ulNameIndex, pulNameIndex,
+           (ulNumNodes / NAME_BUCKET + 1) * sizeof(uint64_t));
+    if (sNames.ulLength != 0)
+        memcpy(pcBase + sHeader.ulNames, sNames.pucBytes, sNames.ulLength);
+    free(pulNameIndex);
+    free(sNames.pucBytes);
+
+    /* fill in the structure and the per-node data: the LOUDS is "10"
+       for a virtual super-root, then for each node a 1 per child and
+       a closing 0 */
+    pulLouds = (uint64_t *)(pcBase + sHeader.ulLouds);
+    pulIsDir = (uint64_t *)(pcBase + sHeader.ulIsDir);
+    pulTotals = (uint64_t *)(pcBase + sHeader.ulTotals);
+    pulContents = (uint64_t *)(pcBase + sHeader.ulContents);
+    if (ulNumNodes != 0)
+        Image_setBit(pulLouds, 0);
+    ulPos = 2;
+    ulDir = 0;
+    ulFile = 0;
+    for (i = 0; i < ulNumNodes; i++)
+    {
+        Node_T oNNode = poNOrder[i];
+        size_t c;
+
+        for (c = 0; c < Node_getNumChildren(oNNode); c++)
+            Image_setBit(pulLouds, ulPos++);
+        ulPos++;
+
+        if (Node_isDirectory(oNNode) == TRUE)
+        {
+            size_t ulDirs, ulFiles;
+            Image_setBit(pulIsDir, i);
+            Node_getTotals(oNNode, &ulDirs, &ulFiles, &ulBytes);
+            pulTotals[3 * ulDir] = ulDirs;
+            pulTotals[3 * ulDir + 1] = ulFiles;
+            pulTotals[3 * ulDir + 2] = ulBytes;
+            ulDir++;
+        }
+        else
+        {
+            void *pvContents;
+            if (Node_fetchContents(oNNode, &pvContents) != SUCCESS)
+            {
+                free(poNOrder);
+                free(pcBase);
+                return MEMORY_ERROR;
+            }
+            pulContents[2 * ulFile] = pvContents == NULL
+                ? IMAGE_NO_CONTENTS : (uint64_t)(size_t)pvContents;
+            pulContents[2 * ulFile + 1] = Node_getSizeContents(oNNode);
+            ulFile++;
+        }
+    }
+    assert(ulNumNodes == 0 || ulPos == ulLoudsBits);
+    free(poNOrder);
+
+    Image_buildRank(pulLouds, ulLoudsBits,
+                    (uint64_t *)(pcBase + sHeader.ulLoudsRank));
+    Image_buildRank(pulIsDir, ulNumNodes,
+                    (uint64_t *)(pcBase + sHeader.ulIsDirRank));
+
+    iStatus = Image_wrap(pcBase, poIResult);
+    if (iStatus != SUCCESS)
+        free(pcBase);
+    return iStatus;
+}
+
+int Image_toTree(Image_T oIImage, Node_T *poNRoot)
+{
+    const struct imageHeader *psHeader;
+    size_t ulNumNodes;
+    const unsigned char *pucName;
+    Node_T *poNHandles;
+    size_t ulNode, ulNext, ulFile, ulPos;
+    int iStatus;
+
+    assert(oIImage != NULL);
+    assert(poNRoot != NULL);
+
+    *poNRoot = NULL_NODE;
+    psHeader = oIImage->psHeader;
+    ulNumNodes = (size_t)psHeader->ulNumNodes;
+    if (ulNumNodes == 0)
+        return SUCCESS;
+
+    /* allocate for all the nodes at once */
+    iStatus = Node_reserve((size_t)psHeader->ulNumDirs,
+                           (size_t)psHeader->ulNumFiles,
+                           (size_t)psHeader->ulNameBytes);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    poNHandles = malloc(ulNumNodes * sizeof(Node_T));
+    if (poNHandles == NULL)
+        return MEMORY_ERROR;
+
+    /* create the nodes in breadth-first order, so that each node's
+       parent already exists, each directory's children are added in
+       order at the end of its run, and the names decode in sequence */
+    pucName = oIImage->pucNames;
+    (void)Image_readName(&pucName, oIImage->pcScratch);
+    iStatus = Node_new(oIImage->pcScratch, NULL_NODE, &poNHandles[0],
+                       TRUE, NULL, 0);
+    ulNext = 1;
+    ulFile = 0;
+    ulPos = 2;
+    for (ulNode = 0; ulNode < ulNumNodes && iStatus == SUCCESS; ulNode++)
+    {
+        /* each 1 in ulNode's run is its next child */
+        while (Image_getBit(oIImage->pulLouds, ulPos) == TRUE)
+        {
+            (void)Image_readName(&pucName, oIImage->pcScratch);
+            if (Image_getBit(oIImage->pulIsDir, ulNext) == TRUE)
+                iStatus = Node_new(oIImage->pcScratch, poNHandles[ulNode],
+                                   &poNHandles[ulNext], TRUE, NULL, 0);
+            else
+            {
+                iStatus = Node_new(oIImage->pcScratch, poNHandles[ulNode],
+                                   &poNHandles[ulNext], FALSE,
+                                   Image_fileContents(oIImage, ulFile),
+                                   (size_t)oIImage->pulContents[2 * ulFile
+                                                                + 1]);
+                ulFile++;
+            }
+            if (iStatus != SUCCESS)
+                break;
+            ulNext++;
+            ulPos++;
+        }
+        ulPos++;
+    }
+
+    if (iStatus != SUCCESS)
+    {
+        if (poNHandles[0] != NULL_NODE)
+            (void)Node_free(poNHandles[0]);
+        free(poNHandles);
+        return iStatus;
+    }
+    *poNRoot = poNHandles[0];
+    free(poNHandles);
+    return SUCCESS;
+}
+
+void Image_free(Image_T oIImage)
+{
+    if (oIImage == NULL)
+        return;
+    if (oIImage->ulMapped != 0)
+        (void)munmap(oIImage->pcBase, oIImage->ulMapped);
+    else
+        free(oIImage->pcBase);
+    free(oIImage->pcScratch);
+    free(oIImage);
+}
+
+boolean Image_holdsContents(Image_T oIImage)
+{
+    assert(oIImage != NULL);
+    return (boolean)((oIImage->psHeader->ulFlags &
+                      IMAGE_CONTENTS_BY_REFERENCE) == 0);
+}
+
+size_t Image_getSize(Image_T oIImage)
+{
+    assert(oIImage != NULL);
+    return (size_t)oIImage->psHeader->ulSize;
+}
+
+size_t Image_getNumNodes(Image_T oIImage)
+{
+    assert(oIImage != NULL);
+    return (size_t)oIImage->psHeader->ulNumNodes;
+}
+
+size_t Image_getSequence(Image_T oIImage)
+{
+    assert(oIImage != NULL);
+    return (size_t)oIImage->psHeader->ulSequence;
+}
+
+/*--------------------------------------------------------------------*/
+/* Saving and loading images                                          */
+/*--------------------------------------------------------------------*/
+
+/* Words buffered by a struct writer between writes to its file */
+enum { WRITER_WORDS = 8192 };
+
+/* A buffered writer to an image file that checksums what it writes */
+struct writer
+{
+    FILE *psFile;
+
+    /* the bytes not yet written to psFile */
+    uint64_t aulBuffer[WRITER_WORDS];
+    size_t ulFill;
+
+    /* the running sums of Image_checksumWords */
+    uint64_t aulSums[2];
+
+    /* whether a write to psFile has failed */
+    boolean bFailed;
+};
+
+/*
+  Adds the ulWords words at pulWords to the running sums pulSums[0]
+  and pulSums[1] of a Fletcher-style checksum: the first sums the
+  words, and the second sums the first after each word, so that
+  reordering words changes it too. All arithmetic is modulo 2^64.
+*/
+static void Image_checksumWords(uint64_t *pulSums, const uint64_t *pulWords,
+                                size_t ulWords)
+{
+    uint64_t ulSum1 = pulSums[0];
+    uint64_t ulSum2 = pulSums[1];
+    size_t w;
+
+    for (w = 0; w < ulWords; w++)
+    {
+        ulSum1 += pulWords[w];
+        ulSum2 += ulSum1;
+    }
+    pulSums[0] = ulSum1;
+    pulSums[1] = ulSum2;
+}
+
+/* Returns the checksum with running sums pulSums. */
+static uint64_t Image_checksumValue(const uint64_t *pulSums)
+{
+    return pulSums[1] ^ ((pulSums[0] << 32) | (pulSums[0] >> 32));
+}
+
+/* Checksums and writes out the full words buffered in psWriter. */
+static void Image_flush(struct writer *psWriter)
+{
+    size_t ulWords = psWriter->ulFill / sizeof(uint64_t);
+
+    assert(psWriter->ulFill % sizeof(uint64_t) == 0);
+
+    Image_checksumWords(psWriter->aulSums, psWriter->aulBuffer, ulWords);
+    if (fwrite(psWriter->aulBuffer, sizeof(uint64_t), ulWords,
+               psWriter->psFile) != ulWords)
+        psWriter->bFailed = TRUE;
+    psWriter->ulFill = 0;
+}
+
+/* Writes the ulLength bytes at pvBytes (or zeros, if pvBytes is NULL)
+   through psWriter. */
+static void Image_write(struct writer *psWriter, const void *pvBytes,
+                        size_t ulLength)
+{
+    const char *pcBytes = pvBytes;
+
+    while (ulLength != 0)
+    {
+        size_t ulChunk = sizeof(psWriter->aulBuffer) - psWriter->ulFill;
+        if (ulChunk > ulLength)
+            ulChunk = ulLength;
+        if (pcBytes != NULL)
+        {
+            memcpy((char *)psWriter->aulBuffer + psWriter->ulFill, pcBytes,
+                   ulChunk);
+            pcBytes += ulChunk;
+        }
+        else
+            memset((char *)psWriter->aulBuffer + psWriter->ulFill, 0,
+                   ulChunk);
+        psWriter->ulFill += ulChunk;
+        ulLength -= ulChunk;
+        if (psWriter->ulFill == sizeof(psWriter->aulBuffer))
+            Image_flush(psWriter);
+    }
+}
+
+/* Writes the word ulWord through psWriter. */
+static void Image_writeWord(struct writer *psWriter, uint64_t ulWord)
+{
+    Image_write(psWriter, &ulWord, sizeof(uint64_t));
+}
+
+/*
+  Writes oIImage to the open file psFile in the saved format, with
+  sequence number ulSequence: the contents are copied into a data
+  section at the end, and each file's contents reference becomes an
+  offset into it. Returns SUCCESS,
+  MEMORY_ERROR if allocation fails, or IO_ERROR if writing fails.
+*/
+static int Image_writeFile(Image_T oIImage, FILE *psFile,
+                           size_t ulSequence)
+{
+    const struct imageHeader *psHeader = oIImage->psHeader;
+    struct imageHeader sHeader;
+    struct writer *psWriter;
+    size_t ulNumFiles = (size_t)psHeader->ulNumFiles;
+    size_t ulDataLength = 0;
+    size_t f;
+    int iStatus = SUCCESS;
+
+    psWriter = malloc(sizeof(struct writer));
+    if (psWriter == NULL)
+        return MEMORY_ERROR;
+    psWriter->psFile = psFile;
+    psWriter->ulFill = 0;
+    psWriter->aulSums[0] = psWriter->aulSums[1] = 0;
+    psWriter->bFailed = FALSE;
+
+    for (f = 0; f < ulNumFiles; f++)
+        if (Image_fileContents(oIImage, f) != NULL)
+            ulDataLength += (size_t)oIImage->pulContents[2 * f + 1];
+
+    /* the header, with the checksum 0 for now, and the sections up to
+       the contents table are written as they are */
+    sHeader = *psHeader;
+    sHeader.ulFlags &= ~(uint64_t)IMAGE_CONTENTS_BY_REFERENCE;
+    sHeader.ulChecksum = 0;
+    sHeader.ulSequence = ulSequence;
+    Image_layout(&sHeader, (size_t)(psHeader->ulTotals - psHeader->ulNames),
+                 ulDataLength);
+    assert(sHeader.ulContents == psHeader->ulContents);
+    Image_write(psWriter, &sHeader, sizeof(sHeader));
+    Image_write(psWriter, oIImage->pcBase + sizeof(sHeader),
+                (size_t)sHeader.ulContents - sizeof(sHeader));
+
+    /* the contents table, with offsets into the data section */
+    ulDataLength = 0;
+    for (f = 0; f < ulNumFiles; f++)
+    {
+        size_t ulLength = (size_t)oIImage->pulContents[2 * f + 1];
+        if (Image_fileContents(oIImage, f) == NULL)
+            Image_writeWord(psWriter, IMAGE_NO_CONTENTS);
+        else
+        {
+            Image_writeWord(psWriter, ulDataLength);
+            ulDataLength += ulLength;
+        }
+        Image_writeWord(psWriter, ulLength);
+    }
+
+    /* the data section */
+    for (f = 0; f < ulNumFiles; f++)
+    {
+        const void *pvContents = Image_fileContents(oIImage, f);
+        if (pvContents != NULL)
+            Image_write(psWriter, pvContents,
+                        (size_t)oIImage->pulContents[2 * f + 1]);
+    }
+    Image_write(psWriter, NULL, Image_align(ulDataLength) - ulDataLength);
+    Image_flush(psWriter);
+
+    /* now the checksum is known */
+    sHeader.ulChecksum = Image_checksumValue(psWriter->aulSums);
+    if (psWriter->bFailed || fseek(psFile, 0L, SEEK_SET) != 0 ||
+        fwrite(&sHeader, sizeof(sHeader), 1, psFile) != 1 ||
+        fflush(psFile) != 0 || fsync(fileno(psFile)) != 0)
+        iStatus = IO_ERROR;
+
+    free(psWriter);
+    return iStatus;
+}
+
+int Image_save(Image_T oIImage, const char *pcFile, size_t ulSequence)
+{
+    char *pcTemp;
+    FILE *psFile;
+    int iStatus;
+
+    assert(oIImage != NULL);
+    assert(pcFile != NULL);
+
+    /* write to a temporary file, then rename it, so that pcFile is
+       never left holding part of an image */
+    pcTemp = malloc(strlen(pcFile) + sizeof(".tmp"));
+    if (pcTemp == NULL)
+        return MEMORY_ERROR;
+    strcpy(pcTemp, pcFile);
+    strcat(pcTemp, ".tmp");
+
+    psFile = fopen(pcTemp, "wb");
+    if (psFile == NULL)
+    {
+        free(pcTemp);
+        return IO_ERROR;
+    }
+    iStatus = Image_writeFile(oIImage, psFile, ulSequence);
+    if (fclose(psFile) != 0 && iStatus == SUCCESS)
+        iStatus = IO_ERROR;
+    if (iStatus == SUCCESS && rename(pcTemp, pcFile) != 0)
+        iStatus = IO_ERROR;
+    if (iStatus != SUCCESS)
+        (void)remove(pcTemp);
+
+    free(pcTemp);
+    return iStatus;
+}
+
+/*
+  Reads the varint at *ppucPos, which must end before pucEnd, into
+  *pulValue, and advances *ppucPos past it. Returns TRUE, or FALSE if
+  it does not end in time.
+*/
+static boolean Image_readVarintBounded(const unsigned char **ppucPos,
+                                       const unsigned char *pucEnd,
+                                       size_t *pulValue)
+{
+    size_t ulValue = 0;
+    int iShift = 0;
+    unsigned char ucByte;
+
+    do
+    {
+        if (*ppucPos == pucEnd || iShift > 56)
+            return FALSE;
+        ucByte = *(*ppucPos)++;
+        ulValue |= (size_t)(ucByte & 0x7F) << iShift;
+        iShift += 7;
+    } while (ucByte & 0x80);
+    *pulValue = ulValue;
+    return TRUE;
+}
+
+/*
+  Returns TRUE if the ulBits bits of pulBits, whose padding to a whole
+  word must be zeros, hold ulOnes ones, and pulRank is their rank
+  directory. Returns FALSE if not.
+*/
+static boolean Image_checkBits(const uint64_t *pulBits,
+                               const uint64_t *pulRank, size_t ulBits,
+                               size_t ulOnes)
+{
+    size_t ulWords = Image_wordsFor(ulBits);
+    size_t ulCount = 0;
+    size_t w;
+
+    if (ulBits % WORD_BITS != 0 &&
+        (pulBits[ulWords - 1] >> (ulBits % WORD_BITS)) != 0)
+        return FALSE;
+    for (w = 0; w < ulWords; w++)
+    {
+        if (w % BLOCK_WORDS == 0 && pulRank[w / BLOCK_WORDS] != ulCount)
+            return FALSE;
+        ulCount += Image_popcount(pulBits[w]);
+    }
+    return (boolean)(pulRank[(ulWords + BLOCK_WORDS - 1) / BLOCK_WORDS] ==
+                     ulCount && ulCount == ulOnes);
+}
+
+/*
+  Decodes, with bounds checks, the name entry of node ulIndex at
+  *ppucPos, which must end before pucEnd, and advances *ppucPos past
+  it. bRunStart tells if the node is the first child of its parent,
+  and *pulPrevious holds the previous name's length, which is updated.
+  Returns TRUE if the entry is well-formed: it shares a prefix only
+  with the previous name in its bucket and run, its name is not empty
+  and at most ulMaxName characters long, and if it starts a bucket,
+  pulNameIndex points to it. Returns FALSE if not.
+*/
+static boolean Image_checkName(const unsigned char **ppucPos,
+                               const unsigned char *pucNames,
+                               const unsigned char *pucEnd,
+                               const uint64_t *pulNameIndex,
+                               size_t ulIndex, boolean bRunStart,
+                               size_t ulMaxName, size_t *pulPrevious)
+{
+    size_t ulShared, ulRest;
+
+    if (ulIndex % NAME_BUCKET == 0 &&
+        pulNameIndex[ulIndex / NAME_BUCKET] != (size_t)(*ppucPos - pucNames))
+        return FALSE;
+    if (!Image_readVarintBounded(ppucPos, pucEnd, &ulShared) ||
+        !Image_readVarintBounded(ppucPos, pucEnd, &ulRest))
+        return FALSE;
+    if (ulShared != 0 && (bRunStart || ulIndex % NAME_BUCKET == 0 ||
+                          ulShared > *pulPrevious))
+        return FALSE;
+    if (ulRest > (size_t)(pucEnd - *ppucPos) || ulShared + ulRest == 0 ||
+        ulShared + ulRest > ulMaxName)
+        return FALSE;
+    *ppucPos += ulRest;
+    *pulPrevious = ulShared + ulRest;
+    return TRUE;
+}
+
+/*
+  Returns TRUE if the LOUDS and the names of the image at pcBase,
+  whose sections are known to be in place, describe a tree: the root
+  is a directory, each node is listed as a directory's child before
+  its own children are, only directories have children, and each name
+  entry is well-formed. Returns FALSE if not.
+*/
+static boolean Image_checkTree(const char *pcBase)
+{
+    const struct imageHeader *psHeader =
+        (const struct imageHeader *)pcBase;
+    const uint64_t *pulLouds = (const uint64_t *)(pcBase + psHeader->ulLouds);
+    const uint64_t *pulIsDir = (const uint64_t *)(pcBase + psHeader->ulIsDir);
+    const uint64_t *pulNameIndex =
+        (const uint64_t *)(pcBase + psHeader->ulNameIndex);
+    const unsigned char *pucNames =
+        (const unsigned char *)(pcBase + psHeader->ulNames);
+    const unsigned char *pucEnd =
+        (const unsigned char *)(pcBase + psHeader->ulTotals);
+    const unsigned char *pucPos = pucNames;
+    size_t ulNumNodes = (size_t)psHeader->ulNumNodes;
+    size_t ulMaxName = (size_t)psHeader->ulMaxName;
+    size_t ulLoudsBits = 2 * ulNumNodes + 1;
+    size_t ulPrevious = 0;
+    size_t ulNode, ulNext, ulPos;
+
+    if (ulNumNodes == 0)
+        return TRUE;
+    if (!Image_getBit(pulLouds, 0) || Image_getBit(pulLouds, 1) ||
+        !Image_getBit(pulIsDir, 0) ||
+        !Image_checkName(&pucPos, pucNames, pucEnd, pulNameIndex, 0, TRUE,
+                         ulMaxName, &ulPrevious))
+        return FALSE;
+
+    /* walk the LOUDS as Image_toTree does */
+    ulNext = 1;
+    ulPos = 2;
+    for (ulNode = 0; ulNode < ulNumNodes; ulNode++)
+    {
+        boolean bRunStart = TRUE;
+
+        if (ulNode >= ulNext)
+            return FALSE;
+        while (ulPos < ulLoudsBits && Image_getBit(pulLouds, ulPos))
+        {
+            if (ulNext >= ulNumNodes || !Image_getBit(pulIsDir, ulNode) ||
+                !Image_checkName(&pucPos, pucNames, pucEnd, pulNameIndex,
+                                 ulNext, bRunStart, ulMaxName,
+                                 &ulPrevious))
+                return FALSE;
+            bRunStart = FALSE;
+            ulNext++;
+            ulPos++;
+        }
+        ulPos++;
+    }
+    return (boolean)(ulNext == ulNumNodes && ulPos == ulLoudsBits);
+}
+
+/*
+  Returns TRUE if *psHeader, whose magic number and version are right,
+  describes a saved image of ulSize bytes: its counts are plausible,
+  and each section is exactly where they put it. Returns FALSE if not.
+*/
+static boolean Image_checkLayout(const struct imageHeader *psHeader,
+                                 size_t ulSize)
+{
+    struct imageHeader sExpected;
+
+    /* the counts must be plausible before any offset is computed from
+       them */
+    if (psHeader->ulFlags != 0 || psHeader->ulSize != ulSize ||
+        psHeader->ulNumNodes > ulSize ||
+        psHeader->ulNumDirs + psHeader->ulNumFiles != psHeader->ulNumNodes ||
+        psHeader->ulNumDirs > ulSize || psHeader->ulNumFiles > ulSize ||
+        psHeader->ulMaxName > ulSize || psHeader->ulNames > ulSize ||
+        psHeader->ulTotals > ulSize || psHeader->ulData > ulSize)
+        return FALSE;
+
+    sExpected = *psHeader;
+    Image_layout(&sExpected, 0, 0);
+    if (psHeader->ulTotals < sExpected.ulNames ||
+        psHeader->ulData < sExpected.ulData)
+        return FALSE;
+    Image_layout(&sExpected, (size_t)(psHeader->ulTotals - psHeader->ulNames),
+                 (size_t)(psHeader->ulSize - psHeader->ulData));
+    return (boolean)(memcmp(&sExpected, psHeader, sizeof(sExpected)) == 0);
+}
+
+/*
+  Returns TRUE if the ulSize bytes at pcBase, starting with a header
+  whose magic number and version are right, are a well-formed saved
+  image: the checksum matches, the layout is right, and the structure,
+  names, and contents references are consistent. Returns FALSE if not.
+*/
+static boolean Image_check(const char *pcBase, size_t ulSize)
+{
+    const struct imageHeader *psHeader =
+        (const struct imageHeader *)pcBase;
+    struct imageHeader sHeader;
+    uint64_t aulSums[2] = {0, 0};
+    const uint64_t *pulContents;
+    size_t ulDataLength, f;
+
+    /* the checksum covers everything, with itself taken as 0 */
+    sHeader = *psHeader;
+    sHeader.ulChecksum = 0;
+    Image_checksumWords(aulSums, (const uint64_t *)(void *)&sHeader,
+                        sizeof(sHeader) / sizeof(uint64_t));
+    Image_checksumWords(aulSums,
+                        (const uint64_t *)(pcBase + sizeof(sHeader)),
+                        (ulSize - sizeof(sHeader)) / sizeof(uint64_t));
+    if (Image_checksumValue(aulSums) != psHeader->ulChecksum)
+        return FALSE;
+
+    if (!Image_checkLayout(psHeader, ulSize))
+        return FALSE;
+
+    /* the bitvectors and their rank directories */
+    if (!Image_checkBits((const uint64_t *)(pcBase + psHeader->ulLouds),
+                         (const uint64_t *)(pcBase + psHeader->ulLoudsRank),
+                         2 * (size_t)psHeader->ulNumNodes + 1,
+                         (size_t)psHeader->ulNumNodes) ||
+        !Image_checkBits((const uint64_t *)(pcBase + psHeader->ulIsDir),
+                         (const uint64_t *)(pcBase + psHeader->ulIsDirRank),
+                         (size_t)psHeader->ulNumNodes,
+                         (size_t)psHeader->ulNumDirs))
+        return FALSE;
+    if (!Image_checkTree(pcBase))
+        return FALSE;
+
+    /* every file's contents must lie within the data section */
+    pulContents = (const uint64_t *)(pcBase + psHeader->ulContents);
+    ulDataLength = (size_t)(psHeader->ulSize - psHeader->ulData);
+    for (f = 0; f < psHeader->ulNumFiles; f++)
+        if (pulContents[2 * f] != IMAGE_NO_CONTENTS &&
+            (pulContents[2 * f] > ulDataLength ||
+             pulContents[2 * f + 1] > ulDataLength - pulContents[2 * f]))
+            return FALSE;
+    return TRUE;
+}
+
+int Image_load(const char *pcFile, Image_T *poIResult)
+{
+    struct imageHeader sHeader;
+    FILE *psFile;
+    char *pcBase;
+    long lSize;
+    size_t ulSize;
+    int iStatus;
+
+    assert(pcFile != NULL);
+    assert(poIResult != NULL);
+
+    *poIResult = NULL;
+    psFile = fopen(pcFile, "rb");
+    if (psFile == NULL)
+        return IO_ERROR;
+
+    /* read the header, then the rest of the image in one go */
+    if (fread(&sHeader, sizeof(sHeader), 1, psFile) != 1)
+    {
+        iStatus = ferror(psFile) ? IO_ERROR : CORRUPT_IMAGE;
+        fclose(psFile);
+        return iStatus;
+    }
+    if (sHeader.uMagic != IMAGE_MAGIC || sHeader.uVersion != IMAGE_VERSION)
+    {
+        fclose(psFile);
+        return CORRUPT_IMAGE;
+    }
+
+    /* the size recorded must be the file's */
+    if (fseek(psFile, 0L, SEEK_END) != 0 || (lSize = ftell(psFile)) < 0 ||
+        fseek(psFile, (long)sizeof(sHeader), SEEK_SET) != 0)
+    {
+        fclose(psFile);
+        return IO_ERROR;
+    }
+    ulSize = (size_t)lSize;
+    if (ulSize != sHeader.ulSize || ulSize % sizeof(uint64_t) != 0)
+    {
+        fclose(psFile);
+        return CORRUPT_IMAGE;
+    }
+    pcBase = malloc(ulSize);
+    if (pcBase == NULL)
+    {
+        fclose(psFile);
+        return MEMORY_ERROR;
+    }
+    memcpy(pcBase, &sHeader, sizeof(sHeader));
+    if (fread(pcBase + sizeof(sHeader), 1, ulSize - sizeof(sHeader),
+              psFile) != ulSize - sizeof(sHeader))
+    {
+        iStatus = ferror(psFile) ? IO_ERROR : CORRUPT_IMAGE;
+        fclose(psFile);
+        free(pcBase);
+        return iStatus;
+    }
+    fclose(psFile);
+
+    if (!Image_check(pcBase, ulSize))
+    {
+        free(pcBase);
+        return CORRUPT_IMAGE;
+    }
+    iStatus = Image_wrap(pcBase, poIResult);
+    if (iStatus != SUCCESS)
+        free(pcBase);
+    return iStatus;
+}
+
+int Image_map(const char *pcFile, Image_T *poIResult)
+{
+    const struct imageHeader *psHeader;
+    struct stat sStat;
+    void *pvBase;
+    size_t ulSize;
+    int iFd;
+    int iStatus;
+
+    assert(pcFile != NULL);
+    assert(poIResult != NULL);
+
+    *poIResult = NULL;
+    iFd = open(pcFile, O_RDONLY);
+    if (iFd < 0)
+        return IO_ERROR;
+    if (fstat(iFd, &sStat) != 0)
+    {
+        (void)close(iFd);
+        return IO_ERROR;
+    }
+    ulSize = (size_t)sStat.st_size;
+    if (ulSize < sizeof(struct imageHeader) ||
+        ulSize % sizeof(uint64_t) != 0)
+    {
+        (void)close(iFd);
+        return CORRUPT_IMAGE;
+    }
+
+    /* the mapping outlives the descriptor */
+    pvBase = mmap(NULL, ulSize, PROT_READ, MAP_SHARED, iFd, 0);
+    (void)close(iFd);
+    if (pvBase == MAP_FAILED)
+        return IO_ERROR;
+
+    /* only the header's page is read here */
+    psHeader = (const struct imageHeader *)pvBase;
+    if (psHeader->uMagic != IMAGE_MAGIC ||
+        psHeader->uVersion != IMAGE_VERSION ||
+        !Image_checkLayout(psHeader, ulSize))
+    {
+        (void)munmap(pvBase, ulSize);
+        return CORRUPT_IMAGE;
+    }
+
+    iStatus = Image_wrap((char *)pvBase, poIResult);
+    if (iStatus != SUCCESS)
+    {
+        (void)munmap(pvBase, ulSize);
+        return iStatus;
+    }
+    (*poIResult)->ulMapped = ulSize;
+    return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+/* Queries                                                            */
+/*--------------------------------------------------------------------*/
+
+int Image_find(Image_T oIImage, Path_T oPPath, size_t *pulNode)
+{
+    size_t ulNode = 0;
+    size_t ulDepth, i;
+
+    assert(oIImage != NULL);
+    assert(oPPath != NULL);
+    assert(pulNode != NULL);
+
+    if (strcmp(Image_getName(oIImage, 0), Path_getComponent(oPPath, 0)))
+        return CONFLICTING_PATH;
+
+    ulDepth = Path_getDepth(oPPath);
+    for (i = 1; i < ulDepth; i++)
+    {
+        if (Image_isDirectory(oIImage, ulNode) == FALSE)
+            return NO_SUCH_PATH;
+        if (!Image_hasChild(oIImage, ulNode, Path_getComponent(oPPath, i),
+                            &ulNode))
+            return NO_SUCH_PATH;
+    }
+
+    *pulNode = ulNode;
+    return SUCCESS;
+}
+
+boolean Image_hasChild(Image_T oIImage, size_t ulDir, const char *pcName,
+                       size_t *pulNode)
+{
+    size_t ulFirst, ulNumFiles, ulNumDirs;
+
+    assert(oIImage != NULL);
+    assert(pcName != NULL);
+    assert(pulNode != NULL);
+
+    Image_getChildren(oIImage, ulDir, &ulFirst, &ulNumFiles, &ulNumDirs);
+    return (boolean)
+        (Image_search(oIImage, ulFirst, ulNumFiles, pcName, pulNode) ||
+         Image_search(oIImage, ulFirst + ulNumFiles, ulNumDirs, pcName,
+                      pulNode));
+}
+
+size_t Image_findPrefix(Image_T oIImage, size_t ulDir, boolean bDirs,
+                        const char *pcPrefix, size_t ulLength)
+{
+    size_t ulFirst, ulNumFiles, ulNumDirs;
+    size_t ulLow, ulHigh;
+
+    assert(oIImage != NULL);
+    assert(pcPrefix != NULL);
+
+    Image_getChildren(oIImage, ulDir, &ulFirst, &ulNumFiles, &ulNumDirs);
+    ulLow = bDirs ? ulFirst + ulNumFiles : ulFirst;
+    ulHigh = bDirs ? ulFirst + ulNumFiles + ulNumDirs :
+             ulFirst + ulNumFiles;
+    while (ulLow < ulHigh)
+    {
+        size_t ulMid = ulLow + (ulHigh - ulLow) / 2;
+        if (strncmp(Image_getName(oIImage, ulMid), pcPrefix, ulLength) < 0)
+            ulLow = ulMid + 1;
+        else
+            ulHigh = ulMid;
+    }
+    return ulLow;
+}
+
+boolean Image_isDirectory(Image_T oIImage, size_t ulNode)
+{
+    assert(oIImage != NULL);
+    assert(ulNode < oIImage->psHeader->ulNumNodes);
+    return Image_getBit(oIImage->pulIsDir, ulNode);
+}
+
+/* Returns the index among the files of oIImage of file ulNode. */
+static size_t Image_fileIndex(Image_T oIImage, size_t ulNode)
+{
+    return ulNode - Image_rank1(oIImage->pulIsDir, oIImage->pulIsDirRank,
+                                ulNode);
+}
+
+void *Image_getContents(Image_T oIImage, size_t ulNode)
+{
+    assert(oIImage != NULL);
+
+    if (Image_isDirectory(oIImage, ulNode) == TRUE)
+        return NULL;
+    return Image_fileContents(oIImage, Image_fileIndex(oIImage, ulNode));
+}
+
+size_t Image_getSizeContents(Image_T oIImage, size_t ulNode)
+{
+    assert(oIImage != NULL);
+
+    if (Image_isDirectory(oIImage, ulNode) == TRUE)
+        return 0;
+    return (size_t)
+        oIImage->pulContents[2 * Image_fileIndex(oIImage, ulNode) + 1];
+}
+
+void Image_getTotals(Image_T oIImage, size_t ulNode, size_t *pulDirs,
+                     size_t *pulFiles, size_t *pulBytes)
+{
+    assert(oIImage != NULL);
+    assert(pulDirs != NULL);
+    assert(pulFiles != NULL);
+    assert(pulBytes != NULL);
+
+    if (Image_isDirectory(oIImage, ulNode) == TRUE)
+    {
+        const uint64_t *pulTotals = oIImage->pulTotals + 3 *
+            Image_rank1(oIImage->pulIsDir, oIImage->pulIsDirRank, ulNode);
+        *pulDirs = (size_t)pulTotals[0];
+        *pulFiles = (size_t)pulTotals[1];
+        *pulBytes = (size_t)pulTotals[2];
+    }
+    else
+    {
+        *pulDirs = 0;
+        *pulFiles = 1;
+        *pulBytes = Image_getSizeContents(oIImage, ulNode);
+    }
+}
+
+/*
+  Sums, for each node in the subtree rooted at node ulNode of oIImage,
+  whose path is ulPathLen characters long, the length of its path plus
+  one (for its newline). Returns the sum.
+*/
+static size_t Image_strlenSubtree(Image_T oIImage, size_t ulNode,
+                                  size_t ulPathLen)
+{
+    size_t ulAcc = ulPathLen + 1;
+    size_t ulFirst, ulNumFiles, ulNumDirs, c;
+    const unsigned char *pucPos;
+
+    if (Image_isDirectory(oIImage, ulNode) == FALSE)
+        return ulAcc;
+
+    Image_getChildren(oIImage, ulNode, &ulFirst, &ulNumFiles, &ulNumDirs);
+    if (ulNumFiles + ulNumDirs == 0)
+        return ulAcc;
+    pucPos = Image_seekName(oIImage, ulFirst);
+    for (c = ulFirst; c < ulFirst + ulNumFiles + ulNumDirs; c++)
+    {
+        /* only the length of each name is needed */
+        size_t ulShared = Image_readVarint(&pucPos);
+        size_t ulRest = Image_readVarint(&pucPos);
+        pucPos += ulRest;
+        if (c < ulFirst + ulNumFiles)
+            ulAcc += ulPathLen + 1 + ulShared + ulRest + 1;
+        else
+            ulAcc += Image_strlenSubtree(oIImage, c, ulPathLen + 1 +
+                                         ulShared + ulRest);
+    }
+    return ulAcc;
+}
+
+/*
+  Writes into pcAcc the path of each node strictly below node ulNode of
+  oIImage, each followed by a newline, in pre-order with files before
+  directories. ulNode's own path is the ulPathLen characters at
+  pcPath. Returns the position in pcAcc just past what was written.
+*/
+static char *Image_strcatSubtree(Image_T oIImage, size_t ulNode,
+                                 const char *pcPath, size_t ulPathLen,
+                                 char *pcAcc)
+{
+    size_t ulFirst, ulNumFiles, ulNumDirs, c;
+    const unsigned char *pucPos;
+    const char *pcPrevious = NULL;
+
+    if (Image_isDirectory(oIImage, ulNode) == FALSE)
+        return pcAcc;
+
+    Image_getChildren(oIImage, ulNode, &ulFirst, &ulNumFiles, &ulNumDirs);
+    if (ulNumFiles + ulNumDirs == 0)
+        return pcAcc;
+    pucPos = Image_seekName(oIImage, ulFirst);
+    for (c = ulFirst; c < ulFirst + ulNumFiles + ulNumDirs; c++)
+    {
+        /* the shared prefix comes from the previous sibling's name,
+           which was written out just before */
+        char *pcLine = pcAcc;
+        size_t ulShared = Image_readVarint(&pucPos);
+        size_t ulRest = Image_readVarint(&pucPos);
+
+        memcpy(pcAcc, pcPath, ulPathLen);
+        pcAcc += ulPathLen;
+        *pcAcc++ = '/';
+        if (ulShared != 0)
+            memcpy(pcAcc, pcPrevious, ulShared);
+        pcPrevious = pcAcc;
+        memcpy(pcAcc + ulShared, pucPos, ulRest);
+        pucPos += ulRest;
+        pcAcc += ulShared + ulRest;
+        *pcAcc++ = '\n';
+
+        if (c >= ulFirst + ulNumFiles)
+            pcAcc = Image_strcatSubtree(oIImage, c, pcLine,
+                                        (size_t)(pcAcc - pcLine) - 1,
+                                        pcAcc);
+    }
+    return pcAcc;
+}
+
+char *Image_toString(Image_T oIImage)
+{
+    size_t ulRootLen;
+    char *pcResult;
+    char *pcEnd;
+
+    assert(oIImage != NULL);
+
+    ulRootLen = strlen(Image_getName(oIImage, 0));
+    pcResult = malloc(Image_strlenSubtree(oIImage, 0, ulRootLen) + 1);
+    if (pcResult == NULL)
+        return NULL;
+
+    memcpy(pcResult, Image_getName(oIImage, 0), ulRootLen);
+    pcResult[ulRootLen] = '\n';
+    pcEnd = Image_strcatSubtree(oIImage, 0, pcResult, ulRootLen,
+                                pcResult + ulRootLen + 1);
+    *pcEnd = '\0';
+    return pcResult;
+}
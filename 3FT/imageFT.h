@@ -0,0 +1,173 @@
+/*--------------------------------------------------------------------*/
+/* imageFT.h                                                          */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef IMAGE_INCLUDED
+#define IMAGE_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+#include "path.h"
+#include "nodeFT.h"
+
+/*
+  An Image_T is an immutable, succinct encoding of a whole File Tree
+  in one contiguous block of memory:
+  * the structure, as the LOUDS (level-order unary degree sequence)
+    bitvector of the nodes in breadth-first order, with a rank
+    directory so that a node's children are found in O(log n)
+  * a bitvector telling directories from files
+  * the names, front-coded in blocks per directory
+  * each directory's subtree totals, and each file's contents
+  Nodes of an image are identified by their breadth-first number: the
+  root is node 0, and the children of a node are consecutive, files
+  first, then directories, each in lexicographic order.
+*/
+typedef struct image *Image_T;
+
+/*
+  Encodes the tree rooted at oNRoot (or an empty tree, if oNRoot is
+  NULL_NODE) as a new image. File contents are kept by reference:
+  the image remembers each file's contents pointer, not the bytes it
+  points to.
+  Returns SUCCESS and sets *poIResult to the new image, or returns
+  MEMORY_ERROR and sets *poIResult to NULL.
+*/
+int Image_fromTree(Node_T oNRoot, Image_T *poIResult);
+
+/*
+  Decodes oIImage back into a tree of nodes, with the files' contents
+  referring to those of the image if it holds them. Returns SUCCESS
+  and sets *poNRoot to the new tree's root (NULL_NODE if the image is
+  of an empty tree), or returns MEMORY_ERROR and sets *poNRoot to
+  NULL_NODE, having created no nodes.
+*/
+int Image_toTree(Image_T oIImage, Node_T *poNRoot);
+
+/*
+  Saves oIImage to the file named pcFile, replacing it, in a versioned
+  and checksummed format that holds the file contents too, along with
+  the sequence number ulSequence, which the caller chooses and
+  Image_getSequence returns once the file is loaded or mapped. The
+  image is written to pcFile.tmp first and then renamed, so pcFile is
+  never left holding part of an image.
+  Returns SUCCESS, MEMORY_ERROR if allocation fails, or IO_ERROR if
+  the file cannot be written.
+*/
+int Image_save(Image_T oIImage, const char *pcFile, size_t ulSequence);
+
+/*
+  Loads the image saved in the file named pcFile into one block of
+  memory, which also holds the file contents: they stay valid until
+  the image is freed. Returns SUCCESS and sets *poIResult to the new
+  image. Otherwise, sets *poIResult to NULL and returns:
+  * IO_ERROR if the file cannot be opened or read
+  * CORRUPT_IMAGE if it is not a saved image of this version, or its
+    checksum or structure is wrong
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Image_load(const char *pcFile, Image_T *poIResult);
+
+/*
+  Maps the image saved in the file named pcFile read-only into memory,
+  without reading it: pages are read in as queries touch them, and are
+  shared through the page cache with other processes mapping the same
+  file. Only the header and the layout of the sections are checked,
+  as checking the checksum or the structure would read the whole
+  file; use Image_load for files that may be damaged. The file must
+  not be truncated while mapped. The file contents stay valid until
+  the image is freed. Returns SUCCESS and sets *poIResult to the new
+  image. Otherwise, sets *poIResult to NULL and returns:
+  * IO_ERROR if the file cannot be opened or mapped
+  * CORRUPT_IMAGE if it is not a saved image of this version, or its
+    layout is wrong
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Image_map(const char *pcFile, Image_T *poIResult);
+
+/* Returns TRUE if oIImage holds its files' contents itself, as loaded
+   and mapped images do, and FALSE if it refers to contents held
+   elsewhere. */
+boolean Image_holdsContents(Image_T oIImage);
+
+/* Destroys and frees all memory allocated for oIImage. */
+void Image_free(Image_T oIImage);
+
+/* Returns the number of bytes of memory oIImage occupies. */
+size_t Image_getSize(Image_T oIImage);
+
+/* Returns the number of nodes in oIImage. */
+size_t Image_getNumNodes(Image_T oIImage);
+
+/* Returns the sequence number oIImage was saved with, or 0 if it was
+   not loaded or mapped from a file. */
+size_t Image_getSequence(Image_T oIImage);
+
+/*
+  Looks up absolute path oPPath in oIImage. Returns SUCCESS and sets
+  *pulNode to the node with that path, if found. Otherwise, returns
+  * CONFLICTING_PATH if the root's path is not a prefix of oPPath
+  * NO_SUCH_PATH if no node with oPPath exists in the image
+*/
+int Image_find(Image_T oIImage, Path_T oPPath, size_t *pulNode);
+
+/*
+  Stores in *pulFirst the first child of directory ulNode of oIImage,
+  and in *pulNumFiles and *pulNumDirs how many of its children are
+  files and directories. The children are the consecutive nodes from
+  *pulFirst on: the files first, then the directories, each in
+  lexicographic order.
+*/
+void Image_getChildren(Image_T oIImage, size_t ulNode, size_t *pulFirst,
+                       size_t *pulNumFiles, size_t *pulNumDirs);
+
+/* Returns the name of node ulNode of oIImage, which is only valid
+   until the next call that reads a name from oIImage. */
+const char *Image_getName(Image_T oIImage, size_t ulNode);
+
+/*
+  Returns TRUE and sets *pulNode to the child of directory ulDir of
+  oIImage named pcName, if it has one, and returns FALSE if not.
+*/
+boolean Image_hasChild(Image_T oIImage, size_t ulDir, const char *pcName,
+                       size_t *pulNode);
+
+/*
+  Returns the first child of directory ulDir of oIImage that is a
+  directory if bDirs is TRUE, or a file if not, whose name's first
+  ulLength characters are not less than the ulLength characters at
+  pcPrefix, as Node_findPrefix does, or the node after the last
+  child of that kind if there is none.
+*/
+size_t Image_findPrefix(Image_T oIImage, size_t ulDir, boolean bDirs,
+                        const char *pcPrefix, size_t ulLength);
+
+/* Returns TRUE if node ulNode of oIImage is a directory. */
+boolean Image_isDirectory(Image_T oIImage, size_t ulNode);
+
+/* Returns the contents of node ulNode of oIImage, or NULL if it is a
+   directory. */
+void *Image_getContents(Image_T oIImage, size_t ulNode);
+
+/* Returns the contents size of node ulNode of oIImage, or 0 if it is
+   a directory. */
+size_t Image_getSizeContents(Image_T oIImage, size_t ulNode);
+
+/*
+  Reports the totals for the subtree rooted at node ulNode of
+  oIImage, with the same meaning as Node_getTotals.
+*/
+void Image_getTotals(Image_T oIImage, size_t ulNode, size_t *pulDirs,
+                     size_t *pulFiles, size_t *pulBytes);
+
+/*
+  Returns a string representation of oIImage, in the same format as
+  FT_toString, or NULL if there is an allocation error.
+
+  Allocates memory for the returned string, which is then owned by
+  the caller!
+*/
+char *Image_toString(Image_T oIImage);
+
+#endif
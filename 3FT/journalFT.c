@@ -0,0 +1,535 @@
+/*--------------------------------------------------------------------*/
+/* journalFT.c                                                        */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+/* for pread, ftruncate, and fdatasync under a strict -std */
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "journalFT.h"
+
+/* "FTJL", identifying a file as a journal */
+#define JOURNAL_MAGIC 0x4C4A5446U
+
+/* The version of the format described below */
+#define JOURNAL_VERSION 1U
+
+/* Record flag: the contents are NULL, and no bytes follow the path */
+#define JOURNAL_NULL_CONTENTS 1U
+
+/*
+  A journal file starts with a header of JOURNAL_HEADER bytes: the
+  magic number and the version (4 bytes each), and the sequence number
+  of the last record before the file's first (8 bytes). Each record
+  follows as its body's length and the body's checksum (4 bytes each),
+  then the body: its sequence number (8 bytes), its JournalOp and its
+  flags (1 byte each), the length of its path, counting the path's
+  '\0' (4 bytes), the length of its contents (8 bytes), the path with
+  its '\0', and the contents. All numbers are little-endian.
+*/
+enum { JOURNAL_HEADER = 16, RECORD_PREFIX = 8, RECORD_BODY = 22 };
+
+/* A journal open for appending */
+struct journal
+{
+    /* the file */
+    int iFd;
+
+    /* the records per group, and the records buffered */
+    size_t ulBatch;
+    size_t ulPending;
+
+    /* the records not yet written out */
+    unsigned char *pucBuffer;
+    size_t ulLength;
+    size_t ulCapacity;
+
+    /* the sequence number of the last record appended */
+    size_t ulLast;
+
+    /* TRUE once writing out has failed */
+    boolean bFailed;
+};
+
+/*--------------------------------------------------------------------*/
+/* Encoding                                                           */
+/*--------------------------------------------------------------------*/
+
+/* Stores the low ulBytes bytes of ulValue at pucPos, little-endian. */
+static void Journal_put(unsigned char *pucPos, uint64_t ulValue,
+                        size_t ulBytes)
+{
+    size_t i;
+    for (i = 0; i < ulBytes; i++)
+    {
+        pucPos[i] = (unsigned char)(ulValue & 0xFF);
+        ulValue >>= 8;
+    }
+}
+
+/* Returns the little-endian number in the ulBytes bytes at pucPos. */
+static uint64_t Journal_get(const unsigned char *pucPos, size_t ulBytes)
+{
+    uint64_t ulValue = 0;
+    while (ulBytes != 0)
+        ulValue = (ulValue << 8) | pucPos[--ulBytes];
+    return ulValue;
+}
+
+/* Returns the FNV-1a checksum of the ulLength bytes at pucBytes. */
+static uint32_t Journal_checksum(const unsigned char *pucBytes,
+                                 size_t ulLength)
+{
+    uint32_t uHash = 2166136261U;
+    size_t i;
+    for (i = 0; i < ulLength; i++)
+    {
+        uHash ^= pucBytes[i];
+        uHash *= 16777619U;
+    }
+    return uHash;
+}
+
+/*
+  Decodes the record at pucPos, which must end by pucEnd and follow a
+  record numbered ulPrevious. Returns TRUE and sets the out parameters
+  to its fields, *ppucNext to the position after it, if it is whole
+  and consistent. Returns FALSE if not, as for a partly written record.
+*/
+static boolean Journal_decode(unsigned char *pucPos,
+                              const unsigned char *pucEnd,
+                              size_t ulPrevious, size_t *pulSequence,
+                              int *piOp, char **ppcPath,
+                              void **ppvContents, size_t *pulLength,
+                              unsigned char **ppucNext)
+{
+    unsigned char *pucBody = pucPos + RECORD_PREFIX;
+    uint64_t ulBodyLength, ulSequence, ulPathLength, ulLength;
+    unsigned uFlags;
+
+    if ((size_t)(pucEnd - pucPos) < RECORD_PREFIX + RECORD_BODY)
+        return FALSE;
+    ulBodyLength = Journal_get(pucPos, 4);
+    if (ulBodyLength < RECORD_BODY ||
+        ulBodyLength > (size_t)(pucEnd - pucBody) ||
+        Journal_checksum(pucBody, (size_t)ulBodyLength) !=
+        (uint32_t)Journal_get(pucPos + 4, 4))
+        return FALSE;
+
+    ulSequence = Journal_get(pucBody, 8);
+    uFlags = pucBody[9];
+    ulPathLength = Journal_get(pucBody + 10, 4);
+    ulLength = Journal_get(pucBody + 14, 8);
+    if (ulSequence <= ulPrevious || pucBody[8] > JOURNAL_WRITE_AT ||
+        (uFlags & ~JOURNAL_NULL_CONTENTS) != 0 || ulPathLength == 0 ||
+        ulPathLength > ulBodyLength - RECORD_BODY ||
+        pucBody[RECORD_BODY + ulPathLength - 1] != '\0')
+        return FALSE;
+    if (uFlags & JOURNAL_NULL_CONTENTS)
+    {
+        if (ulBodyLength != RECORD_BODY + ulPathLength)
+            return FALSE;
+        *ppvContents = NULL;
+    }
+    else
+    {
+        if (ulBodyLength - RECORD_BODY - ulPathLength != ulLength)
+            return FALSE;
+        *ppvContents = pucBody + RECORD_BODY + ulPathLength;
+    }
+    /* a move's or copy's contents are its destination path */
+    if ((pucBody[8] == JOURNAL_MOVE || pucBody[8] == JOURNAL_COPY) &&
+        (*ppvContents == NULL || ulLength == 0 ||
+         pucBody[ulBodyLength - 1] != '\0'))
+        return FALSE;
+    /* a write's contents start with its offset */
+    if (pucBody[8] == JOURNAL_WRITE_AT &&
+        (*ppvContents == NULL || ulLength < 8))
+        return FALSE;
+
+    *pulSequence = (size_t)ulSequence;
+    *piOp = pucBody[8];
+    *ppcPath = (char *)pucBody + RECORD_BODY;
+    *pulLength = (size_t)ulLength;
+    *ppucNext = pucBody + ulBodyLength;
+    return TRUE;
+}
+
+/*--------------------------------------------------------------------*/
+/* Files                                                              */
+/*--------------------------------------------------------------------*/
+
+/* Writes the ulLength bytes at pucBytes to iFd. Returns TRUE, or FALSE
+   if that fails. */
+static boolean Journal_writeAll(int iFd, const unsigned char *pucBytes,
+                                size_t ulLength)
+{
+    while (ulLength != 0)
+    {
+        ssize_t lWritten = write(iFd, pucBytes, ulLength);
+        if (lWritten < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        pucBytes += lWritten;
+        ulLength -= (size_t)lWritten;
+    }
+    return TRUE;
+}
+
+/*
+  Reads the whole file open as iFd into a new block. Returns SUCCESS
+  and sets *ppucBlock to the block (NULL if the file is empty) and
+  *pulSize to its size, or returns IO_ERROR or MEMORY_ERROR.
+*/
+static int Journal_readAll(int iFd, unsigned char **ppucBlock,
+                           size_t *pulSize)
+{
+    struct stat sStat;
+    unsigned char *pucBlock;
+    size_t ulSize, ulRead = 0;
+
+    *ppucBlock = NULL;
+    *pulSize = 0;
+    if (fstat(iFd, &sStat) != 0)
+        return IO_ERROR;
+    ulSize = (size_t)sStat.st_size;
+    if (ulSize == 0)
+        return SUCCESS;
+
+    pucBlock = malloc(ulSize);
+    if (pucBlock == NULL)
+        return MEMORY_ERROR;
+    while (ulRead < ulSize)
+    {
+        ssize_t lRead = pread(iFd, pucBlock + ulRead, ulSize - ulRead,
+                              (off_t)ulRead);
+        if (lRead < 0 && errno == EINTR)
+            continue;
+        if (lRead <= 0)
+        {
+            free(pucBlock);
+            return IO_ERROR;
+        }
+        ulRead += (size_t)lRead;
+    }
+    *ppucBlock = pucBlock;
+    *pulSize = ulSize;
+    return SUCCESS;
+}
+
+/* Returns TRUE if the ulSize bytes at pucBlock start with a journal
+   header of this version, and FALSE if not. */
+static boolean Journal_checkHeader(const unsigned char *pucBlock,
+                                   size_t ulSize)
+{
+    return (boolean)(ulSize >= JOURNAL_HEADER &&
+                     Journal_get(pucBlock, 4) == JOURNAL_MAGIC &&
+                     Journal_get(pucBlock + 4, 4) == JOURNAL_VERSION);
+}
+
+/* Makes the file open as iFd hold just a journal header with last
+   sequence number ulLast, and syncs it. Returns TRUE, or FALSE if that
+   fails. */
+static boolean Journal_reset(int iFd, size_t ulLast)
+{
+    unsigned char aucHeader[JOURNAL_HEADER];
+
+    Journal_put(aucHeader, JOURNAL_MAGIC, 4);
+    Journal_put(aucHeader + 4, JOURNAL_VERSION, 4);
+    Journal_put(aucHeader + 8, ulLast, 8);
+    return (boolean)(ftruncate(iFd, 0) == 0 &&
+                     lseek(iFd, 0, SEEK_SET) == 0 &&
+                     Journal_writeAll(iFd, aucHeader, JOURNAL_HEADER) &&
+                     fdatasync(iFd) == 0);
+}
+
+/*--------------------------------------------------------------------*/
+
+int Journal_open(const char *pcFile, size_t ulBatch,
+                 Journal_T *poJResult)
+{
+    Journal_T oJJournal;
+    unsigned char *pucBlock, *pucPos;
+    size_t ulSize, ulLast = 0;
+    int iFd;
+    int iStatus;
+
+    assert(pcFile != NULL);
+    assert(ulBatch >= 1);
+    assert(poJResult != NULL);
+
+    *poJResult = NULL;
+    oJJournal = malloc(sizeof(struct journal));
+    if (oJJournal == NULL)
+        return MEMORY_ERROR;
+    iFd = open(pcFile, O_RDWR | O_CREAT, 0666);
+    if (iFd < 0)
+    {
+        free(oJJournal);
+        return IO_ERROR;
+    }
+
+    iStatus = Journal_readAll(iFd, &pucBlock, &ulSize);
+    if (iStatus == SUCCESS && ulSize < JOURNAL_HEADER)
+    {
+        /* new, or created but never given its whole header */
+        if (!Journal_reset(iFd, 0))
+            iStatus = IO_ERROR;
+        ulSize = JOURNAL_HEADER;
+    }
+    else if (iStatus == SUCCESS && !Journal_checkHeader(pucBlock, ulSize))
+        iStatus = CORRUPT_IMAGE;
+    else if (iStatus == SUCCESS)
+    {
+        /* find the end of the last whole record, and cut off the rest */
+        size_t ulSequence, ulLength;
+        int iOp;
+        char *pcPath;
+        void *pvContents;
+        unsigned char *pucNext;
+
+        ulLast = (size_t)Journal_get(pucBlock + 8, 8);
+        pucPos = pucBlock + JOURNAL_HEADER;
+        while (Journal_decode(pucPos, pucBlock + ulSize, ulLast,
+                              &ulSequence, &iOp, &pcPath, &pvContents,
+                              &ulLength, &pucNext))
+        {
+            ulLast = ulSequence;
+            pucPos = pucNext;
+        }
+        if (pucPos != pucBlock + ulSize)
+        {
+            ulSize = (size_t)(pucPos - pucBlock);
+            if (ftruncate(iFd, (off_t)ulSize) != 0 || fdatasync(iFd) != 0)
+                iStatus = IO_ERROR;
+        }
+    }
+    free(pucBlock);
+    if (iStatus == SUCCESS && lseek(iFd, (off_t)ulSize, SEEK_SET) < 0)
+        iStatus = IO_ERROR;
+    if (iStatus != SUCCESS)
+    {
+        (void)close(iFd);
+        free(oJJournal);
+        return iStatus;
+    }
+
+    oJJournal->iFd = iFd;
+    oJJournal->ulBatch = ulBatch;
+    oJJournal->ulPending = 0;
+    oJJournal->pucBuffer = NULL;
+    oJJournal->ulLength = 0;
+    oJJournal->ulCapacity = 0;
+    oJJournal->ulLast = ulLast;
+    oJJournal->bFailed = FALSE;
+    *poJResult = oJJournal;
+    return SUCCESS;
+}
+
+size_t Journal_getLastSequence(Journal_T oJJournal)
+{
+    assert(oJJournal != NULL);
+    return oJJournal->ulLast;
+}
+
+/*
+  Makes room for ulBytes more bytes in the buffer of oJJournal,
+  doubling it as needed. Returns TRUE, or FALSE if memory could not be
+  allocated, in which case the buffer is unchanged.
+*/
+static boolean Journal_makeRoom(Journal_T oJJournal, size_t ulBytes)
+{
+    size_t ulCapacity = oJJournal->ulCapacity * 2;
+    unsigned char *pucBuffer;
+
+    if (oJJournal->ulCapacity - oJJournal->ulLength >= ulBytes)
+        return TRUE;
+    if (ulCapacity < oJJournal->ulLength + ulBytes)
+        ulCapacity = oJJournal->ulLength + ulBytes;
+    pucBuffer = realloc(oJJournal->pucBuffer, ulCapacity);
+    if (pucBuffer == NULL)
+        return FALSE;
+    oJJournal->pucBuffer = pucBuffer;
+    oJJournal->ulCapacity = ulCapacity;
+    return TRUE;
+}
+
+int Journal_reserve(Journal_T oJJournal, size_t ulRecords,
+                    size_t ulBytes)
+{
+    assert(oJJournal != NULL);
+
+    if (oJJournal->bFailed)
+        return IO_ERROR;
+    if (!Journal_makeRoom(oJJournal, ulRecords *
+                          (RECORD_PREFIX + RECORD_BODY) + ulBytes))
+        return MEMORY_ERROR;
+    return SUCCESS;
+}
+
+int Journal_append(Journal_T oJJournal, size_t ulSequence, int iOp,
+                   const char *pcPath, const void *pvContents,
+                   size_t ulLength)
+{
+    size_t ulPathLength, ulBodyLength;
+    unsigned char *pucBody;
+
+    assert(oJJournal != NULL);
+    assert(ulSequence > oJJournal->ulLast);
+    assert(iOp >= JOURNAL_INSERT_DIR && iOp <= JOURNAL_WRITE_AT);
+    assert(pcPath != NULL);
+
+    if (oJJournal->bFailed)
+        return IO_ERROR;
+
+    ulPathLength = strlen(pcPath) + 1;
+    ulBodyLength = RECORD_BODY + ulPathLength;
+    if (pvContents != NULL)
+        ulBodyLength += ulLength;
+    if (ulBodyLength > 0xFFFFFFFFU)
+        return MEMORY_ERROR;
+    if (!Journal_makeRoom(oJJournal, RECORD_PREFIX + ulBodyLength))
+        return MEMORY_ERROR;
+
+    pucBody = oJJournal->pucBuffer + oJJournal->ulLength + RECORD_PREFIX;
+    Journal_put(pucBody, ulSequence, 8);
+    pucBody[8] = (unsigned char)iOp;
+    pucBody[9] = (unsigned char)(pvContents == NULL ?
+                                 JOURNAL_NULL_CONTENTS : 0);
+    Journal_put(pucBody + 10, ulPathLength, 4);
+    Journal_put(pucBody + 14, ulLength, 8);
+    memcpy(pucBody + RECORD_BODY, pcPath, ulPathLength);
+    if (pvContents != NULL && ulLength != 0)
+        memcpy(pucBody + RECORD_BODY + ulPathLength, pvContents, ulLength);
+    Journal_put(pucBody - RECORD_PREFIX, ulBodyLength, 4);
+    Journal_put(pucBody - RECORD_PREFIX + 4,
+                Journal_checksum(pucBody, ulBodyLength), 4);
+
+    oJJournal->ulLength += RECORD_PREFIX + ulBodyLength;
+    oJJournal->ulLast = ulSequence;
+    oJJournal->ulPending++;
+    if (oJJournal->ulPending >= oJJournal->ulBatch)
+        return Journal_sync(oJJournal);
+    return SUCCESS;
+}
+
+int Journal_sync(Journal_T oJJournal)
+{
+    assert(oJJournal != NULL);
+
+    if (oJJournal->bFailed)
+        return IO_ERROR;
+    if (oJJournal->ulLength == 0)
+        return SUCCESS;
+
+    /* one write and one sync for the whole group */
+    if (!Journal_writeAll(oJJournal->iFd, oJJournal->pucBuffer,
+                          oJJournal->ulLength) ||
+        fdatasync(oJJournal->iFd) != 0)
+    {
+        oJJournal->bFailed = TRUE;
+        return IO_ERROR;
+    }
+    oJJournal->ulLength = 0;
+    oJJournal->ulPending = 0;
+    return SUCCESS;
+}
+
+int Journal_truncate(Journal_T oJJournal)
+{
+    int iStatus;
+
+    assert(oJJournal != NULL);
+
+    iStatus = Journal_sync(oJJournal);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    if (!Journal_reset(oJJournal->iFd, oJJournal->ulLast))
+    {
+        oJJournal->bFailed = TRUE;
+        return IO_ERROR;
+    }
+    return SUCCESS;
+}
+
+int Journal_close(Journal_T oJJournal)
+{
+    int iStatus;
+
+    assert(oJJournal != NULL);
+
+    iStatus = Journal_sync(oJJournal);
+    if (close(oJJournal->iFd) != 0)
+        iStatus = IO_ERROR;
+    free(oJJournal->pucBuffer);
+    free(oJJournal);
+    return iStatus;
+}
+
+int Journal_replay(const char *pcFile, size_t ulAfter,
+                   Journal_Apply_T pfApply, void *pvExtra,
+                   void **ppvBlock, size_t *pulLast)
+{
+    unsigned char *pucBlock, *pucPos;
+    size_t ulSize, ulPrevious;
+    int iFd;
+    int iStatus;
+
+    assert(pcFile != NULL);
+    assert(pfApply != NULL);
+    assert(ppvBlock != NULL);
+    assert(pulLast != NULL);
+
+    *ppvBlock = NULL;
+    *pulLast = ulAfter;
+    iFd = open(pcFile, O_RDONLY);
+    if (iFd < 0)
+        return IO_ERROR;
+    iStatus = Journal_readAll(iFd, &pucBlock, &ulSize);
+    (void)close(iFd);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    if (!Journal_checkHeader(pucBlock, ulSize))
+    {
+        free(pucBlock);
+        return CORRUPT_IMAGE;
+    }
+
+    *ppvBlock = pucBlock;
+    ulPrevious = (size_t)Journal_get(pucBlock + 8, 8);
+    pucPos = pucBlock + JOURNAL_HEADER;
+    for (;;)
+    {
+        size_t ulSequence, ulLength;
+        int iOp;
+        char *pcPath;
+        void *pvContents;
+        unsigned char *pucNext;
+
+        if (!Journal_decode(pucPos, pucBlock + ulSize, ulPrevious,
+                            &ulSequence, &iOp, &pcPath, &pvContents,
+                            &ulLength, &pucNext))
+            break;
+        if (ulSequence > ulAfter)
+        {
+            iStatus = pfApply(iOp, pcPath, pvContents, ulLength, pvExtra);
+            if (iStatus != SUCCESS)
+                return iStatus;
+            *pulLast = ulSequence;
+        }
+        ulPrevious = ulSequence;
+        pucPos = pucNext;
+    }
+    return SUCCESS;
+}
@@ -0,0 +1,128 @@
+/*--------------------------------------------------------------------*/
+/* journalFT.h                                                        */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef JOURNAL_INCLUDED
+#define JOURNAL_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Journal_T is an append-only file of records, one per mutation of
+  a File Tree, each numbered with a sequence number greater than the
+  one before. Records are buffered in memory and written out in
+  groups: a group is written with one write and made durable with one
+  fdatasync, so that the cost of syncing is shared by all the records
+  in it. A record that was only partly written when the process or
+  the machine stopped is recognized by its length and checksum, and
+  it and everything after it are ignored.
+*/
+typedef struct journal *Journal_T;
+
+/* The mutations a journal records */
+enum JournalOp
+{
+    JOURNAL_INSERT_DIR, JOURNAL_INSERT_FILE, JOURNAL_RM_DIR,
+    JOURNAL_RM_FILE, JOURNAL_REPLACE_CONTENTS, JOURNAL_MOVE, JOURNAL_COPY,
+    JOURNAL_WRITE_AT
+};
+
+/*
+  A function that applies the mutation iOp to the absolute path pcPath,
+  with the contents pvContents of ulLength bytes for JOURNAL_INSERT_FILE
+  and JOURNAL_REPLACE_CONTENTS, the destination path, '\0' included,
+  for JOURNAL_MOVE and JOURNAL_COPY, the offset as 8 bytes, least
+  significant first, and then the bytes written for JOURNAL_WRITE_AT
+  (NULL and 0 for the others), and
+  with pvExtra as passed to Journal_replay. Returns SUCCESS, or a
+  status that stops the replay.
+*/
+typedef int (*Journal_Apply_T)(int iOp, const char *pcPath,
+                               void *pvContents, size_t ulLength,
+                               void *pvExtra);
+
+/*
+  Opens the journal file named pcFile for appending, creating it if it
+  does not exist, and cutting off any partly written record at its
+  end. Once ulBatch records (at least 1) are buffered, they are
+  written out and synced as one group.
+  Returns SUCCESS and sets *poJResult to the journal. Otherwise, sets
+  *poJResult to NULL and returns:
+  * IO_ERROR if the file cannot be opened, read, or written
+  * CORRUPT_IMAGE if the file is not a journal of this version
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Journal_open(const char *pcFile, size_t ulBatch,
+                 Journal_T *poJResult);
+
+/* Returns the sequence number of the last record in oJJournal, or of
+   the last one it was truncated after, or 0 if it never had any. */
+size_t Journal_getLastSequence(Journal_T oJJournal);
+
+/*
+  Appends to oJJournal the record of mutation iOp of the absolute path
+  pcPath, with sequence number ulSequence, which must be greater than
+  that of the last record, and contents pvContents of ulLength bytes
+  (NULL and 0 for mutations without contents). If the record completes
+  a group, writes out and syncs the group.
+  Returns SUCCESS, MEMORY_ERROR if the record could not be buffered (in
+  which case it is not appended), or IO_ERROR if the group could not be
+  written out or synced, or could not be earlier.
+*/
+int Journal_append(Journal_T oJJournal, size_t ulSequence, int iOp,
+                   const char *pcPath, const void *pvContents,
+                   size_t ulLength);
+
+/*
+  Makes room in the buffer of oJJournal for ulRecords more records
+  whose paths, '\0's included, and contents take up ulBytes in all, so
+  that appending them cannot fail for lack of memory, even once a
+  group is written out in between. Returns SUCCESS, MEMORY_ERROR if
+  memory could not be allocated, or IO_ERROR if writing out has failed
+  before.
+*/
+int Journal_reserve(Journal_T oJJournal, size_t ulRecords,
+                    size_t ulBytes);
+
+/*
+  Writes out and syncs the records of oJJournal that are still
+  buffered, if any. Returns SUCCESS, or IO_ERROR if that fails or has
+  failed before: once writing fails, the journal accepts no more
+  records.
+*/
+int Journal_sync(Journal_T oJJournal);
+
+/*
+  Syncs oJJournal, then empties its file, keeping the sequence numbers
+  going: the next record must still be numbered after the last one.
+  Returns SUCCESS, or IO_ERROR if that fails.
+*/
+int Journal_truncate(Journal_T oJJournal);
+
+/*
+  Syncs oJJournal, then closes it and frees all memory allocated for
+  it. Returns SUCCESS, or IO_ERROR if it could not be synced.
+*/
+int Journal_close(Journal_T oJJournal);
+
+/*
+  Reads the journal file named pcFile in one piece, and calls pfApply
+  with pvExtra on each of its records numbered after ulAfter, in
+  order, stopping at the first partly written record. The contents
+  passed to pfApply lie in the block that was read: *ppvBlock is set
+  to it (or to NULL if none was read), and the caller must free it
+  once those contents are no longer used. *pulLast is set to the
+  sequence number of the last record applied, or to ulAfter if none
+  was. Returns SUCCESS if every record was applied. Otherwise, returns
+  * IO_ERROR if the file cannot be opened or read
+  * CORRUPT_IMAGE if the file is not a journal of this version
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  * the status pfApply returned, if it did not return SUCCESS
+*/
+int Journal_replay(const char *pcFile, size_t ulAfter,
+                   Journal_Apply_T pfApply, void *pvExtra,
+                   void **ppvBlock, size_t *pulLast);
+
+#endif
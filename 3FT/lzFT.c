@@ -0,0 +1,203 @@
+/*--------------------------------------------------------------------*/
+/* lzFT.c                                                             */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <string.h>
+#include "lzFT.h"
+
+/* The shortest copy a block encodes, and the farthest back a copy
+   can start */
+enum {MIN_MATCH = 4, MAX_OFFSET = 65535};
+
+/* The number of entries in the table of where 4-byte sequences were
+   last seen, a power of 2 */
+enum {HASH_BITS = 12, HASH_SIZE = 1 << HASH_BITS};
+
+/*
+  A block is a sequence of runs, each a token byte, whose high 4 bits
+  are the number of literal bytes and whose low 4 bits are the length
+  of the copy after them minus MIN_MATCH; then, if the number of
+  literals is 15 or more, the rest of it in bytes that each add up to
+  255, a byte under 255 ending them; then the literals; then, unless
+  the block ends with them, the distance back to the copy's source in
+  2 bytes, least significant first, and, if the copy's length is
+  MIN_MATCH + 15 or more, the rest of it as for the literals.
+*/
+
+/* Returns the 4 bytes at pucBytes as one number, the first lowest. */
+static unsigned long Lz_read4(const unsigned char *pucBytes)
+{
+    return (unsigned long)pucBytes[0] |
+           (unsigned long)pucBytes[1] << 8 |
+           (unsigned long)pucBytes[2] << 16 |
+           (unsigned long)pucBytes[3] << 24;
+}
+
+/* Returns the slot of the table for the 4 bytes ulSeq. */
+static size_t Lz_hash(unsigned long ulSeq)
+{
+    return (size_t)(((ulSeq * 2654435761UL) & 0xffffffffUL) >>
+                    (32 - HASH_BITS));
+}
+
+/* Writes the part of ulCount past 15 as the extra bytes of a length
+   at *ppucOut, and advances *ppucOut past them. */
+static void Lz_writeLength(unsigned char **ppucOut, size_t ulCount)
+{
+    ulCount -= 15;
+    while (ulCount >= 255)
+    {
+        *(*ppucOut)++ = 255;
+        ulCount -= 255;
+    }
+    *(*ppucOut)++ = (unsigned char)ulCount;
+}
+
+/* Returns the rest of the length uPart (15 if it has more) from the
+   extra bytes at *ppucIn, and advances *ppucIn past them. */
+static size_t Lz_readLength(const unsigned char **ppucIn, unsigned int uPart)
+{
+    size_t ulCount = uPart;
+    unsigned char ucByte;
+
+    if (uPart != 15)
+        return ulCount;
+    do
+    {
+        ucByte = *(*ppucIn)++;
+        ulCount += ucByte;
+    } while (ucByte == 255);
+    return ulCount;
+}
+
+/*
+  Writes a run of the ulLiterals bytes at pucLiterals, followed by a
+  copy of ulMatch bytes from ulOffset back, or by nothing if ulMatch
+  is 0, at *ppucOut, and advances *ppucOut past it. Returns 1, or 0
+  if the run would not fit before pucEnd, in which case nothing is
+  written.
+*/
+static int Lz_writeRun(unsigned char **ppucOut, unsigned char *pucEnd,
+                       const unsigned char *pucLiterals,
+                       size_t ulLiterals, size_t ulOffset, size_t ulMatch)
+{
+    unsigned char *pucOut = *ppucOut;
+    size_t ulRest = ulMatch == 0 ? 0 : ulMatch - MIN_MATCH;
+    size_t ulNeeded = 1 + (ulLiterals >= 15 ? ulLiterals / 255 + 1 : 0) +
+                      ulLiterals +
+                      (ulMatch == 0 ? 0 : 2) +
+                      (ulRest >= 15 ? ulRest / 255 + 1 : 0);
+
+    if ((size_t)(pucEnd - pucOut) < ulNeeded)
+        return 0;
+
+    *pucOut++ = (unsigned char)((ulLiterals < 15 ? ulLiterals : 15) << 4 |
+                                (ulRest < 15 ? ulRest : 15));
+    if (ulLiterals >= 15)
+        Lz_writeLength(&pucOut, ulLiterals);
+    memcpy(pucOut, pucLiterals, ulLiterals);
+    pucOut += ulLiterals;
+    if (ulMatch != 0)
+    {
+        *pucOut++ = (unsigned char)(ulOffset & 0xff);
+        *pucOut++ = (unsigned char)(ulOffset >> 8);
+        if (ulRest >= 15)
+            Lz_writeLength(&pucOut, ulRest);
+    }
+    *ppucOut = pucOut;
+    return 1;
+}
+
+size_t Lz_compress(const void *pvIn, size_t ulLength, void *pvOut,
+                   size_t ulRoom)
+{
+    const unsigned char *pucIn = pvIn;
+    unsigned char *pucOut = pvOut;
+    unsigned char *pucEnd = pucOut + ulRoom;
+    /* where each 4-byte sequence was last seen, plus 1 (0 if never) */
+    size_t aulTable[HASH_SIZE];
+    size_t ulAt = 0, ulAnchor = 0;
+
+    assert(pvIn != NULL || ulLength == 0);
+    assert(pvOut != NULL || ulRoom == 0);
+
+    if (ulLength == 0)
+        return 0;
+    memset(aulTable, 0, sizeof(aulTable));
+
+    while (ulAt + MIN_MATCH <= ulLength)
+    {
+        unsigned long ulSeq = Lz_read4(pucIn + ulAt);
+        size_t ulSlot = Lz_hash(ulSeq);
+        size_t ulCandidate = aulTable[ulSlot];
+
+        aulTable[ulSlot] = ulAt + 1;
+        if (ulCandidate != 0 && ulAt - (ulCandidate - 1) <= MAX_OFFSET &&
+            Lz_read4(pucIn + ulCandidate - 1) == ulSeq)
+        {
+            size_t ulFrom = ulCandidate - 1;
+            size_t ulMatch = MIN_MATCH;
+
+            while (ulAt + ulMatch < ulLength &&
+                   pucIn[ulFrom + ulMatch] == pucIn[ulAt + ulMatch])
+                ulMatch++;
+            if (!Lz_writeRun(&pucOut, pucEnd, pucIn + ulAnchor,
+                             ulAt - ulAnchor, ulAt - ulFrom, ulMatch))
+                return 0;
+            ulAt += ulMatch;
+            ulAnchor = ulAt;
+        }
+        else
+            /* skip faster through bytes that do not repeat */
+            ulAt += 1 + ((ulAt - ulAnchor) >> 6);
+    }
+
+    if (ulAnchor < ulLength &&
+        !Lz_writeRun(&pucOut, pucEnd, pucIn + ulAnchor,
+                     ulLength - ulAnchor, 0, 0))
+        return 0;
+    return (size_t)(pucOut - (unsigned char *)pvOut);
+}
+
+void Lz_decompress(const void *pvIn, void *pvOut, size_t ulLength)
+{
+    const unsigned char *pucIn = pvIn;
+    unsigned char *pucOut = pvOut;
+    size_t ulAt = 0;
+
+    assert(pvIn != NULL || ulLength == 0);
+    assert(pvOut != NULL || ulLength == 0);
+
+    while (ulAt < ulLength)
+    {
+        unsigned int uToken = *pucIn++;
+        size_t ulLiterals = Lz_readLength(&pucIn, uToken >> 4);
+        size_t ulOffset, ulMatch;
+
+        assert(ulLiterals <= ulLength - ulAt);
+        memcpy(pucOut + ulAt, pucIn, ulLiterals);
+        pucIn += ulLiterals;
+        ulAt += ulLiterals;
+        if (ulAt == ulLength)
+            break;
+
+        ulOffset = (size_t)pucIn[0] | (size_t)pucIn[1] << 8;
+        pucIn += 2;
+        ulMatch = Lz_readLength(&pucIn, uToken & 15) + MIN_MATCH;
+        assert(ulOffset != 0 && ulOffset <= ulAt);
+        assert(ulMatch <= ulLength - ulAt);
+
+        /* a copy may overlap what it copies, repeating it */
+        if (ulOffset >= ulMatch)
+            memcpy(pucOut + ulAt, pucOut + ulAt - ulOffset, ulMatch);
+        else
+        {
+            size_t i;
+            for (i = 0; i < ulMatch; i++)
+                pucOut[ulAt + i] = pucOut[ulAt - ulOffset + i];
+        }
+        ulAt += ulMatch;
+    }
+}
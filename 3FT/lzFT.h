@@ -0,0 +1,32 @@
+/*--------------------------------------------------------------------*/
+/* lzFT.h                                                             */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef LZ_INCLUDED
+#define LZ_INCLUDED
+
+#include <stddef.h>
+
+/*
+  A fast LZ77 codec in the manner of LZ4, for compressing blocks of
+  bytes in memory: a block is a sequence of runs of literal bytes,
+  each followed by a copy of 4 or more bytes from up to 64 KiB back in
+  what came before. It favors speed over ratio: text typically
+  compresses to a half or a third of its size, and bytes with no
+  repeats grow by a little under 1%.
+*/
+
+/*
+  Compresses the ulLength bytes at pvIn into pvOut, which has room for
+  ulRoom bytes. Returns the number of bytes the compressed form takes,
+  or 0 if it would not fit in ulRoom bytes (or ulLength is 0).
+*/
+size_t Lz_compress(const void *pvIn, size_t ulLength, void *pvOut,
+                   size_t ulRoom);
+
+/* Decompresses the compressed form at pvIn, which Lz_compress made
+   from ulLength bytes, into pvOut, which must have room for them. */
+void Lz_decompress(const void *pvIn, void *pvOut, size_t ulLength);
+
+#endif
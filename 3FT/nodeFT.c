@@ -3,395 +3,1955 @@
 /* Author: Judah Guggenheim, code borrowed from Christopher Moretti   */
 /*--------------------------------------------------------------------*/
 
-/* NOTE: This was originally set up to be the node implementation only
-for nodes represanting directories. I (think I) am in the process of changing that now
-to be one node that does both directories and files. */
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
 #include "nodeFT.h"
-#include "dynarray.h"
+#include "contentFT.h"
+
+/* The tag bit of a Node_T that marks a directory. The other bits are
+   the node's index into the pool of its kind. */
+#define DIR_TAG 0x80000000U
+
+/* A node representing a file in a File Tree */
+struct fileNode
+{
+    /* the parent (directory node) of this node. In a free slot, the
+       index of the next free slot instead. */
+    Node_T oNParent;
+
+    /* the offset of this node's name in the name arena */
+    unsigned int uName;
+
+    /* the number of directories' runs and roots referring to this
+       node: more than 1 if trees share it */
+    unsigned int uRefs;
+
+    /* TRUE if the contents are in the content store, heap, chunks, or
+       packed, and this node holds a reference to them; FALSE if they
+       are the client's */
+    boolean bOwned;
+
+    /* the file's contents, which may be NULL */
+    void *contents;
+
+    /* length of the contents in the file */
+    size_t lenContents;
+
+    /* the hash of the contents when they were last set */
+    uint64_t ulHash;
+};
 
 /* A node representing a directory in a File Tree */
-struct node
+struct dirNode
+{
+    /* the parent (directory node) of this node. In a free slot, the
+       index of the next free slot instead. */
+    Node_T oNParent;
+
+    /* the offset of this node's name in the name arena */
+    unsigned int uName;
+
+    /* the number of directories' runs and roots referring to this
+       node: more than 1 if trees share it */
+    unsigned int uRefs;
+
+    /* the index in the child slab of this node's run of children: the
+       uNumFiles file children, then the uNumDirs directory children,
+       each sorted by name, in room for uCapacity children in all */
+    unsigned int uChildren;
+    unsigned int uNumFiles;
+    unsigned int uNumDirs;
+    unsigned int uCapacity;
+
+    /* the number of directories strictly below this node */
+    size_t ulNumDirs;
+
+    /* the number of files strictly below this node */
+    size_t ulNumFiles;
+
+    /* the sum of the contents lengths of the files below this node */
+    size_t ulNumBytes;
+
+    /* the sum of the entry hashes (see Node_entryHash) of this node's
+       children, so that it changes if anything below it does */
+    uint64_t ulHash;
+};
+
+/* A growable vector of same-sized node slots. Slot 0 is never used,
+   so that no node has the handle NULL_NODE. */
+struct pool
+{
+    /* the slots */
+    char *pcSlots;
+
+    /* the size in bytes of one slot */
+    size_t ulSlotSize;
+
+    /* the number of slots ever used, including slot 0 */
+    unsigned int uLength;
+
+    /* the number of slots allocated */
+    unsigned int uCapacity;
+
+    /* the index of the first free slot below uLength, or 0 if none */
+    unsigned int uFree;
+
+    /* the number of slots holding a live node */
+    unsigned int uLive;
+};
+
+/* A growable block of bytes handed out in pieces identified by their
+   offsets. Released pieces are only counted, not reused. */
+struct arena
+{
+    /* the bytes */
+    char *pcBytes;
+
+    /* the number of bytes handed out */
+    size_t ulLength;
+
+    /* the number of bytes allocated */
+    size_t ulCapacity;
+
+    /* the number of handed out bytes that have since been released */
+    size_t ulGarbage;
+};
+
+/* the pool of all file nodes */
+static struct pool sFiles = {NULL, sizeof(struct fileNode), 0, 0, 0, 0};
+
+/* the pool of all directory nodes */
+static struct pool sDirs = {NULL, sizeof(struct dirNode), 0, 0, 0, 0};
+
+/* the '\0'-terminated names of all nodes */
+static struct arena sNames = {NULL, 0, 0, 0};
+
+/* the runs of children (as Node_T) of all directories */
+static struct arena sChildren = {NULL, 0, 0, 0};
+
+/*
+  Takes a free slot from psPool, growing it if needed, and stores its
+  index in *puIndex. Returns SUCCESS, or MEMORY_ERROR if allocation
+  fails or the pool is full.
+*/
+static int Node_poolAlloc(struct pool *psPool, unsigned int *puIndex)
+{
+    assert(psPool != NULL);
+    assert(puIndex != NULL);
+
+    if (psPool->uFree != 0)
+    {
+        *puIndex = psPool->uFree;
+        psPool->uFree = *(Node_T *)(psPool->pcSlots +
+                                    psPool->uFree * psPool->ulSlotSize);
+        psPool->uLive++;
+        return SUCCESS;
+    }
+
+    if (psPool->uLength == psPool->uCapacity)
+    {
+        unsigned int uNewCapacity;
+        char *pcNewSlots;
+
+        if (psPool->uCapacity >= DIR_TAG / 2)
+            return MEMORY_ERROR;
+        uNewCapacity = psPool->uCapacity == 0 ? 64 : psPool->uCapacity * 2;
+        pcNewSlots = realloc(psPool->pcSlots,
+                             uNewCapacity * psPool->ulSlotSize);
+        if (pcNewSlots == NULL)
+            return MEMORY_ERROR;
+        psPool->pcSlots = pcNewSlots;
+        psPool->uCapacity = uNewCapacity;
+        /* slot 0 is reserved for NULL_NODE */
+        if (psPool->uLength == 0)
+            psPool->uLength = 1;
+    }
+
+    *puIndex = psPool->uLength;
+    psPool->uLength++;
+    psPool->uLive++;
+    return SUCCESS;
+}
+
+/* Returns slot uIndex to psPool's free list. */
+static void Node_poolRelease(struct pool *psPool, unsigned int uIndex)
+{
+    assert(psPool != NULL);
+    assert(uIndex != 0 && uIndex < psPool->uLength);
+
+    *(Node_T *)(psPool->pcSlots + uIndex * psPool->ulSlotSize) =
+        psPool->uFree;
+    psPool->uFree = uIndex;
+    psPool->uLive--;
+}
+
+/*
+  Hands out ulBytes bytes at the end of psArena, growing it if needed,
+  and stores their offset in *pulOffset. Returns SUCCESS, or
+  MEMORY_ERROR if allocation fails or the offset would not fit in 32
+  bits.
+*/
+static int Node_arenaAlloc(struct arena *psArena, size_t ulBytes,
+                           size_t *pulOffset)
+{
+    assert(psArena != NULL);
+    assert(pulOffset != NULL);
+
+    if (psArena->ulLength + ulBytes > UINT_MAX)
+        return MEMORY_ERROR;
+
+    if (psArena->ulLength + ulBytes > psArena->ulCapacity)
+    {
+        size_t ulNewCapacity;
+        char *pcNewBytes;
+
+        ulNewCapacity = psArena->ulCapacity == 0 ? 1024
+                                                 : psArena->ulCapacity * 2;
+        while (ulNewCapacity < psArena->ulLength + ulBytes)
+            ulNewCapacity *= 2;
+        pcNewBytes = realloc(psArena->pcBytes, ulNewCapacity);
+        if (pcNewBytes == NULL)
+            return MEMORY_ERROR;
+        psArena->pcBytes = pcNewBytes;
+        psArena->ulCapacity = ulNewCapacity;
+    }
+
+    *pulOffset = psArena->ulLength;
+    psArena->ulLength += ulBytes;
+    return SUCCESS;
+}
+
+/*
+  Grows psPool so that ulMore more slots can be taken from it without
+  growing it again. Returns SUCCESS, or MEMORY_ERROR if allocation
+  fails or the pool would be too large for its indices.
+*/
+static int Node_poolReserve(struct pool *psPool, size_t ulMore)
+{
+    size_t ulNeeded;
+    char *pcNewSlots;
+
+    assert(psPool != NULL);
+
+    /* slot 0 is reserved for NULL_NODE */
+    ulNeeded = (psPool->uLength == 0 ? 1 : psPool->uLength) + ulMore;
+    if (ulNeeded <= psPool->uCapacity)
+        return SUCCESS;
+    if (ulNeeded > DIR_TAG)
+        return MEMORY_ERROR;
+
+    pcNewSlots = realloc(psPool->pcSlots, ulNeeded * psPool->ulSlotSize);
+    if (pcNewSlots == NULL)
+        return MEMORY_ERROR;
+    psPool->pcSlots = pcNewSlots;
+    psPool->uCapacity = (unsigned int)ulNeeded;
+    if (psPool->uLength == 0)
+        psPool->uLength = 1;
+    return SUCCESS;
+}
+
+/*
+  Grows psArena so that ulMore more bytes can be handed out from it
+  without growing it again. Returns SUCCESS, or MEMORY_ERROR if
+  allocation fails or the offsets would not fit in 32 bits.
+*/
+static int Node_arenaReserve(struct arena *psArena, size_t ulMore)
+{
+    char *pcNewBytes;
+
+    assert(psArena != NULL);
+
+    if (psArena->ulLength + ulMore <= psArena->ulCapacity)
+        return SUCCESS;
+    if (psArena->ulLength + ulMore > UINT_MAX)
+        return MEMORY_ERROR;
+
+    pcNewBytes = realloc(psArena->pcBytes, psArena->ulLength + ulMore);
+    if (pcNewBytes == NULL)
+        return MEMORY_ERROR;
+    psArena->pcBytes = pcNewBytes;
+    psArena->ulCapacity = psArena->ulLength + ulMore;
+    return SUCCESS;
+}
+
+/* Frees all of psArena's memory and returns it to its empty state. */
+static void Node_arenaReset(struct arena *psArena)
+{
+    assert(psArena != NULL);
+
+    free(psArena->pcBytes);
+    psArena->pcBytes = NULL;
+    psArena->ulLength = 0;
+    psArena->ulCapacity = 0;
+    psArena->ulGarbage = 0;
+}
+
+/* Returns the file variant of oNNode, which must be a file. */
+static struct fileNode *Node_asFile(Node_T oNNode)
+{
+    assert(oNNode != NULL_NODE);
+    assert((oNNode & DIR_TAG) == 0);
+    assert(oNNode < sFiles.uLength);
+    return (struct fileNode *)(sFiles.pcSlots +
+                               oNNode * sizeof(struct fileNode));
+}
+
+/* Returns the directory variant of oNNode, which must be a directory. */
+static struct dirNode *Node_asDir(Node_T oNNode)
+{
+    assert((oNNode & DIR_TAG) != 0);
+    assert((oNNode & ~DIR_TAG) != 0);
+    assert((oNNode & ~DIR_TAG) < sDirs.uLength);
+    return (struct dirNode *)(sDirs.pcSlots +
+                              (oNNode & ~DIR_TAG) * sizeof(struct dirNode));
+}
+
+/*
+  Returns the run of children of directory oNParent. The pointer is
+  only valid until the next allocation from the child slab.
+*/
+static Node_T *Node_getChildren(Node_T oNParent)
+{
+    return (Node_T *)sChildren.pcBytes + Node_asDir(oNParent)->uChildren;
+}
+
+/* Returns the offset of oNNode's name in the name arena. */
+static unsigned int Node_getNameOffset(Node_T oNNode)
+{
+    if (Node_isDirectory(oNNode) == TRUE)
+        return Node_asDir(oNNode)->uName;
+    else
+        return Node_asFile(oNNode)->uName;
+}
+
+/*
+  Binary searches the children of directory oNParent that are
+  directories if bDirs is TRUE, or files if not, for one named
+  pcName. Returns TRUE if found, and FALSE if not. Stores in *pulIndex
+  the position among the children of that kind where such a child is,
+  or would be inserted.
+*/
+static boolean Node_search(Node_T oNParent, boolean bDirs,
+                           const char *pcName, size_t *pulIndex)
+{
+    struct dirNode *psDir = Node_asDir(oNParent);
+    Node_T *poNKind = Node_getChildren(oNParent);
+    size_t ulLow = 0;
+    size_t ulHigh;
+
+    assert(pcName != NULL);
+    assert(pulIndex != NULL);
+
+    if (bDirs == TRUE)
+    {
+        poNKind += psDir->uNumFiles;
+        ulHigh = psDir->uNumDirs;
+    }
+    else
+        ulHigh = psDir->uNumFiles;
+
+    while (ulLow < ulHigh)
+    {
+        size_t ulMid = ulLow + (ulHigh - ulLow) / 2;
+        int iCmp = strcmp(Node_getName(poNKind[ulMid]), pcName);
+        if (iCmp == 0)
+        {
+            *pulIndex = ulMid;
+            return TRUE;
+        }
+        if (iCmp < 0)
+            ulLow = ulMid + 1;
+        else
+            ulHigh = ulMid;
+    }
+    *pulIndex = ulLow;
+    return FALSE;
+}
+
+/*
+  Makes sure directory oNParent's run of children has room for one
+  more child, moving the run to the end of the child slab with twice
+  the room if it is full (or extending it in place if it already is
+  at the end). Returns SUCCESS, or MEMORY_ERROR if allocation fails.
+*/
+static int Node_reserveChild(Node_T oNParent)
+{
+    struct dirNode *psDir = Node_asDir(oNParent);
+    unsigned int uOldCapacity = psDir->uCapacity;
+    unsigned int uNewCapacity;
+    size_t ulOffset;
+    int iStatus;
+
+    if (psDir->uNumFiles + psDir->uNumDirs < uOldCapacity)
+        return SUCCESS;
+
+    uNewCapacity = uOldCapacity == 0 ? 2 : uOldCapacity * 2;
+
+    if (uOldCapacity != 0 &&
+        (psDir->uChildren + uOldCapacity) * sizeof(Node_T) ==
+        sChildren.ulLength)
+    {
+        iStatus = Node_arenaAlloc(&sChildren,
+                                  (uNewCapacity - uOldCapacity) *
+                                  sizeof(Node_T), &ulOffset);
+        if (iStatus != SUCCESS)
+            return iStatus;
+        psDir->uCapacity = uNewCapacity;
+        return SUCCESS;
+    }
+
+    iStatus = Node_arenaAlloc(&sChildren, uNewCapacity * sizeof(Node_T),
+                              &ulOffset);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    if (uOldCapacity != 0)
+        memcpy(sChildren.pcBytes + ulOffset,
+               Node_getChildren(oNParent),
+               (psDir->uNumFiles + psDir->uNumDirs) * sizeof(Node_T));
+    sChildren.ulGarbage += uOldCapacity * sizeof(Node_T);
+    psDir->uChildren = (unsigned int)(ulOffset / sizeof(Node_T));
+    psDir->uCapacity = uNewCapacity;
+    return SUCCESS;
+}
+
+/*
+  Links new child oNChild into the oNParent children run, at position
+  ulIndex among the children of its own kind (files or directories).
+  The run must have room for it.
+*/
+static void Node_addChild(Node_T oNParent, Node_T oNChild,
+                          size_t ulIndex)
+{
+    struct dirNode *psDir = Node_asDir(oNParent);
+    Node_T *poNChildren = Node_getChildren(oNParent);
+    size_t ulPos = ulIndex;
+
+    assert(oNChild != NULL_NODE);
+    assert(psDir->uNumFiles + psDir->uNumDirs < psDir->uCapacity);
+
+    if (Node_isDirectory(oNChild) == TRUE)
+        ulPos += psDir->uNumFiles;
+    memmove(poNChildren + ulPos + 1, poNChildren + ulPos,
+            (psDir->uNumFiles + psDir->uNumDirs - ulPos) * sizeof(Node_T));
+    poNChildren[ulPos] = oNChild;
+    if (Node_isDirectory(oNChild) == TRUE)
+        psDir->uNumDirs++;
+    else
+        psDir->uNumFiles++;
+}
+
+/*
+  Returns the hash of borrowed contents, of ulLength bytes at
+  pvContents (NULL for none): of where they are and how long, as the
+  FT does not read the bytes it borrows.
+*/
+static uint64_t Node_borrowedHash(const void *pvContents, size_t ulLength)
+{
+    return Content_mix(Content_mix((uint64_t)(size_t)pvContents + 1) +
+                       ulLength);
+}
+
+/*
+  Returns the hash of oNNode as an entry of its parent: of its name,
+  its kind, and its own hash. A directory's hash is the sum of its
+  children's entry hashes, so that it is updated in constant time as
+  they change, and does not depend on the order they were added in.
+*/
+static uint64_t Node_entryHash(Node_T oNNode)
+{
+    const char *pcName = Node_getName(oNNode);
+    uint64_t ulHash = Content_hash(pcName, strlen(pcName));
+
+    if (Node_isDirectory(oNNode) == TRUE)
+        return Content_mix(ulHash +
+                           Content_mix(Node_asDir(oNNode)->ulHash + 1));
+    else
+        return Content_mix(ulHash + Node_asFile(oNNode)->ulHash);
+}
+
+/*
+  Adds the signed deltas lDirs, lFiles, and lBytes to the subtree
+  totals of every ancestor of oNNode, from its parent up to the root,
+  and replaces oNNode's entry hash in its parent's hash, from
+  ulOldEntry to ulNewEntry (0 for a node that was not, or is no
+  longer, a child), which changes the entry hashes of the ancestors'
+  in turn.
+*/
+static void Node_adjustAncestors(Node_T oNNode, long lDirs, long lFiles,
+                                 long lBytes, uint64_t ulOldEntry,
+                                 uint64_t ulNewEntry)
+{
+    Node_T oNCurr;
+
+    assert(oNNode != NULL_NODE);
+
+    for (oNCurr = Node_getParent(oNNode); oNCurr != NULL_NODE;
+         oNCurr = Node_getParent(oNCurr))
+    {
+        struct dirNode *psDir = Node_asDir(oNCurr);
+        psDir->ulNumDirs += (size_t)lDirs;
+        psDir->ulNumFiles += (size_t)lFiles;
+        psDir->ulNumBytes += (size_t)lBytes;
+        if (ulOldEntry != ulNewEntry)
+        {
+            uint64_t ulOldParent = Node_entryHash(oNCurr);
+            psDir->ulHash += ulNewEntry - ulOldEntry;
+            ulOldEntry = ulOldParent;
+            ulNewEntry = Node_entryHash(oNCurr);
+        }
+    }
+}
+
+/*
+  Copies name pcName into the name arena, and stores its offset there
+  in *pulName. pcName may itself be in the name arena, which
+  allocating from it can move. Returns SUCCESS, or MEMORY_ERROR if
+  allocation fails.
+*/
+static int Node_copyName(const char *pcName, size_t *pulName)
 {
-    /* the path to this directory */
-    Path_T oPPath; /* or should it  be: Path_T *opPath;   ?? */
+    size_t ulNameLength = strlen(pcName) + 1;
+    int iStatus;
 
-    /* pointer to the parent (directory node) of this node */
+    if (sNames.pcBytes != NULL && pcName >= sNames.pcBytes &&
+        pcName < sNames.pcBytes + sNames.ulLength)
+    {
+        size_t ulFrom = (size_t)(pcName - sNames.pcBytes);
+        iStatus = Node_arenaAlloc(&sNames, ulNameLength, pulName);
+        if (iStatus != SUCCESS)
+            return iStatus;
+        memcpy(sNames.pcBytes + *pulName, sNames.pcBytes + ulFrom,
+               ulNameLength);
+    }
+    else
+    {
+        iStatus = Node_arenaAlloc(&sNames, ulNameLength, pulName);
+        if (iStatus != SUCCESS)
+            return iStatus;
+        memcpy(sNames.pcBytes + *pulName, pcName, ulNameLength);
+    }
+    return SUCCESS;
+}
+
+/*
+  Removes oNNode from its parent's run of children, if it has a
+  parent, and its subtree from the totals of each of its ancestors.
+  The subtree itself is left as it is.
+*/
+static void Node_unlink(Node_T oNNode)
+{
     Node_T oNParent;
+    size_t ulIndex = 0;
+    size_t ulDirs, ulFiles, ulBytes;
+    struct dirNode *psParent;
+    Node_T *poNSiblings;
+    size_t ulPos;
+
+    assert(oNNode != NULL_NODE);
+
+    oNParent = Node_getParent(oNNode);
+    if (oNParent == NULL_NODE)
+        return;
+
+    psParent = Node_asDir(oNParent);
+    poNSiblings = Node_getChildren(oNParent);
+    if (Node_search(oNParent, Node_isDirectory(oNNode),
+                    Node_getName(oNNode), &ulIndex))
+    {
+        ulPos = ulIndex;
+        if (Node_isDirectory(oNNode) == TRUE)
+        {
+            ulPos += psParent->uNumFiles;
+            psParent->uNumDirs--;
+        }
+        else
+            psParent->uNumFiles--;
+        memmove(poNSiblings + ulPos, poNSiblings + ulPos + 1,
+                (psParent->uNumFiles + psParent->uNumDirs - ulPos) *
+                sizeof(Node_T));
+    }
+
+    Node_getTotals(oNNode, &ulDirs, &ulFiles, &ulBytes);
+    Node_adjustAncestors(oNNode, -(long)ulDirs, -(long)ulFiles,
+                         -(long)ulBytes, Node_entryHash(oNNode), 0);
+}
+
+int Node_reserve(size_t ulDirs, size_t ulFiles, size_t ulNameBytes)
+{
+    int iStatus;
+
+    iStatus = Node_poolReserve(&sDirs, ulDirs);
+    if (iStatus == SUCCESS)
+        iStatus = Node_poolReserve(&sFiles, ulFiles);
+    if (iStatus == SUCCESS)
+        iStatus = Node_arenaReserve(&sNames, ulNameBytes);
+    return iStatus;
+}
+
+int Node_new(const char *pcName, Node_T oNParent, Node_T *poNResult,
+             boolean dir, void *conts, size_t sizeConts)
+{
+    size_t ulIndex = 0;
+    size_t ulNameLength;
+    size_t ulName;
+    unsigned int uSlot;
+    Node_T oNNew;
+    int iStatus;
+
+    assert(pcName != NULL);
+    assert(poNResult != NULL);
+
+    *poNResult = NULL_NODE;
+
+    /* validate the new node's parent */
+    if (oNParent != NULL_NODE)
+    {
+        /* parent cannot be a file */
+        if (Node_isDirectory(oNParent) == FALSE)
+            return CONFLICTING_PATH;
+
+        /* parent must not already have child with this name */
+        if (Node_hasChild(oNParent, pcName, &ulIndex))
+            return ALREADY_IN_TREE;
+
+        /* find the new node's place among the children of its kind */
+        (void)Node_search(oNParent, dir, pcName, &ulIndex);
+
+        iStatus = Node_reserveChild(oNParent);
+        if (iStatus != SUCCESS)
+            return iStatus;
+    }
+
+    /* set the new node's name */
+    ulNameLength = strlen(pcName) + 1;
+    iStatus = Node_copyName(pcName, &ulName);
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    /* allocate and initialize a slot in the pool of the right kind.
+       directories start with no room for children, files get their
+       contents. if it is a directory, conts will be NULL and
+       sizeConts will be 0, and both are ignored. */
+    if (dir == TRUE)
+    {
+        struct dirNode *psNew;
+
+        iStatus = Node_poolAlloc(&sDirs, &uSlot);
+        if (iStatus != SUCCESS)
+        {
+            sNames.ulGarbage += ulNameLength;
+            return iStatus;
+        }
+        oNNew = uSlot | DIR_TAG;
+        psNew = Node_asDir(oNNew);
+        psNew->oNParent = oNParent;
+        psNew->uName = (unsigned int)ulName;
+        psNew->uRefs = 1;
+        psNew->uChildren = 0;
+        psNew->uNumFiles = 0;
+        psNew->uNumDirs = 0;
+        psNew->uCapacity = 0;
+        psNew->ulNumDirs = 0;
+        psNew->ulNumFiles = 0;
+        psNew->ulNumBytes = 0;
+        psNew->ulHash = 0;
+    }
+    else
+    {
+        struct fileNode *psNew;
+
+        iStatus = Node_poolAlloc(&sFiles, &uSlot);
+        if (iStatus != SUCCESS)
+        {
+            sNames.ulGarbage += ulNameLength;
+            return iStatus;
+        }
+        oNNew = uSlot;
+        psNew = Node_asFile(oNNew);
+        psNew->oNParent = oNParent;
+        psNew->uName = (unsigned int)ulName;
+        psNew->uRefs = 1;
+        psNew->bOwned = FALSE;
+        psNew->contents = conts;
+        psNew->lenContents = sizeConts;
+        psNew->ulHash = Node_borrowedHash(conts, sizeConts);
+    }
+
+    /* Link into parent's children run */
+    if (oNParent != NULL_NODE)
+    {
+        Node_addChild(oNParent, oNNew, ulIndex);
+        if (dir == TRUE)
+            Node_adjustAncestors(oNNew, 1, 0, 0, 0, Node_entryHash(oNNew));
+        else
+            Node_adjustAncestors(oNNew, 0, 1, (long)sizeConts, 0,
+                                 Node_entryHash(oNNew));
+    }
+
+    *poNResult = oNNew;
+    return SUCCESS;
+}
+
+/* Returns the number of references to oNNode. */
+static unsigned int *Node_refs(Node_T oNNode)
+{
+    if (Node_isDirectory(oNNode) == TRUE)
+        return &Node_asDir(oNNode)->uRefs;
+    else
+        return &Node_asFile(oNNode)->uRefs;
+}
+
+/*
+  Drops one reference to the subtree rooted at oNNode, without
+  unlinking oNNode from its parent or updating any ancestor's totals.
+  Once nothing refers to a node any more, frees it and drops its
+  references to its children in turn.
+*/
+static void Node_release(Node_T oNNode)
+{
+    size_t i;
+
+    assert(oNNode != NULL_NODE);
+    assert(*Node_refs(oNNode) != 0);
+
+    /* other trees still share this node, and so all below it */
+    if (--*Node_refs(oNNode) != 0)
+        return;
+
+    sNames.ulGarbage += strlen(Node_getName(oNNode)) + 1;
+
+    /* if oNNode is a file, there are no descendents. */
+    if (Node_isDirectory(oNNode) == FALSE)
+    {
+        if (Node_asFile(oNNode)->bOwned)
+            Content_release(Node_asFile(oNNode)->contents);
+        Node_poolRelease(&sFiles, oNNode);
+        return;
+    }
+
+    /* recursively remove children from directories. freeing never
+       moves the pools or the child slab. */
+    for (i = 0; i < Node_getNumChildren(oNNode); i++)
+        Node_release(Node_getChildren(oNNode)[i]);
+    sChildren.ulGarbage += Node_asDir(oNNode)->uCapacity * sizeof(Node_T);
+
+    /* finally, release the node's slot */
+    Node_poolRelease(&sDirs, oNNode & ~DIR_TAG);
+}
+
+size_t Node_free(Node_T oNNode)
+{
+    size_t ulDirs, ulFiles, ulBytes;
+
+    assert(oNNode != NULL_NODE);
+
+    /* remove from parent's run, and the whole subtree from the
+       totals of each of its ancestors */
+    Node_getTotals(oNNode, &ulDirs, &ulFiles, &ulBytes);
+    Node_unlink(oNNode);
+    Node_release(oNNode);
+
+    /* once the last node is gone, give back all the memory */
+    if (sFiles.uLive == 0 && sDirs.uLive == 0)
+    {
+        free(sFiles.pcSlots);
+        sFiles.pcSlots = NULL;
+        sFiles.uLength = sFiles.uCapacity = sFiles.uFree = 0;
+        free(sDirs.pcSlots);
+        sDirs.pcSlots = NULL;
+        sDirs.uLength = sDirs.uCapacity = sDirs.uFree = 0;
+        Node_arenaReset(&sNames);
+        Node_arenaReset(&sChildren);
+    }
+
+    return ulDirs + ulFiles;
+}
+
+int Node_move(Node_T oNNode, Node_T oNNewParent, const char *pcName)
+{
+    size_t ulIndex = 0;
+    size_t ulName = 0;
+    size_t ulDirs, ulFiles, ulBytes;
+    boolean bRename;
+    int iStatus;
+
+    assert(oNNode != NULL_NODE);
+    assert(pcName != NULL);
+    assert(*Node_refs(oNNode) == 1);
+
+    /* allocate everything first, so that failing leaves it in place */
+    if (oNNewParent != NULL_NODE)
+    {
+        if (Node_isDirectory(oNNewParent) == FALSE)
+            return CONFLICTING_PATH;
+        assert(*Node_refs(oNNewParent) == 1);
+        if (Node_hasChild(oNNewParent, pcName, &ulIndex))
+            return ALREADY_IN_TREE;
+        iStatus = Node_reserveChild(oNNewParent);
+        if (iStatus != SUCCESS)
+            return iStatus;
+    }
+    bRename = (boolean)(strcmp(Node_getName(oNNode), pcName) != 0);
+    if (bRename)
+    {
+        iStatus = Node_copyName(pcName, &ulName);
+        if (iStatus != SUCCESS)
+            return iStatus;
+    }
+
+    /* only the subtree's root changes: its descendants store just
+       their own names, and their totals stay the same */
+    Node_unlink(oNNode);
+    if (bRename)
+        sNames.ulGarbage += strlen(Node_getName(oNNode)) + 1;
+    if (Node_isDirectory(oNNode) == TRUE)
+    {
+        Node_asDir(oNNode)->oNParent = oNNewParent;
+        if (bRename)
+            Node_asDir(oNNode)->uName = (unsigned int)ulName;
+    }
+    else
+    {
+        Node_asFile(oNNode)->oNParent = oNNewParent;
+        if (bRename)
+            Node_asFile(oNNode)->uName = (unsigned int)ulName;
+    }
+
+    if (oNNewParent != NULL_NODE)
+    {
+        (void)Node_search(oNNewParent, Node_isDirectory(oNNode),
+                          Node_getName(oNNode), &ulIndex);
+        Node_addChild(oNNewParent, oNNode, ulIndex);
+        Node_getTotals(oNNode, &ulDirs, &ulFiles, &ulBytes);
+        Node_adjustAncestors(oNNode, (long)ulDirs, (long)ulFiles,
+                             (long)ulBytes, 0, Node_entryHash(oNNode));
+    }
+    return SUCCESS;
+}
+
+void Node_share(Node_T oNNode)
+{
+    assert(oNNode != NULL_NODE);
+    assert(*Node_refs(oNNode) < UINT_MAX);
+
+    (*Node_refs(oNNode))++;
+}
+
+/*
+  Creates a node named pcName (a single path component) with parent
+  oNParent that is a copy of oNOld: a file with the same contents
+  (copied if they are in the content heap, and shared otherwise), or
+  a directory with a run of children of its own that shares oNOld's
+  children, and the same totals. Does not link it into oNParent's run
+  of children. Returns SUCCESS and sets *poNResult to the copy, or
+  returns MEMORY_ERROR and leaves *poNResult unchanged.
+*/
+static int Node_clone(Node_T oNOld, Node_T oNParent, const char *pcName,
+                      Node_T *poNResult)
+{
+    Node_T oNNew;
+    size_t ulName, ulNameLength;
+    unsigned int uSlot;
+    int iStatus;
+
+    /* copy the name, the node, and for a directory its run of
+       children, which the copy shares with the original */
+    ulNameLength = strlen(pcName) + 1;
+    iStatus = Node_copyName(pcName, &ulName);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    if (Node_isDirectory(oNOld) == TRUE)
+    {
+        struct dirNode *psNew;
+        unsigned int uNumChildren;
+        size_t ulChildren = 0;
+        unsigned int c;
+
+        uNumChildren = Node_asDir(oNOld)->uNumFiles +
+                       Node_asDir(oNOld)->uNumDirs;
+        iStatus = Node_poolAlloc(&sDirs, &uSlot);
+        if (iStatus == SUCCESS && uNumChildren != 0)
+        {
+            iStatus = Node_arenaAlloc(&sChildren,
+                                      uNumChildren * sizeof(Node_T),
+                                      &ulChildren);
+            if (iStatus != SUCCESS)
+                Node_poolRelease(&sDirs, uSlot);
+        }
+        if (iStatus != SUCCESS)
+        {
+            sNames.ulGarbage += ulNameLength;
+            return iStatus;
+        }
+        oNNew = uSlot | DIR_TAG;
+        psNew = Node_asDir(oNNew);
+        *psNew = *Node_asDir(oNOld);
+        psNew->oNParent = oNParent;
+        psNew->uName = (unsigned int)ulName;
+        psNew->uRefs = 1;
+        psNew->uChildren = (unsigned int)(ulChildren / sizeof(Node_T));
+        psNew->uCapacity = uNumChildren;
+        memcpy(Node_getChildren(oNNew), Node_getChildren(oNOld),
+               uNumChildren * sizeof(Node_T));
+        for (c = 0; c < uNumChildren; c++)
+            Node_share(Node_getChildren(oNNew)[c]);
+    }
+    else
+    {
+        struct fileNode *psNew;
+        void *pvContents = Node_asFile(oNOld)->contents;
+
+        /* heap contents belong to one file each */
+        if (Node_asFile(oNOld)->bOwned &&
+            Content_getKind(pvContents) == CONTENT_HEAP)
+            iStatus = Content_own(pvContents,
+                                  Node_asFile(oNOld)->lenContents,
+                                  &pvContents);
+        if (iStatus == SUCCESS)
+        {
+            iStatus = Node_poolAlloc(&sFiles, &uSlot);
+            if (iStatus != SUCCESS && pvContents !=
+                Node_asFile(oNOld)->contents)
+                Content_release(pvContents);
+        }
+        if (iStatus != SUCCESS)
+        {
+            sNames.ulGarbage += ulNameLength;
+            return iStatus;
+        }
+        oNNew = uSlot;
+        psNew = Node_asFile(oNNew);
+        *psNew = *Node_asFile(oNOld);
+        psNew->oNParent = oNParent;
+        psNew->uName = (unsigned int)ulName;
+        psNew->uRefs = 1;
+        if (pvContents == psNew->contents && psNew->bOwned)
+            Content_retain(pvContents);
+        psNew->contents = pvContents;
+    }
+
+    *poNResult = oNNew;
+    return SUCCESS;
+}
+
+int Node_own(Node_T oNParent, Node_T *poNNode)
+{
+    Node_T oNOld;
+    Node_T oNNew = NULL_NODE;
+    size_t ulIndex;
+    int iStatus;
+
+    assert(poNNode != NULL);
+    assert(*poNNode != NULL_NODE);
+    assert(oNParent == NULL_NODE || *Node_refs(oNParent) == 1);
+
+    oNOld = *poNNode;
+    if (*Node_refs(oNOld) == 1)
+    {
+        /* the parent may have been replaced by a copy since this node
+           was last owned */
+        if (Node_isDirectory(oNOld) == TRUE)
+            Node_asDir(oNOld)->oNParent = oNParent;
+        else
+            Node_asFile(oNOld)->oNParent = oNParent;
+        return SUCCESS;
+    }
+
+    iStatus = Node_clone(oNOld, oNParent, Node_getName(oNOld), &oNNew);
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    /* the parent refers to the copy from now on */
+    if (oNParent != NULL_NODE)
+    {
+        (void)Node_search(oNParent, Node_isDirectory(oNOld),
+                          Node_getName(oNOld), &ulIndex);
+        if (Node_isDirectory(oNOld) == TRUE)
+            ulIndex += Node_asDir(oNParent)->uNumFiles;
+        assert(Node_getChildren(oNParent)[ulIndex] == oNOld);
+        Node_getChildren(oNParent)[ulIndex] = oNNew;
+    }
+    (*Node_refs(oNOld))--;
+
+    *poNNode = oNNew;
+    return SUCCESS;
+}
 
-    /* a pointer to the dynarray containing this node's children.
-    NULL if the node is a file. */
-    DynArray_T oDChildren;
+int Node_copy(Node_T oNNode, Node_T oNNewParent, const char *pcName,
+              Node_T *poNResult)
+{
+    size_t ulIndex = 0;
+    size_t ulDirs, ulFiles, ulBytes;
+    Node_T oNNew = NULL_NODE;
+    int iStatus;
 
-    /* tells if the node is a directory or a file */
-    boolean isDirectory;
+    assert(oNNode != NULL_NODE);
+    assert(oNNewParent != NULL_NODE);
+    assert(pcName != NULL);
+    assert(poNResult != NULL);
 
-    /* contains the node's contents if a file, NULL if a directory */
-    void *contents;
+    *poNResult = NULL_NODE;
 
-    /* length of the contentss in the file, 0 if a directory */
-    size_t lenContents;
-};
+    if (Node_isDirectory(oNNewParent) == FALSE)
+        return CONFLICTING_PATH;
+    assert(*Node_refs(oNNewParent) == 1);
+    if (Node_hasChild(oNNewParent, pcName, &ulIndex))
+        return ALREADY_IN_TREE;
 
-/*
-  Links new child oNChild into oNParent's children array at index
-  ulIndex. Returns SUCCESS if the new child was added successfully,
-  or  MEMORY_ERROR if allocation fails adding oNChild to the array.*/
+    iStatus = Node_reserveChild(oNNewParent);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    iStatus = Node_clone(oNNode, oNNewParent, pcName, &oNNew);
+    if (iStatus != SUCCESS)
+        return iStatus;
 
-static int Node_addChild(Node_T oNParent, Node_T oNChild,
-                         size_t ulIndex)
-{
-    assert(oNParent != NULL);
-    assert(oNChild != NULL);
+    (void)Node_search(oNNewParent, Node_isDirectory(oNNew),
+                      Node_getName(oNNew), &ulIndex);
+    Node_addChild(oNNewParent, oNNew, ulIndex);
+    Node_getTotals(oNNew, &ulDirs, &ulFiles, &ulBytes);
+    Node_adjustAncestors(oNNew, (long)ulDirs, (long)ulFiles,
+                         (long)ulBytes, 0, Node_entryHash(oNNew));
 
-    if (DynArray_addAt(oNParent->oDChildren, ulIndex, oNChild))
-        return SUCCESS;
-    else
-        return MEMORY_ERROR;
+    *poNResult = oNNew;
+    return SUCCESS;
 }
 
 /*
-  Compares the string representation of oNfirst with a string
-  pcSecond representing a node's path.
-  Returns <0, 0, or >0 if oNFirst is "less than", "equal to", or
-  "greater than" pcSecond, respectively.
+  Returns the child of directory oNDir at position uCursor among its
+  children that are directories if bDirs is TRUE, or files if not, or
+  NULL_NODE if it has no more children of that kind.
 */
-static int Node_compareString(const Node_T oNFirst,
-                              const char *pcSecond)
+static Node_T Node_getKindChild(Node_T oNDir, boolean bDirs,
+                                unsigned int uCursor)
 {
-    assert(oNFirst != NULL);
-    assert(pcSecond != NULL);
+    struct dirNode *psDir = Node_asDir(oNDir);
 
-    return Path_compareString(oNFirst->oPPath, pcSecond);
+    if (bDirs == TRUE)
+        return uCursor < psDir->uNumDirs ?
+               Node_getChildren(oNDir)[psDir->uNumFiles + uCursor] :
+               NULL_NODE;
+    else
+        return uCursor < psDir->uNumFiles ?
+               Node_getChildren(oNDir)[uCursor] : NULL_NODE;
 }
 
-int Node_new(Path_T oPPath, Node_T oNParent, Node_T *poNResult, boolean dir,
-             void *conts, size_t sizeConts)
+/*
+  Merges the children of directory oNSrc into those of directory
+  oNDst, which must be ready to be modified, as Node_merge documents,
+  and recomputes oNDst's totals and hash (but not its ancestors').
+  Walks the four sorted runs of files and directories of both in
+  lockstep, one name at a time, and builds oNDst's new run of children
+  in one pass.
+  After a failure, merges no more directories, but keeps building the
+  run, so that the tree stays consistent. Returns SUCCESS, or
+  MEMORY_ERROR.
+*/
+static int Node_mergeDir(Node_T oNDst, Node_T oNSrc, boolean bFiles,
+                         boolean bKinds)
 {
-    struct node *psNew;
-    Path_T oPParentPath = NULL;
-    Path_T oPNewPath = NULL;
-    size_t ulParentDepth;
-    size_t ulIndex = 0;
+    unsigned int auCursors[4] = {0, 0, 0, 0};
+    unsigned int uCapacity, uNew, uNumFiles = 0, uNumDirs = 0;
+    unsigned int uNumDropped = 0;
+    size_t ulNew, ulDirs = 0, ulFiles = 0, ulBytes = 0;
+    uint64_t ulHash = 0;
+    Node_T *poNDirs;
+    Node_T *poNDropped;
+    struct dirNode *psDst;
     int iStatus;
+    int r;
 
-    assert(oPPath != NULL);
-    assert(poNResult != NULL);
+    uCapacity = Node_asDir(oNDst)->uNumFiles + Node_asDir(oNDst)->uNumDirs +
+                Node_asDir(oNSrc)->uNumFiles + Node_asDir(oNSrc)->uNumDirs;
+    if (uCapacity == 0)
+        return SUCCESS;
 
-    /* allocate space for a new node */
-    psNew = malloc(sizeof(struct node));
-    if (psNew == NULL)
-    {
-        *poNResult = NULL;
+    /* directories go after all the files, so collect them apart, as
+       well as the children replaced by oNSrc's, which are released
+       only once the old run is no longer searched by Node_own */
+    poNDirs = malloc(2 * uCapacity * sizeof(Node_T));
+    if (poNDirs == NULL)
         return MEMORY_ERROR;
-    }
-
-    /* set the new node's path */
-    iStatus = Path_dup(oPPath, &oPNewPath);
+    poNDropped = poNDirs + uCapacity;
+    iStatus = Node_arenaAlloc(&sChildren, uCapacity * sizeof(Node_T),
+                              &ulNew);
     if (iStatus != SUCCESS)
     {
-        free(psNew);
-        *poNResult = NULL;
+        free(poNDirs);
         return iStatus;
     }
-    psNew->oPPath = oPNewPath;
+    uNew = (unsigned int)(ulNew / sizeof(Node_T));
 
-    /* validate and set the new node's parent */
-    if (oNParent != NULL)
+    for (;;)
     {
-        size_t ulSharedDepth;
+        /* the heads of oNDst's files and directories, and of oNSrc's */
+        Node_T aoNHeads[4];
+        const char *pcName = NULL;
+        Node_T oNDstChild = NULL_NODE;
+        Node_T oNSrcChild = NULL_NODE;
+        Node_T oNOut;
 
-        oPParentPath = oNParent->oPPath;
-        ulParentDepth = Path_getDepth(oPParentPath);
-        ulSharedDepth = Path_getSharedPrefixDepth(psNew->oPPath,
-                                                  oPParentPath);
-        /* parent must be an ancestor of child and cannot be a file */
-        if (ulSharedDepth < ulParentDepth ||
-            oNParent->isDirectory == FALSE)
+        /* find the least name among the heads. each name is in each
+           directory's runs once at most */
+        for (r = 0; r < 4; r++)
         {
-            Path_free(psNew->oPPath);
-            free(psNew);
-            *poNResult = NULL;
-            return CONFLICTING_PATH;
+            aoNHeads[r] = Node_getKindChild(r < 2 ? oNDst : oNSrc,
+                                            (boolean)(r % 2),
+                                            auCursors[r]);
+            if (aoNHeads[r] != NULL_NODE &&
+                (pcName == NULL ||
+                 strcmp(Node_getName(aoNHeads[r]), pcName) < 0))
+                pcName = Node_getName(aoNHeads[r]);
         }
-
-        /* parent must be exactly one level up from child */
-        if (Path_getDepth(psNew->oPPath) != ulParentDepth + 1)
+        if (pcName == NULL)
+            break;
+        for (r = 0; r < 4; r++)
         {
-            Path_free(psNew->oPPath);
-            free(psNew);
-            *poNResult = NULL;
-            return NO_SUCH_PATH;
+            if (aoNHeads[r] != NULL_NODE &&
+                strcmp(Node_getName(aoNHeads[r]), pcName) == 0)
+            {
+                if (r < 2)
+                    oNDstChild = aoNHeads[r];
+                else
+                    oNSrcChild = aoNHeads[r];
+                auCursors[r]++;
+            }
         }
 
-        /* parent must not already have child with this path */
-        if (Node_hasChild(oNParent, oPPath, &ulIndex))
+        /* keep what only oNDst has, or both share already, splice in
+           what only oNSrc has, and settle conflicts by the policy */
+        if (oNSrcChild == NULL_NODE || oNSrcChild == oNDstChild)
+            oNOut = oNDstChild;
+        else if (oNDstChild == NULL_NODE)
+            oNOut = oNSrcChild;
+        else if (Node_isDirectory(oNDstChild) == TRUE &&
+                 Node_isDirectory(oNSrcChild) == TRUE)
         {
-            Path_free(psNew->oPPath);
-            free(psNew);
-            *poNResult = NULL;
-            return ALREADY_IN_TREE;
+            if (iStatus == SUCCESS)
+                iStatus = Node_own(oNDst, &oNDstChild);
+            if (iStatus == SUCCESS)
+                iStatus = Node_mergeDir(oNDstChild, oNSrcChild, bFiles,
+                                        bKinds);
+            oNOut = oNDstChild;
         }
-    }
-    else
-    {
-        /* new node must be root */
-        /* can only create one "level" at a time */
-        if (Path_getDepth(psNew->oPPath) != 1)
+        else if (Node_isDirectory(oNDstChild) ==
+                 Node_isDirectory(oNSrcChild) ? bFiles : bKinds)
         {
-            Path_free(psNew->oPPath);
-            free(psNew);
-            *poNResult = NULL;
-            return NO_SUCH_PATH;
+            poNDropped[uNumDropped++] = oNDstChild;
+            oNOut = oNSrcChild;
         }
+        else
+            oNOut = oNDstChild;
+
+        /* like a copy's children, a spliced node keeps its parent
+           until it is owned */
+        if (oNOut == oNSrcChild && oNOut != oNDstChild)
+            Node_share(oNOut);
+        if (Node_isDirectory(oNOut) == TRUE)
+            poNDirs[uNumDirs++] = oNOut;
+        else
+            ((Node_T *)sChildren.pcBytes)[uNew + uNumFiles++] = oNOut;
     }
-    psNew->oNParent = oNParent;
 
-    /* initialize the new node */
-    if (dir == TRUE)
+    /* replace the run, and total up the new children */
+    memcpy((Node_T *)sChildren.pcBytes + uNew + uNumFiles, poNDirs,
+           uNumDirs * sizeof(Node_T));
+    while (uNumDropped != 0)
+        Node_release(poNDropped[--uNumDropped]);
+    free(poNDirs);
+    psDst = Node_asDir(oNDst);
+    sChildren.ulGarbage += psDst->uCapacity * sizeof(Node_T);
+    psDst->uChildren = uNew;
+    psDst->uCapacity = uCapacity;
+    psDst->uNumFiles = uNumFiles;
+    psDst->uNumDirs = uNumDirs;
+    for (r = 0; (unsigned int)r < uNumFiles + uNumDirs; r++)
     {
-        psNew->oDChildren = DynArray_new(0);
-        if (psNew->oDChildren == NULL)
-        {
-            Path_free(psNew->oPPath);
-            free(psNew);
-            *poNResult = NULL;
-            return MEMORY_ERROR;
-        }
+        size_t ulChildDirs, ulChildFiles, ulChildBytes;
+        Node_getTotals(Node_getChildren(oNDst)[r], &ulChildDirs,
+                       &ulChildFiles, &ulChildBytes);
+        ulDirs += ulChildDirs;
+        ulFiles += ulChildFiles;
+        ulBytes += ulChildBytes;
+        ulHash += Node_entryHash(Node_getChildren(oNDst)[r]);
     }
+    psDst->ulNumDirs = ulDirs;
+    psDst->ulNumFiles = ulFiles;
+    psDst->ulNumBytes = ulBytes;
+    psDst->ulHash = ulHash;
+    return iStatus;
+}
+
+int Node_merge(Node_T oNDst, Node_T oNSrc, boolean bFiles,
+               boolean bKinds)
+{
+    size_t ulOldDirs, ulOldFiles, ulOldBytes;
+    size_t ulDirs, ulFiles, ulBytes;
+    uint64_t ulOldEntry;
+    int iStatus;
+
+    assert(oNDst != NULL_NODE);
+    assert(oNSrc != NULL_NODE);
+    assert(Node_isDirectory(oNDst) == TRUE);
+    assert(Node_isDirectory(oNSrc) == TRUE);
+    assert(*Node_refs(oNDst) == 1);
+
+    if (oNDst == oNSrc)
+        return SUCCESS;
+
+    Node_getTotals(oNDst, &ulOldDirs, &ulOldFiles, &ulOldBytes);
+    ulOldEntry = Node_entryHash(oNDst);
+    iStatus = Node_mergeDir(oNDst, oNSrc, bFiles, bKinds);
+    Node_getTotals(oNDst, &ulDirs, &ulFiles, &ulBytes);
+    Node_adjustAncestors(oNDst, (long)ulDirs - (long)ulOldDirs,
+                         (long)ulFiles - (long)ulOldFiles,
+                         (long)ulBytes - (long)ulOldBytes, ulOldEntry,
+                         Node_entryHash(oNDst));
+    return iStatus;
+}
+
+/* Returns the number of bytes oNNode takes up: its slot, its name,
+   the room in its run of children, and its contents, unless they are
+   stored, chunked, or packed, and so may be shared with other files. */
+static size_t Node_getBytes(Node_T oNNode)
+{
+    size_t ulBytes = strlen(Node_getName(oNNode)) + 1;
+
+    if (Node_isDirectory(oNNode) == TRUE)
+        return ulBytes + sizeof(struct dirNode) +
+               Node_asDir(oNNode)->uCapacity * sizeof(Node_T);
     else
+        return ulBytes + sizeof(struct fileNode) +
+               (Node_asFile(oNNode)->bOwned &&
+                Content_getKind(Node_asFile(oNNode)->contents) !=
+                CONTENT_HEAP ? 0 : Node_asFile(oNNode)->lenContents);
+}
+
+/*
+  Adds the bytes taken up by the nodes of the subtree rooted at
+  oNNode to *pulShared if bShared is TRUE or oNNode is shared, and to
+  *pulExclusive otherwise. A shared node may be reached more than
+  once: pucDirsSeen and pucFilesSeen have a bit for each slot of the
+  pools, set once its node has been counted. Stored, chunked, and
+  packed contents are counted once, in count ulCount (see
+  Content_countOnce), as shared if more than one file refers to them,
+  and packed ones as the bytes they take packed.
+*/
+static void Node_addUsage(Node_T oNNode, boolean bShared,
+                          unsigned char *pucDirsSeen,
+                          unsigned char *pucFilesSeen, size_t ulCount,
+                          size_t *pulExclusive, size_t *pulShared)
+{
+    size_t i;
+
+    if (*Node_refs(oNNode) > 1)
     {
-        psNew->oDChildren = NULL;
+        unsigned char *pucSeen;
+        unsigned int uIndex = oNNode & ~DIR_TAG;
+
+        pucSeen = Node_isDirectory(oNNode) ? pucDirsSeen : pucFilesSeen;
+        if (pucSeen[uIndex / CHAR_BIT] & (1U << (uIndex % CHAR_BIT)))
+            return;
+        pucSeen[uIndex / CHAR_BIT] |= (unsigned char)
+                                      (1U << (uIndex % CHAR_BIT));
+        bShared = TRUE;
     }
-    /* add contents if it is a file.
-    if it is a directory, dir will be FALSE, conts will
-    be NULL, and sizeConts will be 0. */
-    psNew->isDirectory = dir;
-    psNew->contents = conts;
-    psNew->lenContents = sizeConts;
 
-    /* Link into parent's children list */
-    if (oNParent != NULL)
+    if (bShared)
+        *pulShared += Node_getBytes(oNNode);
+    else
+        *pulExclusive += Node_getBytes(oNNode);
+
+    if (Node_isDirectory(oNNode) == FALSE)
     {
-        iStatus = Node_addChild(oNParent, psNew, ulIndex);
-        if (iStatus != SUCCESS)
+        struct fileNode *psFile = Node_asFile(oNNode);
+        if (psFile->bOwned &&
+            Content_getKind(psFile->contents) != CONTENT_HEAP &&
+            Content_countOnce(psFile->contents, ulCount))
         {
-            Path_free(psNew->oPPath);
-            free(psNew);
-            *poNResult = NULL;
-            return iStatus;
+            size_t ulLength = psFile->lenContents;
+            if (Content_getKind(psFile->contents) == CONTENT_PACKED ||
+                Content_getKind(psFile->contents) == CONTENT_TIERED)
+                ulLength = Content_getResidentLength(psFile->contents);
+            if (Content_getRefs(psFile->contents) > 1)
+                *pulShared += ulLength;
+            else
+                *pulExclusive += ulLength;
         }
+        return;
     }
+    for (i = 0; i < Node_getNumChildren(oNNode); i++)
+        Node_addUsage(Node_getChildren(oNNode)[i], bShared, pucDirsSeen,
+                      pucFilesSeen, ulCount, pulExclusive, pulShared);
+}
 
-    *poNResult = psNew;
+int Node_getUsage(Node_T oNRoot, size_t *pulExclusive,
+                  size_t *pulShared)
+{
+    unsigned char *pucDirsSeen;
+    unsigned char *pucFilesSeen;
+
+    assert(pulExclusive != NULL);
+    assert(pulShared != NULL);
 
-    /* assert(oNParent == NULL || CheckerDT_Node_isValid(oNParent)); */
-    /* assert(CheckerDT_Node_isValid(*poNResult)); */
+    *pulExclusive = 0;
+    *pulShared = 0;
+    if (oNRoot == NULL_NODE)
+        return SUCCESS;
 
+    pucDirsSeen = calloc(sDirs.uLength / CHAR_BIT + 1, 1);
+    pucFilesSeen = calloc(sFiles.uLength / CHAR_BIT + 1, 1);
+    if (pucDirsSeen == NULL || pucFilesSeen == NULL)
+    {
+        free(pucDirsSeen);
+        free(pucFilesSeen);
+        return MEMORY_ERROR;
+    }
+    Node_addUsage(oNRoot, FALSE, pucDirsSeen, pucFilesSeen,
+                  Content_newCount(), pulExclusive, pulShared);
+    free(pucDirsSeen);
+    free(pucFilesSeen);
     return SUCCESS;
 }
 
 /*
-  Destroys and frees all memory allocated for the subtree rooted at
-  oNNode, i.e., deletes this node and all its descendents. Returns the
-  number of nodes deleted.
+  Copies the subtree rooted at oNNode, whose (already copied) parent
+  has the new handle oNNewParent, from the current pools and arenas
+  into psFilesTo, psDirsTo, psNamesTo, and psChildrenTo, which must
+  have room for it. Nodes are appended in pre-order: each directory,
+  then its file children, then the subtrees of its directory children.
+  Returns the handle of oNNode's copy.
 */
-size_t Node_free(Node_T oNNode)
+static Node_T Node_copyPreOrder(Node_T oNNode, Node_T oNNewParent,
+                                struct pool *psFilesTo,
+                                struct pool *psDirsTo,
+                                struct arena *psNamesTo,
+                                struct arena *psChildrenTo)
 {
-    size_t ulIndex = 0;
-    size_t ulCount = 0;
+    const char *pcName = Node_getName(oNNode);
+    size_t ulNameLength = strlen(pcName) + 1;
+    unsigned int uName = (unsigned int)psNamesTo->ulLength;
+    Node_T oNNew;
 
-    assert(oNNode != NULL);
-    /* assert(CheckerDT_Node_isValid(oNNode)); */
+    memcpy(psNamesTo->pcBytes + uName, pcName, ulNameLength);
+    psNamesTo->ulLength += ulNameLength;
 
-
-    /* remove from parent's list */
-    if (oNNode->oNParent != NULL)
+    if (Node_isDirectory(oNNode) == FALSE)
     {
-        if (DynArray_bsearch(
-                oNNode->oNParent->oDChildren,
-                oNNode, &ulIndex,
-                (int (*)(const void *, const void *))Node_compare))
-            (void)DynArray_removeAt(oNNode->oNParent->oDChildren,
-                                    ulIndex);
-    }
+        struct fileNode *psNew;
 
-    /* recursively remove children from directories */
-    if (oNNode->isDirectory == TRUE)
+        oNNew = psFilesTo->uLength++;
+        psNew = (struct fileNode *)psFilesTo->pcSlots + oNNew;
+        *psNew = *Node_asFile(oNNode);
+        psNew->oNParent = oNNewParent;
+        psNew->uName = uName;
+    }
+    else
     {
-        while (DynArray_getLength(oNNode->oDChildren) != 0)
+        struct dirNode *psNew;
+        unsigned int uNumChildren;
+        unsigned int uChildren;
+        unsigned int c;
+
+        oNNew = psDirsTo->uLength++ | DIR_TAG;
+        psNew = (struct dirNode *)psDirsTo->pcSlots + (oNNew & ~DIR_TAG);
+        *psNew = *Node_asDir(oNNode);
+        psNew->oNParent = oNNewParent;
+        psNew->uName = uName;
+
+        /* reserve the run first, then fill it in as each child is
+           copied */
+        uNumChildren = psNew->uNumFiles + psNew->uNumDirs;
+        uChildren = (unsigned int)(psChildrenTo->ulLength / sizeof(Node_T));
+        psNew->uChildren = uChildren;
+        psNew->uCapacity = uNumChildren;
+        psChildrenTo->ulLength += uNumChildren * sizeof(Node_T);
+        for (c = 0; c < uNumChildren; c++)
         {
-            ulCount += Node_free(DynArray_get(oNNode->oDChildren, 0));
+            Node_T oNChild = Node_copyPreOrder(
+                Node_getChildren(oNNode)[c], oNNew, psFilesTo, psDirsTo,
+                psNamesTo, psChildrenTo);
+            ((Node_T *)psChildrenTo->pcBytes)[uChildren + c] = oNChild;
         }
     }
+    return oNNew;
+}
 
-    /* if onNode is a file, there are no descendents. */
-    else
+int Node_compact(Node_T oNRoot, Node_T *poNNewRoot)
+{
+    struct pool sFilesTo = {NULL, sizeof(struct fileNode), 1, 0, 0, 0};
+    struct pool sDirsTo = {NULL, sizeof(struct dirNode), 1, 0, 0, 0};
+    struct arena sNamesTo = {NULL, 0, 0, 0};
+    struct arena sChildrenTo = {NULL, 0, 0, 0};
+
+    assert(poNNewRoot != NULL);
+
+    *poNNewRoot = oNRoot;
+    if (oNRoot == NULL_NODE)
+        return SUCCESS;
+
+    /* every live node must be reached from oNRoot exactly once:
+       shared nodes must stay where all their trees refer to them */
+    assert(Node_getParent(oNRoot) == NULL_NODE);
+    if (sDirs.uLive != Node_asDir(oNRoot)->ulNumDirs + 1 ||
+        sFiles.uLive != Node_asDir(oNRoot)->ulNumFiles)
+        return NOT_COMPACTED;
+
+    /* allocate exactly enough for the live nodes before changing
+       anything, so that failure leaves the tree as it was. every
+       node but the root has one slot in some directory's run. */
+    sFilesTo.uCapacity = sFiles.uLive + 1;
+    sDirsTo.uCapacity = sDirs.uLive + 1;
+    sNamesTo.ulCapacity = sNames.ulLength - sNames.ulGarbage;
+    sChildrenTo.ulCapacity = (sFiles.uLive + sDirs.uLive - 1) *
+                             sizeof(Node_T);
+    sFilesTo.pcSlots = malloc(sFilesTo.uCapacity * sizeof(struct fileNode));
+    sDirsTo.pcSlots = malloc(sDirsTo.uCapacity * sizeof(struct dirNode));
+    sNamesTo.pcBytes = malloc(sNamesTo.ulCapacity);
+    sChildrenTo.pcBytes = malloc(sChildrenTo.ulCapacity + 1);
+    if (sFilesTo.pcSlots == NULL || sDirsTo.pcSlots == NULL ||
+        sNamesTo.pcBytes == NULL || sChildrenTo.pcBytes == NULL)
     {
-        Path_free(oNNode->oPPath);
-        free(oNNode);
-        oNNode = NULL;
-        ulCount++;
-        return ulCount;
+        free(sFilesTo.pcSlots);
+        free(sDirsTo.pcSlots);
+        free(sNamesTo.pcBytes);
+        free(sChildrenTo.pcBytes);
+        return MEMORY_ERROR;
     }
 
-    DynArray_free(oNNode->oDChildren);
-
-    /* remove path */
-    Path_free(oNNode->oPPath);
+    *poNNewRoot = Node_copyPreOrder(oNRoot, NULL_NODE, &sFilesTo,
+                                    &sDirsTo, &sNamesTo, &sChildrenTo);
+    assert(sFilesTo.uLength == sFilesTo.uCapacity);
+    assert(sDirsTo.uLength == sDirsTo.uCapacity);
+    assert(sNamesTo.ulLength == sNamesTo.ulCapacity);
 
-    /* finally, free the struct node */
-    free(oNNode);
-    oNNode = NULL;
-    ulCount++;
-    return ulCount;
+    sFilesTo.uLive = sFiles.uLive;
+    sDirsTo.uLive = sDirs.uLive;
+    free(sFiles.pcSlots);
+    free(sDirs.pcSlots);
+    free(sNames.pcBytes);
+    free(sChildren.pcBytes);
+    sFiles = sFilesTo;
+    sDirs = sDirsTo;
+    sNames = sNamesTo;
+    sChildren = sChildrenTo;
+    return SUCCESS;
 }
 
-
-/* Returns the path object representing oNNode's absolute path. */
-Path_T Node_getPath(Node_T oNNode)
+const char *Node_getName(Node_T oNNode)
 {
-    assert(oNNode != NULL);
-    return oNNode->oPPath;
+    assert(oNNode != NULL_NODE);
+    return sNames.pcBytes + Node_getNameOffset(oNNode);
 }
 
-boolean Node_hasChild(Node_T oNParent, Path_T oPPath,
+boolean Node_hasChild(Node_T oNParent, const char *pcName,
                       size_t *pulChildID)
 {
-    assert(oNParent != NULL);
-    assert(oPPath != NULL);
+    size_t ulIndex = 0;
+    boolean bFound;
+
+    assert(oNParent != NULL_NODE);
+    assert(pcName != NULL);
     assert(pulChildID != NULL);
 
-    if (oNParent->isDirectory == FALSE)
+    if (Node_isDirectory(oNParent) == FALSE)
     {
         return FALSE;
     }
-    /* *pulChildID is the index into oNParent->oDChildren */
-    return DynArray_bsearch(oNParent->oDChildren,
-                            (char *)Path_getPathname(oPPath), pulChildID,
-                            (int (*)(const void *, const void *))Node_compareString);
+    /* file children take identifiers 0 to (number of files - 1),
+       and directory children the identifiers after them */
+    if (Node_search(oNParent, FALSE, pcName, &ulIndex))
+    {
+        *pulChildID = ulIndex;
+        return TRUE;
+    }
+    bFound = Node_search(oNParent, TRUE, pcName, &ulIndex);
+    *pulChildID = Node_getNumFileChildren(oNParent) + ulIndex;
+    return bFound;
+}
+
+size_t Node_findPrefix(Node_T oNParent, boolean bDirs,
+                       const char *pcPrefix, size_t ulLength)
+{
+    struct dirNode *psDir;
+    Node_T *poNKind;
+    size_t ulLow = 0;
+    size_t ulHigh;
+
+    assert(oNParent != NULL_NODE);
+    assert(Node_isDirectory(oNParent));
+    assert(pcPrefix != NULL);
+
+    psDir = Node_asDir(oNParent);
+    poNKind = Node_getChildren(oNParent);
+    if (bDirs == TRUE)
+    {
+        poNKind += psDir->uNumFiles;
+        ulHigh = psDir->uNumDirs;
+    }
+    else
+        ulHigh = psDir->uNumFiles;
+
+    while (ulLow < ulHigh)
+    {
+        size_t ulMid = ulLow + (ulHigh - ulLow) / 2;
+        if (strncmp(Node_getName(poNKind[ulMid]), pcPrefix, ulLength) < 0)
+            ulLow = ulMid + 1;
+        else
+            ulHigh = ulMid;
+    }
+    return bDirs == TRUE ? psDir->uNumFiles + ulLow : ulLow;
 }
 
 
 /* Returns the number of children that oNParent has. */
 size_t Node_getNumChildren(Node_T oNParent)
 {
-    assert(oNParent != NULL);
-    if (oNParent->isDirectory == FALSE)
+    assert(oNParent != NULL_NODE);
+    if (Node_isDirectory(oNParent) == FALSE)
+    {
+        return 0;
+    }
+    return (size_t)Node_asDir(oNParent)->uNumFiles +
+           Node_asDir(oNParent)->uNumDirs;
+}
+
+/* Returns the number of file children that oNParent has. */
+size_t Node_getNumFileChildren(Node_T oNParent)
+{
+    assert(oNParent != NULL_NODE);
+    if (Node_isDirectory(oNParent) == FALSE)
     {
         return 0;
     }
-    return (DynArray_getLength(oNParent->oDChildren));
+    return Node_asDir(oNParent)->uNumFiles;
 }
 
 
 /*
   Returns an int SUCCESS status and sets *poNResult to be the child
   node of oNParent with identifier ulChildID, if one exists.
-  Otherwise, sets *poNResult to NULL and returns status:
+  Otherwise, sets *poNResult to NULL_NODE and returns status:
   * NO_SUCH_PATH if ulChildID is not a valid child for oNParent
 */
 int Node_getChild(Node_T oNParent, size_t ulChildID,
                   Node_T *poNResult)
 {
-
-    assert(oNParent != NULL);
+    assert(oNParent != NULL_NODE);
     assert(poNResult != NULL);
 
-    if (oNParent->isDirectory == FALSE)
-    {
-        *poNResult = NULL;
-        return NO_SUCH_PATH;
-    }
-
-    /* ulChildID is the index into oNParent->oDChildren */
+    /* ulChildID indexes the run of children, which holds the files
+       first, then the directories */
     if (ulChildID >= Node_getNumChildren(oNParent))
     {
-        *poNResult = NULL;
+        *poNResult = NULL_NODE;
         return NO_SUCH_PATH;
     }
-    else
-    {
-        *poNResult = DynArray_get(oNParent->oDChildren, ulChildID);
-        return SUCCESS;
-    }
+    *poNResult = Node_getChildren(oNParent)[ulChildID];
+    return SUCCESS;
 }
 
 
 /*
   Returns the parent node of oNNode.
-  Returns NULL if oNNode is the root and thus has no parent.
+  Returns NULL_NODE if oNNode is the root and thus has no parent.
 */
 
 Node_T Node_getParent(Node_T oNNode)
 {
-    assert(oNNode != NULL);
-    return oNNode->oNParent;
+    assert(oNNode != NULL_NODE);
+    if (Node_isDirectory(oNNode) == TRUE)
+        return Node_asDir(oNNode)->oNParent;
+    else
+        return Node_asFile(oNNode)->oNParent;
 }
 
 
-/*
-  Compares oNFirst and oNSecond lexicographically based on their paths.
-  Returns <0, 0, or >0 if onFirst is "less than", "equal to", or
-  "greater than" oNSecond, respectively.
-*/
-int Node_compare(Node_T oNFirst, Node_T oNSecond)
+boolean Node_isDirectory(Node_T oNNode)
+{
+    assert(oNNode != NULL_NODE);
+    return (boolean)((oNNode & DIR_TAG) != 0);
+}
+
+void *Node_getContents(Node_T oNNode)
 {
-    assert(oNFirst != NULL);
-    assert(oNSecond != NULL);
-    return (Path_comparePath(oNFirst->oPPath, oNSecond->oPPath));
+    struct fileNode *psFile;
+    const void *pvBytes;
+
+    assert(oNNode != NULL_NODE);
+    if (Node_isDirectory(oNNode) == TRUE)
+    {
+        return NULL;
+    }
+    psFile = Node_asFile(oNNode);
+    if (!psFile->bOwned)
+        return psFile->contents;
+    Content_touch(psFile->contents);
+    switch (Content_getKind(psFile->contents))
+    {
+    case CONTENT_CHUNKED:
+        return Content_flatten(psFile->contents);
+    case CONTENT_PACKED:
+        return (void *)Content_unpack(psFile->contents);
+    case CONTENT_TIERED:
+        (void)Content_page(psFile->contents, &pvBytes);
+        return (void *)pvBytes;
+    case CONTENT_MAPPED:
+        return (void *)Content_getMapped(psFile->contents);
+    default:
+        return psFile->contents;
+    }
 }
 
+int Node_fetchContents(Node_T oNNode, void **ppvResult)
+{
+    struct fileNode *psFile;
 
-/*
-  Returns a string representation for oNNode, or NULL if
-  there is an allocation error.
+    assert(oNNode != NULL_NODE);
+    assert(ppvResult != NULL);
 
-  Allocates memory for the returned string, which is then owned by
-  the caller!
-*/
+    *ppvResult = Node_getContents(oNNode);
+    if (Node_isDirectory(oNNode) == TRUE)
+        return SUCCESS;
+    psFile = Node_asFile(oNNode);
+    if (psFile->bOwned && *ppvResult == NULL && psFile->lenContents != 0)
+        return MEMORY_ERROR;
+    return SUCCESS;
+}
 
-boolean Node_isDirectory(Node_T oNNode)
+size_t Node_getSizeContents(Node_T oNNode)
 {
-    assert(oNNode != NULL);
-    return oNNode->isDirectory;
+    assert(oNNode != NULL_NODE);
+    if (Node_isDirectory(oNNode) == TRUE)
+    {
+        return 0;
+    }
+    return Node_asFile(oNNode)->lenContents;
 }
 
-void *Node_getContents(Node_T oNNode)
+void Node_getTotals(Node_T oNNode, size_t *pulDirs, size_t *pulFiles,
+                    size_t *pulBytes)
 {
-    assert(oNNode != NULL);
-    return oNNode->contents;
+    assert(oNNode != NULL_NODE);
+    assert(pulDirs != NULL);
+    assert(pulFiles != NULL);
+    assert(pulBytes != NULL);
+
+    if (Node_isDirectory(oNNode) == TRUE)
+    {
+        *pulDirs = Node_asDir(oNNode)->ulNumDirs + 1;
+        *pulFiles = Node_asDir(oNNode)->ulNumFiles;
+        *pulBytes = Node_asDir(oNNode)->ulNumBytes;
+    }
+    else
+    {
+        *pulDirs = 0;
+        *pulFiles = 1;
+        *pulBytes = Node_asFile(oNNode)->lenContents;
+    }
 }
 
-size_t Node_getSizeContents(Node_T oNNode)
+uint64_t Node_getHash(Node_T oNNode)
 {
-    assert(oNNode != NULL);
-    return oNNode->lenContents;
+    assert(oNNode != NULL_NODE);
+
+    if (Node_isDirectory(oNNode) == TRUE)
+        return Node_asDir(oNNode)->ulHash;
+    else
+        return Node_asFile(oNNode)->ulHash;
 }
 
 int Node_setContents(Node_T oNNode, void *pvNewContents, size_t newLenContents)
 {
-    assert(oNNode != NULL);
+    struct fileNode *psFile;
+    uint64_t ulOldEntry;
+
+    assert(oNNode != NULL_NODE);
 
     if (Node_isDirectory(oNNode) == TRUE)
     {
         return NOT_A_FILE;
     }
-    oNNode->contents = pvNewContents;
-    oNNode->lenContents = newLenContents;
+    psFile = Node_asFile(oNNode);
+    ulOldEntry = Node_entryHash(oNNode);
+    if (psFile->bOwned)
+        Content_release(psFile->contents);
+    psFile->bOwned = FALSE;
+    psFile->ulHash = Node_borrowedHash(pvNewContents, newLenContents);
+    Node_adjustAncestors(oNNode, 0, 0,
+                         (long)newLenContents - (long)psFile->lenContents,
+                         ulOldEntry, Node_entryHash(oNNode));
+    psFile->contents = pvNewContents;
+    psFile->lenContents = newLenContents;
+    return SUCCESS;
+}
+
+/*
+  Makes the contents pvStored, of newLenContents bytes, to which the
+  caller holds a reference that passes to file oNNode, oNNode's
+  contents, releasing those it held before.
+*/
+static void Node_adoptContents(Node_T oNNode, void *pvStored,
+                               size_t newLenContents)
+{
+    struct fileNode *psFile;
+    uint64_t ulOldEntry;
+
+    psFile = Node_asFile(oNNode);
+    ulOldEntry = Node_entryHash(oNNode);
+    if (psFile->bOwned)
+        Content_release(psFile->contents);
+    psFile->bOwned = TRUE;
+    if (Content_getKind(pvStored) == CONTENT_HEAP)
+        psFile->ulHash = Content_hash(pvStored, newLenContents);
+    else
+        psFile->ulHash = Content_getHash(pvStored);
+    Node_adjustAncestors(oNNode, 0, 0,
+                         (long)newLenContents - (long)psFile->lenContents,
+                         ulOldEntry, Node_entryHash(oNNode));
+    psFile->contents = pvStored;
+    psFile->lenContents = newLenContents;
+}
+
+int Node_storeContents(Node_T oNNode, const void *pvNewContents,
+                       size_t newLenContents, int iKind)
+{
+    void *pvStored;
+    int iStatus;
+
+    assert(oNNode != NULL_NODE);
+    assert(pvNewContents != NULL);
+    assert(iKind == CONTENT_STORED || iKind == CONTENT_HEAP ||
+           iKind == CONTENT_TIERED);
+
+    if (Node_isDirectory(oNNode) == TRUE)
+        return NOT_A_FILE;
+
+    /* store the new contents before letting go of the old, which may
+       be the same */
+    if (iKind == CONTENT_STORED)
+        iStatus = Content_intern(pvNewContents, newLenContents, &pvStored);
+    else if (iKind == CONTENT_TIERED)
+        iStatus = Content_tier(pvNewContents, newLenContents, &pvStored);
+    else
+        iStatus = Content_own(pvNewContents, newLenContents, &pvStored);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    Node_adoptContents(oNNode, pvStored, newLenContents);
+    return SUCCESS;
+}
+
+int Node_loadContents(Node_T oNNode, int iFd, size_t ulOffset,
+                      size_t newLenContents, int iKind)
+{
+    void *pvStored;
+    int iStatus;
+
+    assert(oNNode != NULL_NODE);
+
+    if (Node_isDirectory(oNNode) == TRUE)
+        return NOT_A_FILE;
+    iStatus = Content_load(iFd, ulOffset, newLenContents, iKind,
+                           &pvStored);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    Node_adoptContents(oNNode, pvStored, newLenContents);
+    return SUCCESS;
+}
+
+int Node_sendContents(Node_T oNNode, int iFd)
+{
+    struct fileNode *psFile;
+
+    assert(oNNode != NULL_NODE);
+
+    if (Node_isDirectory(oNNode) == TRUE)
+        return NOT_A_FILE;
+    psFile = Node_asFile(oNNode);
+    if (!psFile->bOwned)
+        return Content_sendBytes(psFile->contents, psFile->lenContents,
+                                 iFd);
+    return Content_send(psFile->contents, psFile->lenContents, iFd);
+}
+
+int Node_writeContents(Node_T oNNode, size_t ulOffset,
+                       const void *pvBytes, size_t ulLength)
+{
+    struct fileNode *psFile;
+    uint64_t ulOldEntry;
+    size_t ulOldLength;
+    int iStatus;
+
+    assert(oNNode != NULL_NODE);
+    assert(pvBytes != NULL || ulLength == 0);
+
+    if (Node_isDirectory(oNNode) == TRUE)
+        return NOT_A_FILE;
+
+    /* the first write chunks the contents, once */
+    psFile = Node_asFile(oNNode);
+    if (!psFile->bOwned ||
+        Content_getKind(psFile->contents) != CONTENT_CHUNKED)
+    {
+        const void *pvFlat = psFile->contents;
+        void *pvChunked;
+
+        if (psFile->bOwned &&
+            Content_getKind(psFile->contents) == CONTENT_PACKED)
+        {
+            pvFlat = Content_unpack(psFile->contents);
+            if (pvFlat == NULL)
+                return MEMORY_ERROR;
+        }
+        else if (psFile->bOwned &&
+                 Content_getKind(psFile->contents) == CONTENT_TIERED)
+        {
+            iStatus = Content_page(psFile->contents, &pvFlat);
+            if (iStatus != SUCCESS)
+                return iStatus;
+        }
+        else if (psFile->bOwned &&
+                 Content_getKind(psFile->contents) == CONTENT_MAPPED)
+            pvFlat = Content_getMapped(psFile->contents);
+        iStatus = Content_chunk(pvFlat, psFile->lenContents,
+                                &pvChunked);
+        if (iStatus != SUCCESS)
+            return iStatus;
+        if (psFile->bOwned)
+            Content_release(psFile->contents);
+        psFile->bOwned = TRUE;
+        psFile->contents = pvChunked;
+    }
+
+    ulOldEntry = Node_entryHash(oNNode);
+    ulOldLength = psFile->lenContents;
+    iStatus = Content_write(&psFile->contents, ulOffset, pvBytes,
+                            ulLength);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    if (ulLength != 0 && ulOffset + ulLength > ulOldLength)
+        psFile->lenContents = ulOffset + ulLength;
+    psFile->ulHash = Content_getHash(psFile->contents);
+    Node_adjustAncestors(oNNode, 0, 0,
+                         (long)psFile->lenContents - (long)ulOldLength,
+                         ulOldEntry, Node_entryHash(oNNode));
+    return SUCCESS;
+}
+
+int Node_readContents(Node_T oNNode, size_t ulOffset, void *pvBuf,
+                      size_t ulLength, size_t *pulRead)
+{
+    struct fileNode *psFile;
+    const void *pvBytes;
+
+    assert(oNNode != NULL_NODE);
+    assert(Node_isDirectory(oNNode) == FALSE);
+    assert(pvBuf != NULL || ulLength == 0);
+    assert(pulRead != NULL);
+
+    *pulRead = 0;
+    psFile = Node_asFile(oNNode);
+    pvBytes = psFile->contents;
+    if (psFile->bOwned)
+    {
+        Content_touch(psFile->contents);
+        if (Content_getKind(psFile->contents) == CONTENT_CHUNKED)
+        {
+            *pulRead = Content_read(psFile->contents, ulOffset, pvBuf,
+                                    ulLength);
+            return SUCCESS;
+        }
+        if (Content_getKind(psFile->contents) == CONTENT_TIERED)
+            return Content_readTiered(psFile->contents, ulOffset, pvBuf,
+                                      ulLength, pulRead);
+        if (Content_getKind(psFile->contents) == CONTENT_MAPPED)
+            pvBytes = Content_getMapped(psFile->contents);
+        if (Content_getKind(psFile->contents) == CONTENT_PACKED)
+        {
+            pvBytes = Content_unpack(psFile->contents);
+            if (pvBytes == NULL)
+                return MEMORY_ERROR;
+        }
+    }
+    if (ulOffset >= psFile->lenContents)
+        return SUCCESS;
+    if (ulLength > psFile->lenContents - ulOffset)
+        ulLength = psFile->lenContents - ulOffset;
+    memcpy(pvBuf, (const char *)pvBytes + ulOffset, ulLength);
+    *pulRead = ulLength;
     return SUCCESS;
 }
 
+void Node_pack(Node_T oNNode, size_t ulMinLength, boolean bColdOnly)
+{
+    size_t i;
+
+    assert(oNNode != NULL_NODE);
+
+    if (Node_isDirectory(oNNode) == FALSE)
+    {
+        struct fileNode *psFile = Node_asFile(oNNode);
+
+        /* contents several files share are kept once already, tiered
+           contents make room by going to their spill file, and mapped
+           contents are in their file already */
+        if (!psFile->bOwned || psFile->contents == NULL ||
+            psFile->lenContents < ulMinLength ||
+            Content_getKind(psFile->contents) == CONTENT_PACKED ||
+            Content_getKind(psFile->contents) == CONTENT_TIERED ||
+            Content_getKind(psFile->contents) == CONTENT_MAPPED ||
+            Content_getRefs(psFile->contents) > 1)
+            return;
+        if (bColdOnly && !Content_cool(psFile->contents))
+            return;
+        (void)Content_pack(&psFile->contents, psFile->lenContents,
+                           psFile->ulHash);
+        return;
+    }
+    for (i = 0; i < Node_getNumChildren(oNNode); i++)
+        Node_pack(Node_getChildren(oNNode)[i], ulMinLength, bColdOnly);
+}
+
+void *Node_retainContents(Node_T oNNode)
+{
+    assert(oNNode != NULL_NODE);
+
+    if (Node_isDirectory(oNNode) == TRUE || !Node_asFile(oNNode)->bOwned)
+        return NULL;
+    Content_retain(Node_asFile(oNNode)->contents);
+    return Node_asFile(oNNode)->contents;
+}
+
 char *Node_toString(Node_T oNNode)
 {
+    Node_T oNCurr;
+    size_t ulLength = 0;
     char *copyPath;
+    char *pcInsert;
+
+    assert(oNNode != NULL_NODE);
+
+    /* the path is the names from the root down, joined by '/' */
+    for (oNCurr = oNNode; oNCurr != NULL_NODE;
+         oNCurr = Node_getParent(oNCurr))
+        ulLength += strlen(Node_getName(oNCurr)) + 1;
 
-    assert(oNNode != NULL);
-    copyPath = malloc(Path_getStrLength(Node_getPath(oNNode)) + 1);
+    copyPath = malloc(ulLength);
     if (copyPath == NULL)
         return NULL;
-    else
-        return strcpy(copyPath, Path_getPathname(Node_getPath(oNNode)));
+
+    /* fill in from the end */
+    pcInsert = copyPath + ulLength - 1;
+    *pcInsert = '\0';
+    for (oNCurr = oNNode; oNCurr != NULL_NODE;
+         oNCurr = Node_getParent(oNCurr))
+    {
+        size_t ulNameLength = strlen(Node_getName(oNCurr));
+        if (oNCurr != oNNode)
+            *--pcInsert = '/';
+        pcInsert -= ulNameLength;
+        memcpy(pcInsert, Node_getName(oNCurr), ulNameLength);
+    }
+    return copyPath;
 }
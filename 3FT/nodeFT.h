@@ -1,5 +1,5 @@
 /*--------------------------------------------------------------------*/
-/* nodeDT.h                                                           */
+/* nodeFT.h                                                           */
 /* Author: Judah Guggenheim, code borrowed from Christopher Moretti   */
 /*--------------------------------------------------------------------*/
 
@@ -7,94 +7,358 @@
 #define NODE_INCLUDED
 
 #include <stddef.h>
+#include <stdint.h>
 #include "a4def.h"
-#include "path.h"
-/* #include "dynarray.h" */
 
-/* A Node_T is a node in a Directory Tree */
-typedef struct node *Node_T;
+/*
+  A Node_T is a handle to a node in a File Tree: a 32-bit value that
+  stays valid until the node is freed. All nodes live in two growable
+  pools (one for files, one for directories) owned by this module, and
+  a Node_T is the node's index into the pool of its kind, with the
+  high bit set for directories.
+
+  Trees may share nodes: a node counts the directories and roots that
+  refer to it, and is only freed once none does. A shared node must
+  not be modified; Node_own gives the tree being modified its own copy
+  first, so that each modification copies just the path down to the
+  nodes it changes.
+*/
+typedef unsigned int Node_T;
+
+/* The Node_T that refers to no node, e.g., the parent of the root. */
+enum { NULL_NODE = 0 };
 
 /*
-  Creates a new node in the Directory Tree, with path oPPath and
-  parent oNParent. If the node is a file, dir is FALSE and conts and 
+  Creates a new node in the File Tree, named pcName (a single path
+  component), as a child of oNParent, or as a root if oNParent is
+  NULL_NODE. If the node is a file, dir is FALSE and conts and
   sizeConts represent the contents of that file and their size. If the
   node is a directory, dir is TRUE, conts is NULL, and sizeConts is 0.
   Returns an int SUCCESS status and sets *poNResult
-  to be the new node if successful. Otherwise, sets *poNResult to NULL
-  and returns status:
+  to be the new node if successful. Otherwise, sets *poNResult to
+  NULL_NODE and returns status:
   * MEMORY_ERROR if memory could not be allocated to complete request
-  * CONFLICTING_PATH if oNParent's path is not an ancestor of oPPath
-  * NO_SUCH_PATH if oPPath is of depth 0
-                 or oNParent's path is not oPPath's direct parent
-                 or oNParent is NULL but oPPath is not of depth 1
-  * ALREADY_IN_TREE if oNParent already has a child with this path
+  * CONFLICTING_PATH if oNParent is a file
+  * ALREADY_IN_TREE if oNParent already has a child named pcName
 */
-int Node_new(Path_T oPPath, Node_T oNParent, Node_T *poNResult, boolean dir,
-             void *conts, size_t sizeConts);
+int Node_new(const char *pcName, Node_T oNParent, Node_T *poNResult,
+             boolean dir, void *conts, size_t sizeConts);
 
 /*
-  Destroys and frees all memory allocated for the subtree rooted at
-  oNNode, i.e., deletes this node and all its descendents. Returns the
-  number of nodes deleted.
+  Removes the subtree rooted at oNNode from its parent, if it has one,
+  and destroys and frees all memory allocated for the nodes of that
+  subtree that no other tree shares. Returns the number of nodes in
+  the subtree.
 */
 size_t Node_free(Node_T oNNode);
 
-/* Returns the path object representing oNNode's absolute path. */
-Path_T Node_getPath(Node_T oNNode);
+/*
+  Moves the subtree rooted at oNNode from its parent, if it has one,
+  into directory oNNewParent, or makes it a root of its own if
+  oNNewParent is NULL_NODE, under the name pcName (a single path
+  component). Nodes store only their own names, so this takes time
+  proportional to the parents' numbers of children, but not to the
+  size of the subtree, and moving a node out as a root under its own
+  name cannot fail. oNNode and oNNewParent must have been readied with
+  Node_own, and oNNewParent must not be in the subtree.
+  Returns SUCCESS if moved. Otherwise, leaves oNNode where it was and
+  returns status:
+  * CONFLICTING_PATH if oNNewParent is a file
+  * ALREADY_IN_TREE if oNNewParent already has a child named pcName
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_move(Node_T oNNode, Node_T oNNewParent, const char *pcName);
+
+/*
+  Makes oNNode, the root of some tree, the root of one more tree
+  too, e.g., of a snapshot: the subtree stays until Node_free has been
+  called once for each tree.
+*/
+void Node_share(Node_T oNNode);
+
+/*
+  Readies *poNNode, a child of oNParent, or a root if oNParent is
+  NULL_NODE, to be modified or to have its children modified:
+  oNParent must already be ready. If *poNNode is shared with another
+  tree, replaces it, in oNParent's run of children too, with a copy
+  that shares its children instead, and sets *poNNode to the copy.
+  Call for each node on the path from the root down before modifying
+  any of them: Node_new, Node_free, and Node_setContents update the
+  totals of every ancestor of the nodes they change.
+  Returns SUCCESS, or MEMORY_ERROR if the copy could not be allocated,
+  in which case *poNNode is unchanged.
+*/
+int Node_own(Node_T oNParent, Node_T *poNNode);
+
+/*
+  Creates a copy of the subtree rooted at oNNode as a child of
+  directory oNNewParent, named pcName (a single path component), and
+  sets *poNResult to it. Only oNNode itself is copied: the copy shares
+  oNNode's children, and through them the rest of the subtree, until
+  Node_own gives either side copies of the nodes it modifies, so this
+  takes time proportional to oNNode's and oNNewParent's numbers of
+  children. oNNewParent must have been readied with Node_own, and must
+  not be in the subtree. File contents are shared, not copied.
+  Returns SUCCESS if copied. Otherwise, sets *poNResult to NULL_NODE
+  and returns status:
+  * CONFLICTING_PATH if oNNewParent is a file
+  * ALREADY_IN_TREE if oNNewParent already has a child named pcName
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_copy(Node_T oNNode, Node_T oNNewParent, const char *pcName,
+              Node_T *poNResult);
 
 /*
-  Returns TRUE if oNParent has a child with path oPPath. Returns
+  Merges the subtree rooted at directory oNSrc into directory oNDst,
+  which must have been readied with Node_own: children only oNSrc has
+  are shared into oNDst whole, without visiting their subtrees;
+  directories both have are merged in turn; and where one has a file
+  and the other a node of the same name, oNDst keeps its own unless
+  bFiles is TRUE (for two files) or bKinds is TRUE (for a file and a
+  directory), in which case it takes oNSrc's instead. oNSrc is left as
+  it was, sharing its nodes with oNDst. Takes time proportional to the
+  numbers of children of the directories both have, not to the size
+  of oNSrc. Updates the totals of oNDst and its ancestors.
+  Returns SUCCESS, or MEMORY_ERROR if memory could not be allocated to
+  complete request, in which case oNDst may be partly merged.
+*/
+int Node_merge(Node_T oNDst, Node_T oNSrc, boolean bFiles,
+               boolean bKinds);
+
+/*
+  Reports the memory taken up by the tree rooted at oNRoot (none if it
+  is NULL_NODE): the nodes' slots, names, room for children, and file
+  contents. Stores in *pulShared the bytes of the nodes that are shared
+  with other trees, or reached more than once in this one, e.g., after
+  Node_copy, and of all nodes below them, each counted once. Stores in
+  *pulExclusive the bytes of the rest, which only this tree uses.
+  Returns SUCCESS, or MEMORY_ERROR if memory could not be allocated to
+  complete request, in which case both are set to 0.
+*/
+int Node_getUsage(Node_T oNRoot, size_t *pulExclusive,
+                  size_t *pulShared);
+
+/*
+  Makes room for ulDirs more directories and ulFiles more files, with
+  ulNameBytes bytes of names in all (counting each name's '\0'), so
+  that creating that many nodes in one go does not reallocate the
+  pools and the name arena once per doubling. Returns SUCCESS, or
+  MEMORY_ERROR if allocation fails or the pools cannot grow that
+  large, in which case some of the room may have been made.
+*/
+int Node_reserve(size_t ulDirs, size_t ulFiles, size_t ulNameBytes);
+
+/*
+  Relocates every node in the tree rooted at oNRoot, which must be all
+  the nodes there are, into freshly allocated pools and arenas sized
+  exactly for them, so that freed slots and released names and
+  children runs no longer take up space. Nodes, their names, and their
+  children runs are laid out in the order a pre-order traversal that
+  lists files before directories visits them, so each subtree occupies
+  consecutive memory.
+  All Node_T handles change: returns SUCCESS and sets *poNNewRoot to
+  the root's new handle. Otherwise, sets *poNNewRoot to oNRoot, leaves
+  every node where it was, and returns:
+  * NOT_COMPACTED if some nodes are shared, i.e., are not reached from
+                  oNRoot exactly once
+  * MEMORY_ERROR if memory could not be allocated
+*/
+int Node_compact(Node_T oNRoot, Node_T *poNNewRoot);
+
+/*
+  Returns oNNode's name, i.e., the last component of its absolute
+  path. The string is owned by this module, and is only valid until
+  the next call that creates or frees a node.
+*/
+const char *Node_getName(Node_T oNNode);
+
+/*
+  Returns TRUE if oNParent has a child named pcName. Returns
   FALSE if it does not.
 
   If oNParent has such a child, stores in *pulChildID the child's
   identifier (as used in Node_getChild). If oNParent does not have
   such a child, stores in *pulChildID the identifier that such a
-  child _would_ have if inserted.
+  child _would_ have if inserted as a directory.
 */
-boolean Node_hasChild(Node_T oNParent, Path_T oPPath,
+boolean Node_hasChild(Node_T oNParent, const char *pcName,
                       size_t *pulChildID);
 
+/*
+  Returns the identifier (as used in Node_getChild) of the first child
+  of directory oNParent that is a directory if bDirs is TRUE, or a file
+  if not, whose name's first ulLength characters are not less than the
+  ulLength characters at pcPrefix, found by binary search: the first
+  whose name starts with them, if any does, as those that do follow
+  one another. If there is none, returns the identifier after the
+  last child of that kind.
+*/
+size_t Node_findPrefix(Node_T oNParent, boolean bDirs,
+                       const char *pcPrefix, size_t ulLength);
+
 /* Returns the number of children that oNParent has. */
 size_t Node_getNumChildren(Node_T oNParent);
 
-/* Returns TRUE if oNNode is a directory, FALSE if it's a file. */
+/*
+  Returns the number of file children that oNParent has. Children
+  identifiers list all file children, in lexicographic order, before
+  all directory children, also in lexicographic order: the file
+  children have identifiers 0 through Node_getNumFileChildren - 1,
+  and the directory children the identifiers from there up to
+  Node_getNumChildren - 1.
+*/
+size_t Node_getNumFileChildren(Node_T oNParent);
+
+/*
+  Returns TRUE if oNNode is a directory, FALSE if it's a file. This
+  reads only the tag bit of the handle.
+*/
 boolean Node_isDirectory(Node_T oNNode);
 
-/* Returns contents if oNNode is a file, NULL if it's a directory. */
+/* Returns contents if oNNode is a file, NULL if it's a directory.
+   Chunked, packed, tiered, and mapped contents are returned in one
+   block (see Content_flatten, Content_unpack, Content_page, and
+   Content_getMapped), or as NULL if memory could not be allocated for
+   it or it could not be read. */
 void* Node_getContents(Node_T oNNode);
 
+/*
+  Sets *ppvResult to what Node_getContents returns for oNNode, and
+  returns SUCCESS, or MEMORY_ERROR if oNNode holds contents that could
+  not be returned in one block. Borrowed contents are set as they
+  are, even when NULL for a file of some length.
+*/
+int Node_fetchContents(Node_T oNNode, void **ppvResult);
+
 /* Returns size of contents if oNNode is a file (0 if it's a directory). */
 size_t Node_getSizeContents(Node_T oNNode);
 
+/*
+  Reports the totals for the subtree rooted at oNNode: stores in
+  *pulDirs the number of directories in it (including oNNode itself
+  if it is a directory), in *pulFiles the number of files in it
+  (including oNNode itself if it is a file), and in *pulBytes the sum
+  of those files' contents sizes. Runs in constant time, as each
+  directory keeps these totals up to date as nodes are added, removed,
+  or have their contents replaced.
+*/
+void Node_getTotals(Node_T oNNode, size_t *pulDirs, size_t *pulFiles,
+                    size_t *pulBytes);
+
+/*
+  Returns the hash of the subtree rooted at oNNode: for a file, of its
+  contents; for a directory, of the names, kinds, and hashes of its
+  children. Subtrees with the same names, kinds, and contents (as
+  they were when last set) hash the same, and ones that differ hash
+  the same only with negligible probability. Contents the FT holds
+  are hashed by their bytes, and borrowed ones, which it never reads,
+  by their address and length. Runs in constant time, as each
+  directory keeps its hash up to date, like its totals.
+*/
+uint64_t Node_getHash(Node_T oNNode);
+
 /* If oNNode is a file, updates contents to *pvNewContents and content size
- to newLenContents and return SUCCESS. Otherwise, return NOT_A_FILE. */
+ to newLenContents and return SUCCESS. Otherwise, return NOT_A_FILE.
+ Contents oNNode held in the content store or heap are released. */
 int Node_setContents(Node_T oNNode, void *pvNewContents, size_t newLenContents);
 
+/*
+  Like Node_setContents, but stores a copy of the newLenContents bytes
+  at pvNewContents (which must not be NULL) and makes the copy
+  oNNode's contents, of the kind iKind: in the content store, shared
+  with any other file whose contents are the same bytes, if it is
+  CONTENT_STORED, in the content heap, for oNNode alone, if it is
+  CONTENT_HEAP, and as tiered contents, for oNNode alone, if it is
+  CONTENT_TIERED. Contents oNNode held before are released. Returns SUCCESS,
+  NOT_A_FILE if oNNode is a directory, or MEMORY_ERROR if memory could
+  not be allocated to complete request, in which case oNNode is
+  unchanged.
+*/
+int Node_storeContents(Node_T oNNode, const void *pvNewContents,
+                       size_t newLenContents, int iKind);
+
+/*
+  Like Node_storeContents, but makes oNNode's contents of the kind
+  iKind from the newLenContents bytes at offset ulOffset of the file
+  open as iFd, with Content_load, which also takes CONTENT_MAPPED.
+  Returns SUCCESS, NOT_A_FILE if oNNode is a directory, or
+  MEMORY_ERROR or IO_ERROR if the contents could not be made (see
+  Content_load), in which case oNNode is unchanged.
+*/
+int Node_loadContents(Node_T oNNode, int iFd, size_t ulOffset,
+                      size_t newLenContents, int iKind);
+
+/*
+  Writes the contents of file oNNode to the file open as iFd, at its
+  offset, with Content_send for contents the content store, heap,
+  chunks, or others hold. Returns SUCCESS, NOT_A_FILE if oNNode is a
+  directory, or MEMORY_ERROR or IO_ERROR if they could not be written
+  (see Content_send).
+*/
+int Node_sendContents(Node_T oNNode, int iFd);
+
+/*
+  Writes the ulLength bytes at pvBytes into the contents of oNNode at
+  offset ulOffset, extending them if the bytes reach past their end,
+  with 0 bytes between their end and ulOffset if it is past it. The
+  first write chunks the contents (see contentFT.h), copying them if
+  they were not chunked, after which writes take time in proportion
+  to ulLength. Returns SUCCESS, NOT_A_FILE if oNNode is a directory,
+  or MEMORY_ERROR if memory could not be allocated to complete
+  request, in which case oNNode's contents hold the same bytes as
+  before.
+*/
+int Node_writeContents(Node_T oNNode, size_t ulOffset,
+                       const void *pvBytes, size_t ulLength);
+
+/*
+  Copies up to ulLength bytes of the contents of file oNNode from
+  offset ulOffset into pvBuf, and stores in *pulRead the number
+  copied, fewer if the end of the contents comes first. Returns
+  SUCCESS, MEMORY_ERROR if memory could not be allocated to unpack
+  the contents, or IO_ERROR if they could not be read from their
+  spill file, in which case *pulRead is 0.
+*/
+int Node_readContents(Node_T oNNode, size_t ulOffset, void *pvBuf,
+                      size_t ulLength, size_t *pulRead);
+
+/*
+  Packs the contents of the files in the subtree rooted at oNNode (see
+  Content_pack) that the content store, heap, or chunks hold for that
+  file alone, are at least ulMinLength bytes long, are not packed,
+  tiered, or mapped, and, if bColdOnly is TRUE, were not touched
+  since the last call that looked at them (see Content_cool). The
+  bytes of the files stay the same, so this may be done to nodes that
+  trees share. Contents that memory cannot be allocated to pack are
+  left as they were.
+*/
+void Node_pack(Node_T oNNode, size_t ulMinLength, boolean bColdOnly);
+
+/* If oNNode is a file whose contents are in the content store, heap,
+   or chunks, or are packed, tiered, or mapped, adds a reference to
+   them and returns them, for Content_release to drop. Returns NULL
+   otherwise. */
+void *Node_retainContents(Node_T oNNode);
+
 /*
   Returns an int SUCCESS status and sets *poNResult to be the child
   node of oNParent with identifier ulChildID, if one exists.
-  Otherwise, sets *poNResult to NULL and returns status:
+  Otherwise, sets *poNResult to NULL_NODE and returns status:
   * NO_SUCH_PATH if ulChildID is not a valid child for oNParent
 */
 int Node_getChild(Node_T oNParent, size_t ulChildID,
                   Node_T *poNResult);
 
 /*
-  Returns a the parent node of oNNode.
-  Returns NULL if oNNode is the root and thus has no parent.
+  Returns a the parent node of oNNode, i.e., the one it was created
+  or last readied by Node_own under.
+  Returns NULL_NODE if oNNode is the root and thus has no parent.
 */
 Node_T Node_getParent(Node_T oNNode);
 
 /*
-  Compares oNFirst and oNSecond lexicographically based on their paths.
-  Returns <0, 0, or >0 if onFirst is "less than", "equal to", or
-  "greater than" oNSecond, respectively.
-*/
-int Node_compare(Node_T oNFirst, Node_T oNSecond);
-
-/*
-  Returns a string representation for oNNode, or NULL if
-  there is an allocation error.
+  Returns a string representation for oNNode (its absolute path), or
+  NULL if there is an allocation error.
 
   Allocates memory for the returned string, which is then owned by
   the caller!
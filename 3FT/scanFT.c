@@ -0,0 +1,525 @@
+/*--------------------------------------------------------------------*/
+/* scanFT.c                                                           */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+/* for syscall, openat, and O_DIRECTORY, as getdents64 is Linux's */
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "scanFT.h"
+
+/* The size of the buffer getdents64 fills with entries */
+enum {DENTS_SIZE = 32768};
+
+/* An entry as getdents64 returns it */
+struct linuxDirent64
+{
+    uint64_t ulIno;
+    int64_t lOff;
+    unsigned short uReclen;
+    unsigned char ucType;
+    char acName[1];
+};
+
+/* An entry of a scanned directory */
+struct entry
+{
+    /* its name */
+    char *pcName;
+
+    /* TRUE if it is a directory */
+    boolean bIsDir;
+
+    /* the number of the directory, if it is one, or the length of the
+       contents of the file */
+    size_t ulDirOrLength;
+
+    /* the contents of the file, or NULL if it is a directory */
+    void *pvContents;
+};
+
+/* A scanned directory */
+struct dir
+{
+    /* its path relative to the scanned directory, "." for that one */
+    char *pcPath;
+
+    /* its entries, and the room for them */
+    struct entry *psEntries;
+    size_t ulNumEntries;
+    size_t ulCapacity;
+};
+
+struct scan
+{
+    /* the directories, numbered in the order they were found, and the
+       room for them */
+    struct dir **ppsDirs;
+    size_t ulNumDirs;
+    size_t ulCapacity;
+
+    /* the numbers of the directories found but not taken by a thread
+       yet, as a stack, with room for ulCapacity of them */
+    size_t *pulPending;
+    size_t ulNumPending;
+
+    /* the number of threads scanning a directory */
+    size_t ulBusy;
+
+    /* the status of the first directory or file that failed, or
+       SUCCESS */
+    int iStatus;
+
+    /* the descriptor of the scanned directory */
+    int iRootFd;
+
+    /* the totals Scan_getTotals reports */
+    size_t ulFiles;
+    size_t ulBytes;
+
+    /* guards the fields above, once the threads run, and signals that
+       a directory was queued or the scan ended */
+    pthread_mutex_t sLock;
+    pthread_cond_t sChanged;
+};
+
+/* Orders entries by name. */
+static int Scan_compareEntries(const void *pvFirst, const void *pvSecond)
+{
+    return strcmp(((const struct entry *)pvFirst)->pcName,
+                  ((const struct entry *)pvSecond)->pcName);
+}
+
+/*
+  Adds a new directory with path pcPath to oSScan, queued to be
+  scanned, and stores its number in *pulResult, which the caller
+  must hold the lock for. Returns SUCCESS, or MEMORY_ERROR if memory
+  could not be allocated.
+*/
+static int Scan_addDir(Scan_T oSScan, const char *pcPath,
+                       size_t *pulResult)
+{
+    struct dir *psDir;
+
+    if (oSScan->ulNumDirs == oSScan->ulCapacity)
+    {
+        size_t ulNewCapacity = oSScan->ulCapacity == 0 ? 64 :
+                               oSScan->ulCapacity * 2;
+        struct dir **ppsNewDirs;
+        size_t *pulNewPending;
+
+        ppsNewDirs = realloc(oSScan->ppsDirs,
+                             ulNewCapacity * sizeof(struct dir *));
+        if (ppsNewDirs == NULL)
+            return MEMORY_ERROR;
+        oSScan->ppsDirs = ppsNewDirs;
+        pulNewPending = realloc(oSScan->pulPending,
+                                ulNewCapacity * sizeof(size_t));
+        if (pulNewPending == NULL)
+            return MEMORY_ERROR;
+        oSScan->pulPending = pulNewPending;
+        oSScan->ulCapacity = ulNewCapacity;
+    }
+
+    psDir = calloc(1, sizeof(struct dir));
+    if (psDir == NULL)
+        return MEMORY_ERROR;
+    psDir->pcPath = malloc(strlen(pcPath) + 1);
+    if (psDir->pcPath == NULL)
+    {
+        free(psDir);
+        return MEMORY_ERROR;
+    }
+    strcpy(psDir->pcPath, pcPath);
+
+    *pulResult = oSScan->ulNumDirs;
+    oSScan->ppsDirs[oSScan->ulNumDirs++] = psDir;
+    oSScan->pulPending[oSScan->ulNumPending++] = *pulResult;
+    return SUCCESS;
+}
+
+/*
+  Adds an entry named pcName to psDir, a directory if bIsDir is TRUE
+  and a file otherwise, and stores it in *ppsResult. Returns SUCCESS,
+  or MEMORY_ERROR if memory could not be allocated.
+*/
+static int Scan_addEntry(struct dir *psDir, const char *pcName,
+                         boolean bIsDir, struct entry **ppsResult)
+{
+    struct entry *psEntry;
+
+    if (psDir->ulNumEntries == psDir->ulCapacity)
+    {
+        size_t ulNewCapacity = psDir->ulCapacity == 0 ? 8 :
+                               psDir->ulCapacity * 2;
+        struct entry *psNewEntries = realloc(psDir->psEntries,
+                                             ulNewCapacity *
+                                             sizeof(struct entry));
+        if (psNewEntries == NULL)
+            return MEMORY_ERROR;
+        psDir->psEntries = psNewEntries;
+        psDir->ulCapacity = ulNewCapacity;
+    }
+
+    psEntry = &psDir->psEntries[psDir->ulNumEntries];
+    psEntry->pcName = malloc(strlen(pcName) + 1);
+    if (psEntry->pcName == NULL)
+        return MEMORY_ERROR;
+    strcpy(psEntry->pcName, pcName);
+    psEntry->bIsDir = bIsDir;
+    psEntry->ulDirOrLength = 0;
+    psEntry->pvContents = NULL;
+    psDir->ulNumEntries++;
+    *ppsResult = psEntry;
+    return SUCCESS;
+}
+
+/*
+  Reads the whole contents of the file named pcName in the directory
+  open as iDirFd into psEntry. Returns SUCCESS, or IO_ERROR or
+  MEMORY_ERROR if they could not be read.
+*/
+static int Scan_readFile(int iDirFd, const char *pcName,
+                         struct entry *psEntry)
+{
+    struct stat sStat;
+    size_t ulDone = 0;
+    char *pcContents;
+    int iFd;
+
+    iFd = openat(iDirFd, pcName, O_RDONLY | O_NOFOLLOW);
+    if (iFd < 0)
+        return IO_ERROR;
+    if (fstat(iFd, &sStat) != 0)
+    {
+        (void)close(iFd);
+        return IO_ERROR;
+    }
+    pcContents = malloc((size_t)sStat.st_size + 1);
+    if (pcContents == NULL)
+    {
+        (void)close(iFd);
+        return MEMORY_ERROR;
+    }
+
+    /* a file that shrinks as it is read keeps what was there */
+    while (ulDone < (size_t)sStat.st_size)
+    {
+        ssize_t lRead = read(iFd, pcContents + ulDone,
+                             (size_t)sStat.st_size - ulDone);
+        if (lRead < 0 && errno == EINTR)
+            continue;
+        if (lRead < 0)
+        {
+            free(pcContents);
+            (void)close(iFd);
+            return IO_ERROR;
+        }
+        if (lRead == 0)
+            break;
+        ulDone += (size_t)lRead;
+    }
+    (void)close(iFd);
+    psEntry->pvContents = pcContents;
+    psEntry->ulDirOrLength = ulDone;
+    return SUCCESS;
+}
+
+/*
+  Lists directory ulDir of oSScan and reads its files, queueing its
+  subdirectories. Returns SUCCESS, or IO_ERROR or MEMORY_ERROR if the
+  directory could not be listed or a file read.
+*/
+static int Scan_dir(Scan_T oSScan, size_t ulDir)
+{
+    char *pcDents;
+    struct dir *psDir;
+    int iDirFd;
+    int iStatus = SUCCESS;
+    size_t i;
+
+    pthread_mutex_lock(&oSScan->sLock);
+    psDir = oSScan->ppsDirs[ulDir];
+    pthread_mutex_unlock(&oSScan->sLock);
+
+    iDirFd = openat(oSScan->iRootFd, psDir->pcPath,
+                    O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+    if (iDirFd < 0)
+        return IO_ERROR;
+    pcDents = malloc(DENTS_SIZE);
+    if (pcDents == NULL)
+    {
+        (void)close(iDirFd);
+        return MEMORY_ERROR;
+    }
+
+    while (iStatus == SUCCESS)
+    {
+        long lGot = syscall(SYS_getdents64, iDirFd, pcDents, DENTS_SIZE);
+        long lAt;
+
+        if (lGot < 0 && errno == EINTR)
+            continue;
+        if (lGot < 0)
+            iStatus = IO_ERROR;
+        if (lGot <= 0)
+            break;
+        for (lAt = 0; iStatus == SUCCESS && lAt < lGot;
+             lAt += ((struct linuxDirent64 *)(pcDents + lAt))->uReclen)
+        {
+            struct linuxDirent64 *psDent =
+                (struct linuxDirent64 *)(pcDents + lAt);
+            unsigned char ucType = psDent->ucType;
+            struct entry *psEntry;
+
+            if (!strcmp(psDent->acName, ".") ||
+                !strcmp(psDent->acName, ".."))
+                continue;
+
+            /* filesystems that do not report types are asked */
+            if (ucType == DT_UNKNOWN)
+            {
+                struct stat sStat;
+                if (fstatat(iDirFd, psDent->acName, &sStat,
+                            AT_SYMLINK_NOFOLLOW) != 0)
+                {
+                    iStatus = IO_ERROR;
+                    break;
+                }
+                ucType = S_ISDIR(sStat.st_mode) ? DT_DIR :
+                         S_ISREG(sStat.st_mode) ? DT_REG : DT_LNK;
+            }
+            if (ucType != DT_DIR && ucType != DT_REG)
+                continue;
+
+            iStatus = Scan_addEntry(psDir, psDent->acName,
+                                    (boolean)(ucType == DT_DIR),
+                                    &psEntry);
+            if (iStatus == SUCCESS && ucType == DT_REG)
+                iStatus = Scan_readFile(iDirFd, psDent->acName, psEntry);
+        }
+    }
+    free(pcDents);
+    (void)close(iDirFd);
+    if (iStatus != SUCCESS)
+        return iStatus;
+
+    /* the entries are sorted here, in parallel, so that they can be
+       inserted in order */
+    if (psDir->ulNumEntries > 1)
+        qsort(psDir->psEntries, psDir->ulNumEntries, sizeof(struct entry),
+              Scan_compareEntries);
+
+    pthread_mutex_lock(&oSScan->sLock);
+    for (i = 0; iStatus == SUCCESS && i < psDir->ulNumEntries; i++)
+    {
+        struct entry *psEntry = &psDir->psEntries[i];
+        if (psEntry->bIsDir)
+        {
+            char *pcPath = malloc(strlen(psDir->pcPath) +
+                                  strlen(psEntry->pcName) + 2);
+            if (pcPath == NULL)
+                iStatus = MEMORY_ERROR;
+            else
+            {
+                strcpy(pcPath, psDir->pcPath);
+                strcat(pcPath, "/");
+                strcat(pcPath, psEntry->pcName);
+                iStatus = Scan_addDir(oSScan, pcPath,
+                                      &psEntry->ulDirOrLength);
+                free(pcPath);
+            }
+        }
+        else
+        {
+            oSScan->ulFiles++;
+            oSScan->ulBytes += psEntry->ulDirOrLength;
+        }
+    }
+    pthread_cond_broadcast(&oSScan->sChanged);
+    pthread_mutex_unlock(&oSScan->sLock);
+    return iStatus;
+}
+
+/* Scans directories of the scan pvScan until none is left to scan or
+   one fails. Returns NULL. */
+static void *Scan_work(void *pvScan)
+{
+    Scan_T oSScan = pvScan;
+
+    pthread_mutex_lock(&oSScan->sLock);
+    for (;;)
+    {
+        size_t ulDir;
+        int iStatus;
+
+        /* the scan ends once no directory is queued or being scanned,
+           or one failed */
+        while (oSScan->ulNumPending == 0 && oSScan->ulBusy != 0 &&
+               oSScan->iStatus == SUCCESS)
+            pthread_cond_wait(&oSScan->sChanged, &oSScan->sLock);
+        if (oSScan->ulNumPending == 0 || oSScan->iStatus != SUCCESS)
+            break;
+
+        ulDir = oSScan->pulPending[--oSScan->ulNumPending];
+        oSScan->ulBusy++;
+        pthread_mutex_unlock(&oSScan->sLock);
+        iStatus = Scan_dir(oSScan, ulDir);
+        pthread_mutex_lock(&oSScan->sLock);
+        oSScan->ulBusy--;
+        if (iStatus != SUCCESS && oSScan->iStatus == SUCCESS)
+            oSScan->iStatus = iStatus;
+        if (oSScan->ulBusy == 0)
+            pthread_cond_broadcast(&oSScan->sChanged);
+    }
+    pthread_mutex_unlock(&oSScan->sLock);
+    return NULL;
+}
+
+int Scan_run(const char *pcDir, size_t ulThreads, Scan_T *poSResult)
+{
+    Scan_T oSScan;
+    pthread_t *psThreads;
+    size_t ulStarted = 0;
+    size_t ulRoot;
+    int iStatus;
+
+    assert(pcDir != NULL);
+    assert(ulThreads >= 1);
+    assert(poSResult != NULL);
+
+    *poSResult = NULL;
+    oSScan = calloc(1, sizeof(struct scan));
+    if (oSScan == NULL)
+        return MEMORY_ERROR;
+    oSScan->iStatus = SUCCESS;
+    oSScan->iRootFd = open(pcDir, O_RDONLY | O_DIRECTORY);
+    if (oSScan->iRootFd < 0)
+    {
+        free(oSScan);
+        return IO_ERROR;
+    }
+    pthread_mutex_init(&oSScan->sLock, NULL);
+    pthread_cond_init(&oSScan->sChanged, NULL);
+
+    psThreads = malloc(ulThreads * sizeof(pthread_t));
+    iStatus = psThreads == NULL ? MEMORY_ERROR :
+              Scan_addDir(oSScan, ".", &ulRoot);
+    if (iStatus == SUCCESS)
+    {
+        /* the scan goes on with the threads that could be started */
+        while (ulStarted < ulThreads &&
+               pthread_create(&psThreads[ulStarted], NULL, Scan_work,
+                              oSScan) == 0)
+            ulStarted++;
+        if (ulStarted == 0)
+            iStatus = MEMORY_ERROR;
+    }
+    while (ulStarted > 0)
+        pthread_join(psThreads[--ulStarted], NULL);
+    free(psThreads);
+    (void)close(oSScan->iRootFd);
+    if (iStatus == SUCCESS)
+        iStatus = oSScan->iStatus;
+    if (iStatus != SUCCESS)
+    {
+        Scan_free(oSScan);
+        return iStatus;
+    }
+    *poSResult = oSScan;
+    return SUCCESS;
+}
+
+void Scan_free(Scan_T oSScan)
+{
+    size_t i, j;
+
+    assert(oSScan != NULL);
+
+    for (i = 0; i < oSScan->ulNumDirs; i++)
+    {
+        struct dir *psDir = oSScan->ppsDirs[i];
+        for (j = 0; j < psDir->ulNumEntries; j++)
+        {
+            free(psDir->psEntries[j].pcName);
+            free(psDir->psEntries[j].pvContents);
+        }
+        free(psDir->psEntries);
+        free(psDir->pcPath);
+        free(psDir);
+    }
+    free(oSScan->ppsDirs);
+    free(oSScan->pulPending);
+    pthread_mutex_destroy(&oSScan->sLock);
+    pthread_cond_destroy(&oSScan->sChanged);
+    free(oSScan);
+}
+
+size_t Scan_getNumDirs(Scan_T oSScan)
+{
+    assert(oSScan != NULL);
+    return oSScan->ulNumDirs;
+}
+
+size_t Scan_getNumEntries(Scan_T oSScan, size_t ulDir)
+{
+    assert(oSScan != NULL);
+    assert(ulDir < oSScan->ulNumDirs);
+    return oSScan->ppsDirs[ulDir]->ulNumEntries;
+}
+
+const char *Scan_getName(Scan_T oSScan, size_t ulDir, size_t ulEntry)
+{
+    assert(oSScan != NULL);
+    assert(ulDir < oSScan->ulNumDirs);
+    assert(ulEntry < oSScan->ppsDirs[ulDir]->ulNumEntries);
+    return oSScan->ppsDirs[ulDir]->psEntries[ulEntry].pcName;
+}
+
+boolean Scan_isDirectory(Scan_T oSScan, size_t ulDir, size_t ulEntry)
+{
+    assert(oSScan != NULL);
+    assert(ulDir < oSScan->ulNumDirs);
+    assert(ulEntry < oSScan->ppsDirs[ulDir]->ulNumEntries);
+    return oSScan->ppsDirs[ulDir]->psEntries[ulEntry].bIsDir;
+}
+
+size_t Scan_getDir(Scan_T oSScan, size_t ulDir, size_t ulEntry)
+{
+    assert(Scan_isDirectory(oSScan, ulDir, ulEntry));
+    return oSScan->ppsDirs[ulDir]->psEntries[ulEntry].ulDirOrLength;
+}
+
+const void *Scan_getContents(Scan_T oSScan, size_t ulDir,
+                             size_t ulEntry, size_t *pulLength)
+{
+    struct entry *psEntry;
+
+    assert(!Scan_isDirectory(oSScan, ulDir, ulEntry));
+    assert(pulLength != NULL);
+
+    psEntry = &oSScan->ppsDirs[ulDir]->psEntries[ulEntry];
+    *pulLength = psEntry->ulDirOrLength;
+    return psEntry->pvContents;
+}
+
+void Scan_getTotals(Scan_T oSScan, size_t *pulFiles, size_t *pulBytes)
+{
+    assert(oSScan != NULL);
+    assert(pulFiles != NULL);
+    assert(pulBytes != NULL);
+
+    *pulFiles = oSScan->ulFiles;
+    *pulBytes = oSScan->ulBytes;
+}
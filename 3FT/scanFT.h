@@ -0,0 +1,66 @@
+/*--------------------------------------------------------------------*/
+/* scanFT.h                                                           */
+/* Author: Judah Guggenheim                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef SCAN_INCLUDED
+#define SCAN_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Scan_T is the hierarchy under a directory of a real filesystem,
+  read into memory by a pool of threads: the directories, each with
+  the names of its entries, and the contents of its regular files.
+  The threads take directories from a shared queue, open each with
+  openat relative to the scanned directory, list it with getdents64,
+  and read its files whole, so that the system calls of many
+  directories and files are in flight at once. Symbolic links and
+  special files are left out. The directories are numbered from 0,
+  the scanned directory, each after its parent, and the entries of
+  each are sorted by name.
+*/
+typedef struct scan *Scan_T;
+
+/*
+  Scans the directory named pcDir with ulThreads threads (at least 1).
+  Returns SUCCESS and sets *poSResult to the scan. Otherwise, sets
+  *poSResult to NULL and returns:
+  * IO_ERROR if a directory could not be listed or a file read
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Scan_run(const char *pcDir, size_t ulThreads, Scan_T *poSResult);
+
+/* Frees oSScan, the contents of its files included. */
+void Scan_free(Scan_T oSScan);
+
+/* Returns the number of directories in oSScan, the scanned one
+   included. */
+size_t Scan_getNumDirs(Scan_T oSScan);
+
+/* Returns the number of entries of directory ulDir of oSScan. */
+size_t Scan_getNumEntries(Scan_T oSScan, size_t ulDir);
+
+/* Returns the name of entry ulEntry of directory ulDir of oSScan. */
+const char *Scan_getName(Scan_T oSScan, size_t ulDir, size_t ulEntry);
+
+/* Returns TRUE if entry ulEntry of directory ulDir of oSScan is a
+   directory, and FALSE if it is a file. */
+boolean Scan_isDirectory(Scan_T oSScan, size_t ulDir, size_t ulEntry);
+
+/* Returns the number of the directory that entry ulEntry of directory
+   ulDir of oSScan is, which must be a directory. */
+size_t Scan_getDir(Scan_T oSScan, size_t ulDir, size_t ulEntry);
+
+/* Returns the contents of the file that entry ulEntry of directory
+   ulDir of oSScan is, which must be a file, and stores their length
+   in *pulLength. */
+const void *Scan_getContents(Scan_T oSScan, size_t ulDir,
+                             size_t ulEntry, size_t *pulLength);
+
+/* Stores in *pulFiles and *pulBytes the number of files in oSScan and
+   the bytes of their contents. */
+void Scan_getTotals(Scan_T oSScan, size_t *pulFiles, size_t *pulBytes);
+
+#endif